@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2013-2024  Charlie Sharpsteen, Stefan Löffler
+ * Copyright (C) 2013-2025  Charlie Sharpsteen, Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -15,8 +15,10 @@
 #include "PDFBackend.h"
 
 #include <QApplication>
+#include <QBitArray>
 #include <QPainter>
-#include <QPainterPath>
+#include <QRegion>
+#include <QtMath>
 #include <QTimeZone>
 #include <algorithm>
 #include <memory>
@@ -26,6 +28,12 @@ namespace QtPDF {
 
 namespace Backend {
 
+// Number of Page objects a Document keeps loaded (see
+// Document::releaseUnusedPages()); pages are cheap unless their text layer was
+// extracted (a few tens of kB per page), so this is large enough for the text
+// of sizeable documents to be reused by subsequent searches
+static const std::size_t MaxLoadedPages = 256;
+
 class BackendManager
 {
   std::list< std::unique_ptr<BackendInterface> > m_backendInterfaces;
@@ -213,7 +221,7 @@ Document::~Document()
 }
 
 Document::size_type Document::numPages() const { QReadLocker docLocker(_docLock.data()); return _numPages; }
-PDFPageProcessingThread &Document::processingThread() { QReadLocker docLocker(_docLock.data()); return _processingThread; }
+PDFPageProcessingThreadPool &Document::processingThreadPool() { QReadLocker docLocker(_docLock.data()); return _processingThreadPool; }
 
 QWeakPointer<Page> Document::page(size_type at)
 {
@@ -224,6 +232,124 @@ QWeakPointer<Page> Document::page(size_type at)
   return _pages[at];
 }
 
+void Document::releasePage(size_type at)
+{
+  QWriteLocker docLocker(_docLock.data());
+  if (!_releasePage(at))
+    return;
+  QMutexLocker usageLocker(&_pageUsageLock);
+  const auto it = _pageUsagePos.find(at);
+  if (it != _pageUsagePos.end()) {
+    _pageUsage.erase(it.value());
+    _pageUsagePos.erase(it);
+  }
+}
+
+bool Document::_releasePage(size_type at)
+{
+  if (at < 0 || at >= _pages.size() || _pages[at].isNull())
+    return true;
+  // Processing requests only hold plain pointers to their pages, so they must
+  // not be destroyed while any requests are pending
+  if (_processingThreadPool.hasRequestsFor(_pages[at].data()))
+    return false;
+  if (_releasedPages.size() < _pages.size())
+    _releasedPages.resize(_pages.size());
+  _releasedPages[at] = _pages[at];
+  _pages[at].clear();
+  return true;
+}
+
+void Document::touchPage(size_type at)
+{
+  QMutexLocker usageLocker(&_pageUsageLock);
+  const auto it = _pageUsagePos.find(at);
+  if (it == _pageUsagePos.end())
+    _pageUsagePos.insert(at, _pageUsage.insert(_pageUsage.end(), at));
+  else if (std::next(it.value()) != _pageUsage.end())
+    _pageUsage.splice(_pageUsage.end(), _pageUsage, it.value());
+}
+
+void Document::releaseUnusedPages(size_type keep)
+{
+  QWriteLocker docLocker(_docLock.data());
+  QMutexLocker usageLocker(&_pageUsageLock);
+  for (auto it = _pageUsage.begin(); it != _pageUsage.end() && _pageUsage.size() > MaxLoadedPages; ) {
+    const size_type at = *it;
+    if (at == keep || !_releasePage(at)) {
+      ++it;
+      continue;
+    }
+    _pageUsagePos.remove(at);
+    it = _pageUsage.erase(it);
+  }
+}
+
+bool Document::restoreReleasedPage(size_type at)
+{
+  if (at < 0 || at >= _releasedPages.size() || at >= _pages.size())
+    return false;
+  QSharedPointer<Page> page(_releasedPages[at].toStrongRef());
+  _releasedPages[at].clear();
+  if (!page)
+    return false;
+  _pages[at] = page;
+  return true;
+}
+
+QVector<Document::PageGeometry> Document::pageGeometries()
+{
+  quint64 version{0};
+  {
+    QReadLocker docLocker(_docLock.data());
+    if (_havePageGeometries)
+      return _pageGeometries;
+    version = _version;
+  }
+  // NB: Compute the geometries without holding a lock as the default
+  // implementation of computePageGeometries() may need a write lock
+  const QVector<PageGeometry> retVal = computePageGeometries();
+  QWriteLocker docLocker(_docLock.data());
+  // Don't cache the result if the document changed in the meantime
+  if (_version == version) {
+    _pageGeometries = retVal;
+    _havePageGeometries = true;
+  }
+  return retVal;
+}
+
+QVector<QSizeF> Document::pageSizes()
+{
+  const QVector<PageGeometry> geometries = pageGeometries();
+  QVector<QSizeF> retVal;
+  retVal.reserve(geometries.size());
+  for (const PageGeometry & geometry : geometries)
+    retVal.append(geometry.size);
+  return retVal;
+}
+
+QVector<Document::PageGeometry> Document::computePageGeometries()
+{
+  QVector<PageGeometry> retVal;
+  const size_type n = numPages();
+  retVal.reserve(qMax(n, size_type(0)));
+  for (size_type i = 0; i < n; ++i) {
+    QSharedPointer<Page> p(page(i).toStrongRef());
+    PageGeometry geometry;
+    if (p)
+      geometry.size = p->pageSizeF();
+    retVal.append(geometry);
+  }
+  return retVal;
+}
+
+void Document::setPageGeometries(const QVector<PageGeometry> & geometries)
+{
+  ++_version;
+  _pageGeometries = geometries;
+  _havePageGeometries = true;
+}
+
 QList<SearchResult> Document::search(const QString & searchText, const SearchFlags & flags, const size_type startPage)
 {
   QReadLocker docLocker(_docLock.data());
@@ -255,13 +381,13 @@ QList<SearchResult> Document::search(const QString & searchText, const SearchFla
 
 void Document::clearPages()
 {
-  // Clear the processing thread to ensure no task still needs the pages we are
+  // Clear the processing threads to ensure no task still needs the pages we are
   // about to destroy.
   // NB: Do this before acquiring _docLock. See clearWorkStack() documentation.
   // This should not cause any problems as we are supposed to currently be in
   // the main (GUI) thread, and only this thread is supposed to add items to the
   // work stack.
-  _processingThread.clearWorkStack();
+  _processingThreadPool.clearWorkStack();
 
   QWriteLocker docLocker(_docLock.data());
   foreach(QSharedPointer<Page> page, _pages) {
@@ -269,6 +395,22 @@ void Document::clearPages()
       continue;
     page->detachFromParent();
   }
+  // Released pages that are still used elsewhere must not refer to this
+  // document any longer, either
+  foreach(QWeakPointer<Page> releasedPage, _releasedPages) {
+    QSharedPointer<Page> page(releasedPage.toStrongRef());
+    if (page)
+      page->detachFromParent();
+  }
+  _releasedPages.clear();
+  {
+    QMutexLocker usageLocker(&_pageUsageLock);
+    _pageUsage.clear();
+    _pageUsagePos.clear();
+  }
+  ++_version;
+  _pageGeometries.clear();
+  _havePageGeometries = false;
   // Note: clear() releases all QSharedPointer to pages, thereby destroying them
   // (if they are not used elsewhere)
   _pages.clear();
@@ -339,6 +481,9 @@ void Page::detachFromParent()
 {
   QWriteLocker pageLocker(&_pageLock);
   _parent = nullptr;
+  // The text belongs to the old document version
+  QMutexLocker textLayerLocker(&_textLayerLock);
+  _textLayer.reset();
 }
 
 QRectF Page::getContentBoundingBox() const
@@ -403,22 +548,40 @@ QSharedPointer<QImage> Page::getCachedImage(double xres, double yres, QRect rend
   return _parent->pageCache().getImage(tile);
 }
 
-void Page::asyncRenderToImage(QObject *listener, double xres, double yres, QRect render_box, bool cache)
+void Page::asyncRenderToImage(QObject *listener, double xres, double yres, QRect render_box, bool cache, const PageProcessingRequest::Priority priority)
 {
   QReadLocker docLocker(_docLock.data());
   QReadLocker pageLocker(&_pageLock);
   if (!_parent)
     return;
-  _parent->processingThread().addPageProcessingRequest(new PageProcessingRenderPageRequest(this, listener, xres, yres, render_box, cache));
+  _parent->processingThreadPool().addPageProcessingRequest(new PageProcessingRenderPageRequest(this, listener, xres, yres, render_box, cache, priority));
 }
 
-bool higherResolutionThan(const PDFPageTile & t1, const PDFPageTile & t2)
+// Returns true if `t1` is better suited than `t2` as a stand-in for a tile at
+// resolution `xres`
+// Tiles that are (or were) properly rendered come before placeholders (which
+// typically are composed of other tiles themselves). Among those, the tiles
+// closest to `xres` are best, higher resolutions before lower ones. Like the
+// levels of a mip map, this ensures we scale as little as possible (in
+// particular, we don't scale down a huge image if a smaller one is available)
+// while not losing sharpness unnecessarily.
+// Note: We silently assume that xres and yres behave the same way
+static bool betterStandInThan(const PDFPageCache::CachedTile & t1, const PDFPageCache::CachedTile & t2, const double xres)
 {
-  // Note: We silently assume that xres and yres behave the same way
-  return t1.xres > t2.xres;
+  const bool isPlaceholder1 = (t1.status == PDFPageCache::PLACEHOLDER);
+  const bool isPlaceholder2 = (t2.status == PDFPageCache::PLACEHOLDER);
+  if (isPlaceholder1 != isPlaceholder2)
+    return isPlaceholder2;
+  const bool isHigher1 = (t1.tile.xres >= xres);
+  const bool isHigher2 = (t2.tile.xres >= xres);
+  if (isHigher1 != isHigher2)
+    return isHigher1;
+  if (isHigher1)
+    return t1.tile.xres < t2.tile.xres;
+  return t1.tile.xres > t2.tile.xres;
 }
 
-QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres, const double yres, QRect render_box /* = QRect() */)
+QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres, const double yres, QRect render_box /* = QRect() */, const PageProcessingRequest::Priority priority /* = PageProcessingRequest::Priority_Visible */, PDFPageCache::TileStatus * status /* = nullptr */)
 {
   QReadLocker docLocker(_docLock.data());
   QReadLocker pageLocker(&_pageLock);
@@ -431,10 +594,13 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
   // 1) it is current
   // 2) it is a placeholder (in this case, it is currently rendering in the
   // background and we don't need to do anything)
-  PDFPageCache::TileStatus status{PDFPageCache::UNKNOWN};
-  QSharedPointer<QImage> retVal = getCachedImage(xres, yres, render_box, &status);
-  if (retVal && (status == PDFPageCache::CURRENT || status == PDFPageCache::PLACEHOLDER))
+  PDFPageCache::TileStatus cachedStatus{PDFPageCache::UNKNOWN};
+  QSharedPointer<QImage> retVal = getCachedImage(xres, yres, render_box, &cachedStatus);
+  if (retVal && (cachedStatus == PDFPageCache::CURRENT || cachedStatus == PDFPageCache::PLACEHOLDER)) {
+    if (status)
+      *status = cachedStatus;
     return retVal;
+  }
 
   if (listener) {
     // Render asyncronously, but add a dummy image to the cache first and return
@@ -442,11 +608,13 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
     // Note: Start the rendering in the background before constructing the image
     // to take advantage of multi-core CPUs. Since we hold the write lock here
     // there's nothing to worry about
-    asyncRenderToImage(listener, xres, yres, render_box, true);
+    asyncRenderToImage(listener, xres, yres, render_box, true, priority);
 
-    if (retVal && status == PDFPageCache::OUTDATED) {
+    if (retVal && cachedStatus == PDFPageCache::OUTDATED) {
       // If we have an outdated image, use that as a placeholder
       _parent->pageCache().setImage(PDFPageTile(xres, yres, render_box, _parent, _n), retVal, PDFPageCache::PLACEHOLDER, false);
+      if (status)
+        *status = PDFPageCache::PLACEHOLDER;
     }
     else {
       // otherwise construct a dummy image
@@ -456,51 +624,33 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
 
       // Look through the cache to find tiles we can reuse (by scaling) for our
       // dummy tile
-      // TODO: Benchmark this. If it is actualy too slow (i.e., just keeping the
-      // rendered image from popping up due to the write lock we hold) disable it
       if (_parent) {
-        QList<PDFPageTile> tiles = _parent->pageCache().tiles();
-        for (QList<PDFPageTile>::iterator it = tiles.begin(); it != tiles.end(); ) {
-          if (it->doc != _parent || it->page_num != pageNum()) {
-            it = tiles.erase(it);
-            continue;
-          }
-          // See if it->render_box intersects with render_box (after proper scaling)
-          QRect scaledRect = QTransform::fromScale(xres / it->xres, yres / it->yres).mapRect(it->render_box);
-          if (!scaledRect.intersects(render_box)) {
-            it = tiles.erase(it);
-            continue;
-          }
-          ++it;
-        }
-        // Sort the remaining tiles by size, high-res first
-        std::sort(tiles.begin(), tiles.end(), higherResolutionThan);
-        // Finally, crop, scale and paint each image until the whole area is
-        // filled or no images are left in the list
-        QPainterPath clipPath;
-        clipPath.addRect(0, 0, render_box.width(), render_box.height());
-        foreach (PDFPageTile tile, tiles) {
-          QSharedPointer<QImage> tileImg = _parent->pageCache().getImage(tile);
-          if (!tileImg)
-            continue;
-
-          // cropRect is the part of `tile` that overlaps the tile-to-paint (after
+        QList<PDFPageCache::CachedTile> tiles = _parent->pageCache().overlappingTiles(PDFPageTile(xres, yres, render_box, _parent, _n));
+        std::sort(tiles.begin(), tiles.end(), [xres](const PDFPageCache::CachedTile & t1, const PDFPageCache::CachedTile & t2) {
+          return betterStandInThan(t1, t2, xres);
+        });
+        // Finally, paint the relevant part of each image (scaled appropriately)
+        // until the whole area is filled or no images are left in the list
+        QRegion unpainted(0, 0, render_box.width(), render_box.height());
+        for (const PDFPageCache::CachedTile & t : tiles) {
+          // paintRect is the part `t` fills of the area we paint to (after
           // proper scaling).
-          // paintRect is the part `tile` fills of the area we paint to (after
-          // proper scaling).
-          QRect cropRect = QTransform::fromScale(tile.xres / xres, tile.yres / yres).mapRect(render_box).intersected(tile.render_box).translated(-tile.render_box.left(), -tile.render_box.top());
-          QRect paintRect = QTransform::fromScale(xres / tile.xres, yres / tile.yres).mapRect(tile.render_box).intersected(render_box).translated(-render_box.left(), -render_box.top());
-
-          // Get the actual image and paint it onto the dummy tile
-          QImage tmp(tileImg->copy(cropRect).scaled(paintRect.size()));
-          p.setClipPath(clipPath);
-          p.drawImage(paintRect.topLeft(), tmp);
-
-          // Confine the clipping path to the part we have not painted to yet.
-          QPainterPath pp;
-          pp.addRect(paintRect);
-          clipPath = clipPath.subtracted(pp);
-          if (clipPath.isEmpty())
+          // cropRect is the corresponding part of `t`'s image.
+          const QRectF paintRect = QTransform::fromScale(xres / t.tile.xres, yres / t.tile.yres).mapRect(QRectF(t.tile.render_box)).intersected(QRectF(render_box)).translated(-render_box.topLeft());
+          if (!unpainted.intersects(paintRect.toAlignedRect()))
+            continue;
+          const QRectF cropRect = QTransform::fromScale(t.tile.xres / xres, t.tile.yres / yres).mapRect(paintRect.translated(render_box.topLeft())).translated(-t.tile.render_box.topLeft());
+
+          // Let QPainter crop and scale the image in one go; this avoids the
+          // temporary copies of (possibly large) images
+          p.setClipRegion(unpainted);
+          p.drawImage(paintRect, *t.image, cropRect);
+
+          // Confine the clipping region to the part we have not painted to yet.
+          // NB: Only subtract what has been covered completely so no gaps
+          // remain at the edges
+          unpainted -= QRect(QPoint(qCeil(paintRect.left()), qCeil(paintRect.top())), QPoint(qFloor(paintRect.right()) - 1, qFloor(paintRect.bottom()) - 1));
+          if (unpainted.isEmpty())
             break;
         }
       }
@@ -511,12 +661,36 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
       // Note: In the meantime the asynchronous rendering could have finished and
       // insert the final image in the cache---we must handle that case and delete
       // our temporary image
-      retVal = _parent->pageCache().setImage(PDFPageTile(xres, yres, render_box, _parent, _n), tmpImg, PDFPageCache::PLACEHOLDER, false);
+      const PDFPageTile tile(xres, yres, render_box, _parent, _n);
+      retVal = _parent->pageCache().setImage(tile, tmpImg, PDFPageCache::PLACEHOLDER, false);
+      if (status)
+        *status = (retVal == tmpImg ? PDFPageCache::PLACEHOLDER : _parent->pageCache().getStatus(tile));
     }
     return retVal;
   }
   renderToImage(xres, yres, render_box, true);
-  return getCachedImage(xres, yres, render_box);
+  return getCachedImage(xres, yres, render_box, status);
+}
+
+void Page::prefetchTile(QObject * listener, const double xres, const double yres, const QRect & render_box)
+{
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(&_pageLock);
+  if (!_parent)
+    return;
+  const PDFPageCache::TileStatus status = _parent->pageCache().getStatus(PDFPageTile(xres, yres, render_box, _parent, _n));
+  if (status == PDFPageCache::CURRENT || status == PDFPageCache::PLACEHOLDER)
+    return;
+  asyncRenderToImage(listener, xres, yres, render_box, true, PageProcessingRequest::Priority_Prefetch);
+}
+
+void Page::dropPlaceholders()
+{
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(&_pageLock);
+  if (!_parent)
+    return;
+  _parent->pageCache().removePlaceholders(_parent, _n);
 }
 
 void Page::asyncLoadLinks(QObject *listener)
@@ -525,7 +699,182 @@ void Page::asyncLoadLinks(QObject *listener)
   QReadLocker pageLocker(&_pageLock);
   if (!_parent)
     return;
-  _parent->processingThread().addPageProcessingRequest(new PageProcessingLoadLinksRequest(this, listener));
+  _parent->processingThreadPool().addPageProcessingRequest(new PageProcessingLoadLinksRequest(this, listener));
+}
+
+QSharedPointer<const PDFTextLayer> Page::textLayer() const
+{
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(&_pageLock);
+  // NB: Only one thread extracts the text; others wanting the text of the same
+  // page wait for it rather than extracting it again
+  QMutexLocker textLayerLocker(&_textLayerLock);
+  if (!_textLayer) {
+    // Don't cache anything for pages that were detached from their document
+    if (!_parent)
+      return QSharedPointer<const PDFTextLayer>(new PDFTextLayer());
+    _textLayer = QSharedPointer<const PDFTextLayer>(new PDFTextLayer(loadTextLayer()));
+  }
+  return _textLayer;
+}
+
+QList<Page::Box> Page::boxes() const
+{
+  const QSharedPointer<const PDFTextLayer> text = textLayer();
+  QList<Box> retVal;
+  retVal.reserve(text->words().size());
+  for (const PDFTextLayer::Word & word : text->words()) {
+    Box box;
+    box.boundingBox = word.boundingBox;
+    box.subBoxes.reserve(static_cast<int>(word.end - word.begin));
+    for (PDFTextLayer::size_type i = word.begin; i < word.end; ++i) {
+      Box subBox;
+      subBox.boundingBox = text->glyphBox(i);
+      box.subBoxes << subBox;
+    }
+    retVal << box;
+  }
+  return retVal;
+}
+
+QString Page::selectedText(const QList<QPolygonF> & selection, BoxBoundaryList * wordBoxes /* = nullptr */, BoxBoundaryList * charBoxes /* = nullptr */, const bool onlyFullyEnclosed /* = false */) const
+{
+  // Since the text layer doesn't contain any space glyphs (only separators
+  // inferred from the layout), the selection will contain a list of words.
+  // Hence, by iterating over them, we get a list of words with no whitespace
+  // inbetween
+  QString retVal;
+  bool insertSpace = false;
+
+  if (wordBoxes) {
+    wordBoxes->clear();
+  }
+  if (charBoxes) {
+    charBoxes->clear();
+  }
+  if (selection.isEmpty()) {
+    return retVal;
+  }
+
+  const QSharedPointer<const PDFTextLayer> text = textLayer();
+  QRectF selectionBoundingBox;
+  for (const QPolygonF & p : selection) {
+    selectionBoundingBox = selectionBoundingBox.united(p.boundingRect());
+  }
+
+  const PDFTextLayer::Word * lastWord = nullptr;
+  for (const PDFTextLayer::Line & line : text->lines()) {
+    // Skip entire lines (and words below) that are clearly outside the
+    // selection without checking each character
+    if (!line.boundingBox.intersects(selectionBoundingBox))
+      continue;
+    for (PDFTextLayer::size_type iWord = line.beginWord; iWord < line.endWord; ++iWord) {
+      const PDFTextLayer::Word & word = text->words()[iWord];
+      if (!word.boundingBox.intersects(selectionBoundingBox))
+        continue;
+
+      // Determine which characters to include (if any)
+      QBitArray include(static_cast<int>(word.end - word.begin));
+      for (PDFTextLayer::size_type i = word.begin; i < word.end; ++i) {
+        const QRectF charBox = text->glyphBox(i);
+        QPolygonF remainder(charBox);
+        for (const QPolygonF & p : selection) {
+          // Include characters if they are entirely inside the selection area
+          // or onlyFullyEnclosed == false; using "intersection only" can cause
+          // problems for overlapping char boxes (if the selection is made of
+          // entire char boxes, it would return characters that are not
+          // actually inside the selection but are just "edge cases") but is
+          // necessary if the selection comes from external sources, such as
+          // SyncTeX
+          if (p.intersected(charBox).empty())
+            continue;
+          if (!onlyFullyEnclosed) {
+            include.setBit(static_cast<int>(i - word.begin));
+            break;
+          }
+          remainder = remainder.subtracted(p);
+          if (remainder.empty()) {
+            include.setBit(static_cast<int>(i - word.begin));
+            break;
+          }
+        }
+      }
+      if (include.count(true) == 0) continue;
+
+      // If we get here, we found a word that is at least partially selected,
+      // so we append the appropriate text
+
+      // Guess ends of lines (relative to the last selected word)
+      if (lastWord && PDFTextLayer::isNewLine(lastWord->boundingBox, word.boundingBox)) {
+        retVal += QString::fromLatin1("\n");
+
+        if (wordBoxes)
+          (*wordBoxes).append(lastWord->boundingBox);
+        if (charBoxes)
+          (*charBoxes).append(lastWord->boundingBox);
+        // If we queued a space to be inserted, ignore that as we inserted a
+        // newline instead anyway
+        insertSpace = false;
+      }
+
+      if (insertSpace && lastWord) {
+        retVal += QString::fromLatin1(" ");
+
+        // As word and char Boxes, insert those of the lastWord since that was
+        // the one causing insertSpace to be true
+        if (wordBoxes)
+          (*wordBoxes).append(lastWord->boundingBox);
+        if (charBoxes)
+          (*charBoxes).append(lastWord->boundingBox);
+      }
+      // Default to not inserting a space after this word
+      insertSpace = false;
+
+      // Insert the actual characters
+      for (PDFTextLayer::size_type i = word.begin; i < word.end; ++i) {
+        if (!include.testBit(static_cast<int>(i - word.begin))) continue;
+
+        retVal += text->text()[i];
+
+        if (wordBoxes)
+          (*wordBoxes).append(word.boundingBox);
+        if (charBoxes)
+          (*charBoxes).append(text->glyphBox(i));
+
+        // If we reached the end of the word, possibly queue a space to be
+        // inserted. By queuing this until the next word is processed, we
+        // ensure that spaces are not inserted at the end of the string or
+        // before newlines
+        if (i == word.end - 1)
+          insertSpace = word.spaceAfter;
+      }
+      // Remember the last processed word (required for detecting newlines and
+      // inserting spaces)
+      lastWord = &word;
+    }
+  }
+
+  return retVal;
+}
+
+QList<SearchResult> Page::search(const QString & searchText, const SearchFlags & flags) const
+{
+  QList<SearchResult> results;
+  const QSharedPointer<const PDFTextLayer> text = textLayer();
+  const Qt::CaseSensitivity caseSensitivity = (flags.testFlag(Search_CaseInsensitive) ? Qt::CaseInsensitive : Qt::CaseSensitive);
+
+  SearchResult result;
+  result.pageNum = _n;
+  for (const QVector<QRectF> & lineBoxes : text->search(searchText, caseSensitivity)) {
+    result.bbox = QRectF();
+    for (const QRectF & box : lineBoxes)
+      result.bbox = result.bbox.united(box);
+    result.lineBoxes = lineBoxes;
+    results << result;
+  }
+  if (flags.testFlag(Search_Backwards))
+    std::reverse(results.begin(), results.end());
+  return results;
 }
 
 //static
@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2013-2024  Charlie Sharpsteen, Stefan Löffler
+ * Copyright (C) 2013-2025  Charlie Sharpsteen, Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -18,6 +18,7 @@
 #include "PDFFontInfo.h"
 #include "PDFPageCache.h"
 #include "PDFPageProcessingThread.h"
+#include "PDFTextLayer.h"
 #include "PDFToC.h"
 #include "PDFTransitions.h"
 
@@ -26,6 +27,8 @@
 #include <QReadLocker>
 #include <QWeakPointer>
 
+#include <list>
+
 namespace QtPDF {
 
 namespace Backend {
@@ -88,13 +91,40 @@ public:
   // Uses doc-read-lock
   QString fileName() const { QReadLocker docLocker(_docLock.data()); return _fileName; }
   // Uses doc-read-lock
-  PDFPageProcessingThread& processingThread();
+  PDFPageProcessingThreadPool& processingThreadPool();
   static PDFPageCache& pageCache() { return _pageCache; }
 
   // Uses doc-read-lock and may use doc-write-lock
   // NB: no const variant exists as we may need to create a new Page (if it was
   // not cached in _pages), which requires a non-const `this` pointer as parent
   virtual QWeakPointer<Page> page(size_type at);
+  // Drops the document's own reference to the Page object `at` (if it exists)
+  // to free the resources it holds (e.g., its text layer) while it is not
+  // needed, e.g., because it is far from what is displayed. The page stays
+  // valid as long as it is used elsewhere; page() reuses or recreates it as
+  // necessary. Pages with pending processing requests are not released.
+  // NB: The document also releases the pages used least recently by itself if
+  // too many are loaded (see releaseUnusedPages()), regardless of who needed
+  // them (e.g., the view, a search, or prefetching).
+  // Uses doc-write-lock
+  void releasePage(size_type at);
+
+  // The geometry of a page, as far as it is needed to lay out pages
+  struct PageGeometry {
+    // Size (in pt) as displayed, i.e., with the page's rotation applied
+    QSizeF size;
+  };
+  // Changes every time the pages of the document (may) change, e.g., when it is
+  // (re)loaded; can be used to tell if data derived from the pages is outdated
+  // Uses doc-read-lock
+  quint64 version() const { QReadLocker docLocker(_docLock.data()); return _version; }
+  // Returns the geometry of all pages, e.g., to lay them out. The result is
+  // computed only once per version().
+  // Uses doc-read-lock and may use doc-write-lock (see computePageGeometries())
+  QVector<PageGeometry> pageGeometries();
+  // Returns the sizes (in pt) of all pages; see pageGeometries()
+  // Uses doc-read-lock and may use doc-write-lock
+  QVector<QSizeF> pageSizes();
   virtual PDFDestination resolveDestination(const PDFDestination & namedDestination) const {
     return (namedDestination.isExplicit() ? namedDestination : PDFDestination());
   }
@@ -112,6 +142,24 @@ public:
   // Uses doc-write-lock
   virtual void reload() = 0;
 
+  // Reloading in two steps keeps the expensive part (reading and parsing the
+  // file, comparing the pages, etc.) off the GUI thread. prepareReload() does
+  // not change the document and may be called from any thread; it returns
+  // early (and nullptr) if `abortFlag` gets set. finishReload() then replaces
+  // the contents of the document with the prepared ones; like reload(), it
+  // must be called from the main (GUI) thread.
+  // The default implementations don't prepare anything and simply reload()
+  // when finishing, respectively.
+  class PreparedReload
+  {
+  public:
+    virtual ~PreparedReload() = default;
+  };
+  // Uses doc-read-lock
+  virtual QSharedPointer<PreparedReload> prepareReload(const AbortFlag * abortFlag = nullptr) { Q_UNUSED(abortFlag); return {}; }
+  // Uses doc-write-lock
+  virtual void finishReload(QSharedPointer<PreparedReload> prepared) { Q_UNUSED(prepared); reload(); }
+
   // Returns `true` if unlocking was successful and `false` otherwise.
   // Uses doc-read-lock and may use doc-write-lock
   virtual bool unlock(const QString password) = 0;
@@ -156,11 +204,47 @@ protected:
 
   void clearPages();
   virtual void clearMetaData();
+  // Computes the geometry of all pages for pageGeometries(). Backends should
+  // override this to avoid creating Page objects for that.
+  // Uses doc-read-lock and may use doc-write-lock (see page())
+  virtual QVector<PageGeometry> computePageGeometries();
+  // Stores `geometries` as the page geometries of a new version()
+  // Requires a doc-write-lock
+  void setPageGeometries(const QVector<PageGeometry> & geometries);
+  // Puts page `at` back into _pages if it was released by releasePage() but is
+  // still alive; returns true on success
+  // Requires a doc-write-lock
+  bool restoreReleasedPage(size_type at);
+  // Removes page `at` from _pages for releasePage() (without updating
+  // _pageUsage); returns false if the page is loaded but cannot be released
+  // Requires a doc-write-lock
+  bool _releasePage(size_type at);
+  // Marks page `at` (which must be in _pages) as the one used most recently;
+  // backends call this whenever page() returns a page
+  // Requires a doc-read-lock
+  void touchPage(size_type at);
+  // Releases the pages used least recently (except page `keep`) while more
+  // than MaxLoadedPages are loaded; backends call this after adding a page to
+  // _pages
+  // Uses doc-write-lock
+  void releaseUnusedPages(size_type keep);
 
   size_type _numPages{-1};
-  PDFPageProcessingThread _processingThread;
+  PDFPageProcessingThreadPool _processingThreadPool;
   static PDFPageCache _pageCache;
   QVector< QSharedPointer<Page> > _pages;
+  // Pages dropped from _pages by releasePage()
+  QVector< QWeakPointer<Page> > _releasedPages;
+  // Indices of the pages in _pages, from least to most recently used, and the
+  // position of each index in that list; protected by _pageUsageLock (see
+  // touchPage())
+  std::list<size_type> _pageUsage;
+  QHash< size_type, std::list<size_type>::iterator > _pageUsagePos;
+  QMutex _pageUsageLock;
+  quint64 _version{0};
+  // Cache for pageGeometries(); only valid if _havePageGeometries is true
+  QVector<PageGeometry> _pageGeometries;
+  bool _havePageGeometries{false};
   Permissions _permissions;
 
   QString _fileName;
@@ -205,7 +289,15 @@ protected:
   QSharedPointer<QImage> getCachedImage(double xres, double yres, QRect render_box = QRect(), PDFPageCache::TileStatus * status = nullptr);
 
   // Uses doc-read-lock and page-read-lock.
-  virtual void asyncRenderToImage(QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false);
+  virtual void asyncRenderToImage(QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false, const PageProcessingRequest::Priority priority = PageProcessingRequest::Priority_Visible);
+
+  // Extracts the text of the page from the backend; see textLayer()
+  // The caller holds a doc-read-lock and a page-read-lock.
+  virtual PDFTextLayer loadTextLayer() const { return PDFTextLayer(); }
+
+private:
+  mutable QSharedPointer<const PDFTextLayer> _textLayer;
+  mutable QMutex _textLayerLock;
 
 public:
   // Class to encapsulate boxes, e.g., for selecting
@@ -238,7 +330,9 @@ public:
   // of characters) to speed up hit calculations. Only one level of subboxes is
   // currently supported. The big box boundingBox must completely encompass all
   // subBoxes' boundingBoxes.
-  virtual QList<Box> boxes() const { return QList<Box>(); }
+  // The default implementation returns the words (with their characters as
+  // subboxes) of the textLayer().
+  virtual QList<Box> boxes() const;
   // Return selected text
   // The returned text should contain all characters inside (at least) one of
   // the `selection` polygons.
@@ -246,41 +340,58 @@ public:
   // Optionally, the function can also return wordBoxes and/or charBoxes for
   // each character (i.e., a rect enclosing the word the character is part of
   // and/or a rect enclosing the actual character)
-  virtual QString selectedText(const QList<QPolygonF> & selection, BoxBoundaryList * wordBoxes = nullptr, BoxBoundaryList * charBoxes = nullptr, const bool onlyFullyEnclosed = false) const {
-    Q_UNUSED(selection)
-    Q_UNUSED(onlyFullyEnclosed)
-    if (wordBoxes) wordBoxes->clear();
-    if (charBoxes) charBoxes->clear();
-    return QString();
-  }
+  // The default implementation is based on the textLayer().
+  virtual QString selectedText(const QList<QPolygonF> & selection, BoxBoundaryList * wordBoxes = nullptr, BoxBoundaryList * charBoxes = nullptr, const bool onlyFullyEnclosed = false) const;
 
   // Uses page-read-lock and doc-read-lock.
-  virtual QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false) const = 0;
+  // If `abortFlag` is given and gets set while rendering, the backend may stop
+  // as soon as possible and return a null image (in which case nothing is
+  // cached).
+  virtual QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false, const AbortFlag * abortFlag = nullptr) const = 0;
 
   // Returns either a cached image (if it exists), or triggers a render request.
   // If listener != nullptr, this is an asynchronous render request and the method
   // returns a dummy image (which is added to the cache to speed up future
   // requests). Otherwise, the method renders the page synchronously and returns
   // the result.
+  // `priority` is used for asynchronous render requests. If `status` is given,
+  // it receives the status of the returned image, i.e., CURRENT or PLACEHOLDER
+  // (or UNKNOWN if no image could be obtained).
+  // Uses page-read-lock and doc-read-lock.
+  QSharedPointer<QImage> getTileImage(QObject * listener, const double xres, const double yres, QRect render_box = QRect(), const PageProcessingRequest::Priority priority = PageProcessingRequest::Priority_Visible, PDFPageCache::TileStatus * status = nullptr);
+  // Requests the tile to be rendered (and cached) in the background at
+  // Priority_Prefetch unless it is cached (or being rendered) already. Unlike
+  // getTileImage(), this does not create a placeholder.
   // Uses page-read-lock and doc-read-lock.
-  QSharedPointer<QImage> getTileImage(QObject * listener, const double xres, const double yres, QRect render_box = QRect());
+  void prefetchTile(QObject * listener, const double xres, const double yres, const QRect & render_box);
+  // Removes the placeholders of this page from the cache so they get composed
+  // anew (from the tiles available by then) the next time they are requested;
+  // pending render requests are not affected
+  // Uses page-read-lock and doc-read-lock.
+  void dropPlaceholders();
 
   virtual QList< QSharedPointer<Annotation::AbstractAnnotation> > loadAnnotations() { return QList< QSharedPointer<Annotation::AbstractAnnotation> >(); }
 
+  // Returns a value that changes whenever the appearance of the page changes
+  // (as far as the backend can tell), e.g., to find out which pages actually
+  // changed when reloading a document. An empty value means "unknown".
+  // This can be expensive as it may involve rendering the page.
+  // Uses page-read-lock and doc-read-lock.
+  virtual QByteArray fingerprint() const { return QByteArray(); }
+
+  // Returns the text of the page. It is extracted from the backend (see
+  // loadTextLayer()) on first use and kept until the page is detached from
+  // its document (i.e., when the document is reloaded), so it is cheap to
+  // query it repeatedly, e.g., when searching or selecting text.
+  // Uses doc-read-lock and page-read-lock.
+  QSharedPointer<const PDFTextLayer> textLayer() const;
+
   // Searches the page for the given text string and returns a list of boxes
   // that contain that text.
-  //
-  // TODO:
-  //
-  // Implement as a function that returns a generator object which can return
-  // the search results one at a time rather than all at once which is time
-  // consuming. Even better, allow the returned object to be used as a C++
-  // iterator---then we could pass it off to QtConcurrent to generate results
-  // in the background and access them through a QFuture.
-  //
-  // This is very tricky to do in C++. God I miss Python and its `itertools`
-  // library.
-  virtual QList<SearchResult> search(const QString & searchText, const SearchFlags & flags) const = 0;
+  // The default implementation searches the textLayer().
+  // Thread-safe; different pages can be searched concurrently (see
+  // PDFSearcher).
+  virtual QList<SearchResult> search(const QString & searchText, const SearchFlags & flags) const;
   static QList<SearchResult> executeSearch(SearchRequest request);
 };
 
@@ -295,10 +406,14 @@ struct SearchRequest
 struct SearchResult
 {
   Document::size_type pageNum;
+  // Bounding box of the whole match
   QRectF bbox;
+  // Bounding boxes of the parts of the match on each line it spans; may be
+  // empty if the backend only provides bbox
+  QVector<QRectF> lineBoxes;
 
   bool operator==(const SearchResult & o) const {
-    return (pageNum == o.pageNum && bbox == o.bbox);
+    return (pageNum == o.pageNum && bbox == o.bbox && lineBoxes == o.lineBoxes);
   }
 };
 
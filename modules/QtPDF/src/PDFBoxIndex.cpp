@@ -0,0 +1,208 @@
+/**
+ * Copyright (C) 2025  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#include "PDFBoxIndex.h"
+
+#include <QtMath>
+#include <algorithm>
+
+namespace QtPDF {
+
+// Upper bound on the number of columns and rows, respectively, to keep the
+// memory footprint of the grid in check (e.g., for degenerate input)
+static const int MaxGridSize = 512;
+
+PDFBoxIndex::PDFBoxIndex(const QVector<QRectF> & rects)
+{
+  if (rects.isEmpty())
+    return;
+
+  _rects.reserve(rects.size());
+  double left{0}, top{0}, right{0}, bottom{0};
+  for (const QRectF & rect : rects) {
+    const QRectF r = rect.normalized();
+    if (_rects.isEmpty()) {
+      left = r.left();
+      top = r.top();
+      right = r.right();
+      bottom = r.bottom();
+    }
+    else {
+      left = qMin(left, r.left());
+      top = qMin(top, r.top());
+      right = qMax(right, r.right());
+      bottom = qMax(bottom, r.bottom());
+    }
+    _rects.append(r);
+  }
+  _bounds = QRectF(QPointF(left, top), QPointF(right, bottom));
+
+  // Aim at about one rectangle per (roughly square) cell
+  const double width = qMax(_bounds.width(), 1e-3);
+  const double height = qMax(_bounds.height(), 1e-3);
+  const double cellSize = qSqrt(width * height / _rects.size());
+  _numColumns = qBound(1, qCeil(width / cellSize), MaxGridSize);
+  _numRows = qBound(1, qCeil(height / cellSize), MaxGridSize);
+  _cellWidth = width / _numColumns;
+  _cellHeight = height / _numRows;
+
+  // Fill the cells in two passes: first count the rectangles per cell to set
+  // up _cellStart, then store the indices
+  _cellStart.fill(0, _numColumns * _numRows + 1);
+  for (const QRectF & r : _rects) {
+    for (size_type row = cellRow(r.top()); row <= cellRow(r.bottom()); ++row) {
+      for (size_type column = cellColumn(r.left()); column <= cellColumn(r.right()); ++column)
+        ++_cellStart[row * _numColumns + column + 1];
+    }
+  }
+  for (size_type i = 1; i < _cellStart.size(); ++i)
+    _cellStart[i] += _cellStart[i - 1];
+
+  _cellItems.resize(_cellStart.last());
+  QVector<size_type> fillPos{_cellStart};
+  for (size_type i = 0; i < _rects.size(); ++i) {
+    const QRectF & r = _rects[i];
+    for (size_type row = cellRow(r.top()); row <= cellRow(r.bottom()); ++row) {
+      for (size_type column = cellColumn(r.left()); column <= cellColumn(r.right()); ++column)
+        _cellItems[fillPos[row * _numColumns + column]++] = i;
+    }
+  }
+}
+
+PDFBoxIndex::size_type PDFBoxIndex::cellColumn(const double x) const
+{
+  return qBound(size_type(0), static_cast<size_type>(qFloor((x - _bounds.left()) / _cellWidth)), _numColumns - 1);
+}
+
+PDFBoxIndex::size_type PDFBoxIndex::cellRow(const double y) const
+{
+  return qBound(size_type(0), static_cast<size_type>(qFloor((y - _bounds.top()) / _cellHeight)), _numRows - 1);
+}
+
+PDFBoxIndex::size_type PDFBoxIndex::indexAt(const QPointF & pt) const
+{
+  if (isEmpty())
+    return -1;
+  // Points outside the grid are mapped to the closest cell; they are not
+  // contained in any of its rectangles, though
+  const size_type cell = cellRow(pt.y()) * _numColumns + cellColumn(pt.x());
+  // NB: The indices in each cell are sorted
+  for (size_type i = _cellStart[cell]; i < _cellStart[cell + 1]; ++i) {
+    if (_rects[_cellItems[i]].contains(pt))
+      return _cellItems[i];
+  }
+  return -1;
+}
+
+QVector<PDFBoxIndex::size_type> PDFBoxIndex::intersecting(const QRectF & rect) const
+{
+  QVector<size_type> retVal;
+  if (isEmpty())
+    return retVal;
+  const QRectF r = rect.normalized();
+  if (r.right() < _bounds.left() || r.left() > _bounds.right() || r.bottom() < _bounds.top() || r.top() > _bounds.bottom())
+    return retVal;
+
+  for (size_type row = cellRow(r.top()); row <= cellRow(r.bottom()); ++row) {
+    for (size_type column = cellColumn(r.left()); column <= cellColumn(r.right()); ++column) {
+      const size_type cell = row * _numColumns + column;
+      for (size_type i = _cellStart[cell]; i < _cellStart[cell + 1]; ++i) {
+        if (_rects[_cellItems[i]].intersects(r))
+          retVal.append(_cellItems[i]);
+      }
+    }
+  }
+  // Rectangles spanning several cells may have been found more than once
+  std::sort(retVal.begin(), retVal.end());
+  retVal.erase(std::unique(retVal.begin(), retVal.end()), retVal.end());
+  return retVal;
+}
+
+PDFBoxIndex::size_type PDFBoxIndex::nearest(const QPointF & pt) const
+{
+  if (isEmpty())
+    return -1;
+
+  size_type best{-1};
+  double bestDistance{0};
+  const auto checkCell = [&](const size_type row, const size_type column) {
+    const size_type cell = row * _numColumns + column;
+    for (size_type i = _cellStart[cell]; i < _cellStart[cell + 1]; ++i) {
+      const size_type index = _cellItems[i];
+      const double d = distance(pt, _rects[index]);
+      if (best < 0 || d < bestDistance || (d == bestDistance && index < best)) {
+        best = index;
+        bestDistance = d;
+      }
+    }
+  };
+
+  // Search the cells in rings of growing size around the cell containing `pt`
+  // (or the closest one if `pt` is outside the grid)
+  const size_type row = cellRow(pt.y());
+  const size_type column = cellColumn(pt.x());
+  for (size_type ring = 0; ; ++ring) {
+    const size_type r0 = row - ring, r1 = row + ring;
+    const size_type c0 = column - ring, c1 = column + ring;
+    for (size_type r = qMax(r0, size_type(0)); r <= qMin(r1, _numRows - 1); ++r) {
+      if (r == r0 || r == r1) {
+        for (size_type c = qMax(c0, size_type(0)); c <= qMin(c1, _numColumns - 1); ++c)
+          checkCell(r, c);
+      }
+      else {
+        if (c0 >= 0)
+          checkCell(r, c0);
+        if (c1 < _numColumns)
+          checkCell(r, c1);
+      }
+    }
+
+    // Rectangles that were not found yet don't overlap any of the cells
+    // searched so far, so their distance to `pt` is at least the distance to
+    // the border of the searched area (except where that coincides with the
+    // border of the grid)
+    bool searchedAll{true};
+    double bound{0};
+    const auto updateBound = [&](const bool atBorder, const double d) {
+      if (atBorder)
+        return;
+      bound = (searchedAll ? d : qMin(bound, d));
+      searchedAll = false;
+    };
+    updateBound(c0 <= 0, pt.x() - (_bounds.left() + c0 * _cellWidth));
+    updateBound(c1 >= _numColumns - 1, _bounds.left() + (c1 + 1) * _cellWidth - pt.x());
+    updateBound(r0 <= 0, pt.y() - (_bounds.top() + r0 * _cellHeight));
+    updateBound(r1 >= _numRows - 1, _bounds.top() + (r1 + 1) * _cellHeight - pt.y());
+    if (searchedAll || (best >= 0 && bound > bestDistance))
+      break;
+  }
+  return best;
+}
+
+// static
+double PDFBoxIndex::distance(const QPointF & pt, const QRectF & rect)
+{
+  double dx{0}, dy{0};
+  if (pt.x() < rect.left())
+    dx = rect.left() - pt.x();
+  else if (pt.x() > rect.right())
+    dx = pt.x() - rect.right();
+  if (pt.y() < rect.top())
+    dy = rect.top() - pt.y();
+  else if (pt.y() > rect.bottom())
+    dy = pt.y() - rect.bottom();
+  return dx + dy;
+}
+
+} // namespace QtPDF
@@ -0,0 +1,79 @@
+/**
+ * Copyright (C) 2025  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFBoxIndex_H
+#define PDFBoxIndex_H
+
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+namespace QtPDF {
+
+// Spatial index over a list of rectangles (e.g., the word boxes of a page) to
+// find the rectangles at or near a given position without going through all
+// of them (e.g., for hit testing while the mouse moves).
+// The rectangles are distributed over a uniform grid with (on average) about
+// one rectangle per cell; each rectangle is registered in all cells it
+// overlaps. Queries only look at the cells concerned, so they take roughly
+// O(1 + k) time for k results (provided the rectangles are not too unevenly
+// distributed, which is usually the case for text).
+// All queries report indices into the list of rectangles passed to the
+// constructor; ties are resolved in favor of the smallest index.
+class PDFBoxIndex
+{
+public:
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+  using size_type = int;
+#else
+  using size_type = qsizetype;
+#endif
+
+  PDFBoxIndex() = default;
+  explicit PDFBoxIndex(const QVector<QRectF> & rects);
+
+  size_type size() const { return _rects.size(); }
+  bool isEmpty() const { return _rects.isEmpty(); }
+
+  // Returns the index of the first rectangle containing `pt`, or -1 if there
+  // is none
+  size_type indexAt(const QPointF & pt) const;
+  // Returns the (sorted) indices of all rectangles intersecting `rect`
+  QVector<size_type> intersecting(const QRectF & rect) const;
+  // Returns the index of the rectangle with the smallest Manhattan distance to
+  // `pt` (0 for rectangles containing it), or -1 if the index is empty
+  size_type nearest(const QPointF & pt) const;
+
+  // Manhattan distance between `pt` and the closest point of `rect`
+  static double distance(const QPointF & pt, const QRectF & rect);
+
+private:
+  size_type cellColumn(const double x) const;
+  size_type cellRow(const double y) const;
+
+  QVector<QRectF> _rects;
+  QRectF _bounds;
+  size_type _numColumns{0};
+  size_type _numRows{0};
+  double _cellWidth{1};
+  double _cellHeight{1};
+  // The indices of the rectangles in cell (column, row) are
+  // _cellItems[_cellStart[row * _numColumns + column]] to
+  // _cellItems[_cellStart[row * _numColumns + column + 1] - 1]
+  QVector<size_type> _cellStart;
+  QVector<size_type> _cellItems;
+};
+
+} // namespace QtPDF
+
+#endif // !defined(PDFBoxIndex_H)
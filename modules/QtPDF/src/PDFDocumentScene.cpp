@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2023-2024  Stefan Löffler
+ * Copyright (C) 2023-2025  Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -22,6 +22,11 @@
 
 namespace QtPDF {
 
+// Number of page items that may keep their contents loaded (see
+// PDFDocumentScene::recyclePageItems()); items close to what is shown in any
+// view are never unloaded, though
+static const int MaxLoadedPageItems = 16;
+
 // PDFDocumentScene
 // ================
 //
@@ -100,13 +105,26 @@ PDFDocumentScene::PDFDocumentScene(QSharedPointer<Backend::Document> a_doc, QObj
   _reloadTimer.setInterval(500);
   connect(&_reloadTimer, &QTimer::timeout, this, &PDFDocumentScene::reloadDocument);
   connect(&_fileWatcher, &QFileSystemWatcher::fileChanged, &_reloadTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+  // Any reload that is still running is outdated as soon as the file changes
+  // again
+  connect(&_fileWatcher, &QFileSystemWatcher::fileChanged, this, &PDFDocumentScene::abortReload);
+  connect(&_reloadWatcher, &QFutureWatcher< QSharedPointer<Backend::Document::PreparedReload> >::finished, this, &PDFDocumentScene::finishReload);
   setWatchForDocumentChangesOnDisk(true);
 
+  // Unloading is deferred as it must not happen while painting
+  _recycleTimer.setSingleShot(true);
+  _recycleTimer.setInterval(200);
+  connect(&_recycleTimer, &QTimer::timeout, this, &PDFDocumentScene::recyclePageItems);
+
   reinitializeScene();
 }
 
 PDFDocumentScene::~PDFDocumentScene()
 {
+  // The background reload uses _doc, so wait for it to finish (which should
+  // not take long once aborted)
+  abortReload();
+  _reloadWatcher.waitForFinished();
   // Destroy the _unlockProxy if it is not currently attached to the scene (in
   // which case it is destroyed automatically)
   if (!_unlockProxy->scene()) {
@@ -300,6 +318,7 @@ void PDFDocumentScene::reinitializeScene()
     removeItem(_unlockProxy);
   clear();
   _pages.clear();
+  _loadedPageItems.clear();
   _pageLayout.clearPages();
 
   _lastPage = _doc->numPages();
@@ -312,13 +331,17 @@ void PDFDocumentScene::reinitializeScene()
   }
   else {
     // Create a `PDFPageGraphicsItem` for each page in the PDF document and let
-    // them be layed out by a `PDFPageLayout` instance.
+    // them be layed out by a `PDFPageLayout` instance. Only the page sizes are
+    // needed for that; everything else (including the backend Page objects) is
+    // only loaded once the items are painted (and unloaded again by
+    // recyclePageItems()), so this is cheap even for large documents.
     if (_shownPageIdx >= _lastPage)
       _shownPageIdx = _lastPage - 1;
 
+    const QVector<QSizeF> pageSizes = _doc->pageSizes();
     for (size_type i = 0; i < _lastPage; ++i)
     {
-      PDFPageGraphicsItem * pagePtr = new PDFPageGraphicsItem(_doc->page(i), _dpiX, _dpiY);
+      PDFPageGraphicsItem * pagePtr = new PDFPageGraphicsItem(_doc.toWeakRef(), i, pageSizes.value(i), _dpiX, _dpiY);
       pagePtr->setVisible(i == _shownPageIdx || _shownPageIdx == -2);
       _pages.append(pagePtr);
       addItem(pagePtr);
@@ -340,11 +363,39 @@ void PDFDocumentScene::reloadDocument()
   if(!QFile::exists(_doc->fileName()))
     return;
 
-  _doc->reload();
+  // Read and parse the new file contents in the background; the old ones
+  // remain visible until they are replaced in finishReload()
+  abortReload();
+  _reloadAbortFlag = std::make_shared<AbortFlag>(false);
+  const std::shared_ptr<AbortFlag> abortFlag{_reloadAbortFlag};
+  const QSharedPointer<Backend::Document> doc{_doc};
+  _reloadWatcher.setFuture(QtConcurrent::run([doc, abortFlag]() { return doc->prepareReload(abortFlag.get()); }));
+}
+
+void PDFDocumentScene::finishReload()
+{
+  // Ignore reloads that have been aborted in the meantime (e.g., because the
+  // file changed again); a new one is on its way in that case
+  if (!_reloadAbortFlag || *_reloadAbortFlag)
+    return;
+  _reloadAbortFlag.reset();
+
+  const QSharedPointer<Backend::Document::PreparedReload> prepared{_reloadWatcher.result()};
+  // Don't keep the prepared contents alive any longer than necessary
+  _reloadWatcher.setFuture(QFuture< QSharedPointer<Backend::Document::PreparedReload> >());
+
+  // Swap in the new contents all at once
+  _doc->finishReload(prepared);
   reinitializeScene();
   emit documentChanged(_doc.toWeakRef());
 }
 
+void PDFDocumentScene::abortReload()
+{
+  if (_reloadAbortFlag)
+    *_reloadAbortFlag = true;
+}
+
 
 // Other
 // -----
@@ -415,4 +466,52 @@ bool PDFDocumentScene::isPageItem(const QGraphicsItem * item)
   return (item->type() == PDFPageGraphicsItem::Type);
 }
 
+void PDFDocumentScene::pageItemPainted(PDFPageGraphicsItem * pageItem)
+{
+  // Move the item to the end of the list (unless it is there already, which
+  // is the common case when an item is repainted)
+  if (_loadedPageItems.isEmpty() || _loadedPageItems.last() != pageItem) {
+    _loadedPageItems.removeOne(pageItem);
+    _loadedPageItems.append(pageItem);
+  }
+  if (_loadedPageItems.size() > MaxLoadedPageItems && !_recycleTimer.isActive())
+    _recycleTimer.start();
+}
+
+// Unloads the contents of the page items that were painted least recently
+// (and releases the corresponding backend Page objects) so that the resources
+// needed do not grow with the number of pages that were viewed. Items that are
+// shown, or that are about to be shown when scrolling, are kept.
+void PDFDocumentScene::recyclePageItems()
+{
+  QList<QRectF> keepRects;
+  foreach(QGraphicsView * view, views()) {
+    if (!view->isVisible())
+      continue;
+    const QRectF visibleRect = view->mapToScene(view->viewport()->rect()).boundingRect();
+    // Also keep about one screen in either direction (see
+    // PDFDocumentView::updatePrefetchRegions())
+    keepRects.append(visibleRect.adjusted(-visibleRect.width(), -visibleRect.height(), visibleRect.width(), visibleRect.height()));
+  }
+
+  for (auto it = _loadedPageItems.begin(); it != _loadedPageItems.end() && _loadedPageItems.size() > MaxLoadedPageItems; ) {
+    PDFPageGraphicsItem * pageItem = *it;
+    bool keep{false};
+    if (pageItem->isVisible()) {
+      const QRectF itemRect = pageItem->sceneBoundingRect();
+      foreach(const QRectF & rect, keepRects) {
+        if (rect.intersects(itemRect))
+          keep = true;
+      }
+    }
+    if (keep) {
+      ++it;
+      continue;
+    }
+    pageItem->unloadContents();
+    _doc->releasePage(pageItem->pageNum());
+    it = _loadedPageItems.erase(it);
+  }
+}
+
 } // namespace QtPDF
@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2023-2024  Stefan Löffler
+ * Copyright (C) 2023-2025  Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -14,13 +14,17 @@
 #ifndef PDFDocumentScene_H
 #define PDFDocumentScene_H
 
+#include "PDFBackend.h"
 #include "PDFPageLayout.h"
 
 #include <QFileSystemWatcher>
+#include <QFutureWatcher>
 #include <QGraphicsScene>
 #include <QSharedPointer>
 #include <QTimer>
 
+#include <memory>
+
 class QLabel;
 class QPushButton;
 
@@ -30,10 +34,6 @@ class PDFAction;
 class PDFActionEvent;
 class PDFPageGraphicsItem;
 
-namespace Backend {
-class Document;
-} // namespace Backend
-
 class PDFDocumentScene : public QGraphicsScene
 {
   Q_OBJECT
@@ -69,6 +69,9 @@ public:
 
   static bool isPageItem(const QGraphicsItem * item);
 
+  // Called by page items when they are painted; see recyclePageItems()
+  void pageItemPainted(PDFPageGraphicsItem * pageItem);
+
 signals:
   void pageChangeRequested(QtPDF::PDFDocumentScene::size_type pageNum);
   void pageLayoutChanged();
@@ -84,6 +87,9 @@ protected slots:
   void pageLayoutChanged(const QRectF& sceneRect);
   void reinitializeScene();
   void finishUnlock();
+  void finishReload();
+  void abortReload();
+  void recyclePageItems();
 
 protected:
   // Used in non-continuous mode to keep track of currently shown page across
@@ -103,8 +109,16 @@ private:
   QList<QGraphicsItem*> _pages;
   size_type _lastPage;
   PDFPageLayout _pageLayout;
+  // Page items that loaded their contents when they were painted, in the
+  // order they were last painted; see recyclePageItems()
+  QList<PDFPageGraphicsItem*> _loadedPageItems;
+  QTimer _recycleTimer;
   QFileSystemWatcher _fileWatcher;
   QTimer _reloadTimer;
+  // The document is reloaded in the background (see reloadDocument()); a
+  // reload is aborted by setting its flag
+  QFutureWatcher< QSharedPointer<Backend::Document::PreparedReload> > _reloadWatcher;
+  std::shared_ptr<AbortFlag> _reloadAbortFlag;
   double _dpiX, _dpiY;
 
   void handleActionEvent(const PDFActionEvent * action_event);
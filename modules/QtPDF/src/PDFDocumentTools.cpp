@@ -663,23 +663,6 @@ void Measure::keyReleaseEvent(QKeyEvent *event)
 // ========================
 //
 
-// distanceFromRect() computes the Manhatten distance between a point and a
-// rectangle. If the point is inside (or on the border of) the rectangle, the
-// function returns 0. Otherwise, it returns the smallest Manhatten distance of
-// pt to any point on the border of the rectangle.
-inline double distanceFromRect(const QPointF & pt, const QRectF & rect) {
-  double dx{0}, dy{0};
-  if (pt.x() < rect.left())
-    dx = rect.left() - pt.x();
-  else if (pt.x() > rect.right())
-    dx = pt.x() - rect.right();
-  if (pt.y() < rect.top())
-    dy = rect.top() - pt.y();
-  else if (pt.y() > rect.bottom())
-    dy = pt.y() - rect.bottom();
-  return dx + dy;
-}
-
 Select::Select(PDFDocumentView * parent) :
   AbstractTool(parent),
   _cursorOverBox(false),
@@ -760,9 +743,9 @@ void Select::mousePressEvent(QMouseEvent * event)
   else if (_mouseMode == MouseMode_TextSelect) {
     // Find the box the mouse cursor is over
     QPointF curPdfCoords = pageGraphicsItem->pointScale().inverted().map(pageGraphicsItem->mapFromScene(_parent->mapToScene(event->pos())));
-    for (_startBox = 0; _startBox < _boxes.size() && !_boxes[_startBox].boundingBox.contains(curPdfCoords); ++_startBox) ;
+    _startBox = _boxIndex.indexAt(curPdfCoords);
     // If we didn't find the box, something went wrong; bail out
-    if (_startBox >= _boxes.size())
+    if (_startBox < 0)
       _mouseMode = MouseMode_None;
     else {
       // Find the subbox the cursor is over (if any)
@@ -811,13 +794,7 @@ void Select::mouseMoveEvent(QMouseEvent *event)
   {
     // Check if the cursor is over a box (in which case we use text select mode)
     // or not (in which case we use marquee select mode)
-    _cursorOverBox = false;
-    foreach(Backend::Page::Box b, _boxes) {
-      if (b.boundingBox.contains(curPdfCoords)) {
-        _cursorOverBox = true;
-        break;
-      }
-    }
+    _cursorOverBox = (_boxIndex.indexAt(curPdfCoords) >= 0);
     _parent->viewport()->setCursor(_cursorOverBox ? Qt::IBeamCursor : Qt::CrossCursor);
     break;
   }
@@ -834,18 +811,17 @@ void Select::mouseMoveEvent(QMouseEvent *event)
     // Set WindingFill so overlapping, individual paths are both filled
     // completely.
     highlightPath.setFillRule(Qt::WindingFill);
-    for (const Backend::Page::Box & b : _boxes) {
+    for (const size_type i : _boxIndex.intersecting(marqueeRect)) {
+      const Backend::Page::Box & b = _boxes[i];
       // Note: If b.boundingBox is fully contained in the marqueeRect, add it
       // without iterating over the subboxes. Otherwise, add all intersected
       // subboxes
-      if (marqueeRect.intersects(b.boundingBox)) {
-        if (b.subBoxes.isEmpty() || marqueeRect.contains(b.boundingBox))
-          highlightPath.addRect(toView.mapRect(b.boundingBox));
-        else {
-          for(const Backend::Page::Box & sb : b.subBoxes) {
-            if (marqueeRect.intersects(sb.boundingBox))
-              highlightPath.addRect(toView.mapRect(sb.boundingBox));
-          }
+      if (b.subBoxes.isEmpty() || marqueeRect.contains(b.boundingBox))
+        highlightPath.addRect(toView.mapRect(b.boundingBox));
+      else {
+        for(const Backend::Page::Box & sb : b.subBoxes) {
+          if (marqueeRect.intersects(sb.boundingBox))
+            highlightPath.addRect(toView.mapRect(sb.boundingBox));
         }
       }
     }
@@ -860,19 +836,11 @@ void Select::mouseMoveEvent(QMouseEvent *event)
 
     // Find the box (and subbox therein) that is closest to the current mouse
     // position
-    size_type endBox{0};
-    double minDist = -1;
-    for (size_type i = 0; i < _boxes.size(); ++i) {
-      double dist = distanceFromRect(curPdfCoords, _boxes[i].boundingBox);
-      if (minDist < -.5 || dist < minDist) {
-        endBox = i;
-        minDist = dist;
-      }
-    }
+    size_type endBox = _boxIndex.nearest(curPdfCoords);
     size_type endSubbox{0};
-    minDist = -1;
+    double minDist = -1;
     for (size_type i = 0; i < _boxes[endBox].subBoxes.size(); ++i) {
-      double dist = distanceFromRect(curPdfCoords, _boxes[endBox].subBoxes[i].boundingBox);
+      double dist = PDFBoxIndex::distance(curPdfCoords, _boxes[endBox].subBoxes[i].boundingBox);
       if (minDist < -.5 || dist < minDist) {
         endSubbox = i;
         minDist = dist;
@@ -985,6 +953,7 @@ void Select::resetBoxes(const size_type pageNum /* = -1 */)
 {
   _pageNum = pageNum;
   _boxes.clear();
+  _boxIndex = PDFBoxIndex();
 #ifdef DEBUG
   // In debug builds, remove any previously shown (selectable) boxes
   foreach(QGraphicsRectItem * box, _displayBoxes) {
@@ -1005,6 +974,11 @@ void Select::resetBoxes(const size_type pageNum /* = -1 */)
     return;
 
   _boxes = page->boxes();
+  QVector<QRectF> boundingBoxes;
+  boundingBoxes.reserve(_boxes.size());
+  for (const Backend::Page::Box & b : _boxes)
+    boundingBoxes.append(b.boundingBox);
+  _boxIndex = PDFBoxIndex(boundingBoxes);
 #ifdef DEBUG
   // In debug builds, show all selectable boxes
   PDFPageGraphicsItem * pageGraphicsItem = dynamic_cast<PDFPageGraphicsItem*>(scene->pageAt(pageNum));
@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2013-2023  Stefan Löffler
+ * Copyright (C) 2013-2025  Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -15,6 +15,7 @@
 #define PDFDocumentTools_H
 
 #include "PDFBackend.h"
+#include "PDFBoxIndex.h"
 
 #ifdef DEBUG
   #include <QDebug>
@@ -357,6 +358,8 @@ protected:
 
   size_type _pageNum;
   QList<Backend::Page::Box> _boxes;
+  // Spatial index of the boundingBoxes of _boxes for hit testing
+  PDFBoxIndex _boxIndex;
   size_type _startBox, _startSubbox;
 #ifdef DEBUG
   // All elements of _displayBoxes are automatically added to a QGraphicsScene,
@@ -19,6 +19,8 @@
 #include "PDFDocumentScene.h"
 #include "PDFGuideline.h"
 
+#include <algorithm>
+
 // This has to be outside the namespace (according to Qt docs)
 static void initResources()
 {
@@ -100,6 +102,23 @@ PDFDocumentView::PDFDocumentView(QWidget *parent /* = nullptr */):
   connect(&_searcher, &PDFSearcher::resultReady, this, &PDFDocumentView::searchResultReady);
   connect(&_searcher, &PDFSearcher::progressValueChanged, this, &PDFDocumentView::searchProgressValueChanged);
 
+  // While scrolling or zooming, tiles that were requested a moment ago may
+  // already be out of view; weed them out regularly (but not on every single
+  // scroll step) so the render threads can focus on what is visible, and
+  // prefetch what is likely to come into view next
+  _renderRequestsTimer.setSingleShot(true);
+  _renderRequestsTimer.setInterval(50);
+  connect(&_renderRequestsTimer, &QTimer::timeout, this, &PDFDocumentView::updateRenderRequests);
+  connect(this, &PDFDocumentView::changedZoom, this, &PDFDocumentView::scheduleUpdateRenderRequests);
+  // In single page mode, the scroll direction is determined by page changes
+  connect(this, &PDFDocumentView::changedPage, this, [this](const size_type pageNum) {
+    if (_pageMode == PageMode_SinglePage && _prefetchPage >= 0 && pageNum != _prefetchPage) {
+      _scrollDirection = (pageNum > _prefetchPage ? 1 : -1);
+      scheduleUpdateRenderRequests();
+    }
+    _prefetchPage = pageNum;
+  });
+
   showRuler(false);
   connect(&_ruler, &PDFRuler::dragStart, this, [this](QPoint pos, Qt::Edge origin) {
     const Qt::Orientation orientation = [](Qt::Edge origin) {
@@ -938,7 +957,14 @@ void PDFDocumentView::searchResultReady(PDFSearcher::size_type pageIndex)
   const auto & results = _searcher.resultAt(pageIndex);
   // Convert the search result to highlight boxes
   for(const Backend::SearchResult & result : results) {
-    _searchResults << addHighlightPath(result.pageNum, result.bbox, _searchResultHighlightBrush);
+    if (result.lineBoxes.isEmpty()) {
+      _searchResults << addHighlightPath(result.pageNum, result.bbox, _searchResultHighlightBrush);
+      continue;
+    }
+    QPainterPath path;
+    for (const QRectF & box : result.lineBoxes)
+      path.addRect(box);
+    _searchResults << addHighlightPath(result.pageNum, path, _searchResultHighlightBrush);
   }
 
   // If this is the first result that becomes available in a new search, center
@@ -1605,6 +1631,203 @@ void PDFDocumentView::resizeEvent(QResizeEvent * event)
 {
   _ruler.resize(size());
   Super::resizeEvent(event);
+  scheduleUpdateRenderRequests();
+}
+
+void PDFDocumentView::scrollContentsBy(int dx, int dy)
+{
+  Super::scrollContentsBy(dx, dy);
+
+  // Keep track of the (vertical) scroll direction and speed for prefetching
+  // NB: dy < 0 means the contents move up, i.e., towards the end of the
+  // document
+  if (dy != 0) {
+    const int direction = (dy < 0 ? 1 : -1);
+    qreal speed = 0;
+    if (_scrollTimer.isValid()) {
+      const qint64 elapsed = _scrollTimer.restart();
+      // Pauses longer than half a second start a new scroll movement
+      if (elapsed > 0 && elapsed < 500 && direction == _scrollDirection && viewport()->height() > 0)
+        speed = 1000. * qAbs(dy) / viewport()->height() / elapsed;
+    }
+    else
+      _scrollTimer.start();
+    // Smooth the speed as scroll steps (e.g., from the mouse wheel) can be
+    // rather irregular
+    _scrollSpeed = (speed > 0 ? (_scrollSpeed + speed) / 2 : 0);
+    _scrollDirection = direction;
+  }
+
+  scheduleUpdateRenderRequests();
+}
+
+void PDFDocumentView::scheduleUpdateRenderRequests()
+{
+  // NB: Don't restart the timer if it is running already, or continuous
+  // scrolling would postpone dropping requests until the scrolling stopped
+  if (!_renderRequestsTimer.isActive())
+    _renderRequestsTimer.start();
+}
+
+void PDFDocumentView::updateRenderRequests()
+{
+  updatePrefetchRegions();
+  dropStaleRenderRequests();
+  prefetchTiles();
+}
+
+void PDFDocumentView::updatePrefetchRegions()
+{
+  _prefetchRegions.clear();
+  if (!_pdf_scene || _pageMode == PageMode_Presentation || _scrollDirection == 0)
+    return;
+
+  const QRectF visibleRect = mapToScene(viewport()->rect()).boundingRect();
+  // Look further ahead when scrolling fast (more than one screen per second)
+  const int lookahead = (_scrollSpeed > 1 ? 2 : 1);
+
+  if (_pageMode == PageMode_SinglePage) {
+    // Prefetch the part of the next page(s) that will be shown first, i.e.,
+    // their top (or bottom when going backwards), in the same width as the
+    // current page
+    const QGraphicsItem * currentPage = _pdf_scene->pageAt(_currentPage);
+    if (!currentPage)
+      return;
+    const QRectF currentRect = currentPage->mapRectFromScene(visibleRect).intersected(currentPage->boundingRect());
+    for (int i = 1; i <= lookahead; ++i) {
+      PDFPageGraphicsItem * pageItem = dynamic_cast<PDFPageGraphicsItem*>(_pdf_scene->pageAt(_currentPage + i * _scrollDirection));
+      if (!pageItem)
+        break;
+      QRectF region(currentRect.left(), 0, currentRect.width(), currentRect.height());
+      if (_scrollDirection < 0)
+        region.moveBottom(pageItem->boundingRect().bottom());
+      _prefetchRegions.append(qMakePair(pageItem, region.intersected(pageItem->boundingRect())));
+    }
+    return;
+  }
+
+  // The area (in scene coordinates) that will come into view next
+  const qreal height = lookahead * visibleRect.height();
+  const QRectF aheadRect(visibleRect.left(), (_scrollDirection > 0 ? visibleRect.bottom() : visibleRect.top() - height), visibleRect.width(), height);
+  foreach(QGraphicsItem * item, _pdf_scene->items(aheadRect, Qt::IntersectsItemBoundingRect)) {
+    if (item->type() != PDFPageGraphicsItem::Type || !item->isVisible())
+      continue;
+    PDFPageGraphicsItem * pageItem = static_cast<PDFPageGraphicsItem*>(item);
+    const QRectF region = pageItem->mapRectFromScene(aheadRect).intersected(pageItem->boundingRect());
+    if (!region.isEmpty())
+      _prefetchRegions.append(qMakePair(pageItem, region));
+  }
+  // Sort by distance from the visible area
+  std::sort(_prefetchRegions.begin(), _prefetchRegions.end(), [this](const QPair<PDFPageGraphicsItem *, QRectF> & a, const QPair<PDFPageGraphicsItem *, QRectF> & b) {
+    const QRectF aRect = a.first->mapRectToScene(a.second);
+    const QRectF bRect = b.first->mapRectToScene(b.second);
+    if (_scrollDirection > 0)
+      return aRect.top() < bRect.top();
+    return aRect.bottom() > bRect.bottom();
+  });
+}
+
+void PDFDocumentView::prefetchTiles()
+{
+  if (_prefetchRegions.isEmpty())
+    return;
+
+  const qreal scaleFactor = transform().m11() * viewport()->devicePixelRatio();
+  // Don't use more than a quarter of the cache for prefetching so we don't
+  // evict the tiles that are currently visible
+  constexpr qint64 tileCost = static_cast<qint64>(TILE_SIZE) * TILE_SIZE * 4;
+  const qint64 maxNumTiles = qMax(Backend::Document::pageCache().maxCost() / 4 / tileCost, static_cast<qint64>(1));
+
+  struct PrefetchTile {
+    QSharedPointer<Backend::Page> page;
+    PDFPageGraphicsItem * pageItem;
+    double xres, yres;
+    QRect tile;
+  };
+  // Tiles to prefetch, the most urgent ones first
+  QVector<PrefetchTile> tiles;
+
+  for (const auto & region : _prefetchRegions) {
+    QSharedPointer<Backend::Page> page(region.first->page().toStrongRef());
+    if (!page)
+      continue;
+    // See PDFPageGraphicsItem::paint() for how the tiles are determined
+    const double xres = 72. * region.first->pointScale().m11() * scaleFactor;
+    const double yres = 72. * region.first->pointScale().m22() * scaleFactor;
+    const QRectF pixelRect = QTransform::fromScale(scaleFactor, scaleFactor).mapRect(region.second);
+    const int imin = qFloor(pixelRect.left() / TILE_SIZE);
+    const int imax = qCeil(pixelRect.right() / TILE_SIZE);
+    const int jmin = qFloor(pixelRect.top() / TILE_SIZE);
+    const int jmax = qCeil(pixelRect.bottom() / TILE_SIZE);
+    for (int n = 0; n < jmax - jmin; ++n) {
+      // Rows in the direction of scrolling
+      const int j = (_scrollDirection > 0 ? jmin + n : jmax - 1 - n);
+      for (int i = imin; i < imax; ++i) {
+        if (tiles.size() >= maxNumTiles)
+          break;
+        tiles.append({page, region.first, xres, yres, QRect(i * TILE_SIZE, j * TILE_SIZE, TILE_SIZE, TILE_SIZE)});
+      }
+    }
+  }
+
+  // Requests of the same priority are processed in LIFO order, so add the
+  // least urgent ones first
+  for (auto it = tiles.crbegin(); it != tiles.crend(); ++it)
+    it->page->prefetchTile(it->pageItem, it->xres, it->yres, it->tile);
+}
+
+void PDFDocumentView::dropStaleRenderRequests()
+{
+  if (!_pdf_scene || _pageMode == PageMode_Presentation)
+    return;
+  QSharedPointer<Backend::Document> doc(_pdf_scene->document().toStrongRef());
+  if (!doc)
+    return;
+
+  const QRectF visibleRect = mapToScene(viewport()->rect()).boundingRect();
+  const qreal scaleFactor = transform().m11() * viewport()->devicePixelRatio();
+  // The magnifier displays the same page items at a higher resolution, so
+  // tiles at other resolutions may still be needed while it is shown
+  bool magnifierVisible = false;
+  foreach(const PDFDocumentMagnifierView * magnifier, findChildren<PDFDocumentMagnifierView*>()) {
+    if (magnifier->isVisible())
+      magnifierVisible = true;
+  }
+
+  doc->processingThreadPool().dropRequests([&](const Backend::PageProcessingRequest & request) {
+    if (request.type() != Backend::PageProcessingRequest::PageRendering)
+      return false;
+    const PDFPageGraphicsItem * pageItem = qobject_cast<const PDFPageGraphicsItem*>(request.listener);
+    if (!pageItem || pageItem->scene() != _pdf_scene.data())
+      return false;
+    const Backend::PageProcessingRenderPageRequest & renderRequest = dynamic_cast<const Backend::PageProcessingRenderPageRequest &>(request);
+    if (renderRequest.xres <= 0 || renderRequest.yres <= 0)
+      return false;
+
+    // See PDFPageGraphicsItem::paint() for how the resolution is determined;
+    // NB: allow for some round-off errors in the comparison
+    // NB: Previews are requested at a fixed resolution that is independent of
+    // the zoom level
+    const qreal xres = 72. * pageItem->pointScale().m11() * scaleFactor;
+    if (!magnifierVisible && renderRequest.priority != Backend::PageProcessingRequest::Priority_Preview && qAbs(renderRequest.xres - xres) > 1e-3 * xres)
+      return true;
+
+    // Map the tile (given in pixels at the render resolution) to item and
+    // ultimately to scene coordinates
+    // NB: Render requests always have a proper render box; a null box (as
+    // used for previews) is turned into the whole page by
+    // Page::getTileImage() before the request is made
+    const QRectF tileRect = pageItem->pointScale().mapRect(QTransform::fromScale(72. / renderRequest.xres, 72. / renderRequest.yres).mapRect(QRectF(renderRequest.render_box)));
+    if (renderRequest.priority == Backend::PageProcessingRequest::Priority_Prefetch) {
+      // Prefetched tiles are stale once they are no longer ahead of the view
+      for (const auto & region : _prefetchRegions) {
+        if (region.first == pageItem && region.second.intersects(tileRect))
+          return false;
+      }
+      return true;
+    }
+    return !pageItem->mapRectToScene(tileRect).intersects(visibleRect);
+  });
 }
 
 void PDFDocumentView::armTool(const DocumentTool::AbstractTool::Type toolType)
@@ -1870,14 +2093,14 @@ QPixmap& PDFDocumentMagnifierView::dropShadow()
 
 // This class descends from `QGraphicsObject` and implements the on-screen
 // representation of `Page` objects.
-PDFPageGraphicsItem::PDFPageGraphicsItem(QWeakPointer<Backend::Page> a_page, const double dpiX, const double dpiY, QGraphicsItem *parent /* = nullptr */):
+PDFPageGraphicsItem::PDFPageGraphicsItem(QWeakPointer<Backend::Document> a_doc, const size_type pageNum, const QSizeF & pageSize, const double dpiX, const double dpiY, QGraphicsItem *parent /* = nullptr */):
   Super(parent),
-  _page(a_page),
+  _doc(a_doc),
   // FIXME: The QGraphicsObject should be independent of the hardware it is
   // shown on
   _dpiX(dpiX),
   _dpiY(dpiY),
-  _pageNum(-1),
+  _pageNum(pageNum),
   _linksLoaded(false),
   _annotationsLoaded(false),
   _zoomLevel(0.0)
@@ -1888,46 +2111,57 @@ PDFPageGraphicsItem::PDFPageGraphicsItem(QWeakPointer<Backend::Page> a_page, con
   // NOTE: This flag needs Qt 4.6 or newer.
   setFlags(QGraphicsItem::ItemUsesExtendedStyleOption);
 
-  QSharedPointer<Backend::Page> page(_page.toStrongRef());
-  if (page) {
-    _pageNum = page->pageNum();
-    // Create an empty pixmap that is the same size as the PDF page. This
-    // allows us to delay the rendering of pages until they actually come into
-    // view yet still know what the page size is.
-    _pageSize = page->pageSizeF();
-    _pageSize.setWidth(_pageSize.width() * _dpiX / 72.0);
-    _pageSize.setHeight(_pageSize.height() * _dpiY / 72.0);
+  // Only the page size is needed up front. This allows us to delay loading
+  // (and rendering) pages until they actually come into view yet still know
+  // how to lay them out.
+  _pageSize = pageSize;
+  _pageSize.setWidth(_pageSize.width() * _dpiX / 72.0);
+  _pageSize.setHeight(_pageSize.height() * _dpiY / 72.0);
 
-    // `_pageScale` holds a transformation matrix that can map between normalized
-    // page coordinates (in the range 0...1) and the coordinate system for this
-    // graphics item. `_pointScale` is similar, except it maps from coordinates
-    // expressed in pixels at a resolution of 72 dpi.
-    _pageScale = QTransform::fromScale(_pageSize.width(), _pageSize.height());
-    _pointScale = QTransform::fromScale(_dpiX / 72.0, _dpiY / 72.0);
-  }
+  // `_pageScale` holds a transformation matrix that can map between normalized
+  // page coordinates (in the range 0...1) and the coordinate system for this
+  // graphics item. `_pointScale` is similar, except it maps from coordinates
+  // expressed in pixels at a resolution of 72 dpi.
+  _pageScale = QTransform::fromScale(_pageSize.width(), _pageSize.height());
+  _pointScale = QTransform::fromScale(_dpiX / 72.0, _dpiY / 72.0);
 }
 
 QRectF PDFPageGraphicsItem::boundingRect() const { return QRectF(QPointF(0.0, 0.0), _pageSize); }
 int PDFPageGraphicsItem::type() const { return Type; }
 
+QWeakPointer<Backend::Page> PDFPageGraphicsItem::page() const
+{
+  if (_page.isNull()) {
+    QSharedPointer<Backend::Document> doc(_doc.toStrongRef());
+    if (doc)
+      _page = doc->page(_pageNum);
+  }
+  return _page;
+}
+
+void PDFPageGraphicsItem::unloadContents()
+{
+  // NB: Other children (e.g., highlights) are not loaded by this item, so they
+  // are kept
+  foreach(QGraphicsItem * child, childItems()) {
+    if (child->type() == PDFLinkGraphicsItem::Type || child->type() == PDFMarkupAnnotationGraphicsItem::Type)
+      delete child;
+  }
+  _linksLoaded = false;
+  _annotationsLoaded = false;
+  _page.clear();
+}
+
 QPointF PDFPageGraphicsItem::mapFromPage(const QPointF & point) const
 {
-  QSharedPointer<Backend::Page> page(_page.toStrongRef());
-  if (!page)
-    return QPointF();
   // item coordinates are in pixels
-  return QPointF(_pageSize.width() * point.x() / page->pageSizeF().width(), \
-    _pageSize.height() * (1.0 - point.y() / page->pageSizeF().height()));
+  return QPointF(point.x() * _dpiX / 72.0, _pageSize.height() - point.y() * _dpiY / 72.0);
 }
 
 QPointF PDFPageGraphicsItem::mapToPage(const QPointF & point) const
 {
-  QSharedPointer<Backend::Page> page(_page.toStrongRef());
-  if (!page)
-    return QPointF();
   // item coordinates are in pixels
-  return QPointF(page->pageSizeF().width() * point.x() / _pageSize.width(), \
-    page->pageSizeF().height() * (1.0 - point.y() / _pageSize.height()));
+  return QPointF(point.x() * 72.0 / _dpiX, (_pageSize.height() - point.y()) * 72.0 / _dpiY);
 }
 
 // An overloaded paint method allows us to handle rendering via asynchronous
@@ -1939,12 +2173,18 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
   qreal scaleFactor = painter->transform().m11();
   QTransform scaleT = QTransform::fromScale(scaleFactor, scaleFactor);
   QRect pageRect = scaleT.mapRect(boundingRect()).toAlignedRect();
-  QSharedPointer<Backend::Page> page(_page.toStrongRef());
+  QSharedPointer<Backend::Page> page(this->page().toStrongRef());
   QSharedPointer<QImage> renderedPage;
 
   if (!page)
     return;
 
+  // Let the scene know this item is (about to be) shown so it can unload the
+  // items that have not been shown for some time
+  PDFDocumentScene * pdfScene = qobject_cast<PDFDocumentScene*>(scene());
+  if (pdfScene)
+    pdfScene->pageItemPainted(this);
+
   // If this is the first time this `PDFPageGraphicsItem` has come into view,
   // `_linksLoaded` will be `false`. We then load all of the links on the page.
   if (!_linksLoaded)
@@ -1962,6 +2202,11 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
   if ( _zoomLevel != scaleFactor )
     _zoomLevel = scaleFactor;
 
+  if (!_firstPaintTimer.isValid())
+    _firstPaintTimer.start();
+  // Set to true once (part of) the actual page content is painted
+  bool paintedContent = false;
+
   // get a pointer to the parent view (if any)
   PDFDocumentView * view = (widget ? qobject_cast<PDFDocumentView*>(widget->parent()) : nullptr);
 
@@ -2007,8 +2252,10 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
       // up during presentations, and we don't need tiles as we always display
       // the full page, anyway).
       renderedPage = page->getTileImage(nullptr, _dpiX * scaleFactor, _dpiY * scaleFactor);
-      if (renderedPage)
+      if (renderedPage) {
         painter->drawImage(QPoint(0, 0), *renderedPage);
+        paintedContent = true;
+      }
     }
   }
   else { // presentation mode
@@ -2034,6 +2281,20 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
 
     const QRect visibleRect = scaleT.mapRect(exposedRect).toAlignedRect();
 
+    const double xres = _dpiX * scaleFactor * painter->device()->devicePixelRatio();
+    const double yres = _dpiY * scaleFactor * painter->device()->devicePixelRatio();
+
+    // Request a low-resolution preview of the whole page before any tiles. It
+    // is rendered ahead of them and (once available) used to compose the
+    // placeholders of tiles that are still being rendered, so the page never
+    // appears blank for long.
+    if (xres > 2 * PREVIEW_DPI && yres > 2 * PREVIEW_DPI) {
+      Backend::PDFPageCache::TileStatus previewStatus{Backend::PDFPageCache::UNKNOWN};
+      page->getTileImage(this, PREVIEW_DPI, PREVIEW_DPI, QRect(), Backend::PageProcessingRequest::Priority_Preview, &previewStatus);
+      if (previewStatus == Backend::PDFPageCache::CURRENT)
+        paintedContent = true;
+    }
+
     // Each tile is rendered at TILE_SIZE pixels, which may be scaled (e.g. on
     // high-dpi screens) and displayed at an effective size
     int effectiveTileSize = static_cast<int>(TILE_SIZE / painter->device()->devicePixelRatio());
@@ -2074,7 +2335,10 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
             useGrayScale = true;
         }
 
-        renderedPage = page->getTileImage(this, _dpiX * scaleFactor * painter->device()->devicePixelRatio(), _dpiY * scaleFactor * painter->device()->devicePixelRatio(), renderTile);
+        Backend::PDFPageCache::TileStatus tileStatus{Backend::PDFPageCache::UNKNOWN};
+        renderedPage = page->getTileImage(this, xres, yres, renderTile, Backend::PageProcessingRequest::Priority_Visible, &tileStatus);
+        if (tileStatus == Backend::PDFPageCache::CURRENT)
+          paintedContent = true;
         // renderedPage as returned from getTileImage _should_ always be valid
         if ( renderedPage ) {
           if (useGrayScale) {
@@ -2098,6 +2362,13 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
     }
   }
   painter->restore();
+
+  if (paintedContent && _timeToFirstMeaningfulPaint < 0) {
+    _timeToFirstMeaningfulPaint = _firstPaintTimer.elapsed();
+#ifdef DEBUG
+    qDebug() << "Time to first meaningful paint of page" << _pageNum << ":" << _timeToFirstMeaningfulPaint << "milliseconds";
+#endif
+  }
 }
 
 //static
@@ -2142,6 +2413,15 @@ bool PDFPageGraphicsItem::event(QEvent *event)
     // fetches stuff from the cache.
     //
     // Perhaps there should be a separate event for when the cache is updated.
+    const Backend::PDFPageRenderedEvent * rendered_event = dynamic_cast<const Backend::PDFPageRenderedEvent*>(event);
+    if (rendered_event && rendered_event->xres == PREVIEW_DPI && rendered_event->yres == PREVIEW_DPI) {
+      // The preview has become available; placeholders composed before that
+      // (i.e., typically without any page content) are composed anew on the
+      // next repaint
+      QSharedPointer<Backend::Page> page(_page.toStrongRef());
+      if (page)
+        page->dropPlaceholders();
+    }
     update();
 
     return true;
@@ -2163,6 +2443,12 @@ void PDFPageGraphicsItem::addLinks(QList< QSharedPointer<Annotation::Link> > lin
   QElapsedTimer stopwatch;
   stopwatch.start();
 #endif
+  // Links may have been requested more than once if the item was unloaded in
+  // the meantime (see unloadContents())
+  foreach(QGraphicsItem * child, childItems()) {
+    if (child->type() == PDFLinkGraphicsItem::Type)
+      delete child;
+  }
   foreach( QSharedPointer<Annotation::Link> link, links ){
     PDFLinkGraphicsItem * linkItem = new PDFLinkGraphicsItem(link);
     // Map the link from pdf coordinates to scene coordinates
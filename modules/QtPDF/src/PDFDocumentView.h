@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2013-2023  Charlie Sharpsteen, Stefan Löffler
+ * Copyright (C) 2013-2025  Charlie Sharpsteen, Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -35,6 +35,10 @@ class PDFDocumentView;
 
 
 const int TILE_SIZE=1024;
+// Resolution of the low-resolution previews of whole pages that are displayed
+// while the actual tiles are being rendered. As it doesn't depend on the zoom
+// level, previews remain usable (and cached) while zooming.
+const double PREVIEW_DPI=48.;
 
 class PDFDocumentView : public QGraphicsView {
   Q_OBJECT
@@ -172,6 +176,7 @@ protected:
   void wheelEvent(QWheelEvent * event) override;
   void changeEvent(QEvent * event) override;
   void resizeEvent(QResizeEvent * event) override;
+  void scrollContentsBy(int dx, int dy) override;
 
   // Maybe this will become public later on
   // Ownership of tool is transferred to PDFDocumentView
@@ -194,6 +199,13 @@ protected slots:
   void searchProgressValueChanged(PDFSearcher::size_type progressValue);
   void reinitializeFromScene();
   void notifyTextSelectionChanged();
+  // Removes pending render requests for tiles that are no longer visible (or
+  // no longer ahead of the view, in the case of prefetched tiles) or were
+  // requested for a different zoom level from the processing queue
+  void dropStaleRenderRequests();
+  // Drops stale render requests and prefetches the tiles that are likely to
+  // come into view next (based on the scroll direction and speed)
+  void updateRenderRequests();
 
 private:
   PageMode _pageMode{PageMode_OneColumnContinuous};
@@ -219,6 +231,26 @@ private:
   QBrush _currentSearchResultHighlightBrush;
   PDFRuler _ruler{this};
   bool _useGrayScale{false};
+  QTimer _renderRequestsTimer;
+
+  // Scroll tracking for prefetching
+  QElapsedTimer _scrollTimer;
+  // Smoothed scroll speed in viewport heights per second
+  qreal _scrollSpeed{0};
+  // +1 when moving towards the end of the document, -1 when moving towards its
+  // beginning, 0 if unknown
+  int _scrollDirection{0};
+  // The page the (single page mode) prefetching was last based on
+  size_type _prefetchPage{-1};
+  // The parts (in item coordinates) of the page items that should be
+  // prefetched, the most urgent ones first
+  QVector< QPair<PDFPageGraphicsItem *, QRectF> > _prefetchRegions;
+
+  void scheduleUpdateRenderRequests();
+  void updatePrefetchRegions();
+  // Requests the tiles in _prefetchRegions (as far as the cache budget
+  // permits) at Priority_Prefetch
+  void prefetchTiles();
 
   // Never try to set a vanilla QGraphicsScene, always use a PDFGraphicsScene.
   void setScene(QGraphicsScene *scene);
@@ -270,7 +302,9 @@ class PDFPageGraphicsItem : public QGraphicsObject
   typedef QGraphicsObject Super;
   using size_type = PDFDocumentView::size_type;
 
-  QWeakPointer<Backend::Page> _page;
+  QWeakPointer<Backend::Document> _doc;
+  // Obtained from _doc on demand; see page()
+  mutable QWeakPointer<Backend::Page> _page;
 
   double _dpiX;
   double _dpiY;
@@ -284,6 +318,10 @@ class PDFPageGraphicsItem : public QGraphicsObject
   QTransform _pageScale, _pointScale;
   qreal _zoomLevel;
 
+  // Started the first time the item is painted
+  QElapsedTimer _firstPaintTimer;
+  qint64 _timeToFirstMeaningfulPaint{-1};
+
   friend class PageProcessingRenderPageRequest;
   friend class PageProcessingLoadLinksRequest;
 //  friend class PDFPageLayout;
@@ -291,7 +329,9 @@ class PDFPageGraphicsItem : public QGraphicsObject
   static void imageToGrayScale(QImage & img);
 
 public:
-  PDFPageGraphicsItem(QWeakPointer<Backend::Page> a_page, const double dpiX, const double dpiY, QGraphicsItem *parent = nullptr);
+  // `pageSize` is the size of the page in pt; the item only depends on the
+  // backend Page object when it is painted (see page())
+  PDFPageGraphicsItem(QWeakPointer<Backend::Document> a_doc, const size_type pageNum, const QSizeF & pageSize, const double dpiX, const double dpiY, QGraphicsItem *parent = nullptr);
 
   // This seems fragile as it assumes no other code declaring a custom graphics
   // item will choose the same ID for it's object types. Unfortunately, there
@@ -304,7 +344,16 @@ public:
 
   QRectF boundingRect() const override;
 
-  QWeakPointer<Backend::Page> page() const { return _page; }
+  // Returns the backend Page object displayed by this item; it is obtained
+  // from the document (and thus possibly created) on first use, as well as
+  // after the document released it (see unloadContents())
+  QWeakPointer<Backend::Page> page() const;
+
+  // Drops everything that was loaded when the item was painted (the links,
+  // annotations, and the reference to the backend Page object) to free
+  // resources while the item is far from view; it is reloaded as necessary
+  // when the item is painted again
+  void unloadContents();
 
   // Maps the point _point_ from the page's coordinate system (in pt) to this
   // item's coordinate system - chain with mapToScene and related methods to get
@@ -315,13 +364,18 @@ public:
   // convert from coordinates in other systems
   QPointF mapToPage(const QPointF & point) const;
 
-  QTransform pageScale() { return _pageScale; }
-  QTransform pointScale() { return _pointScale; }
+  QTransform pageScale() const { return _pageScale; }
+  QTransform pointScale() const { return _pointScale; }
 
   // get the nominal (i.e., unmagnified) page size in pixel
   QSizeF pageSizeF() const { return _pageSize; }
   size_type pageNum() const { return _pageNum; }
 
+  // The time (in milliseconds) from the first paint of this item until (part
+  // of) the actual page content (as opposed to mere placeholders) was first
+  // painted, or -1 if that has not happened yet
+  qint64 timeToFirstMeaningfulPaint() const { return _timeToFirstMeaningfulPaint; }
+
 protected:
   bool event(QEvent * event) override;
 
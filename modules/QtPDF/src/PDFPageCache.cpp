@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2023  Stefan Löffler, Charlie Sharpsteen
+ * Copyright (C) 2023-2025  Stefan Löffler, Charlie Sharpsteen
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -15,15 +15,221 @@
 #include "PDFPageCache.h"
 
 #include <QImage>
+#include <QTransform>
+#include <QtMath>
+
+#include <climits>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
 
 namespace QtPDF {
 
 namespace Backend {
 
+// Finalizer of MurmurHash3; spreads the bits of `h` so that even values that
+// only differ in their high bits (such as tile coordinates, which are
+// multiples of the tile size) end up in different shards
+static inline quint64 mixBits(quint64 h)
+{
+  h ^= h >> 33;
+  h *= Q_UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  h *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+  h ^= h >> 33;
+  return h;
+}
+
+// Returns the range of grid cells (as column/row indices) that `rect` overlaps
+static inline QRect gridCells(const QRectF & rect, const int cellSize)
+{
+  const int left = qFloor(rect.left() / cellSize);
+  const int top = qFloor(rect.top() / cellSize);
+  const int right = qCeil(rect.right() / cellSize) - 1;
+  const int bottom = qCeil(rect.bottom() / cellSize) - 1;
+  return QRect(QPoint(left, top), QPoint(qMax(left, right), qMax(top, bottom)));
+}
+
+void PDFPageCache::LevelEntry::insert(const PDFPageTile & tile)
+{
+  tiles.insert(tile);
+  const QRect cells = gridCells(QRectF(tile.render_box), GridCellSize);
+  for (int row = cells.top(); row <= cells.bottom(); ++row) {
+    for (int col = cells.left(); col <= cells.right(); ++col)
+      grid[qMakePair(col, row)].insert(tile);
+  }
+}
+
+void PDFPageCache::LevelEntry::remove(const PDFPageTile & tile)
+{
+  if (!tiles.remove(tile))
+    return;
+  const QRect cells = gridCells(QRectF(tile.render_box), GridCellSize);
+  for (int row = cells.top(); row <= cells.bottom(); ++row) {
+    for (int col = cells.left(); col <= cells.right(); ++col) {
+      auto it = grid.find(qMakePair(col, row));
+      if (it == grid.end())
+        continue;
+      it->remove(tile);
+      if (it->isEmpty())
+        grid.erase(it);
+    }
+  }
+}
+
+PDFPageCache::CachedTileData::~CachedTileData()
+{
+  if (!shard->removing)
+    ++shard->evictions;
+  auto docIt = shard->documents.find(tile.doc);
+  if (docIt == shard->documents.end())
+    return;
+  auto pageIt = docIt->pages.find(tile.page_num);
+  if (pageIt == docIt->pages.end())
+    return;
+  auto levelIt = pageIt->find(qMakePair(tile.xres, tile.yres));
+  if (levelIt == pageIt->end())
+    return;
+  levelIt->remove(tile);
+  if (levelIt->isEmpty())
+    pageIt->erase(levelIt);
+  if (pageIt->isEmpty())
+    docIt->pages.erase(pageIt);
+}
+
+PDFPageCache::Shard::~Shard()
+{
+  // Destroy all tiles while `documents` is still alive
+  removing = true;
+  cache.clear();
+}
+
+quint64 PDFPageCache::Shard::generationOf(const Document * doc) const
+{
+  auto it = documents.constFind(doc);
+  return (it == documents.constEnd() ? 0 : it->generation);
+}
+
+PDFPageCache::TileStatus PDFPageCache::Shard::statusOf(const CachedTileData & data) const
+{
+  // Tiles whose document was marked outdated after the tile's status was set
+  // are outdated, regardless of what they were before
+  if (data.status != OUTDATED && data.generation != generationOf(data.tile.doc))
+    return OUTDATED;
+  return data.status;
+}
+
+void PDFPageCache::Shard::insert(const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status)
+{
+  // Replacing an existing tile is not an eviction
+  if (cache.contains(tile))
+    remove(tile);
+
+  CachedTileData * data = new CachedTileData(this, tile, image, status, generationOf(tile.doc));
+#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
+  const bool inserted = cache.insert(tile, data, (image ? image->byteCount() : 0));
+#elif QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+  // No image (1024x124x4 bytes by default) should ever come even close to the
+  // 2 GB mark corresponding to INT_MAX
+  const bool inserted = cache.insert(tile, data, (image ? static_cast<int>(image->sizeInBytes()) : 0));
+#else
+  const bool inserted = cache.insert(tile, data, (image ? image->sizeInBytes() : 0));
+#endif
+  // NB: If the image is too big for the cache, QCache has already deleted
+  // `data`
+  if (inserted)
+    documents[tile.doc].pages[tile.page_num][qMakePair(tile.xres, tile.yres)].insert(tile);
+}
+
+void PDFPageCache::Shard::remove(const PDFPageTile & tile)
+{
+  removing = true;
+  cache.remove(tile);
+  removing = false;
+}
+
+PDFPageCache::PDFPageCache()
+{
+  setMaxCost(0);
+}
+
+PDFPageCache::~PDFPageCache() = default;
+
+PDFPageCache::Shard & PDFPageCache::shardFor(const PDFPageTile & tile) const
+{
+  // NB: All resolutions of a tile end up in the same shard
+  quint64 h = mixBits(static_cast<quint64>(reinterpret_cast<quintptr>(tile.doc)) ^ static_cast<quint64>(tile.page_num));
+  h = mixBits(h ^ ((static_cast<quint64>(static_cast<quint32>(tile.render_box.x())) << 32) | static_cast<quint32>(tile.render_box.y())));
+  return _shards[static_cast<std::size_t>(h % NumShards)];
+}
+
+qint64 PDFPageCache::maxCost() const
+{
+  QMutexLocker l(&_maxCostLock);
+  return _maxCost;
+}
+
+void PDFPageCache::setMaxCost(const qint64 cost)
+{
+  QMutexLocker l(&_maxCostLock);
+  // NB: QCache rejects objects that cost more than its maximum, so a smaller
+  // budget per shard would keep tiles from being cached at all
+  _maxCost = qMax((cost > 0 ? cost : defaultMaxCost()), minMaxCost());
+  const qint64 shardCost = _maxCost / NumShards;
+  for (Shard & shard : _shards) {
+    QMutexLocker shardLocker(&shard.mutex);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    shard.cache.setMaxCost(static_cast<int>(qMin(shardCost, static_cast<qint64>(INT_MAX))));
+#else
+    shard.cache.setMaxCost(shardCost);
+#endif
+  }
+}
+
+//static
+qint64 PDFPageCache::minMaxCost()
+{
+  constexpr qint64 maxTileCost = 1024 * 1024 * 4;
+  return NumShards * maxTileCost;
+}
+
+//static
+qint64 PDFPageCache::defaultMaxCost()
+{
+  constexpr qint64 MiB = 1024 * 1024;
+  qint64 physicalMemory{0};
+#if defined(Q_OS_WIN)
+  MEMORYSTATUSEX memStatus;
+  memStatus.dwLength = sizeof(memStatus);
+  if (GlobalMemoryStatusEx(&memStatus))
+    physicalMemory = static_cast<qint64>(memStatus.ullTotalPhys);
+#elif defined(Q_OS_UNIX)
+  const long numPages = sysconf(_SC_PHYS_PAGES);
+  const long pageSize = sysconf(_SC_PAGE_SIZE);
+  if (numPages > 0 && pageSize > 0)
+    physicalMemory = static_cast<qint64>(numPages) * static_cast<qint64>(pageSize);
+#endif
+  // Fall back to the budget we used to have if we can't determine the amount
+  // of memory
+  if (physicalMemory <= 0)
+    return 1024 * MiB;
+  // Use 1/8 of the physical memory, but at least 256 MiB (64 tiles) and at
+  // most 4 GiB
+  return qBound(256 * MiB, physicalMemory / 8, 4096 * MiB);
+}
+
 QSharedPointer<QImage> PDFPageCache::getImage(const PDFPageTile & tile) const
 {
-  QReadLocker locker(&_lock);
-  CachedTileData * data = m_cache.object(tile);
+  Shard & shard = shardFor(tile);
+  QMutexLocker l(&shard.mutex);
+  CachedTileData * data = shard.cache.object(tile);
+  if (data && shard.statusOf(*data) == CURRENT)
+    ++shard.hits;
+  else
+    ++shard.misses;
   if (data) {
     return data->image;
   }
@@ -32,71 +238,247 @@ QSharedPointer<QImage> PDFPageCache::getImage(const PDFPageTile & tile) const
 
 PDFPageCache::TileStatus PDFPageCache::getStatus(const PDFPageTile & tile) const
 {
-  QReadLocker locker(&_lock);
-  CachedTileData * data = m_cache.object(tile);
+  Shard & shard = shardFor(tile);
+  QMutexLocker l(&shard.mutex);
+  CachedTileData * data = shard.cache.object(tile);
   if (data) {
-    return data->status;
+    return shard.statusOf(*data);
   }
   return UNKNOWN;
 }
 
 QSharedPointer<QImage> PDFPageCache::setImage(const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status, const bool overwrite /* = true */)
 {
-  QWriteLocker locker(&_lock);
-
-  auto insert = [this](const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status) {
-    CachedTileData * data = new CachedTileData{image, status};
-#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
-    m_cache.insert(tile, data, (image ? image->byteCount() : 0));
-#elif QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    // No image (1024x124x4 bytes by default) should ever come even close to the
-    // 2 GB mark corresponding to INT_MAX; note that Document::Document() sets
-    // the cache's max-size to 1 GB total
-    m_cache.insert(tile, data, (image ? static_cast<int>(image->sizeInBytes()) : 0));
-#else
-    m_cache.insert(tile, data, (image ? image->sizeInBytes() : 0));
-#endif
-  };
+  Shard & shard = shardFor(tile);
+  QMutexLocker l(&shard.mutex);
 
-  CachedTileData * data = m_cache.object(tile);
+  CachedTileData * data = shard.cache.object(tile);
   if (!data) {
-    insert(tile, image, status);
+    shard.insert(tile, image, status);
     return image;
   }
   if (data->image == image) {
     // Trying to overwrite an image with itself - just update the status
     data->status = status;
+    data->generation = shard.generationOf(tile.doc);
     return data->image;
   }
   if (overwrite) {
-    insert(tile, image, status);
+    shard.insert(tile, image, status);
     return image;
   }
   return data->image;
 }
 
+void PDFPageCache::clear()
+{
+  for (Shard & shard : _shards) {
+    QMutexLocker l(&shard.mutex);
+    shard.removing = true;
+    shard.cache.clear();
+    shard.removing = false;
+    shard.documents.clear();
+  }
+}
+
 void PDFPageCache::removeDocumentTiles(const Document *doc)
 {
-  QWriteLocker l(&_lock);
+  for (Shard & shard : _shards) {
+    QMutexLocker l(&shard.mutex);
+    auto it = shard.documents.find(doc);
+    if (it == shard.documents.end())
+      continue;
+    // Take the entry out of the index first; CachedTileData's destructor then
+    // has nothing left to update
+    const DocumentEntry entry = *it;
+    shard.documents.erase(it);
+    shard.removing = true;
+    for (const PageEntry & page : entry.pages) {
+      for (const LevelEntry & level : page) {
+        for (const PDFPageTile & tile : level.tiles)
+          shard.cache.remove(tile);
+      }
+    }
+    shard.removing = false;
+  }
+}
+
+void PDFPageCache::markOutdated(const Document * doc, const QSet<page_size_type> & unchangedPages /* = QSet<page_size_type>() */)
+{
+  for (Shard & shard : _shards) {
+    QMutexLocker l(&shard.mutex);
+    auto it = shard.documents.find(doc);
+    if (it == shard.documents.end())
+      continue;
+    const quint64 previousGeneration = (it->generation)++;
+    for (const page_size_type page_num : unchangedPages) {
+      auto pageIt = it->pages.constFind(page_num);
+      if (pageIt == it->pages.constEnd())
+        continue;
+      for (const LevelEntry & level : *pageIt) {
+        for (const PDFPageTile & tile : level.tiles) {
+          // Only tiles that were current up to now stay current; tiles that
+          // were outdated before (e.g., because the page changed in an earlier
+          // revision) or placeholders (whose rendering was for the previous
+          // revision) don't
+          CachedTileData * data = shard.cache.object(tile);
+          if (data && data->status == CURRENT && data->generation == previousGeneration)
+            data->generation = it->generation;
+        }
+      }
+    }
+  }
+}
+
+void PDFPageCache::discardPlaceholder(const PDFPageTile & tile)
+{
+  Shard & shard = shardFor(tile);
+  QMutexLocker l(&shard.mutex);
+
+  CachedTileData * data = shard.cache.object(tile);
+  if (data && shard.statusOf(*data) == PLACEHOLDER) {
+    data->status = OUTDATED;
+  }
+}
+
+void PDFPageCache::removePlaceholders(const Document * doc, const page_size_type page_num)
+{
+  for (Shard & shard : _shards) {
+    QMutexLocker l(&shard.mutex);
+    auto docIt = shard.documents.constFind(doc);
+    if (docIt == shard.documents.constEnd())
+      continue;
+    auto pageIt = docIt->pages.constFind(page_num);
+    if (pageIt == docIt->pages.constEnd())
+      continue;
+    // Collect the tiles first as removing them modifies the index
+    QList<PDFPageTile> placeholders;
+    for (const LevelEntry & level : *pageIt) {
+      for (const PDFPageTile & tile : level.tiles) {
+        const CachedTileData * data = shard.cache.object(tile);
+        if (data && data->composed && shard.statusOf(*data) == PLACEHOLDER)
+          placeholders.append(tile);
+      }
+    }
+    for (const PDFPageTile & tile : placeholders)
+      shard.remove(tile);
+  }
+}
 
-  const auto keys = m_cache.keys();
-  for (const PDFPageTile & tile : keys) {
-    if (tile.doc == doc) {
-      m_cache.remove(tile);
+QSet<PDFPageCache::page_size_type> PDFPageCache::pagesWithTiles(const Document * doc) const
+{
+  QSet<page_size_type> retVal;
+  for (const Shard & shard : _shards) {
+    QMutexLocker l(&shard.mutex);
+    auto docIt = shard.documents.constFind(doc);
+    if (docIt == shard.documents.constEnd())
+      continue;
+    for (auto pageIt = docIt->pages.cbegin(); pageIt != docIt->pages.cend(); ++pageIt)
+      retVal.insert(pageIt.key());
+  }
+  return retVal;
+}
+
+QList<PDFPageTile> PDFPageCache::tiles(const Document * doc, const page_size_type page_num) const
+{
+  QList<PDFPageTile> retVal;
+  for (const Shard & shard : _shards) {
+    QMutexLocker l(&shard.mutex);
+    auto docIt = shard.documents.constFind(doc);
+    if (docIt == shard.documents.constEnd())
+      continue;
+    auto pageIt = docIt->pages.constFind(page_num);
+    if (pageIt == docIt->pages.constEnd())
+      continue;
+    for (const LevelEntry & level : *pageIt) {
+      for (const PDFPageTile & tile : level.tiles)
+        retVal.append(tile);
     }
   }
+  return retVal;
 }
 
-void PDFPageCache::markOutdated(const Document * doc)
+QList<PDFPageCache::CachedTile> PDFPageCache::overlappingTiles(const PDFPageTile & tile) const
 {
-  QWriteLocker l(&_lock);
+  QList<CachedTile> retVal;
+  const QRectF rect(tile.render_box);
+  for (Shard & shard : _shards) {
+    QMutexLocker l(&shard.mutex);
+    auto docIt = shard.documents.constFind(tile.doc);
+    if (docIt == shard.documents.constEnd())
+      continue;
+    auto pageIt = docIt->pages.constFind(tile.page_num);
+    if (pageIt == docIt->pages.constEnd())
+      continue;
+    for (auto levelIt = pageIt->cbegin(); levelIt != pageIt->cend(); ++levelIt) {
+      const LevelEntry & level = levelIt.value();
+      // `tile` in the coordinates of this resolution level
+      const QRectF levelRect = QTransform::fromScale(levelIt.key().first / tile.xres, levelIt.key().second / tile.yres).mapRect(rect);
+      const auto addIfOverlapping = [&](const PDFPageTile & t) {
+        if (t == tile || !levelRect.intersects(QRectF(t.render_box)))
+          return;
+        // NB: This marks the tile as recently used, which is fine as it is
+        // about to be used as a stand-in
+        const CachedTileData * data = shard.cache.object(t);
+        if (!data || !data->image)
+          return;
+        retVal.append({t, data->image, shard.statusOf(*data)});
+      };
 
-  const auto keys = m_cache.keys();
-  for (const PDFPageTile & tile : keys) {
-    if (tile.doc == doc) {
-      m_cache[tile]->status = OUTDATED;
+      // Only look at the tiles in the grid cells `levelRect` overlaps, unless
+      // there are more of those cells than cells with tiles (e.g., for levels
+      // of much higher resolution than `tile`)
+      const QRect cells = gridCells(levelRect, GridCellSize);
+      if (static_cast<qint64>(cells.width()) * cells.height() > level.grid.size()) {
+        for (const PDFPageTile & t : level.tiles)
+          addIfOverlapping(t);
+        continue;
+      }
+      // Tiles spanning several cells must only be considered once
+      const bool singleCell = (cells.width() == 1 && cells.height() == 1);
+      QSet<PDFPageTile> seen;
+      for (int row = cells.top(); row <= cells.bottom(); ++row) {
+        for (int col = cells.left(); col <= cells.right(); ++col) {
+          auto cellIt = level.grid.constFind(qMakePair(col, row));
+          if (cellIt == level.grid.constEnd())
+            continue;
+          for (const PDFPageTile & t : *cellIt) {
+            if (!singleCell) {
+              if (seen.contains(t))
+                continue;
+              seen.insert(t);
+            }
+            addIfOverlapping(t);
+          }
+        }
+      }
     }
   }
+  return retVal;
+}
+
+PDFPageCache::Statistics PDFPageCache::statistics() const
+{
+  Statistics retVal;
+  for (const Shard & shard : _shards) {
+    QMutexLocker l(&shard.mutex);
+    retVal.hits += shard.hits;
+    retVal.misses += shard.misses;
+    retVal.evictions += shard.evictions;
+    retVal.numTiles += shard.cache.count();
+    retVal.totalCost += shard.cache.totalCost();
+  }
+  return retVal;
+}
+
+void PDFPageCache::resetStatistics()
+{
+  for (Shard & shard : _shards) {
+    QMutexLocker l(&shard.mutex);
+    shard.hits = 0;
+    shard.misses = 0;
+    shard.evictions = 0;
+  }
 }
 
 } // namespace Backend
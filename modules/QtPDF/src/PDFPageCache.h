@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2023-2024  Stefan Löffler, Charlie Sharpsteen
+ * Copyright (C) 2023-2025  Stefan Löffler, Charlie Sharpsteen
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -18,9 +18,14 @@
 #include "PDFPageTile.h"
 
 #include <QCache>
-#include <QReadWriteLock>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QPair>
+#include <QSet>
 #include <QSharedPointer>
-#include <QWriteLocker>
+
+#include <array>
 
 class QImage;
 
@@ -29,6 +34,14 @@ namespace QtPDF {
 namespace Backend {
 
 // This class is thread-safe
+// The tiles are distributed over several shards, each of which has its own
+// lock, LRU list and (an equal share of the) memory budget. This keeps
+// contention low when several render threads and the GUI thread access the
+// cache concurrently. Each shard additionally keeps an index of its tiles by
+// document, page, resolution and position (in a coarse grid) so that
+// operations concerning only one document, page or area (e.g., finding
+// stand-ins for tiles that are still being rendered) don't have to go through
+// all cached tiles.
 class PDFPageCache
 {
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
@@ -36,11 +49,45 @@ class PDFPageCache
 #else
   using size_type = qsizetype;
 #endif
+
 public:
+  using page_size_type = decltype(PDFPageTile::page_num);
+
   enum TileStatus { UNKNOWN, PLACEHOLDER, CURRENT, OUTDATED };
 
-  size_type maxCost() const { QReadLocker locker(&_lock); return m_cache.maxCost(); }
-  void setMaxCost(const size_type cost) { QWriteLocker locker(&_lock); m_cache.setMaxCost(cost); }
+  struct Statistics {
+    // calls to getImage() that found a current image
+    qint64 hits{0};
+    // calls to getImage() that found no image, or only a placeholder or an
+    // outdated one
+    qint64 misses{0};
+    // tiles that were removed to make room for new ones
+    qint64 evictions{0};
+    qint64 numTiles{0};
+    // total size of all cached images in bytes
+    qint64 totalCost{0};
+  };
+
+  // A tile together with its image and status at the time of the query
+  struct CachedTile {
+    PDFPageTile tile;
+    QSharedPointer<QImage> image;
+    TileStatus status;
+  };
+
+  PDFPageCache();
+  ~PDFPageCache();
+
+  // Memory budget in bytes
+  qint64 maxCost() const;
+  // Values <= 0 select defaultMaxCost(); values below minMaxCost() are raised
+  // to it
+  void setMaxCost(const qint64 cost);
+  // The smallest budget; it lets every shard hold at least one tile of the
+  // largest size the view renders (1024 x 1024 pixels)
+  static qint64 minMaxCost();
+  // A budget based on the amount of physical memory of the system
+  static qint64 defaultMaxCost();
 
   // Returns the image under the key `tile` or nullptr if it doesn't exist
   QSharedPointer<QImage> getImage(const PDFPageTile & tile) const;
@@ -50,23 +97,114 @@ public:
   // it can be different
   QSharedPointer<QImage> setImage(const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status, const bool overwrite = true);
 
-  void clear() { QWriteLocker l(&_lock); m_cache.clear(); }
+  void clear();
   void removeDocumentTiles(const Document *doc);
-  // Mark all tiles outdated
-  void markOutdated(const Document *doc);
+  // Mark all tiles outdated, except for the current tiles of `unchangedPages`
+  // (e.g., pages whose contents did not change when the document was
+  // reloaded); these stay current
+  // NB: This does not touch the individual tiles (except those of
+  // `unchangedPages`); tiles cached before the call simply report OUTDATED
+  // from then on
+  void markOutdated(const Document *doc, const QSet<page_size_type> & unchangedPages = QSet<page_size_type>());
+  // Mark the tile outdated if it is a placeholder (e.g., because the
+  // corresponding render request was dropped); this ensures the tile is
+  // requested again the next time it is needed while the placeholder image
+  // can still be displayed in the meantime
+  void discardPlaceholder(const PDFPageTile & tile);
+  // Removes all placeholders of the given page that were composed from other
+  // tiles, e.g., so they are composed anew when better stand-ins have become
+  // available in the meantime; outdated images serving as placeholders are
+  // kept
+  void removePlaceholders(const Document * doc, const page_size_type page_num);
+
+  // Returns the numbers of all pages of the given document that have cached
+  // tiles
+  QSet<page_size_type> pagesWithTiles(const Document * doc) const;
+  // Returns all cached tiles of the given page
+  QList<PDFPageTile> tiles(const Document * doc, const page_size_type page_num) const;
+  // Returns all cached tiles of the same page as `tile` (at any resolution)
+  // that overlap `tile` once they are scaled to its resolution; `tile` itself
+  // is not included
+  // NB: This does not count towards the hits or misses
+  QList<CachedTile> overlappingTiles(const PDFPageTile & tile) const;
+
+  Statistics statistics() const;
+  void resetStatistics();
 
-  QList<PDFPageTile> tiles() const { QReadLocker locker(&_lock); return m_cache.keys(); }
 protected:
+  static constexpr int NumShards = 8;
+
+  struct Shard;
+
   struct CachedTileData {
+    CachedTileData(Shard * shard, const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status, const quint64 generation)
+      : shard(shard), tile(tile), image(image), status(status), generation(generation), composed(status == PLACEHOLDER) { }
+    // Removes the tile from the shard's index; this also covers tiles that
+    // QCache deletes on its own to make room for new ones
+    ~CachedTileData();
+
+    Shard * shard;
+    const PDFPageTile tile;
     QSharedPointer<QImage> image;
     TileStatus status;
+    // The DocumentEntry::generation at the time the status was set
+    quint64 generation;
+    // true if `image` was inserted as a placeholder (i.e., composed from other
+    // tiles) rather than rendered for this tile
+    bool composed;
+  };
+
+  // (xres, yres)
+  using Resolution = QPair<double, double>;
+  // (column, row) of a cell of GridCellSize x GridCellSize pixels
+  using GridCell = QPair<int, int>;
+  static constexpr int GridCellSize = 1024;
+
+  // The tiles of one page at one resolution; `grid` additionally lists them
+  // under every grid cell their render_box overlaps
+  struct LevelEntry {
+    void insert(const PDFPageTile & tile);
+    void remove(const PDFPageTile & tile);
+    bool isEmpty() const { return tiles.isEmpty(); }
+
+    QSet<PDFPageTile> tiles;
+    QHash<GridCell, QSet<PDFPageTile> > grid;
+  };
+  // The tiles of one page, grouped by resolution
+  using PageEntry = QMap<Resolution, LevelEntry>;
+
+  struct DocumentEntry {
+    // Incremented by markOutdated()
+    quint64 generation{0};
+    QHash<page_size_type, PageEntry> pages;
+  };
+
+  struct Shard {
+    ~Shard();
+
+    // The following methods require `mutex` to be locked
+    TileStatus statusOf(const CachedTileData & data) const;
+    quint64 generationOf(const Document * doc) const;
+    void insert(const PDFPageTile & tile, QSharedPointer<QImage> image, const TileStatus status);
+    void remove(const PDFPageTile & tile);
+
+    mutable QMutex mutex;
+    // NB: `documents` must be declared before (i.e., destroyed after) `cache`
+    // as CachedTileData::~CachedTileData() accesses it
+    QHash<const Document *, DocumentEntry> documents;
+    QCache<PDFPageTile, CachedTileData> cache;
+    // true while tiles are removed deliberately (as opposed to being evicted)
+    bool removing{false};
+    mutable qint64 hits{0};
+    mutable qint64 misses{0};
+    qint64 evictions{0};
   };
 
-  mutable QReadWriteLock _lock;
+  Shard & shardFor(const PDFPageTile & tile) const;
 
-  // Set cache for rendered pages to be 1GB. This is enough for 256 RGBA tiles
-  // (1024 x 1024 pixels x 4 bytes per pixel).
-  QCache<PDFPageTile, CachedTileData> m_cache{1024 * 1024 * 1024};
+  mutable std::array<Shard, NumShards> _shards;
+  qint64 _maxCost{0};
+  mutable QMutex _maxCostLock;
 };
 
 } // namespace Backend
@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2023  Stefan Löffler
+ * Copyright (C) 2023-2025  Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -97,6 +97,7 @@ void PDFPageLayout::addPage(PDFPageGraphicsItem * page) {
     return;
 
   item.page = page;
+  item.size = page->pageSizeF();
   if (_layoutItems.isEmpty()) {
     item.row = 0;
     item.col = _firstCol;
@@ -113,7 +114,7 @@ void PDFPageLayout::addPage(PDFPageGraphicsItem * page) {
 }
 
 void PDFPageLayout::removePage(PDFPageGraphicsItem * page) {
-  QList<LayoutItem>::iterator it;
+  QVector<LayoutItem>::iterator it;
   int row = 0, col = 0;
 
   // **TODO:** Decide what to do with pages that are in the list multiple times
@@ -144,11 +145,13 @@ void PDFPageLayout::removePage(PDFPageGraphicsItem * page) {
 }
 
 void PDFPageLayout::insertPage(PDFPageGraphicsItem * page, PDFPageGraphicsItem * before /* = nullptr */) {
-  QList<LayoutItem>::iterator it;
+  QVector<LayoutItem>::iterator it;
   int row = 0, col = 0;
   LayoutItem item;
 
   item.page = page;
+  if (page)
+    item.size = page->pageSizeF();
 
   // **TODO:** Decide what to do with pages that are in the list multiple times
   // (see also insertPage())
@@ -195,8 +198,9 @@ void PDFPageLayout::relayout() {
 void PDFPageLayout::continuousModeRelayout() {
   // Create arrays to hold offsets and make sure that they have
   // sufficient space (to avoid moving the data around in memory)
-  QVector<qreal> colOffsets(_numCols + 1, 0), rowOffsets(rowCount() + 1, 0);
-  QList<LayoutItem>::iterator it;
+  const int numRows = rowCount();
+  QVector<qreal> colOffsets(_numCols + 1, 0), rowOffsets(numRows + 1, 0);
+  QVector<LayoutItem>::iterator it;
   QSizeF pageSize;
   QRectF sceneRect;
 
@@ -204,7 +208,7 @@ void PDFPageLayout::continuousModeRelayout() {
   for (it = _layoutItems.begin(); it != _layoutItems.end(); ++it) {
     if (!it->page)
       continue;
-    pageSize = it->page->pageSizeF();
+    pageSize = it->size;
 
     if (colOffsets[it->col + 1] < pageSize.width())
       colOffsets[it->col + 1] = pageSize.width();
@@ -215,7 +219,7 @@ void PDFPageLayout::continuousModeRelayout() {
   // Next, calculate cumulative offsets (including spacing)
   for (int i = 1; i <= _numCols; ++i)
     colOffsets[i] += colOffsets[i - 1] + _xSpacing;
-  for (int i = 1; i <= rowCount(); ++i)
+  for (int i = 1; i <= numRows; ++i)
     rowOffsets[i] += rowOffsets[i - 1] + _ySpacing;
 
   // Finally, position pages
@@ -229,7 +233,7 @@ void PDFPageLayout::continuousModeRelayout() {
     // left-align the right-most column to avoid large space between columns
     // In all other cases, center the page in allotted space (in case we
     // stumble over pages of different sizes, e.g., landscape pages, etc.)
-    pageSize = it->page->pageSizeF();
+    pageSize = it->size;
     qreal x{0};
     if (_numCols > 1 && it->col == 0)
       x = colOffsets[it->col + 1] - _xSpacing - pageSize.width();
@@ -245,7 +249,7 @@ void PDFPageLayout::continuousModeRelayout() {
   // leave some space around the pages (note that the space on the right/bottom
   // is already included in the corresponding Offset values and that the method
   // signature is (x0, y0, w, h)!)
-  sceneRect.setRect(-_xSpacing / 2, -_ySpacing / 2, colOffsets[_numCols], rowOffsets[rowCount()]);
+  sceneRect.setRect(-_xSpacing / 2, -_ySpacing / 2, colOffsets[_numCols], rowOffsets[numRows]);
   emit layoutChanged(sceneRect);
 }
 
@@ -253,7 +257,7 @@ void PDFPageLayout::continuousModeRelayout() {
 void PDFPageLayout::singlePageModeRelayout()
 {
   qreal maxWidth = 0.0, maxHeight = 0.0;
-  QList<LayoutItem>::iterator it;
+  QVector<LayoutItem>::iterator it;
   QSizeF pageSize;
   QRectF sceneRect;
 
@@ -262,7 +266,7 @@ void PDFPageLayout::singlePageModeRelayout()
   for (it = _layoutItems.begin(); it != _layoutItems.end(); ++it) {
     if (!it->page)
       continue;
-    pageSize = it->page->pageSizeF();
+    pageSize = it->size;
     qreal width{pageSize.width()};
     qreal height{pageSize.height()};
     if (width > maxWidth)
@@ -277,7 +281,7 @@ void PDFPageLayout::singlePageModeRelayout()
 }
 
 void PDFPageLayout::rearrange() {
-  QList<LayoutItem>::iterator it;
+  QVector<LayoutItem>::iterator it;
   int row{0};
   int col{_firstCol};
   for (it = _layoutItems.begin(); it != _layoutItems.end(); ++it) {
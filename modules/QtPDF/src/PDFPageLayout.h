@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2023  Stefan Löffler
+ * Copyright (C) 2023-2025  Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -14,8 +14,9 @@
 #ifndef PDFPageLayout_H
 #define PDFPageLayout_H
 
-#include <QList>
 #include <QObject>
+#include <QSizeF>
+#include <QVector>
 
 namespace QtPDF {
 
@@ -27,11 +28,14 @@ class PDFPageLayout : public QObject {
   Q_OBJECT
   struct LayoutItem {
     PDFPageGraphicsItem * page{nullptr};
+    // The size of `page` (which doesn't change); cached so relayouts only need
+    // to go over this (contiguous) list, even for thousands of pages
+    QSizeF size;
     int row{-1};
     int col{-1};
   };
 
-  QList<LayoutItem> _layoutItems;
+  QVector<LayoutItem> _layoutItems;
   int _numCols{1};
   int _firstCol{0};
   qreal _xSpacing{10}; // spacing in pixel @ zoom=1
@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2023  Stefan Löffler
+ * Copyright (C) 2023-2025  Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -20,8 +20,10 @@
 namespace QtPDF {
 namespace Backend {
 
+int PDFPageProcessingThreadPool::_defaultMaxThreadCount = 0;
+
 #ifdef DEBUG
-void PDFPageProcessingThread::dumpWorkStack(const QStack<PageProcessingRequest*> & ws)
+void PDFPageProcessingThreadPool::dumpWorkStack(const QStack<PageProcessingRequest*> & ws)
 {
   QStringList strList;
   for (int i = 0; i < ws.size(); ++i) {
@@ -39,16 +41,126 @@ void PDFPageProcessingThread::dumpWorkStack(const QStack<PageProcessingRequest*>
 // Backend Rendering
 // =================
 
-PDFPageProcessingThread::~PDFPageProcessingThread()
+void PDFPageProcessingThread::run()
+{
+  while (PageProcessingRequest * workItem = _pool->takeRequest()) {
+#ifdef DEBUG
+    qDebug() << "processing work item" << *workItem;
+    QElapsedTimer timer;
+    timer.start();
+#endif
+    workItem->execute();
+#ifdef DEBUG
+    QString jobDesc;
+    switch (workItem->type()) {
+      case PageProcessingRequest::LoadLinks:
+        jobDesc = QString::fromUtf8("loading links");
+        break;
+      case PageProcessingRequest::PageRendering:
+        jobDesc = QString::fromUtf8("rendering page");
+        break;
+    }
+    qDebug() << "finished " << jobDesc << "for page" << workItem->page->pageNum() << ". Time elapsed: " << timer.elapsed() << " ms.";
+#endif
+
+    // Delete the work item as it has fulfilled its purpose
+    // Note that we can't delete it here or we might risk that some emitted
+    // signals are invalidated; to ensure they reach their destination, we
+    // need to call deleteLater().
+    // Note: workItem *must* live in the main (GUI) thread for this!
+    Q_ASSERT(workItem->thread() == QCoreApplication::instance()->thread());
+    _pool->finishRequest(workItem);
+    workItem->deleteLater();
+  }
+}
+
+PDFPageProcessingThreadPool::~PDFPageProcessingThreadPool()
 {
   _mutex.lock();
   _quit = true;
   _waitCondition.wakeAll();
   _mutex.unlock();
-  wait();
+  for (const std::unique_ptr<PDFPageProcessingThread> & thread : _threads)
+    thread->wait();
+
+  // Workers quit without touching the remaining requests, so we have to clean
+  // them up here
+  for (QStack<PageProcessingRequest*> & workStack : _workStacks) {
+    foreach(PageProcessingRequest * workItem, workStack) {
+      if (workItem)
+        workItem->deleteLater();
+    }
+  }
+}
+
+int PDFPageProcessingThreadPool::defaultMaxThreadCount()
+{
+  if (_defaultMaxThreadCount > 0)
+    return _defaultMaxThreadCount;
+  return qMax(1, QThread::idealThreadCount());
+}
+
+void PDFPageProcessingThreadPool::setDefaultMaxThreadCount(const int count)
+{
+  _defaultMaxThreadCount = count;
 }
 
-void PDFPageProcessingThread::addPageProcessingRequest(PageProcessingRequest * request)
+int PDFPageProcessingThreadPool::maxThreadCount() const
+{
+  QMutexLocker locker(&_mutex);
+  return (_maxThreadCount > 0 ? _maxThreadCount : defaultMaxThreadCount());
+}
+
+void PDFPageProcessingThreadPool::setMaxThreadCount(const int count)
+{
+  QMutexLocker locker(&_mutex);
+  _maxThreadCount = count;
+  // If the limit was raised, idle workers may be able to pick up some work now
+  _waitCondition.wakeAll();
+}
+
+int PDFPageProcessingThreadPool::concurrencyLimit() const
+{
+  QMutexLocker locker(&_mutex);
+  return _concurrencyLimit;
+}
+
+void PDFPageProcessingThreadPool::setConcurrencyLimit(const int limit)
+{
+  QMutexLocker locker(&_mutex);
+  _concurrencyLimit = limit;
+  _waitCondition.wakeAll();
+}
+
+int PDFPageProcessingThreadPool::threadCount() const
+{
+  QMutexLocker locker(&_mutex);
+  return static_cast<int>(_threads.size());
+}
+
+int PDFPageProcessingThreadPool::_effectiveMaxThreadCount() const
+{
+  int retVal = (_maxThreadCount > 0 ? _maxThreadCount : defaultMaxThreadCount());
+  if (_concurrencyLimit > 0)
+    retVal = qMin(retVal, _concurrencyLimit);
+  return retVal;
+}
+
+bool PDFPageProcessingThreadPool::_isWorkStackEmpty() const
+{
+  for (const QStack<PageProcessingRequest*> & workStack : _workStacks) {
+    if (!workStack.empty())
+      return false;
+  }
+  return true;
+}
+
+bool PDFPageProcessingThreadPool::_canTakeRequest() const
+{
+  return !_isWorkStackEmpty() && _activeRequests.size() < _effectiveMaxThreadCount();
+}
+
+void PDFPageProcessingThreadPool::addPageProcessingRequest(PageProcessingRequest * request)
 {
 
   if (!request)
@@ -59,111 +171,195 @@ void PDFPageProcessingThread::addPageProcessingRequest(PageProcessingRequest * r
   Q_ASSERT(request->thread() == QCoreApplication::instance()->thread());
 
   QMutexLocker locker(&(this->_mutex));
-  // Note: Commenting the "remove identical requests in the stack" code for now.
-  // This should be handled by the caching routine elsewhere automatically. If
-  // in doubt, it's better to render a tile twice than to not render it at all
-  // (thereby leaving the dummy image in the cache indefinitely)
-/*
-  // remove any instances of the given request type before adding the new one to
-  // avoid processing it several times
-  // **TODO:** Could it be that we require several concurrent versions of the
-  //           same page?
-  int i;
-  for (i = _workStack.size() - 1; i >= 0; --i) {
-    if (*(_workStack[i]) == *request) {
-      // Using deleteLater() doesn't work because we have no event queue in this
-      // thread. However, since the object is still on the stack, it is still
-      // sleeping and directly deleting it should therefore be safe.
-      delete _workStack[i];
-      _workStack.remove(i);
+
+  // If an identical request is already being processed, its result will
+  // reach the same listener, so there is no point in doing the work twice
+  // Note: If in doubt, it's better to render a tile twice than to not render
+  // it at all (thereby leaving the dummy image in the cache indefinitely), so
+  // we only coalesce requests that are identical and target the same listener
+  foreach(PageProcessingRequest * activeRequest, _activeRequests) {
+    if (!activeRequest->isAborted() && activeRequest->listener == request->listener && *activeRequest == *request) {
+#ifdef DEBUG
+      qDebug() << "coalescing request with active request:" << *request;
+#endif
+      ++_statistics.coalesced;
+      request->deleteLater();
+      return;
+    }
+  }
+
+  // Remove any pending instance of the same request before adding the new one
+  // to avoid processing it several times; the new one inherits the more urgent
+  // priority of the two and moves to the top of its stack
+  for (QStack<PageProcessingRequest*> & workStack : _workStacks) {
+    for (auto i = workStack.size() - 1; i >= 0; --i) {
+      PageProcessingRequest * pendingRequest = workStack[i];
+      if (pendingRequest->listener != request->listener || !(*pendingRequest == *request))
+        continue;
+#ifdef DEBUG
+      qDebug() << "coalescing request with pending request:" << *request;
+#endif
+      if (pendingRequest->priority < request->priority)
+        request->priority = pendingRequest->priority;
+      workStack.remove(i);
+      pendingRequest->deleteLater();
+      ++_statistics.coalesced;
     }
   }
-*/
 
-  _workStack.push(request);
+  _workStacks[request->priority].push(request);
 #ifdef DEBUG
   qDebug() << "new request:" << *request;
 #endif
 
-  locker.unlock();
-  if (!isRunning())
-    start();
+  // Only spin up another worker if all existing ones are busy and we are
+  // allowed to process more jobs in parallel
+  if (_numIdleThreads == 0 && static_cast<int>(_threads.size()) < _effectiveMaxThreadCount()) {
+    _threads.push_back(std::unique_ptr<PDFPageProcessingThread>(new PDFPageProcessingThread(this)));
+    _threads.back()->start();
+  }
   else
     _waitCondition.wakeOne();
 }
 
-void PDFPageProcessingThread::run()
+int PDFPageProcessingThreadPool::dropRequests(const std::function<bool(const PageProcessingRequest &)> & isStale)
 {
-  _mutex.lock();
-  _idle = false;
-  while (!_quit) {
-    // mutex must be locked at start of loop
-    if (!_workStack.empty()) {
-      PageProcessingRequest * workItem = _workStack.pop();
-      _mutex.unlock();
+  // Requests may only be destroyed in the main (GUI) thread
+  Q_ASSERT(QThread::currentThread() == QCoreApplication::instance()->thread());
 
-#ifdef DEBUG
-      qDebug() << "processing work item" << *workItem << "; remaining items:" << _workStack.size();
-      QElapsedTimer timer;
-      timer.start();
-#endif
-      workItem->execute();
-#ifdef DEBUG
-      QString jobDesc;
-      switch (workItem->type()) {
-        case PageProcessingRequest::LoadLinks:
-          jobDesc = QString::fromUtf8("loading links");
-          break;
-        case PageProcessingRequest::PageRendering:
-          jobDesc = QString::fromUtf8("rendering page");
-          break;
+  int numDropped{0};
+  {
+    QMutexLocker locker(&_mutex);
+    for (QStack<PageProcessingRequest*> & workStack : _workStacks) {
+      for (auto i = workStack.size() - 1; i >= 0; --i) {
+        PageProcessingRequest * workItem = workStack[i];
+        if (!isStale(*workItem))
+          continue;
+        workStack.remove(i);
+        _droppedRequests.append(workItem);
       }
-      qDebug() << "finished " << jobDesc << "for page" << workItem->page->pageNum() << ". Time elapsed: " << timer.elapsed() << " ms.";
-#endif
+    }
+    numDropped = static_cast<int>(_droppedRequests.size());
+    foreach(PageProcessingRequest * workItem, _activeRequests) {
+      if (workItem->isAborted() || !isStale(*workItem))
+        continue;
+      // The worker takes care of cleaning up once execute() returns
+      workItem->abort();
+      ++numDropped;
+    }
+    _statistics.dropped += numDropped;
+  }
 
-      // Delete the work item as it has fulfilled its purpose
-      // Note that we can't delete it here or we might risk that some emitted
-      // signals are invalidated; to ensure they reach their destination, we
-      // need to call deleteLater().
-      // Note: workItem *must* live in the main (GUI) thread for this!
-      Q_ASSERT(workItem->thread() == QCoreApplication::instance()->thread());
-      workItem->deleteLater();
+  // NB: discard() accesses other locks (e.g., the page cache's), so don't hold
+  // _mutex (and thereby block the workers) while calling it
+  foreach(PageProcessingRequest * workItem, _droppedRequests) {
+    workItem->discard();
+    workItem->deleteLater();
+  }
+  {
+    QMutexLocker locker(&_mutex);
+    _droppedRequests.clear();
+  }
+#ifdef DEBUG
+  if (numDropped > 0)
+    qDebug() << "dropped" << numDropped << "stale requests";
+#endif
+  return numDropped;
+}
 
-      _mutex.lock();
+bool PDFPageProcessingThreadPool::hasRequestsFor(const Page * page) const
+{
+  QMutexLocker locker(&_mutex);
+  for (const QStack<PageProcessingRequest*> & workStack : _workStacks) {
+    for (const PageProcessingRequest * workItem : workStack) {
+      if (workItem && workItem->page == page)
+        return true;
     }
-    else {
+  }
+  for (const PageProcessingRequest * workItem : _activeRequests) {
+    if (workItem->page == page)
+      return true;
+  }
+  for (const PageProcessingRequest * workItem : _droppedRequests) {
+    if (workItem->page == page)
+      return true;
+  }
+  return false;
+}
+
+PageProcessingRequest * PDFPageProcessingThreadPool::takeRequest()
+{
+  QMutexLocker locker(&_mutex);
+  while (!_quit && !_canTakeRequest()) {
 #ifdef DEBUG
-      qDebug() << "going to sleep";
+    qDebug() << "going to sleep";
 #endif
-      _idle = true;
-      _idleCondition.wakeAll();
-      _waitCondition.wait(&_mutex);
-      _idle = false;
+    ++_numIdleThreads;
+    _waitCondition.wait(&_mutex);
+    --_numIdleThreads;
 #ifdef DEBUG
-      qDebug() << "waking up";
+    qDebug() << "waking up";
 #endif
-    }
   }
-  _mutex.unlock();
+  if (_quit)
+    return nullptr;
+
+  // Take the most recent request of the most urgent priority
+  for (QStack<PageProcessingRequest*> & workStack : _workStacks) {
+    if (workStack.empty())
+      continue;
+    PageProcessingRequest * workItem = workStack.pop();
+    _activeRequests.append(workItem);
+#ifdef DEBUG
+    dumpWorkStack(workStack);
+    qDebug() << "active jobs:" << _activeRequests.size();
+#endif
+    return workItem;
+  }
+  // _canTakeRequest() guarantees that some work stack is non-empty
+  Q_ASSERT(false);
+  return nullptr;
 }
 
-void PDFPageProcessingThread::clearWorkStack()
+void PDFPageProcessingThreadPool::finishRequest(PageProcessingRequest * request)
 {
-  _mutex.lock();
+  QMutexLocker locker(&_mutex);
+  _activeRequests.removeOne(request);
+  // Aborted requests were already counted as dropped
+  if (!request->isAborted())
+    ++_statistics.executed;
+  if (_activeRequests.empty())
+    _idleCondition.wakeAll();
+  // If we were limited by _concurrencyLimit, another worker may be waiting
+  // for the slot we just freed
+  if (!_isWorkStackEmpty())
+    _waitCondition.wakeOne();
+}
 
-  foreach(PageProcessingRequest * workItem, _workStack) {
-    if (!workItem)
-      continue;
-    Q_ASSERT(workItem->thread() == QCoreApplication::instance()->thread());
-    workItem->deleteLater();
+void PDFPageProcessingThreadPool::clearWorkStack()
+{
+  QMutexLocker locker(&_mutex);
+
+  for (QStack<PageProcessingRequest*> & workStack : _workStacks) {
+    foreach(PageProcessingRequest * workItem, workStack) {
+      if (!workItem)
+        continue;
+      Q_ASSERT(workItem->thread() == QCoreApplication::instance()->thread());
+      workItem->deleteLater();
+      ++_statistics.dropped;
+    }
+    workStack.clear();
   }
-  _workStack.clear();
 
-  if (!_idle) {
-    // Wait until the current operation finishes
-    _idleCondition.wait(&_mutex);
+  // Abort all currently running operations and wait until they finish
+  foreach(PageProcessingRequest * workItem, _activeRequests) {
+    if (!workItem->isAborted()) {
+      workItem->abort();
+      ++_statistics.dropped;
+    }
   }
-  _mutex.unlock();
+  while (!_activeRequests.empty())
+    _idleCondition.wait(&_mutex);
 }
 
 
@@ -206,19 +402,35 @@ const QEvent::Type PDFLinksLoadedEvent::LinksLoadedEvent = static_cast<QEvent::T
 
 bool PageProcessingRenderPageRequest::execute()
 {
-  // TODO: Aborting renders doesn't really work right now---the backend knows
-  // nothing about the PDF scenes.
-  //
-  // Idea: Perhaps allow page render requests to provide a pointer to a function
-  // that returns a `bool` value indicating if the request is still valid? Then
-  // the `PDFPageGraphicsItem` could have a function that indicates if the item
-  // is anywhere near a viewport.
-  QImage rendered_page = page->renderToImage(xres, yres, render_box, cache);
+  // The abort flag is handed on to the backend, which checks it regularly
+  // during rendering (if supported). Requests are aborted by the
+  // PDFPageProcessingThreadPool, e.g., when the tile scrolled out of view or
+  // the document is reloaded.
+  QImage rendered_page = page->renderToImage(xres, yres, render_box, cache, &_aborted);
+  if (isAborted()) {
+    // The (partial) result must not be used; in particular, we must not leave
+    // the placeholder in the cache
+    discard();
+    return false;
+  }
   QCoreApplication::postEvent(listener, new PDFPageRenderedEvent(xres, yres, render_box, rendered_page));
 
   return true;
 }
 
+void PageProcessingRenderPageRequest::discard()
+{
+  // If the tile was to be cached, a placeholder was put into the cache in the
+  // meantime (see Page::getTileImage()); make sure it doesn't stay there
+  // indefinitely
+  if (!cache)
+    return;
+  const Document * doc = page->document();
+  if (!doc)
+    return;
+  Document::pageCache().discardPlaceholder(PDFPageTile(xres, yres, render_box, doc, page->pageNum()));
+}
+
 bool PageProcessingLoadLinksRequest::execute()
 {
   QCoreApplication::postEvent(listener, new PDFLinksLoadedEvent(page->loadLinks()));
@@ -23,6 +23,12 @@
 #include <QThread>
 #include <QWaitCondition>
 
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
 namespace QtPDF {
 
 namespace Annotation {
@@ -33,27 +39,52 @@ namespace Backend {
 
 class Page;
 
+// Flag that can be set from any thread to ask a (possibly) lengthy operation,
+// e.g., rendering a page, to stop as soon as possible
+using AbortFlag = std::atomic<bool>;
+
 class PageProcessingRequest : public QObject
 {
   Q_OBJECT
   friend class PDFPageProcessingThread;
+  friend class PDFPageProcessingThreadPool;
+
+public:
+  enum Type { PageRendering, LoadLinks };
+  // Requests with a lower Priority value are processed first; requests of the
+  // same priority are processed in LIFO order
+  // Priority_Preview is meant for cheap (low-resolution) renderings that are
+  // displayed until the actual (visible) tiles become available
+  enum Priority { Priority_Preview, Priority_Visible, Priority_Prefetch, Priority_Background };
 
   // Protect c'tor and execute() so we can't access them except in derived
   // classes and friends
 protected:
-  PageProcessingRequest(Page *page, QObject *listener) : page(page), listener(listener) { }
+  PageProcessingRequest(Page *page, QObject *listener, const Priority priority) : page(page), listener(listener), priority(priority) { }
   // Should perform whatever processing it is designed to do
   // Returns true if finished successfully, false otherwise
   virtual bool execute() = 0;
+  // Called if the request became obsolete before it could be finished, i.e.,
+  // if it was removed from the work stack before it was executed, or if it was
+  // aborted while executing
+  // NB: May be called from the main (GUI) thread or from a worker thread
+  virtual void discard() { }
 
-public:
-  enum Type { PageRendering, LoadLinks };
+  // Set by abort(); execute() should check it regularly (or pass it on to the
+  // backend) and bail out as soon as possible if it is set
+  AbortFlag _aborted{false};
 
+public:
   ~PageProcessingRequest() override = default;
   virtual Type type() const = 0;
 
+  // Asks the request to stop executing as soon as possible; thread-safe
+  void abort() { _aborted = true; }
+  bool isAborted() const { return _aborted; }
+
   Page *page;
   QObject *listener;
+  Priority priority;
 
   virtual bool operator==(const PageProcessingRequest & r) const;
 #ifdef DEBUG
@@ -67,8 +98,8 @@ class PageProcessingRenderPageRequest : public PageProcessingRequest
   friend class PDFPageProcessingThread;
 
 public:
-  PageProcessingRenderPageRequest(Page *page, QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false) :
-    PageProcessingRequest(page, listener),
+  PageProcessingRenderPageRequest(Page *page, QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false, const Priority priority = Priority_Visible) :
+    PageProcessingRequest(page, listener, priority),
     xres(xres), yres(yres),
     render_box(render_box),
     cache(cache)
@@ -80,12 +111,13 @@ public:
   operator QString() const override;
 #endif
 
+  const double xres, yres;
+  const QRect render_box;
+  const bool cache;
+
 protected:
   bool execute() override;
-
-  double xres, yres;
-  QRect render_box;
-  bool cache;
+  void discard() override;
 };
 
 
@@ -115,7 +147,7 @@ class PageProcessingLoadLinksRequest : public PageProcessingRequest
   friend class PDFPageProcessingThread;
 
 public:
-  PageProcessingLoadLinksRequest(Page *page, QObject *listener) : PageProcessingRequest(page, listener) { }
+  PageProcessingLoadLinksRequest(Page *page, QObject *listener) : PageProcessingRequest(page, listener, Priority_Background) { }
   Type type() const override { return LoadLinks; }
 
 #ifdef DEBUG
@@ -143,27 +175,102 @@ public:
 };
 
 
+class PDFPageProcessingThreadPool;
+
 // Class to perform (possibly) lengthy operations on pages in the background
 // Modelled after the "Blocking Fortune Client Example" in the Qt docs
 // (https://doc.qt.io/qt-5/qtnetwork-blockingfortuneclient-example.html)
 
-// The `PDFPageProcessingThread` is a thread that processes background jobs.
-// Each job is represented by a subclass of `PageProcessingRequest` and
-// contains an `execute` method that performs the actual work.
+// The `PDFPageProcessingThread` is a worker thread that processes background
+// jobs. Each job is represented by a subclass of `PageProcessingRequest` and
+// contains an `execute` method that performs the actual work. Workers don't
+// hold any jobs themselves; they are owned by a `PDFPageProcessingThreadPool`
+// and take their jobs from its (shared) work stack.
 class PDFPageProcessingThread : public QThread
 {
   Q_OBJECT
 
 public:
-  PDFPageProcessingThread() = default;
-  ~PDFPageProcessingThread() override;
+  explicit PDFPageProcessingThread(PDFPageProcessingThreadPool * pool) : _pool(pool) { }
+
+protected:
+  void run() override;
+
+private:
+  PDFPageProcessingThreadPool * _pool;
+};
+
+// The `PDFPageProcessingThreadPool` manages up to `maxThreadCount()` worker
+// threads that process the jobs on its work stack concurrently. Jobs are
+// scheduled by priority first and in LIFO order second (the most recently
+// requested tiles are usually the ones the user is looking at). Workers are
+// only started when there is work that no idle worker could pick up, so
+// documents that are never rendered don't cost any threads.
+class PDFPageProcessingThreadPool
+{
+  friend class PDFPageProcessingThread;
+
+public:
+  // Counters to judge the effectiveness of the scheduling
+  struct Statistics {
+    // requests that were processed by a worker
+    qint64 executed{0};
+    // requests that were merged with an identical pending or running request
+    qint64 coalesced{0};
+    // requests that were removed from the work stack without being processed
+    qint64 dropped{0};
+  };
+
+  PDFPageProcessingThreadPool() = default;
+  ~PDFPageProcessingThreadPool();
+
+  PDFPageProcessingThreadPool(const PDFPageProcessingThreadPool &) = delete;
+  PDFPageProcessingThreadPool & operator=(const PDFPageProcessingThreadPool &) = delete;
+
+  // The number of workers used by pools that don't have an explicit
+  // maxThreadCount set; defaults to QThread::idealThreadCount()
+  static int defaultMaxThreadCount();
+  static void setDefaultMaxThreadCount(const int count);
+
+  // Maximum number of workers of this pool; values <= 0 select
+  // defaultMaxThreadCount()
+  int maxThreadCount() const;
+  void setMaxThreadCount(const int count);
+
+  // Upper bound on the number of jobs the backend can process concurrently
+  // (e.g., because it serializes all calls internally anyway); values <= 0
+  // mean "no limit"
+  int concurrencyLimit() const;
+  void setConcurrencyLimit(const int limit);
+
+  // Number of workers currently running (idle or busy)
+  int threadCount() const;
 
   // add a processing request to the work stack
   // Note: request must have been created on the heap and must be in the scope
   // of this thread; use requestRenderPage() and requestLoadLinks() for that
+  // If an identical request (for the same listener) is already pending, the
+  // two are coalesced; if one is currently being processed, the new request
+  // is discarded.
   void addPageProcessingRequest(PageProcessingRequest * request);
 
+  // Removes all pending requests for which `isStale` returns true from the
+  // work stack (e.g., tiles that scrolled out of view or were requested for a
+  // different zoom level) and returns the number of removed requests. Running
+  // requests for which `isStale` returns true are aborted (and counted, too).
+  // `isStale` is called in the calling thread with the pool's mutex locked, so
+  // it must not call back into the pool. The removed requests are discarded
+  // after the mutex is released.
+  // Must be called from the main (GUI) thread.
+  int dropRequests(const std::function<bool(const PageProcessingRequest &)> & isStale);
+
+  // Returns true if any request for `page` is pending or currently being
+  // processed
+  bool hasRequestsFor(const Page * page) const;
+
   // drop all remaining processing requests
+  // Running requests are aborted, so this usually only blocks for a short time
+  // (unless the backend does not support aborting)
   // WARNING: This function *must not* be called while the calling thread holds
   // any locks that would prevent and work item from finishing. Otherwise, we
   // could run into the following deadlock scenario:
@@ -172,16 +279,40 @@ public:
   // finish. However, that lock is held by the caller of clearWorkStack().
   void clearWorkStack();
 
-protected:
-  void run() override;
+  Statistics statistics() const { QMutexLocker locker(&_mutex); return _statistics; }
+  void resetStatistics() { QMutexLocker locker(&_mutex); _statistics = Statistics(); }
 
 private:
-  QStack<PageProcessingRequest*> _workStack;
-  QMutex _mutex;
+  // Called by the workers; blocks until there is a job the calling worker may
+  // process and returns it, or returns nullptr if the worker should quit
+  PageProcessingRequest * takeRequest();
+  // Called by the workers once they have finished the job obtained from
+  // takeRequest()
+  void finishRequest(PageProcessingRequest * request);
+
+  // The following methods require _mutex to be locked
+  int _effectiveMaxThreadCount() const;
+  bool _canTakeRequest() const;
+  bool _isWorkStackEmpty() const;
+
+  // One work stack per PageProcessingRequest::Priority
+  std::array<QStack<PageProcessingRequest*>, PageProcessingRequest::Priority_Background + 1> _workStacks;
+  // Requests currently being processed by the workers
+  QList<PageProcessingRequest*> _activeRequests;
+  // Requests removed from the work stacks by dropRequests() that are being
+  // discarded (outside of _mutex); hasRequestsFor() still counts them so their
+  // pages stay alive until then
+  QList<PageProcessingRequest*> _droppedRequests;
+  Statistics _statistics;
+  mutable QMutex _mutex;
   QWaitCondition _waitCondition;
-  bool _idle{true};
   QWaitCondition _idleCondition;
+  std::vector< std::unique_ptr<PDFPageProcessingThread> > _threads;
+  int _maxThreadCount{0};
+  int _concurrencyLimit{0};
+  int _numIdleThreads{0};
   bool _quit{false};
+  static int _defaultMaxThreadCount;
 #ifdef DEBUG
   static void dumpWorkStack(const QStack<PageProcessingRequest*> & ws);
 #endif
@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2022-2024  Stefan Löffler
+ * Copyright (C) 2022-2025  Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -13,6 +13,8 @@
  */
 #include "PDFSearcher.h"
 
+#include <QtConcurrent>
+
 namespace QtPDF {
 
 void PDFSearcher::populatePages()
@@ -81,6 +83,16 @@ void PDFSearcher::clear()
 void PDFSearcher::stopAndClear()
 {
   ensureStopped();
+  {
+    // Keep the results around so the next search can build on them (see
+    // run())
+    const QMutexLocker mutexLocker{&m_mutex};
+    if (!m_results.isEmpty()) {
+      m_previousResults = m_results;
+      m_previousSearchString = m_searchString;
+      m_previousSearchFlags = m_searchFlags;
+    }
+  }
   clear();
 }
 
@@ -175,24 +187,94 @@ void PDFSearcher::run()
     return;
   }
 
+  // If the search string contains the previous one, it can only occur on
+  // pages that contained the previous one as well
+  const bool skipPagesWithoutPreviousResults = [this] () {
+    const QMutexLocker mutexLocker{&m_mutex};
+    const Qt::CaseSensitivity caseSensitivity = (m_searchFlags.testFlag(Backend::Search_CaseInsensitive) ? Qt::CaseInsensitive : Qt::CaseSensitive);
+    return (!m_previousSearchString.isEmpty() &&
+            m_previousSearchFlags.testFlag(Backend::Search_CaseInsensitive) == m_searchFlags.testFlag(Backend::Search_CaseInsensitive) &&
+            m_searchString.contains(m_previousSearchString, caseSensitivity));
+  }();
+
   {
     const QMutexLocker mutexLocker{&m_mutex};
     m_results.resize(doc->numPages());
+    m_nextPage = 0;
+    m_numAnnounced = 0;
   }
 
-  for (const size_type & pageIndex : m_pages) {
-    if (isInterruptionRequested()) {
+  // This thread works on the search as well, so only idealThreadCount() - 1
+  // additional workers are needed
+  const int numWorkers = QThread::idealThreadCount() - 1;
+  QVector< QFuture<void> > futures;
+  for (int i = 0; i < numWorkers; ++i) {
+    futures << QtConcurrent::run(&m_workers, [this, doc, skipPagesWithoutPreviousResults] () {
+      searchPages(doc, skipPagesWithoutPreviousResults);
+    });
+  }
+  searchPages(doc, skipPagesWithoutPreviousResults);
+  for (QFuture<void> & future : futures) {
+    future.waitForFinished();
+  }
+}
+
+void PDFSearcher::searchPages(const QSharedPointer<Backend::Document> & doc, const bool skipPagesWithoutPreviousResults)
+{
+  while (!isInterruptionRequested()) {
+    const size_type pageIndex = [this] () {
+      const QMutexLocker mutexLocker{&m_mutex};
+      if (m_nextPage >= m_pages.size()) {
+        return static_cast<size_type>(-1);
+      }
+      return m_pages[m_nextPage++];
+    }();
+    if (pageIndex < 0) {
       break;
     }
+
     const QSharedPointer<Backend::Page> page{doc->page(pageIndex).toStrongRef()};
-    if (!page) {
-      continue;
+    const bool canSkip = [&] () {
+      if (!page || !skipPagesWithoutPreviousResults) {
+        return !page;
+      }
+      const QMutexLocker mutexLocker{&m_mutex};
+      if (pageIndex >= m_previousResults.size()) {
+        return false;
+      }
+      const SearchResult & previous = m_previousResults[pageIndex];
+      return (previous.finished && previous.occurences.isEmpty() && previous.page.toStrongRef() == page);
+    }();
+
+    QList<Backend::SearchResult> result;
+    if (!canSkip) {
+      result = page->search(m_searchString, m_searchFlags);
     }
-    auto result = page->search(m_searchString, m_searchFlags);
     {
       const QMutexLocker mutexLocker{&m_mutex};
       m_results[pageIndex].occurences = std::move(result);
       m_results[pageIndex].finished = true;
+      m_results[pageIndex].page = page;
+    }
+    announceResults();
+  }
+}
+
+void PDFSearcher::announceResults()
+{
+  // Only one thread may announce results at any time, otherwise the order of
+  // the signals could get mixed up
+  const QMutexLocker announceLocker{&m_announceMutex};
+  while (true) {
+    const size_type pageIndex = [this] () {
+      const QMutexLocker mutexLocker{&m_mutex};
+      if (m_numAnnounced >= m_pages.size() || !m_results[m_pages[m_numAnnounced]].finished) {
+        return static_cast<size_type>(-1);
+      }
+      return m_pages[m_numAnnounced++];
+    }();
+    if (pageIndex < 0) {
+      return;
     }
     emit resultReady(pageIndex);
     emit progressValueChanged(progressValue());
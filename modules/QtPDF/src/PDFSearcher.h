@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2022-2023  Stefan Löffler
+ * Copyright (C) 2022-2025  Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -18,9 +18,18 @@
 
 #include <QObject>
 #include <QThread>
+#include <QThreadPool>
 
 namespace QtPDF {
 
+// Searches all pages of a document in the background
+// The pages are distributed over several worker threads, but the results are
+// announced (via resultReady()) in the order in which the pages are searched
+// (see populatePages()). Since the pages' text is cached (see
+// Backend::Page::textLayer()), only the first search in a document needs to
+// extract the text from the backend. Moreover, pages that did not contain the
+// previous search string are skipped if the new search string contains it
+// (e.g., when the user types the search string character by character).
 class PDFSearcher : public QThread
 {
 	Q_OBJECT
@@ -58,6 +67,9 @@ private:
   struct SearchResult {
     QList<Backend::SearchResult> occurences;
     bool finished{false};
+    // The page that was searched; used to recognize it in subsequent searches
+    // (after reloading, the document has different page objects)
+    QWeakPointer<Backend::Page> page;
   };
 
   QString m_searchString;
@@ -66,9 +78,27 @@ private:
   QVector<SearchResult> m_results;
   QWeakPointer<Backend::Document> m_doc;
   QVector<size_type> m_pages;
+  // Index (into m_pages) of the next page to search
+  size_type m_nextPage{0};
+  // Number of pages (from the start of m_pages) whose results have been
+  // announced
+  size_type m_numAnnounced{0};
+  // Results of the previous search; see stopAndClear()
+  QVector<SearchResult> m_previousResults;
+  QString m_previousSearchString;
+  Backend::SearchFlags m_previousSearchFlags;
   mutable QMutex m_mutex;
+  // Serializes announcing results to keep them in order
+  QMutex m_announceMutex;
+  QThreadPool m_workers;
 
   void populatePages();
+  // Searches the pages in m_pages until all are done (or the search is
+  // interrupted); called concurrently from several threads
+  void searchPages(const QSharedPointer<Backend::Document> & doc, const bool skipPagesWithoutPreviousResults);
+  // Emits resultReady() for all pages that are finished (in the order of
+  // m_pages) and have not been announced yet
+  void announceResults();
 };
 
 } // namespace QtPDF
@@ -0,0 +1,180 @@
+/**
+ * Copyright (C) 2025  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#include "PDFTextLayer.h"
+
+namespace QtPDF {
+
+namespace Backend {
+
+void PDFTextLayer::appendWord(const QString & text, const QVector<QRectF> & glyphBoxes, const QRectF & boundingBox, const bool spaceAfter)
+{
+  Q_ASSERT(text.size() == glyphBoxes.size());
+  if (text.isEmpty())
+    return;
+
+  const size_type oldSize = _text.size();
+
+  if (_words.isEmpty() || isNewLine(_words.last().boundingBox, boundingBox)) {
+    if (!_words.isEmpty()) {
+      _text += QChar::fromLatin1('\n');
+      _glyphBoxes.append(GlyphBox());
+    }
+    Line line;
+    line.beginWord = _words.size();
+    line.endWord = line.beginWord;
+    line.boundingBox = boundingBox;
+    _lines.append(line);
+  }
+  else if (_words.last().spaceAfter) {
+    _text += QChar::fromLatin1(' ');
+    _glyphBoxes.append(GlyphBox());
+  }
+
+  Word word;
+  word.begin = _text.size();
+  word.end = word.begin + text.size();
+  word.boundingBox = boundingBox;
+  word.spaceAfter = spaceAfter;
+  _text += text;
+  for (const QRectF & glyphBox : glyphBoxes)
+    _glyphBoxes.append(GlyphBox::fromRectF(glyphBox));
+  _words.append(word);
+
+  Line & line = _lines.last();
+  line.endWord = _words.size();
+  line.boundingBox = line.boundingBox.united(boundingBox);
+
+  appendSearchText(oldSize);
+}
+
+void PDFTextLayer::appendSearchText(const size_type begin)
+{
+  // Normalize the text in clusters of a base character and any combining marks
+  // following it (as normalization may combine them) so that each character of
+  // the result can be mapped back to the glyphs it came from. Most text does
+  // not change, so _searchText is only created once normalization changes a
+  // cluster.
+  size_type i = begin;
+  while (i < _text.size()) {
+    size_type end = i + 1;
+    if (_text[i].isHighSurrogate() && end < _text.size() && _text[end].isLowSurrogate())
+      ++end;
+    while (end < _text.size() && _text[end].isMark())
+      ++end;
+
+    const QString cluster = _text.mid(i, end - i);
+    // ASCII characters (without combining marks) are not changed by
+    // normalization
+    const QString normalized = (end == i + 1 && _text[i].unicode() < 0x80 ? cluster : cluster.normalized(QString::NormalizationForm_KC));
+    if (!_hasSearchText && normalized != cluster) {
+      _hasSearchText = true;
+      _searchText = _text.left(i);
+      _searchTextSource.reserve(_text.size());
+      for (size_type j = 0; j < i; ++j)
+        _searchTextSource.append(j);
+    }
+    if (_hasSearchText) {
+      _searchText += normalized;
+      for (size_type j = 0; j < normalized.size(); ++j)
+        _searchTextSource.append(i);
+    }
+    i = end;
+  }
+}
+
+PDFTextLayer::size_type PDFTextLayer::textBegin(const size_type searchBegin) const
+{
+  return (_hasSearchText ? _searchTextSource[searchBegin] : searchBegin);
+}
+
+PDFTextLayer::size_type PDFTextLayer::textEnd(const size_type searchEnd) const
+{
+  if (!_hasSearchText || searchEnd <= 0)
+    return searchEnd;
+  // Include the whole cluster the last character was derived from (e.g., if
+  // only the "f" of a "\uFB01" ligature was matched)
+  const size_type last = _searchTextSource[searchEnd - 1];
+  for (size_type i = searchEnd; i < _searchTextSource.size(); ++i) {
+    if (_searchTextSource[i] != last)
+      return _searchTextSource[i];
+  }
+  return _text.size();
+}
+
+// static
+bool PDFTextLayer::isNewLine(const QRectF & previousWordBox, const QRectF & wordBox)
+{
+  // Guess ends of lines: if the new word is mostly below the previous one
+  // (with the overlap being less than 20% of the height of the larger box), we
+  // assume it's a new line. This should work reasonably well for normal text
+  // (including RTL text), but may fail in some less common cases (e.g.,
+  // subscripts after superscripts, formulas, etc.).
+  return (previousWordBox.bottom() - wordBox.top() < 0.2 * qMax(previousWordBox.height(), wordBox.height()));
+}
+
+QRectF PDFTextLayer::boundingBox(const size_type begin, const size_type end) const
+{
+  QRectF retVal;
+  for (size_type i = qMax(begin, size_type(0)); i < end && i < _glyphBoxes.size(); ++i) {
+    const QRectF box = glyphBox(i);
+    if (!box.isNull())
+      retVal = (retVal.isNull() ? box : retVal.united(box));
+  }
+  return retVal;
+}
+
+QVector< QVector<QRectF> > PDFTextLayer::search(const QString & needle, const Qt::CaseSensitivity caseSensitivity) const
+{
+  QVector< QVector<QRectF> > retVal;
+  const QString normalizedNeedle = needle.normalized(QString::NormalizationForm_KC);
+  if (normalizedNeedle.isEmpty())
+    return retVal;
+
+  // Treat line breaks as spaces so phrases can be found even if they span
+  // several lines; this is only necessary if there are spaces in `needle` at
+  // all, though
+  const QString & searchText = (_hasSearchText ? _searchText : _text);
+  const QString haystack = [&]() {
+    if (!normalizedNeedle.contains(QChar::fromLatin1(' ')))
+      return searchText;
+    QString rv{searchText};
+    rv.replace(QChar::fromLatin1('\n'), QChar::fromLatin1(' '));
+    return rv;
+  }();
+
+  for (size_type i = haystack.indexOf(normalizedNeedle, 0, caseSensitivity); i >= 0; i = haystack.indexOf(normalizedNeedle, i + normalizedNeedle.size(), caseSensitivity)) {
+    const size_type begin = textBegin(i);
+    const size_type end = textEnd(i + normalizedNeedle.size());
+    // Return one box per line so that matches spanning several lines don't
+    // cover (parts of) lines that don't belong to them
+    QVector<QRectF> boxes;
+    size_type lineBegin = begin;
+    for (size_type j = begin; j <= end; ++j) {
+      if (j < end && _text[j] != QChar::fromLatin1('\n'))
+        continue;
+      const QRectF box = boundingBox(lineBegin, j);
+      if (!box.isNull())
+        boxes.append(box);
+      lineBegin = j + 1;
+    }
+    if (!boxes.isEmpty())
+      retVal.append(boxes);
+  }
+  return retVal;
+}
+
+} // namespace Backend
+
+} // namespace QtPDF
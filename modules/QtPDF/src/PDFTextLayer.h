@@ -0,0 +1,120 @@
+/**
+ * Copyright (C) 2025  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFTextLayer_H
+#define PDFTextLayer_H
+
+#include <QRectF>
+#include <QString>
+#include <QVector>
+
+namespace QtPDF {
+
+namespace Backend {
+
+// The text of a page in reading order, as extracted by the backend
+// All characters are stored in one (UTF-16) string; glyphBox() returns the
+// bounding box (in pdf coordinates, i.e., bp) of the character at the same
+// index. To keep the layer compact, glyph boxes are stored in single
+// precision, which is still far more accurate than needed on a page.
+// Words are separated by a space or a line break (as far as the layout
+// suggests); these separators are not part of the page and have null boxes.
+// Consecutive words are grouped into lines.
+// Once built, a text layer is not modified any more, so it can be shared
+// between threads (see Page::textLayer()). It is used for searching, selecting
+// text and finding the context of SyncTeX positions.
+class PDFTextLayer
+{
+public:
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+  using size_type = int;
+#else
+  using size_type = qsizetype;
+#endif
+
+  struct Word {
+    // The characters of the word are in the range [begin, end) of text() (and
+    // the indices of glyphBox())
+    size_type begin;
+    size_type end;
+    QRectF boundingBox;
+    bool spaceAfter;
+  };
+
+  struct Line {
+    // The words of the line are in the range [beginWord, endWord) of words()
+    size_type beginWord;
+    size_type endWord;
+    QRectF boundingBox;
+  };
+
+  // Appends a word (in reading order); `glyphBoxes` must contain the bounding
+  // box of each character of `text`
+  void appendWord(const QString & text, const QVector<QRectF> & glyphBoxes, const QRectF & boundingBox, const bool spaceAfter);
+
+  bool isEmpty() const { return _words.isEmpty(); }
+  const QString & text() const { return _text; }
+  QRectF glyphBox(const size_type i) const { return _glyphBoxes[i].toRectF(); }
+  const QVector<Word> & words() const { return _words; }
+  const QVector<Line> & lines() const { return _lines; }
+
+  // Returns true if a word with the bounding box `wordBox` following one with
+  // `previousWordBox` most likely starts a new line
+  static bool isNewLine(const QRectF & previousWordBox, const QRectF & wordBox);
+
+  // Returns the bounding box of the characters in the range [begin, end)
+  QRectF boundingBox(const size_type begin, const size_type end) const;
+
+  // Returns all (non-overlapping) occurrences of `needle` in reading order;
+  // each occurrence is given by the bounding boxes of its parts on the lines it
+  // spans. Spaces in `needle` also match line breaks. The text and `needle` are
+  // compared in normalization form KC, so, e.g., "find" also matches "\uFB01nd"
+  // (with a ligature).
+  QVector< QVector<QRectF> > search(const QString & needle, const Qt::CaseSensitivity caseSensitivity) const;
+
+private:
+  // Half the size of a QRectF
+  struct GlyphBox {
+    float x, y, width, height;
+
+    static GlyphBox fromRectF(const QRectF & r) {
+      return {static_cast<float>(r.x()), static_cast<float>(r.y()), static_cast<float>(r.width()), static_cast<float>(r.height())};
+    }
+    QRectF toRectF() const { return QRectF(static_cast<qreal>(x), static_cast<qreal>(y), static_cast<qreal>(width), static_cast<qreal>(height)); }
+  };
+
+  // Appends the characters of _text from `begin` on to _searchText
+  void appendSearchText(const size_type begin);
+  // Returns the range of _text that the range [begin, end) of the search text
+  // (see search()) was derived from
+  size_type textBegin(const size_type searchBegin) const;
+  size_type textEnd(const size_type searchEnd) const;
+
+  QString _text;
+  QVector<GlyphBox> _glyphBoxes;
+  QVector<Word> _words;
+  QVector<Line> _lines;
+  // _text in normalization form KC for search(); _searchTextSource holds the
+  // index of the character in _text each character was derived from. Both are
+  // only used if _hasSearchText is set, i.e., if normalization changes _text
+  // (otherwise, _text is searched directly).
+  QString _searchText;
+  QVector<size_type> _searchTextSource;
+  bool _hasSearchText{false};
+};
+
+} // namespace Backend
+
+} // namespace QtPDF
+
+#endif // !defined(PDFTextLayer_H)
@@ -400,12 +400,12 @@ Document::~Document()
 
 void Document::reload()
 {
-  // Clear the processing thread
+  // Clear the processing threads
   // NB: Do this before acquiring _docLock. See clearWorkStack() documentation.
   // This should not cause any problems as we are supposed to currently be in
   // the main (GUI) thread, and only this thread is supposed to add items to the
   // work stack.
-  _processingThread.clearWorkStack();
+  _processingThreadPool.clearWorkStack();
 
   QWriteLocker docLocker(_docLock.data());
   MuPDFLocaleResetter lr;
@@ -505,8 +505,10 @@ QWeakPointer<Backend::Page> Document::page(int at)
     if (at < 0 || at >= _numPages)
       return QWeakPointer<Backend::Page>();
 
-    if (at < _pages.size() && !_pages[at].isNull())
+    if (at < _pages.size() && !_pages[at].isNull()) {
+      touchPage(at);
       return QWeakPointer<Backend::Page>(_pages[at]);;
+    }
 
     // if we get here, the page is not in the array
   }
@@ -516,13 +518,19 @@ QWeakPointer<Backend::Page> Document::page(int at)
   // recheck everything that could have changed before we got the write lock
   if (at >= _numPages)
     return QWeakPointer<Backend::Page>();
-  if (at < _pages.size() && !_pages[at].isNull())
+  if (at < _pages.size() && !_pages[at].isNull()) {
+    touchPage(at);
     return _pages[at].toWeakRef();
+  }
 
   if( _pages.isEmpty() )
     _pages.resize(_numPages);
 
-  _pages[at] = QSharedPointer<Backend::Page>(new Page(this, at, _docLock));
+  // Reuse the page if it was released but is still used elsewhere
+  if (!restoreReleasedPage(at))
+    _pages[at] = QSharedPointer<Backend::Page>(new Page(this, at, _docLock));
+  touchPage(at);
+  releaseUnusedPages(at);
   return _pages[at].toWeakRef();
 }
 
@@ -885,12 +893,14 @@ Page::~Page()
 
 QSizeF Page::pageSizeF() const { QReadLocker pageLocker(_pageLock); return _size; }
 
-QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cache) const
+QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cache, const AbortFlag * abortFlag) const
 {
   QReadLocker docLocker(_docLock.data());
   QReadLocker pageLocker(_pageLock);
   if (!_parent)
     return QImage();
+  if (abortFlag && *abortFlag)
+    return QImage();
 
   // Set up the transformation matrix for the page. Really, we just start with
   // an identity matrix and scale it using the xres, yres inputs.
@@ -115,7 +115,7 @@ public:
 
   QSizeF pageSizeF() const override;
 
-  QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false) const override;
+  QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false, const AbortFlag * abortFlag = nullptr) const override;
 
   QList< QSharedPointer<Annotation::Link> > loadLinks() override;
   QList< QSharedPointer<Annotation::AbstractAnnotation> > loadAnnotations() override;
@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2013-2024  Charlie Sharpsteen, Stefan Löffler
+ * Copyright (C) 2013-2025  Charlie Sharpsteen, Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -15,7 +15,11 @@
 // NOTE: `PopplerQtBackend.h` is included via `PDFBackend.h`
 #include "PDFBackend.h"
 
-#include <QBitArray>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QTemporaryFile>
+#include <QThread>
 
 #include <QDomDocument>
 
@@ -27,6 +31,19 @@
 #endif
 #include <memory>
 
+#if defined(Q_OS_LINUX)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#elif defined(Q_OS_DARWIN)
+#include <sys/clonefile.h>
+#endif
+
+#ifdef DEBUG
+#include <QDebug>
+#endif
+
 // Comparison operator for QSizeF needed to use QSizeF as keys in a QMap
 // NB: Must be in the global namespace
 inline bool operator<(const QSizeF & a, const QSizeF & b) {
@@ -41,6 +58,23 @@ namespace Backend {
 
 namespace PopplerQt {
 
+// Returns the words on the page (as owning pointers regardless of the Qt
+// version)
+static std::vector< std::unique_ptr<::Poppler::TextBox> > textBoxes(const ::Poppler::Page & popplerPage)
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+  const QList<::Poppler::TextBox*> popplerList = popplerPage.textList();
+  std::vector< std::unique_ptr<::Poppler::TextBox> > rv;
+  rv.reserve(static_cast<decltype(rv)::size_type>(popplerList.size()));
+  for (::Poppler::TextBox* box : popplerList) {
+    rv.emplace_back(box);
+  }
+  return rv;
+#else
+  return popplerPage.textList();
+#endif
+}
+
 // TODO: Find a better place to put this
 PDFDestination toPDFDestination(const ::Poppler::Document * doc, const ::Poppler::LinkDestination & dest)
 {
@@ -141,6 +175,163 @@ void convertAnnotation(Annotation::AbstractAnnotation * dest, const ::Poppler::A
 }
 
 
+// Creates `target` as a copy-on-write clone (reflink) of `source`, which is
+// nearly free regardless of the file size. Fails (without copying anything) if
+// the file system does not support clones.
+static bool cloneFile(const QString & source, const QString & target)
+{
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+  const int in = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+  if (in < 0)
+    return false;
+  const int out = ::open(QFile::encodeName(target).constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (out < 0) {
+    ::close(in);
+    return false;
+  }
+  const bool success = (::ioctl(out, FICLONE, in) == 0);
+  ::close(out);
+  ::close(in);
+  if (!success)
+    QFile::remove(target);
+  return success;
+#elif defined(Q_OS_DARWIN)
+  return (::clonefile(QFile::encodeName(source).constData(), QFile::encodeName(target).constData(), 0) == 0);
+#else
+  Q_UNUSED(source);
+  Q_UNUSED(target);
+  return false;
+#endif
+}
+
+// Creates a private clone of the file `filename` that is not affected by any
+// subsequent changes to the original (e.g., when it is re-typeset) and returns
+// its path, or an empty string on failure.
+// Snapshots are only created if the file system supports cloning (see
+// cloneFile()); copying the whole file would cost more than reading it. The
+// snapshot is a hidden file next to the original (clones can only be created
+// on the same file system) that must be removed with releaseSnapshot().
+static QString createSnapshot(const QString & filename)
+{
+  const QFileInfo fi(filename);
+  if (!fi.isFile() || fi.size() <= 0)
+    return {};
+
+  QString snapshotName;
+  {
+    // Reserve a unique file name; cloneFile() does not overwrite existing
+    // files, so the placeholder file is removed again right away
+    QTemporaryFile tmp(QDir(fi.absolutePath()).filePath(QStringLiteral(".%1.XXXXXX").arg(fi.fileName())));
+    if (!tmp.open())
+      return {};
+    snapshotName = tmp.fileName();
+  }
+  if (!cloneFile(filename, snapshotName))
+    return {};
+  return snapshotName;
+}
+
+// Removes a snapshot obtained from createSnapshot()
+// NB: All ::Poppler::Document instances loaded from it must have been
+// destroyed before
+static void releaseSnapshot(QString & snapshot)
+{
+  if (!snapshot.isEmpty() && QFile::exists(snapshot))
+    QFile::remove(snapshot);
+  snapshot.clear();
+}
+
+// Reads the file `filename` into `file` (i.e., sets its snapshot or data, and
+// doc). Returns false if the file could not be read.
+static bool readFile(const QString & filename, LoadedFile & file)
+{
+  // The ::Poppler::Document must not read from the pdf file itself as that
+  // may get modified at any time (e.g., during typesetting). If the file system
+  // can clone the file cheaply, the document is loaded from such a snapshot;
+  // Poppler then only reads the parts of the file it needs. Otherwise, the file
+  // is read into memory (of which Poppler makes its own copy).
+  file.snapshot = createSnapshot(filename);
+  if (!file.snapshot.isEmpty()) {
+    file.doc.reset(::Poppler::Document::load(file.snapshot));
+    return true;
+  }
+  QFile pdf(filename);
+  if (!pdf.open(QIODevice::ReadOnly))
+    return false;
+  file.data = pdf.readAll();
+  pdf.close();
+  file.doc.reset(::Poppler::Document::loadFromData(file.data));
+  return true;
+}
+
+// Returns the geometry of all pages of `doc`
+// NB: ::Poppler::Page objects are lightweight (unlike Backend::Page objects),
+// and pageSizeF() already takes the rotation of the page into account
+static QVector<Backend::Document::PageGeometry> pageGeometriesOf(const ::Poppler::Document & doc)
+{
+  using poppler_size_type = decltype(doc.numPages());
+  QVector<Backend::Document::PageGeometry> retVal;
+  retVal.reserve(doc.numPages());
+  for (poppler_size_type i = 0; i < doc.numPages(); ++i) {
+    const std::unique_ptr<::Poppler::Page> page{doc.page(i)};
+    Backend::Document::PageGeometry geometry;
+    if (page)
+      geometry.size = page->pageSizeF();
+    retVal.append(geometry);
+  }
+  return retVal;
+}
+
+// Returns the most often used page size in `pageGeometries`
+static QSizeF mostCommonPageSize(const QVector<Backend::Document::PageGeometry> & pageGeometries)
+{
+  QMap<QSizeF, Backend::Document::size_type> counts;
+  for (const Backend::Document::PageGeometry & geometry : pageGeometries) {
+    const QSizeF & ps = geometry.size;
+    if (ps.isEmpty())
+      continue;
+    if (counts.contains(ps)) ++counts[ps];
+    else counts[ps] = 1;
+  }
+  Backend::Document::size_type occurrences = -1;
+  QSizeF retVal;
+  Q_FOREACH(QSizeF ps, counts.keys()) {
+      if (occurrences < counts[ps]) {
+          retVal = ps;
+          occurrences = counts[ps];
+      }
+  }
+  return retVal;
+}
+
+// Resolution of the rendering page fingerprints are based on; high enough for
+// most changes to show, low enough to be fast
+static constexpr double fingerprintResolution = 48;
+
+// Combines the (low-resolution) rendering `img` and the `text` of a page into
+// a fingerprint; see Page::fingerprint()
+static QByteArray fingerprint(const QImage & img, const QString & text)
+{
+  if (img.isNull())
+    return QByteArray();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(QByteArray::number(img.width()) + 'x' + QByteArray::number(img.height()));
+  // The text catches small changes that might not be visible at this
+  // resolution (e.g., a different digit)
+  hash.addData(text.toUtf8());
+  for (int y = 0; y < img.height(); ++y)
+    hash.addData(QByteArray::fromRawData(reinterpret_cast<const char *>(img.constScanLine(y)), img.bytesPerLine()));
+  return hash.result();
+}
+
+void LoadedFile::clear()
+{
+  doc.reset();
+  data.clear();
+  releaseSnapshot(snapshot);
+}
+
 // Document Class
 // ==============
 Document::Document(const QString & fileName):
@@ -158,62 +349,174 @@ Document::~Document()
 //  qDebug() << "PopplerQt::Document::~Document()";
 #endif
   clearPages();
+  // The ::Poppler::Document instances may read from the snapshot, so they
+  // must be destroyed before it is released
+  _renderDocs.clear();
+  _poppler_doc.reset();
+  _pdfData.clear();
+  releaseSnapshot(_pdfSnapshot);
   delete _poppler_docLock;
 }
 
 bool Document::load(const QString & filename)
 {
-  bool success{true};
-  QFile pdf(filename);
-  if (pdf.open(QIODevice::ReadOnly)) {
-    QMutexLocker l(_poppler_docLock);
-    // Load the file into memory and then initialize _poppler_doc from memory to
-    // ensure the data is available even while the pdf file gets modified (e.g.,
-    // during typesetting)
-    _poppler_doc = std::unique_ptr<::Poppler::Document>(::Poppler::Document::loadFromData(pdf.readAll()));
-    pdf.close();
-  }
-  else {
-    _poppler_doc.reset();
-    success = false;
-  }
+  LoadedFile file;
+  const bool success = readFile(filename, file);
+  install(file);
+  file.clear();
+
+  _pageFingerprints.clear();
   // "Parse the document" even if loading failed to reset internal data
   parseDocument();
   return success;
 }
 
+void Document::install(LoadedFile & file)
+{
+  // The old data (and snapshot) must outlive all ::Poppler::Document instances
+  // created from it, so they are all handed over to `file`, which releases
+  // them in the right order
+  {
+    QMutexLocker l(_poppler_docLock);
+    // Keep the paper color (which is not stored in the pdf file)
+    if (_poppler_doc && file.doc)
+      file.doc->setPaperColor(_poppler_doc->paperColor());
+    std::swap(_poppler_doc, file.doc);
+  }
+  {
+    // Any previous render documents belong to the old file contents
+    QMutexLocker l(&_renderDocsLock);
+    _renderDocs.clear();
+    _numRenderDocs = 0;
+  }
+  std::swap(_pdfData, file.data);
+  std::swap(_pdfSnapshot, file.snapshot);
+}
 
 void Document::reload()
 {
-  // Clear the processing thread
+  finishReload(prepareReload());
+
+  // TODO: possibly unlock the new document again if it was previously unlocked
+  // and the password is still the same
+}
+
+QSharedPointer<Backend::Document::PreparedReload> Document::prepareReload(const AbortFlag * abortFlag)
+{
+  const auto isAborted = [abortFlag]() { return (abortFlag && *abortFlag); };
+
+  // NB: Even if the file can't be read, the (empty) result is installed by
+  // finishReload() to reflect that (as load() does)
+  QSharedPointer<LoadedFile> prepared{new LoadedFile};
+  readFile(fileName(), *prepared);
+  if (isAborted())
+    return {};
+  if (!prepared->doc || prepared->doc->isLocked())
+    return prepared;
+
+  // Render the new pages the same way as the current ones (see
+  // parseDocument() and install()) so their fingerprints can be compared
+  prepared->doc->setRenderBackend(::Poppler::Document::SplashBackend);
+  prepared->doc->setRenderHint(::Poppler::Document::Antialiasing);
+  prepared->doc->setRenderHint(::Poppler::Document::TextAntialiasing);
+  prepared->doc->setPaperColor(paperColor());
+
+  prepared->pageGeometries = pageGeometriesOf(*prepared->doc);
+
+  // Typically, only a few pages change when a document is re-typeset. To
+  // avoid re-rendering all others, we compare the fingerprints of all pages
+  // that have cached tiles before and after reloading and keep the tiles of
+  // unchanged pages current (see finishReload()).
+  // NB: Fingerprints from the last reload are reused to save time; pages are
+  // compared by their index, so inserting a page marks all following pages as
+  // changed
+  for (const size_type n : _pageCache.pagesWithTiles(this)) {
+    if (isAborted())
+      return {};
+    {
+      QReadLocker docLocker(_docLock.data());
+      auto it = _pageFingerprints.constFind(n);
+      if (it != _pageFingerprints.constEnd()) {
+        prepared->oldFingerprints.insert(n, it.value());
+        continue;
+      }
+    }
+    QSharedPointer<Backend::Page> p(page(n).toStrongRef());
+    if (p)
+      prepared->oldFingerprints.insert(n, p->fingerprint());
+  }
+
+  // The new ::Poppler::Document is not shared with anyone yet, so it can be
+  // used without locking
+  using poppler_size_type = decltype(prepared->doc->numPages());
+  for (auto it = prepared->oldFingerprints.cbegin(); it != prepared->oldFingerprints.cend(); ++it) {
+    if (isAborted())
+      return {};
+    if (it.key() >= prepared->doc->numPages())
+      continue;
+    const std::unique_ptr<::Poppler::Page> popplerPage{prepared->doc->page(static_cast<poppler_size_type>(it.key()))};
+    if (!popplerPage)
+      continue;
+    prepared->newFingerprints.insert(it.key(), fingerprint(popplerPage->renderToImage(fingerprintResolution, fingerprintResolution), popplerPage->text(QRectF())));
+  }
+  return prepared;
+}
+
+void Document::finishReload(QSharedPointer<Backend::Document::PreparedReload> prepared)
+{
+  // NB: prepareReload() only returns nullptr if it was aborted, in which case
+  // there is nothing to do
+  QSharedPointer<LoadedFile> p = prepared.dynamicCast<LoadedFile>();
+  if (!p)
+    return;
+
+  // Clear the processing threads
   // NB: Do this before acquiring _docLock. See clearWorkStack() documentation.
   // This should not cause any problems as we are supposed to currently be in
   // the main (GUI) thread, and only this thread is supposed to add items to the
   // work stack.
-  _processingThread.clearWorkStack();
+  _processingThreadPool.clearWorkStack();
 
   QWriteLocker docLocker(_docLock.data());
 
   clearPages();
-  _pageCache.markOutdated(this);
-
-  load(_fileName);
-
-  // TODO: possibly unlock the new document again if it was previously unlocked
-  // and the password is still the same
+  install(*p);
+  // Release the old file contents right away (rather than whenever the last
+  // reference to `prepared` goes away)
+  p->clear();
+
+  _pageFingerprints.clear();
+  parseDocument(p->pageGeometries);
+
+  QSet<PDFPageCache::page_size_type> unchangedPages;
+  for (auto it = p->oldFingerprints.cbegin(); it != p->oldFingerprints.cend(); ++it) {
+    auto newIt = p->newFingerprints.constFind(it.key());
+    if (newIt == p->newFingerprints.constEnd())
+      continue;
+    _pageFingerprints.insert(it.key(), newIt.value());
+    if (!newIt.value().isEmpty() && newIt.value() == it.value())
+      unchangedPages.insert(it.key());
+  }
+#ifdef DEBUG
+  qDebug() << "Reloaded" << _fileName << "-" << unchangedPages.size() << "of" << p->oldFingerprints.size() << "cached pages unchanged";
+#endif
+  _pageCache.markOutdated(this, unchangedPages);
 }
 
-void Document::parseDocument()
+void Document::parseDocument(const QVector<PageGeometry> & pageGeometries /* = {} */)
 {
   QWriteLocker docLocker(_docLock.data());
-  using poppler_size_type = decltype(_poppler_doc->numPages());
 
   clearMetaData();
   _meta_fileSize = QFileInfo(_fileName).size();
   _numPages = -1;
+  _canRenderConcurrently = false;
+  _processingThreadPool.setConcurrencyLimit(1);
 
-  if (!_poppler_doc || _isLocked())
+  if (!_poppler_doc || _isLocked()) {
+    setPageGeometries({});
     return;
+  }
 
   _numPages = _poppler_doc->numPages();
 
@@ -246,6 +549,13 @@ void Document::parseDocument()
   _poppler_doc->setRenderHint(::Poppler::Document::Antialiasing);
   _poppler_doc->setRenderHint(::Poppler::Document::TextAntialiasing);
 
+  // Unless the document state can change at runtime, pages can be rendered in
+  // parallel using separate ::Poppler::Document instances; otherwise, all
+  // operations are serialized by _poppler_docLock anyway, so there is no point
+  // in using more than one processing thread
+  _canRenderConcurrently = (!_poppler_doc->isEncrypted() && !_poppler_doc->hasOptionalContent());
+  _processingThreadPool.setConcurrencyLimit(_canRenderConcurrently ? 0 : 1);
+
   // Load meta data
   QStringList metaKeys = _poppler_doc->infoKeys();
   if (metaKeys.contains(QString::fromUtf8("Title"))) {
@@ -335,22 +645,10 @@ void Document::parseDocument()
     }
   }
 
-  // Get the most often used page size
-  QMap<QSizeF, size_type> pageSizes;
-  for (poppler_size_type i = 0; i < _numPages; ++i) {
-    const std::unique_ptr<::Poppler::Page> page{_poppler_doc->page(i)};
-    QSizeF ps = page->pageSizeF();
-    if (pageSizes.contains(ps)) ++pageSizes[ps];
-    else pageSizes[ps] = 1;
-  }
-  size_type occurrences = -1;
-  _meta_pageSize = QSizeF();
-  Q_FOREACH(QSizeF ps, pageSizes.keys()) {
-      if (occurrences < pageSizes[ps]) {
-          _meta_pageSize = ps;
-          occurrences = pageSizes[ps];
-      }
-  }
+  // Get the geometry of all pages (so they can be laid out without creating
+  // Page objects) and the most often used page size
+  setPageGeometries(pageGeometries.size() == _numPages ? pageGeometries : pageGeometriesOf(*_poppler_doc));
+  _meta_pageSize = mostCommonPageSize(_pageGeometries);
 
   // Note: Poppler doesn't handle the meta data key "Trapped" correctly, as that
   // has a value of type `name` (/True, /False, or /Unknown) which doesn't get
@@ -362,6 +660,15 @@ void Document::parseDocument()
     _meta_other[key] = _poppler_doc->info(key);
 }
 
+QVector<Backend::Document::PageGeometry> Document::computePageGeometries()
+{
+  QReadLocker docLocker(_docLock.data());
+  if (!_poppler_doc || _isLocked())
+    return {};
+  QMutexLocker popplerLocker(_poppler_docLock);
+  return pageGeometriesOf(*_poppler_doc);
+}
+
 QWeakPointer<Backend::Page> Document::page(size_type at)
 {
   {
@@ -370,8 +677,10 @@ QWeakPointer<Backend::Page> Document::page(size_type at)
     if (at < 0 || at >= _numPages)
       return QWeakPointer<Backend::Page>();
 
-    if (at < _pages.size() && !_pages[at].isNull())
+    if (at < _pages.size() && !_pages[at].isNull()) {
+      touchPage(at);
       return _pages[at];
+    }
   }
 
   // if we get here, the page is not in the array
@@ -380,20 +689,27 @@ QWeakPointer<Backend::Page> Document::page(size_type at)
   // recheck everything that could have changed before we got the write lock
   if (at >= _numPages)
     return QWeakPointer<Backend::Page>();
-  if (at < _pages.size() && !_pages[at].isNull())
+  if (at < _pages.size() && !_pages[at].isNull()) {
+    touchPage(at);
     return _pages[at].toWeakRef();
+  }
 
   if( _pages.isEmpty() )
     _pages.resize(_numPages);
 
-  // If we got here, we don't have the page cached. As we need to create a new
-  // page, we need to make sure the Poppler document is valid and does not go
-  // out of scope
-  QMutexLocker popplerLocker(_poppler_docLock);
-  if (!_poppler_doc)
-    return QWeakPointer<Backend::Page>();
+  // Reuse the page if it was released but is still used elsewhere
+  if (!restoreReleasedPage(at)) {
+    // If we got here, we don't have the page cached. As we need to create a
+    // new page, we need to make sure the Poppler document is valid and does
+    // not go out of scope
+    QMutexLocker popplerLocker(_poppler_docLock);
+    if (!_poppler_doc)
+      return QWeakPointer<Backend::Page>();
 
-  _pages[at] = QSharedPointer<Backend::Page>(new Page(this, at, _docLock));
+    _pages[at] = QSharedPointer<Backend::Page>(new Page(this, at, _docLock));
+  }
+  touchPage(at);
+  releaseUnusedPages(at);
   return _pages[at].toWeakRef();
 }
 
@@ -583,6 +899,51 @@ QList<PDFFontInfo> Document::fonts() const
   return _fonts;
 }
 
+std::unique_ptr<::Poppler::Document> Document::acquireRenderDocument()
+{
+  // Instances loaded from the snapshot only read the parts of the file they
+  // need, so there can be one per rendering thread. Instances loaded from
+  // _pdfData each hold a full copy of it (Poppler does not share the data),
+  // so their number is kept small.
+  constexpr int maxInMemoryRenderDocs = 2;
+
+  if (!_canRenderConcurrently)
+    return {};
+  {
+    QMutexLocker l(&_renderDocsLock);
+    if (!_renderDocs.empty()) {
+      std::unique_ptr<::Poppler::Document> renderDoc = std::move(_renderDocs.back());
+      _renderDocs.pop_back();
+      return renderDoc;
+    }
+    const int maxRenderDocs = (_pdfSnapshot.isEmpty() ? maxInMemoryRenderDocs : QThread::idealThreadCount());
+    if (_numRenderDocs >= maxRenderDocs)
+      return {};
+    ++_numRenderDocs;
+  }
+  // Create a new instance; this does not touch _poppler_doc, so it needs
+  // neither _poppler_docLock nor _renderDocsLock (_pdfSnapshot and _pdfData
+  // are only modified while holding a doc-write-lock)
+  std::unique_ptr<::Poppler::Document> renderDoc{_pdfSnapshot.isEmpty() ? ::Poppler::Document::loadFromData(_pdfData) : ::Poppler::Document::load(_pdfSnapshot)};
+  if (!renderDoc || renderDoc->isLocked()) {
+    QMutexLocker l(&_renderDocsLock);
+    --_numRenderDocs;
+    return {};
+  }
+  renderDoc->setRenderBackend(::Poppler::Document::SplashBackend);
+  renderDoc->setRenderHint(::Poppler::Document::Antialiasing);
+  renderDoc->setRenderHint(::Poppler::Document::TextAntialiasing);
+  return renderDoc;
+}
+
+void Document::releaseRenderDocument(std::unique_ptr<::Poppler::Document> renderDoc)
+{
+  if (!renderDoc)
+    return;
+  QMutexLocker l(&_renderDocsLock);
+  _renderDocs.push_back(std::move(renderDoc));
+}
+
 QAbstractItemModel *Document::optionalContentModel() const
 {
   if (!_poppler_doc) {
@@ -661,28 +1022,75 @@ QSizeF Page::pageSizeF() const
   return _poppler_page->pageSizeF();
 }
 
-QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cache) const
+#ifdef POPPLER_HAS_RENDER_ABORT
+// Callback for ::Poppler::Page::renderToImage(); `payload` holds the address
+// of the AbortFlag
+static bool shouldAbortRender(const QVariant & payload)
+{
+  const AbortFlag * abortFlag = reinterpret_cast<const AbortFlag *>(payload.value<quintptr>());
+  return (abortFlag && *abortFlag);
+}
+#endif
+
+QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cache, const AbortFlag * abortFlag) const
 {
   QReadLocker docLocker(_docLock.data());
   QReadLocker pageLocker(&_pageLock);
   if (!_parent)
     return QImage();
 
-  QImage renderedPage;
+  const auto isAborted = [abortFlag]() { return (abortFlag && *abortFlag); };
+  if (isAborted())
+    return QImage();
 
-  {
-    // Rendering pages is not thread safe.
-    QMutexLocker popplerDocLock(dynamic_cast<Backend::PopplerQt::Document *>(_parent)->_poppler_docLock);
+  QImage renderedPage;
+  const auto render = [&](const ::Poppler::Page & popplerPage) {
+    // A null QRect has a width and height of 0 --- we will tell Poppler to
+    // render the whole page.
+#ifdef POPPLER_HAS_RENDER_ABORT
+    if (abortFlag) {
+      const QRect box = (render_box.isNull() ? QRect(-1, -1, -1, -1) : render_box);
+      return popplerPage.renderToImage(xres, yres, box.x(), box.y(), box.width(), box.height(),
+          ::Poppler::Page::Rotate0, nullptr, nullptr, shouldAbortRender,
+          QVariant::fromValue(reinterpret_cast<quintptr>(abortFlag)));
+    }
+#endif
     if( render_box.isNull() ) {
-      // A null QRect has a width and height of 0 --- we will tell Poppler to render the whole
-      // page.
-      renderedPage = _poppler_page->renderToImage(xres, yres);
-    } else {
-      renderedPage = _poppler_page->renderToImage(xres, yres,
-          render_box.x(), render_box.y(), render_box.width(), render_box.height());
+      return popplerPage.renderToImage(xres, yres);
+    }
+    return popplerPage.renderToImage(xres, yres,
+        render_box.x(), render_box.y(), render_box.width(), render_box.height());
+  };
+
+  Document * doc = dynamic_cast<Backend::PopplerQt::Document *>(_parent);
+  std::unique_ptr<::Poppler::Document> renderDoc = doc->acquireRenderDocument();
+  if (renderDoc) {
+    // Rendering pages is not thread safe, but separate ::Poppler::Document
+    // instances don't share any state, so we can render on our own instance
+    // without blocking other threads.
+    {
+      QMutexLocker popplerDocLock(doc->_poppler_docLock);
+      renderDoc->setPaperColor(doc->_poppler_doc->paperColor());
     }
+    using poppler_size_type = decltype(renderDoc->numPages());
+    const std::unique_ptr<::Poppler::Page> renderPage{renderDoc->page(static_cast<poppler_size_type>(_n))};
+    if (renderPage)
+      renderedPage = render(*renderPage);
+    doc->releaseRenderDocument(std::move(renderDoc));
+  }
+  else {
+    // Rendering pages is not thread safe.
+    QMutexLocker popplerDocLock(doc->_poppler_docLock);
+    // We may have been aborted while waiting for the lock
+    if (isAborted())
+      return QImage();
+    renderedPage = render(*_poppler_page);
   }
 
+  // If the rendering was aborted, renderedPage may be incomplete
+  if (isAborted())
+    return QImage();
+
   if( cache ) {
     const PDFPageTile key(xres, yres, render_box, _parent, _n);
     _parent->pageCache().setImage(key, QSharedPointer<QImage>(new QImage(renderedPage.copy())), PDFPageCache::CURRENT);
@@ -691,6 +1099,25 @@ QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cach
   return renderedPage;
 }
 
+QByteArray Page::fingerprint() const
+{
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(&_pageLock);
+  if (!_parent)
+    return QByteArray();
+
+  const QImage img = renderToImage(fingerprintResolution, fingerprintResolution);
+  if (img.isNull())
+    return QByteArray();
+
+  QString text;
+  {
+    QMutexLocker popplerDocLock(dynamic_cast<Document *>(_parent)->_poppler_docLock);
+    text = _poppler_page->text(QRectF());
+  }
+  return QtPDF::Backend::PopplerQt::fingerprint(img, text);
+}
+
 QList< QSharedPointer<Annotation::Link> > Page::loadLinks()
 {
   {
@@ -993,42 +1420,40 @@ QList< QSharedPointer<Annotation::AbstractAnnotation> > Page::loadAnnotations()
   return _annotations;
 }
 
-QList<SearchResult> Page::search(const QString & searchText, const SearchFlags & flags) const
+PDFTextLayer Page::loadTextLayer() const
 {
-  QList<SearchResult> results;
-  SearchResult result;
-  double left{0}, right{0}, top{0}, bottom{0};
-  ::Poppler::Page::SearchDirection searchDir = (flags.testFlag(Search_Backwards) ? ::Poppler::Page::PreviousResult : ::Poppler::Page::NextResult);
-#if POPPLER_HAS_SEARCH_FLAGS
-  ::Poppler::Page::SearchFlags searchFlags = (flags.testFlag(Search_CaseInsensitive) ? ::Poppler::Page::IgnoreCase : ::Poppler::Page::SearchFlags());
-#else
-  ::Poppler::Page::SearchMode searchFlags = (flags.testFlag(Search_CaseInsensitive) ? ::Poppler::Page::CaseInsensitive : ::Poppler::Page::CaseSensitive);
-#endif
-
-  QReadLocker docLocker(_docLock.data());
-  QReadLocker pageLocker(&_pageLock);
-  if (!_parent)
-    return results;
-
-  result.pageNum = _n;
-
-  QMutexLocker popplerDocLock(dynamic_cast<Document *>(_parent)->_poppler_docLock);
-
-  if (flags & Search_Backwards) {
-    left = right = pageSizeF().width();
-    top = bottom = pageSizeF().height();
-  }
-
-  // The Poppler search function that takes a QRectF has been marked as
-  // depreciated---something to do with float <-> double conversion causing
-  // infinite loops on some architectures. So, we explicitly use doubles and
-  // avoid the depreciated function.
-  while ( _poppler_page->search(searchText, left, top, right, bottom, searchDir, searchFlags) ) {
-    result.bbox = QRectF(qreal(left), qreal(top), qAbs(qreal(right) - qreal(left)), qAbs(qreal(bottom) - qreal(top)));
-    results << result;
+  const auto extract = [](const ::Poppler::Page & popplerPage) {
+    PDFTextLayer layer;
+    for (const std::unique_ptr<::Poppler::TextBox> & popplerTextBox : textBoxes(popplerPage)) {
+      if (!popplerTextBox)
+        continue;
+      const QString text = popplerTextBox->text();
+      QVector<QRectF> glyphBoxes;
+      glyphBoxes.reserve(text.length());
+      for (int i = 0; i < text.length(); ++i)
+        glyphBoxes.append(popplerTextBox->charBoundingBox(i));
+      layer.appendWord(text, glyphBoxes, popplerTextBox->boundingBox(), popplerTextBox->hasSpaceAfter());
+    }
+    return layer;
+  };
+
+  Document * doc = dynamic_cast<Backend::PopplerQt::Document *>(_parent);
+  if (!doc)
+    return PDFTextLayer();
+  // As for rendering, use a separate ::Poppler::Document instance (if
+  // possible) so that the text of several pages can be extracted concurrently
+  std::unique_ptr<::Poppler::Document> renderDoc = doc->acquireRenderDocument();
+  if (renderDoc) {
+    using poppler_size_type = decltype(renderDoc->numPages());
+    PDFTextLayer layer;
+    const std::unique_ptr<::Poppler::Page> renderPage{renderDoc->page(static_cast<poppler_size_type>(_n))};
+    if (renderPage)
+      layer = extract(*renderPage);
+    doc->releaseRenderDocument(std::move(renderDoc));
+    return layer;
   }
-
-  return results;
+  QMutexLocker popplerDocLock(doc->_poppler_docLock);
+  return extract(*_poppler_page);
 }
 
 void Page::loadTransitionData()
@@ -1118,169 +1543,6 @@ void Page::loadTransitionData()
   }
 }
 
-QList< Backend::Page::Box > Page::boxes() const
-{
-  QReadLocker pageLocker(&_pageLock);
-  Q_ASSERT(_poppler_page != nullptr);
-  QList< Backend::Page::Box > retVal;
-
-  const std::vector< std::unique_ptr<::Poppler::TextBox> > popplerTextBoxes = [&]() {
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    const QList<::Poppler::TextBox*> popplerList = _poppler_page->textList();
-    std::vector< std::unique_ptr<::Poppler::TextBox> > rv;
-    rv.reserve(static_cast<decltype(rv)::size_type>(popplerList.size()));
-    for (::Poppler::TextBox* box : popplerList) {
-      rv.emplace_back(box);
-    }
-    return rv;
-#else
-    return _poppler_page->textList();
-#endif
-  }();
-
-  for (const std::unique_ptr<::Poppler::TextBox> & popplerTextBox : popplerTextBoxes) {
-    if (!popplerTextBox)
-      continue;
-    Backend::Page::Box box;
-    box.boundingBox = popplerTextBox->boundingBox();
-    for (int i = 0; i < popplerTextBox->text().length(); ++i) {
-      Backend::Page::Box subBox;
-      subBox.boundingBox = popplerTextBox->charBoundingBox(i);
-      box.subBoxes << subBox;
-    }
-    retVal << box;
-  }
-  return retVal;
-}
-
-QString Page::selectedText(const QList<QPolygonF> & selection, BoxBoundaryList * wordBoxes /* = nullptr */, BoxBoundaryList * charBoxes /* = nullptr */, const bool onlyFullyEnclosed /* = false */) const
-{
-  QReadLocker pageLocker(&_pageLock);
-  Q_ASSERT(_poppler_page != nullptr);
-  using poppler_size_type = decltype(dynamic_cast<Document*>(_parent)->_poppler_doc->numPages());
-  // Using the bounding rects of the selection polygons is almost
-  // certainly wrong! However, poppler-qt4 doesn't offer any alternative AFAICS
-  // (except for positioning each char in the string manually).
-  // Since poppler doesn't add any space glyphs, the selection will contain a
-  // list of words. Hence, by iterating over them, we get a list of words with
-  // no whitespace inbetween
-  QString retVal;
-  bool insertSpace = false;
-
-  if (wordBoxes) {
-    wordBoxes->clear();
-  }
-  if (charBoxes) {
-    charBoxes->clear();
-  }
-
-  // Get a list of all boxes
-  const std::vector< std::unique_ptr<::Poppler::TextBox> > poppler_boxes = [&]() {
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    const QList<::Poppler::TextBox*> popplerList = _poppler_page->textList();
-    std::vector< std::unique_ptr<::Poppler::TextBox> > rv;
-    rv.reserve(static_cast<decltype(rv)::size_type>(popplerList.size()));
-    for (::Poppler::TextBox* box : popplerList) {
-      rv.emplace_back(box);
-    }
-    return rv;
-#else
-    return _poppler_page->textList();
-#endif
-  }();
-  Poppler::TextBox * lastPopplerBox = nullptr;
-
-  // Filter boxes by selection
-  for (const std::unique_ptr<Poppler::TextBox> & poppler_box : poppler_boxes) {
-    if (!poppler_box)
-      continue;
-
-    // Determine which characters to include (if any)
-    QBitArray include(poppler_box->text().length());
-    for (poppler_size_type i = 0; i < poppler_box->text().length(); ++i) {
-      QPolygonF remainder(poppler_box->charBoundingBox(i));
-      foreach (const QPolygonF & p, selection) {
-        // Include characters if they are entirely inside the selection area or
-        // onlyFullyEnclosed == false; using "intersection only" can cause
-        // problems for overlapping char boxes (if the selection is made of
-        // entire char boxes, it would return characters that are not actually
-        // inside the selection but are just "edge cases") but is necessary if
-        // the selection comes from external sources, such as SyncTeX
-        if (p.intersected(poppler_box->charBoundingBox(i)).empty())
-          continue;
-        if (!onlyFullyEnclosed) {
-          include.setBit(i);
-          break;
-        }
-        remainder = remainder.subtracted(p);
-        if (remainder.empty()) {
-          include.setBit(i);
-          break;
-        }
-      }
-    }
-    if (include.count(true) == 0) continue;
-
-    // If we get here, we found a box that is at least partially selected, so we
-    // append the appropriate text
-
-    // Guess ends of lines: if the new box is mostly below the old box (with the
-    // overlap being less than 20% of the height of the larger box), we assume
-    // it's a new line. This should work reasonably well for normal text
-    // (including RTL text), but may fail in some less common cases (e.g.,
-    // subscripts after superscripts, formulas, etc.).
-    if (lastPopplerBox && lastPopplerBox->boundingBox().bottom() - poppler_box->boundingBox().top() < 0.2 * qMax(lastPopplerBox->boundingBox().height(), poppler_box->boundingBox().height())) {
-      retVal += QString::fromLatin1("\n");
-
-      if (wordBoxes)
-        (*wordBoxes).append(lastPopplerBox->boundingBox());
-      if (charBoxes)
-        (*charBoxes).append(lastPopplerBox->boundingBox());
-      // If we queued a space to be inserted, ignore that as we inserted a
-      // newline instead anyway
-      insertSpace = false;
-    }
-
-    if (insertSpace && lastPopplerBox) {
-      retVal += QString::fromLatin1(" ");
-
-      // As word and char Boxes, insert those of the lastPopplerBox since that
-      // was the one causing insertSpace to be true
-      if (wordBoxes)
-        (*wordBoxes).append(lastPopplerBox->boundingBox());
-      if (charBoxes)
-        (*charBoxes).append(lastPopplerBox->boundingBox());
-    }
-
-    // Default to not inserting a space after this word
-    insertSpace = false;
-
-    // Insert the actual characters
-    for (poppler_size_type i = 0; i < poppler_box->text().length(); ++i) {
-      if (!include.testBit(i)) continue;
-
-      retVal += poppler_box->text()[i];
-
-      if (wordBoxes)
-        (*wordBoxes).append(poppler_box->boundingBox());
-      if (charBoxes)
-        (*charBoxes).append(poppler_box->charBoundingBox(i));
-
-      // If we reached the end of the word, possibly queue a space to be
-      // inserted. By queuing this until the next word is processed, we ensure
-      // that spaces are not inserted at the end of the string or before
-      // newlines
-      if (i == poppler_box->text().length() - 1)
-        insertSpace = poppler_box->hasSpaceAfter();
-    }
-    // Remember the last processed box (required for detecting newlines and
-    // inserting spaces)
-    lastPopplerBox = poppler_box.get();
-  }
-
-  return retVal;
-}
-
 } // namespace PopplerQt
 
 } // namespace Backend
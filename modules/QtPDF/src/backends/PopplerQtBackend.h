@@ -1,5 +1,5 @@
 /**
- * Copyright (C) 2013-2023  Charlie Sharpsteen, Stefan Löffler
+ * Copyright (C) 2013-2025  Charlie Sharpsteen, Stefan Löffler
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the Free
@@ -38,6 +38,30 @@ namespace PopplerQt {
 class Document;
 class Page;
 
+// The contents of a pdf file, loaded and ready to be installed in a Document
+// (see Document::load() and Document::prepareReload())
+class LoadedFile : public Backend::Document::PreparedReload
+{
+public:
+  using size_type = Backend::Document::size_type;
+
+  ~LoadedFile() override { clear(); }
+  // Releases the contents in the right order (see below)
+  void clear();
+
+  // NB: The ::Poppler::Document is loaded from the file `snapshot` if possible
+  // or from `data` otherwise; hence, they must be released in reverse order
+  QString snapshot;
+  QByteArray data;
+  std::unique_ptr<::Poppler::Document> doc;
+  // The geometry of all pages of `doc`
+  QVector<Backend::Document::PageGeometry> pageGeometries;
+  // Page::fingerprint() values of the pages that had cached tiles before and
+  // after reloading, respectively
+  QHash<size_type, QByteArray> oldFingerprints;
+  QHash<size_type, QByteArray> newFingerprints;
+};
+
 class Document: public Backend::Document
 {
   typedef Backend::Document Super;
@@ -60,7 +84,44 @@ protected:
   mutable QList<PDFFontInfo> _fonts;
   mutable bool _fontsLoaded{false};
 
+  // Path of a private clone of the pdf file that is not affected by changes to
+  // the original file (e.g., during typesetting); empty if the file system
+  // does not support clones. All ::Poppler::Document instances below are
+  // loaded from this file if possible. See load().
+  // NB: Must only be released after all ::Poppler::Document instances loaded
+  // from it have been destroyed
+  QString _pdfSnapshot;
+  // Raw contents of the pdf file if there is no _pdfSnapshot (empty otherwise)
+  QByteArray _pdfData;
+  // Independent ::Poppler::Document instances used to render pages
+  // concurrently without serializing on _poppler_docLock. Instances not
+  // currently in use are kept here for reuse; access is protected by
+  // _renderDocsLock. See acquireRenderDocument().
+  std::vector< std::unique_ptr<::Poppler::Document> > _renderDocs;
+  // Number of instances created for the current file (in use or in
+  // _renderDocs); protected by _renderDocsLock
+  int _numRenderDocs{0};
+  QMutex _renderDocsLock;
+  // Rendering with separate instances is only equivalent to rendering with
+  // _poppler_doc if the latter has no state that could be changed at runtime
+  // (e.g., the visibility of optional content, or the unlocking password)
+  bool _canRenderConcurrently{false};
+  // Page::fingerprint() values of the pages as of the last reload(); only
+  // pages that had cached tiles at that time are included
+  QHash<size_type, QByteArray> _pageFingerprints;
+
   bool load(const QString & filename);
+  // Replaces _poppler_doc, _pdfData, and _pdfSnapshot by those of `file`,
+  // which takes over the old ones (to be released with it)
+  // Requires a doc-write-lock
+  void install(LoadedFile & file);
+
+  // Returns a ::Poppler::Document instance that can be used for rendering
+  // independent of _poppler_doc, or nullptr if that is not possible
+  // Requires a doc-read-lock; thread-safe otherwise
+  std::unique_ptr<::Poppler::Document> acquireRenderDocument();
+  // Hands an instance obtained from acquireRenderDocument() back for reuse
+  void releaseRenderDocument(std::unique_ptr<::Poppler::Document> renderDoc);
 
   // The following two methods are not thread-safe because they don't acquire a
   // read lock. This is to enable methods that have a write lock to use them.
@@ -75,6 +136,8 @@ public:
   bool isLocked() const override { QReadLocker docLocker(_docLock.data()); return _isLocked(); }
 
   void reload() override;
+  QSharedPointer<Backend::Document::PreparedReload> prepareReload(const AbortFlag * abortFlag = nullptr) override;
+  void finishReload(QSharedPointer<Backend::Document::PreparedReload> prepared) override;
   bool unlock(const QString password) override;
 
   QWeakPointer<Backend::Page> page(size_type at) override;
@@ -86,8 +149,13 @@ public:
 
   QColor paperColor() const override;
   void setPaperColor(const QColor & color) override;
+
+protected:
+  QVector<PageGeometry> computePageGeometries() override;
+
 private:
-  void parseDocument();
+  // `pageGeometries` is the geometry of all pages, if known already
+  void parseDocument(const QVector<PageGeometry> & pageGeometries = {});
 };
 
 
@@ -107,19 +175,18 @@ class Page: public Backend::Page
 protected:
   Page(Document *parent, size_type at, QSharedPointer<QReadWriteLock> docLock);
 
+  PDFTextLayer loadTextLayer() const override;
+
 public:
   ~Page() override;
 
   QSizeF pageSizeF() const override;
 
-  QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false) const override;
+  QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false, const AbortFlag * abortFlag = nullptr) const override;
 
   QList< QSharedPointer<Annotation::Link> > loadLinks() override;
   QList< QSharedPointer<Annotation::AbstractAnnotation> > loadAnnotations() override;
-  QList< Backend::Page::Box > boxes() const override;
-  QString selectedText(const QList<QPolygonF> & selection, BoxBoundaryList * wordBoxes = nullptr, BoxBoundaryList * charBoxes = nullptr, const bool onlyFullyEnclosed = false) const override;
-
-  QList<Backend::SearchResult> search(const QString & searchText, const SearchFlags & flags) const override;
+  QByteArray fingerprint() const override;
 };
 
 } // namespace PopplerQt
@@ -8,6 +8,7 @@ SOURCES = \
   "../src/PDFActions.cpp" \
   "../src/PDFAnnotations.cpp" \
   "../src/PDFBackend.cpp" \
+  "../src/PDFBoxIndex.cpp" \
   "../src/PDFDocumentScene.cpp" \
   "../src/PDFDocumentTools.cpp" \
   "../src/PDFDocumentView.cpp" \
@@ -20,6 +21,7 @@ SOURCES = \
   "../src/PDFPageTile.cpp" \
   "../src/PDFRuler.cpp" \
   "../src/PDFSearcher.cpp" \
+  "../src/PDFTextLayer.cpp" \
   "../src/PDFToC.cpp" \
   "../src/PDFTransitions.cpp" \
   "../src/PaperSizes.cpp" \
@@ -31,6 +33,7 @@ HEADERS = \
   "../src/PDFActions.h" \
   "../src/PDFAnnotations.h" \
   "../src/PDFBackend.h" \
+  "../src/PDFBoxIndex.h" \
   "../src/PDFDocumentScene.h" \
   "../src/PDFDocumentTools.h" \
   "../src/PDFDocumentView.h" \
@@ -44,6 +47,7 @@ HEADERS = \
   "../src/PDFPageTile.h" \
   "../src/PDFRuler.h" \
   "../src/PDFSearcher.h" \
+  "../src/PDFTextLayer.h" \
   "../src/PDFToC.h" \
   "../src/PDFTransitions.h" \
   "../src/PaperSizes.h" \
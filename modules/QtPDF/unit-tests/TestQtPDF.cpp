@@ -19,11 +19,15 @@
   see <https://tug.org/texworks/>.
 */
 #include "TestQtPDF.h"
+#include "PDFBoxIndex.h"
 #include "PaperSizes.h"
 #include "PhysicalUnits.h"
 
 #include <QTimeZone>
 
+#include <atomic>
+#include <thread>
+
 #ifdef USE_MUPDF
   typedef QtPDF::MuPDFBackend Backend;
 #elif USE_POPPLERQT
@@ -129,8 +133,8 @@ public:
   QList<QtPDF::Backend::SearchResult> search(const QString &searchText, const QtPDF::Backend::SearchFlags &flags) const override {
     Q_UNUSED(searchText) Q_UNUSED(flags) return {};
   }
-  QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false) const override {
-    Q_UNUSED(xres) Q_UNUSED(yres) Q_UNUSED(render_box) Q_UNUSED(cache)
+  QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false, const QtPDF::Backend::AbortFlag * abortFlag = nullptr) const override {
+    Q_UNUSED(xres) Q_UNUSED(yres) Q_UNUSED(render_box) Q_UNUSED(cache) Q_UNUSED(abortFlag)
     return {};
   }
 };
@@ -169,6 +173,71 @@ inline void sleep(int ms)
 #endif
 }
 
+// Page that keeps track of how many renders are running concurrently and of
+// the order in which tiles (identified by their left edge) are rendered.
+// Rendering takes `renderDuration` ms unless it is aborted.
+class ConcurrencyCountingPage : public GenericPage
+{
+public:
+  using GenericPage::GenericPage;
+  QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false, const QtPDF::Backend::AbortFlag * abortFlag = nullptr) const override {
+    Q_UNUSED(xres) Q_UNUSED(yres) Q_UNUSED(cache)
+    const int n = ++current;
+    int m = maximum;
+    while (n > m && !maximum.compare_exchange_weak(m, n)) { }
+    {
+      QMutexLocker l(&renderOrderMutex);
+      renderOrder.append(render_box.left());
+    }
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < renderDuration && !(abortFlag && *abortFlag))
+      sleep(5);
+    --current;
+    return {};
+  }
+  static void reset() {
+    current = 0;
+    maximum = 0;
+    renderDuration = 50;
+    QMutexLocker l(&renderOrderMutex);
+    renderOrder.clear();
+  }
+
+  static std::atomic<int> current;
+  static std::atomic<int> maximum;
+  static std::atomic<int> renderDuration;
+  static QMutex renderOrderMutex;
+  static QVector<int> renderOrder;
+};
+
+std::atomic<int> ConcurrencyCountingPage::current{0};
+std::atomic<int> ConcurrencyCountingPage::maximum{0};
+std::atomic<int> ConcurrencyCountingPage::renderDuration{50};
+QMutex ConcurrencyCountingPage::renderOrderMutex;
+QVector<int> ConcurrencyCountingPage::renderOrder;
+
+class ConcurrencyCountingDocument : public GenericDocument
+{
+public:
+  ConcurrencyCountingDocument() {
+    _pages[0] = QSharedPointer<QtPDF::Backend::Page>(new ConcurrencyCountingPage(this, 0, _docLock));
+  }
+};
+
+class RenderedEventCounter : public QObject
+{
+public:
+  int count{0};
+  bool event(QEvent * e) override {
+    if (e->type() == QtPDF::Backend::PDFPageRenderedEvent::PageRenderedEvent) {
+      ++count;
+      return true;
+    }
+    return QObject::event(e);
+  }
+};
+
 QTestData & TestQtPDF::newDocTest(const char * tag)
 {
   return QTest::newRow(tag) << _docs[QString::fromUtf8(tag)];
@@ -211,6 +280,8 @@ void TestQtPDF::abstractBaseClasses()
   QCOMPARE(doc.isValid(), true);
   QCOMPARE(doc.isLocked(), false);
   doc.reload();
+  QVERIFY(doc.prepareReload().isNull());
+  doc.finishReload({});
   QCOMPARE(doc.unlock(QString()), true);
   QCOMPARE(doc.toc(), QtPDF::Backend::PDFToC());
   QCOMPARE(doc.fonts(), QList<QtPDF::Backend::PDFFontInfo>());
@@ -249,6 +320,8 @@ void TestQtPDF::abstractBaseClasses()
 
   QCOMPARE(page->loadAnnotations(), QList< QSharedPointer<QtPDF::Annotation::AbstractAnnotation> >());
   QCOMPARE(page->search(QString(), {}), QList<QtPDF::Backend::SearchResult>());
+  QVERIFY(page->textLayer()->isEmpty());
+  QCOMPARE(page->fingerprint(), QByteArray());
 }
 
 void TestQtPDF::loadDocs()
@@ -443,6 +516,9 @@ void TestQtPDF::page()
   QVERIFY(doc->page(-1).isNull());
   QVERIFY(doc->page(doc->numPages()).isNull());
 
+  const QVector<QSizeF> allPageSizes = doc->pageSizes();
+  QCOMPARE(allPageSizes.size(), qMax(doc->numPages(), QtPDF::Backend::Document::size_type(0)));
+
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
   const bool isSizeF = (pageSize.type() == QVariant::SizeF);
   const bool isVariantList = (pageSize.type() == QVariant::List);
@@ -477,6 +553,7 @@ void TestQtPDF::page()
 #endif
     QVERIFY2(qAbs(page->pageSizeF().width() - size.width()) < 1e-4, qPrintable(QString::fromLatin1("Width of page %1 is %2 instead of %3").arg(i + 1).arg(page->pageSizeF().width()).arg(size.width())));
     QVERIFY2(qAbs(page->pageSizeF().height() - size.height()) < 1e-4, qPrintable(QString::fromLatin1("Height of page %1 is %2 instead of %3").arg(i + 1).arg(page->pageSizeF().height()).arg(size.height())));
+    QCOMPARE(allPageSizes[i], page->pageSizeF());
 
 //		transition
 //		loadLinks()
@@ -488,6 +565,77 @@ void TestQtPDF::page()
   }
 }
 
+void TestQtPDF::releasePage()
+{
+  Backend backend;
+  QSharedPointer<QtPDF::Backend::Document> doc = backend.newDocument(QStringLiteral("pgfmanual.pdf"));
+  QSharedPointer<QtPDF::Backend::Page> page = doc->page(1).toStrongRef();
+  QVERIFY(page);
+
+  // Released pages that are still in use are reused
+  doc->releasePage(1);
+  QVERIFY(doc->page(1).toStrongRef() == page);
+  QCOMPARE(page->document(), doc.data());
+
+  // Otherwise, they are recreated
+  doc->releasePage(1);
+  QWeakPointer<QtPDF::Backend::Page> weakPage = page.toWeakRef();
+  page.reset();
+  QVERIFY(weakPage.isNull());
+  page = doc->page(1).toStrongRef();
+  QVERIFY(page);
+  QCOMPARE(page->pageNum(), QtPDF::Backend::Document::size_type(1));
+
+  // Released pages are detached when the document goes away
+  doc->releasePage(1);
+  doc.reset();
+  QVERIFY(page->document() == nullptr);
+
+  // Releasing pages that don't exist is a no-op
+  doc = backend.newDocument(QStringLiteral("pgfmanual.pdf"));
+  doc->releasePage(-1);
+  doc->releasePage(doc->numPages());
+  doc->releasePage(0);
+  QVERIFY(doc->page(0).toStrongRef());
+
+  // Pages used least recently are released by the document itself (no matter
+  // who asked for them), unless they are still used elsewhere
+  QWeakPointer<QtPDF::Backend::Page> firstPage = doc->page(0);
+  page = doc->page(1).toStrongRef();
+  for (QtPDF::Backend::Document::size_type i = 2; i < doc->numPages(); ++i)
+    QVERIFY(doc->page(i).toStrongRef());
+  QVERIFY(firstPage.isNull());
+  QCOMPARE(page->document(), doc.data());
+  QVERIFY(doc->page(1).toStrongRef() == page);
+}
+
+void TestQtPDF::pageGeometries()
+{
+  Backend backend;
+  QSharedPointer<QtPDF::Backend::Document> doc = backend.newDocument(QStringLiteral("page-rotation.pdf"));
+  const quint64 version = doc->version();
+
+  const QVector<QtPDF::Backend::Document::PageGeometry> geometries = doc->pageGeometries();
+  QCOMPARE(geometries.size(), doc->numPages());
+  for (QtPDF::Backend::Document::size_type i = 0; i < geometries.size(); ++i) {
+    QSharedPointer<QtPDF::Backend::Page> page = doc->page(i).toStrongRef();
+    QVERIFY(page);
+    QCOMPARE(geometries[i].size, page->pageSizeF());
+  }
+
+  // The geometries are computed only once per version; the cached result is
+  // returned (sharing its data) without querying the backend again
+  QCOMPARE(doc->version(), version);
+  const QVector<QtPDF::Backend::Document::PageGeometry> cachedGeometries = doc->pageGeometries();
+  QCOMPARE(cachedGeometries.size(), geometries.size());
+  QVERIFY(cachedGeometries.constData() == geometries.constData());
+  QCOMPARE(doc->version(), version);
+
+  doc->reload();
+  QVERIFY(doc->version() != version);
+  QCOMPARE(doc->pageSizes().size(), geometries.size());
+}
+
 void TestQtPDF::destination_data()
 {
   QTest::addColumn<QtPDF::PDFDestination>("dst");
@@ -1703,6 +1851,123 @@ void TestQtPDF::page_search()
   }
 }
 
+void TestQtPDF::textLayer()
+{
+  using QtPDF::Backend::PDFTextLayer;
+
+  PDFTextLayer layer;
+  QVERIFY(layer.isEmpty());
+  using Boxes = QVector<QRectF>;
+  QCOMPARE(layer.search(QStringLiteral("a"), Qt::CaseSensitive), QVector<Boxes>());
+
+  // Two words on the first line, one on the second
+  layer.appendWord(QStringLiteral("ab"), {QRectF(0, 0, 5, 10), QRectF(5, 0, 5, 10)}, QRectF(0, 0, 10, 10), true);
+  layer.appendWord(QStringLiteral("cd"), {QRectF(15, 0, 5, 10), QRectF(20, 0, 5, 10)}, QRectF(15, 0, 10, 10), false);
+  layer.appendWord(QStringLiteral("Ab"), {QRectF(0, 12, 5, 10), QRectF(5, 12, 5, 10)}, QRectF(0, 12, 10, 10), false);
+  QVERIFY(!layer.isEmpty());
+  QCOMPARE(layer.text(), QStringLiteral("ab cd\nAb"));
+  QCOMPARE(layer.glyphBox(1), QRectF(5, 0, 5, 10));
+  QVERIFY(layer.glyphBox(2).isNull());
+  QCOMPARE(layer.words().size(), 3);
+  QCOMPARE(layer.words()[1].begin, PDFTextLayer::size_type(3));
+  QCOMPARE(layer.words()[1].end, PDFTextLayer::size_type(5));
+  QCOMPARE(layer.lines().size(), 2);
+  QCOMPARE(layer.lines()[0].beginWord, PDFTextLayer::size_type(0));
+  QCOMPARE(layer.lines()[0].endWord, PDFTextLayer::size_type(2));
+  QCOMPARE(layer.lines()[0].boundingBox, QRectF(0, 0, 25, 10));
+  QCOMPARE(layer.lines()[1].beginWord, PDFTextLayer::size_type(2));
+  QCOMPARE(layer.lines()[1].endWord, PDFTextLayer::size_type(3));
+
+  QCOMPARE(layer.boundingBox(0, 5), QRectF(0, 0, 25, 10));
+  QCOMPARE(layer.search(QStringLiteral("ab"), Qt::CaseSensitive), QVector<Boxes>{Boxes{QRectF(0, 0, 10, 10)}});
+  QCOMPARE(layer.search(QStringLiteral("ab"), Qt::CaseInsensitive), (QVector<Boxes>{Boxes{QRectF(0, 0, 10, 10)}, Boxes{QRectF(0, 12, 10, 10)}}));
+  // Phrases spanning lines have one box per line
+  QCOMPARE(layer.search(QStringLiteral("cd Ab"), Qt::CaseSensitive), (QVector<Boxes>{Boxes{QRectF(15, 0, 10, 10), QRectF(0, 12, 10, 10)}}));
+  QCOMPARE(layer.search(QStringLiteral("xy"), Qt::CaseSensitive), QVector<Boxes>());
+
+  // Text and needle are compared in normalization form KC; matches cover the
+  // whole glyphs they were derived from
+  {
+    PDFTextLayer ligatures;
+    ligatures.appendWord(QString::fromUtf8("\xEF\xAC\x81nd"), {QRectF(0, 0, 10, 10), QRectF(10, 0, 5, 10), QRectF(15, 0, 5, 10)}, QRectF(0, 0, 20, 10), true);
+    ligatures.appendWord(QString::fromUtf8("cafe\xCC\x81"), {QRectF(25, 0, 5, 10), QRectF(30, 0, 5, 10), QRectF(35, 0, 5, 10), QRectF(40, 0, 5, 10), QRectF(40, 0, 5, 10)}, QRectF(25, 0, 20, 10), false);
+    QCOMPARE(ligatures.search(QStringLiteral("find"), Qt::CaseSensitive), QVector<Boxes>{Boxes{QRectF(0, 0, 20, 10)}});
+    QCOMPARE(ligatures.search(QStringLiteral("FIND"), Qt::CaseInsensitive), QVector<Boxes>{Boxes{QRectF(0, 0, 20, 10)}});
+    QCOMPARE(ligatures.search(QStringLiteral("in"), Qt::CaseSensitive), QVector<Boxes>{Boxes{QRectF(0, 0, 15, 10)}});
+    QCOMPARE(ligatures.search(QString::fromUtf8("\xEF\xAC\x81"), Qt::CaseSensitive), QVector<Boxes>{Boxes{QRectF(0, 0, 10, 10)}});
+    QCOMPARE(ligatures.search(QString::fromUtf8("caf\xC3\xA9"), Qt::CaseSensitive), QVector<Boxes>{Boxes{QRectF(25, 0, 20, 10)}});
+    QCOMPARE(ligatures.search(QStringLiteral("nd cafe"), Qt::CaseSensitive), QVector<Boxes>());
+  }
+
+  // Text layers are cached by the pages
+  if (!_docs.contains(QStringLiteral("base14-fonts")))
+    QSKIP("base14-fonts document not loaded");
+  QSharedPointer<QtPDF::Backend::Page> page = _docs[QStringLiteral("base14-fonts")]->page(0).toStrongRef();
+  QVERIFY(page);
+  QCOMPARE(page->textLayer(), page->textLayer());
+  QCOMPARE(page->boxes().size(), page->textLayer()->words().size());
+}
+
+void TestQtPDF::boxIndex()
+{
+  using QtPDF::PDFBoxIndex;
+
+  PDFBoxIndex empty;
+  QCOMPARE(empty.indexAt(QPointF(0, 0)), PDFBoxIndex::size_type(-1));
+  QCOMPARE(empty.intersecting(QRectF(0, 0, 1, 1)), QVector<PDFBoxIndex::size_type>());
+  QCOMPARE(empty.nearest(QPointF(0, 0)), PDFBoxIndex::size_type(-1));
+
+  // Lines of "words" of varying widths, plus a few rects spanning several
+  // lines and a duplicate (to check that ties go to the smaller index)
+  QVector<QRectF> rects;
+  for (int line = 0; line < 40; ++line) {
+    double x = 10;
+    for (int word = 0; word < 12; ++word) {
+      const double w = 3 + (line * 7 + word * 13) % 17;
+      rects << QRectF(x, 20 + 12 * line, w, 10);
+      x += w + 4;
+    }
+  }
+  rects << QRectF(5, 100, 300, 150) << QRectF(250, 15, 2, 400) << rects[42];
+  const PDFBoxIndex index(rects);
+  QCOMPARE(index.size(), rects.size());
+
+  const auto bruteForceIndexAt = [&rects](const QPointF & pt) {
+    for (PDFBoxIndex::size_type i = 0; i < rects.size(); ++i) {
+      if (rects[i].contains(pt))
+        return i;
+    }
+    return PDFBoxIndex::size_type(-1);
+  };
+  const auto bruteForceNearest = [&rects](const QPointF & pt) {
+    PDFBoxIndex::size_type best = 0;
+    for (PDFBoxIndex::size_type i = 1; i < rects.size(); ++i) {
+      if (PDFBoxIndex::distance(pt, rects[i]) < PDFBoxIndex::distance(pt, rects[best]))
+        best = i;
+    }
+    return best;
+  };
+  const auto bruteForceIntersecting = [&rects](const QRectF & r) {
+    QVector<PDFBoxIndex::size_type> rv;
+    for (PDFBoxIndex::size_type i = 0; i < rects.size(); ++i) {
+      if (rects[i].intersects(r))
+        rv << i;
+    }
+    return rv;
+  };
+
+  for (int y = -50; y < 600; y += 7) {
+    for (int x = -50; x < 400; x += 9) {
+      const QPointF pt(x + 0.5, y + 0.25);
+      QCOMPARE(index.indexAt(pt), bruteForceIndexAt(pt));
+      QCOMPARE(index.nearest(pt), bruteForceNearest(pt));
+    }
+  }
+  QCOMPARE(index.indexAt(rects[42].center()), PDFBoxIndex::size_type(42));
+  for (const QRectF & r : {QRectF(0, 0, 50, 50), QRectF(100, 300, -60, -40), QRectF(-10, -10, 1000, 1000), QRectF(500, 500, 10, 10)})
+    QCOMPARE(index.intersecting(r), bruteForceIntersecting(r));
+}
+
 void TestQtPDF::paperSize_data()
 {
   QTest::addColumn<QSizeF>("requestSize");
@@ -1990,6 +2255,379 @@ void TestQtPDF::pageTile()
 #endif
 }
 
+void TestQtPDF::fingerprint()
+{
+#ifndef USE_POPPLERQT
+  QSKIP("Fingerprints are only supported by the poppler-qt backend");
+#endif
+  Backend backend;
+  QSharedPointer<QtPDF::Backend::Document> doc1 = backend.newDocument(QStringLiteral("base14-fonts.pdf"));
+  QSharedPointer<QtPDF::Backend::Document> doc2 = backend.newDocument(QStringLiteral("base14-fonts.pdf"));
+  QSharedPointer<QtPDF::Backend::Document> doc3 = backend.newDocument(QStringLiteral("jpg.pdf"));
+  QSharedPointer<QtPDF::Backend::Page> page1 = doc1->page(0).toStrongRef();
+  QSharedPointer<QtPDF::Backend::Page> page2 = doc2->page(0).toStrongRef();
+  QSharedPointer<QtPDF::Backend::Page> page3 = doc3->page(0).toStrongRef();
+  QVERIFY(page1);
+  QVERIFY(page2);
+  QVERIFY(page3);
+
+  const QByteArray fingerprint1 = page1->fingerprint();
+  QVERIFY(!fingerprint1.isEmpty());
+  QCOMPARE(page2->fingerprint(), fingerprint1);
+  QVERIFY(page3->fingerprint() != fingerprint1);
+
+  // Reloading an unchanged document keeps its cached tiles current
+  const QtPDF::Backend::PDFPageTile tile(72, 72, QRect(0, 0, 16, 16), doc1.data(), 0);
+  page1->renderToImage(tile.xres, tile.yres, tile.render_box, true);
+  QCOMPARE(doc1->pageCache().getStatus(tile), QtPDF::Backend::PDFPageCache::CURRENT);
+  doc1->reload();
+  QCOMPARE(doc1->pageCache().getStatus(tile), QtPDF::Backend::PDFPageCache::CURRENT);
+  doc1->pageCache().removeDocumentTiles(doc1.data());
+}
+
+void TestQtPDF::prepareReload()
+{
+#ifndef USE_POPPLERQT
+  QSKIP("Reloading in the background is only supported by the poppler-qt backend");
+#endif
+  Backend backend;
+  QSharedPointer<QtPDF::Backend::Document> doc = backend.newDocument(QStringLiteral("base14-fonts.pdf"));
+  QSharedPointer<QtPDF::Backend::Page> page = doc->page(0).toStrongRef();
+  QVERIFY(page);
+  const QtPDF::Backend::PDFPageTile tile(72, 72, QRect(0, 0, 16, 16), doc.data(), 0);
+  page->renderToImage(tile.xres, tile.yres, tile.render_box, true);
+
+  // Aborted reloads don't prepare anything
+  const QtPDF::Backend::AbortFlag aborted{true};
+  QVERIFY(doc->prepareReload(&aborted).isNull());
+
+  // Preparing does not change the document (even if it is done in another
+  // thread)
+  QSharedPointer<QtPDF::Backend::Document::PreparedReload> prepared;
+  std::thread worker([doc, &prepared]() { prepared = doc->prepareReload(); });
+  worker.join();
+  QVERIFY(!prepared.isNull());
+  QVERIFY(doc->page(0).toStrongRef() == page);
+  QCOMPARE(doc->pageCache().getStatus(tile), QtPDF::Backend::PDFPageCache::CURRENT);
+
+  // Finishing replaces the pages, but keeps the tiles of unchanged pages
+  doc->finishReload(prepared);
+  QVERIFY(doc->page(0).toStrongRef() != page);
+  QCOMPARE(doc->numPages(), QtPDF::Backend::Document::size_type(1));
+  QCOMPARE(doc->pageCache().getStatus(tile), QtPDF::Backend::PDFPageCache::CURRENT);
+  doc->pageCache().removeDocumentTiles(doc.data());
+}
+
+void TestQtPDF::pageCache()
+{
+  using QtPDF::Backend::PDFPageCache;
+  using QtPDF::Backend::PDFPageTile;
+
+  const QtPDF::Backend::Document * doc1 = _docs[QStringLiteral("page-rotation")].data();
+  const QtPDF::Backend::Document * doc2 = _docs[QStringLiteral("base14-fonts")].data();
+  auto newImage = []() { return QSharedPointer<QImage>(new QImage(16, 16, QImage::Format_ARGB32)); };
+  // 16 x 16 pixels x 4 bytes
+  const qint64 tileCost = 1024;
+
+  PDFPageCache cache;
+  QVERIFY(cache.maxCost() > 0);
+  QCOMPARE(cache.maxCost(), PDFPageCache::defaultMaxCost());
+  cache.setMaxCost(2 * PDFPageCache::minMaxCost());
+  QCOMPARE(cache.maxCost(), 2 * PDFPageCache::minMaxCost());
+  // Budgets too small to hold the largest tiles are raised
+  cache.setMaxCost(1024 * 1024);
+  QCOMPARE(cache.maxCost(), PDFPageCache::minMaxCost());
+
+  const PDFPageTile t1{1., 1., QRect(0, 0, 16, 16), doc1, 0};
+  const PDFPageTile t2{1., 1., QRect(16, 0, 16, 16), doc1, 0};
+  const PDFPageTile t3{1., 1., QRect(0, 0, 16, 16), doc1, 1};
+  const PDFPageTile t4{1., 1., QRect(0, 0, 16, 16), doc2, 0};
+
+  QCOMPARE(cache.getStatus(t1), PDFPageCache::UNKNOWN);
+  QVERIFY(cache.getImage(t1).isNull());
+
+  QSharedPointer<QImage> img1 = newImage();
+  QCOMPARE(cache.setImage(t1, img1, PDFPageCache::CURRENT), img1);
+  cache.setImage(t2, newImage(), PDFPageCache::CURRENT);
+  cache.setImage(t3, newImage(), PDFPageCache::CURRENT);
+  cache.setImage(t4, newImage(), PDFPageCache::CURRENT);
+  QCOMPARE(cache.getStatus(t1), PDFPageCache::CURRENT);
+  QCOMPARE(cache.getImage(t1), img1);
+  QCOMPARE(cache.statistics().numTiles, qint64(4));
+  QCOMPARE(cache.statistics().totalCost, 4 * tileCost);
+
+  // Non-overwriting insertions keep the existing image
+  QSharedPointer<QImage> img2 = newImage();
+  QCOMPARE(cache.setImage(t1, img2, PDFPageCache::PLACEHOLDER, false), img1);
+  QCOMPARE(cache.getStatus(t1), PDFPageCache::CURRENT);
+
+  // Per-page index
+  {
+    QList<PDFPageTile> tiles = cache.tiles(doc1, 0);
+    std::sort(tiles.begin(), tiles.end());
+    QList<PDFPageTile> expected{t1, t2};
+    std::sort(expected.begin(), expected.end());
+    QCOMPARE(tiles, expected);
+    QCOMPARE(cache.tiles(doc1, 1), QList<PDFPageTile>{t3});
+    QCOMPARE(cache.tiles(doc1, 2), QList<PDFPageTile>());
+  }
+
+  // markOutdated() only affects the tiles of the given document that were
+  // cached before the call
+  cache.markOutdated(doc1);
+  QCOMPARE(cache.getStatus(t1), PDFPageCache::OUTDATED);
+  QCOMPARE(cache.getStatus(t3), PDFPageCache::OUTDATED);
+  QCOMPARE(cache.getStatus(t4), PDFPageCache::CURRENT);
+  QCOMPARE(cache.getImage(t1), img1);
+  cache.setImage(t1, img2, PDFPageCache::CURRENT);
+  QCOMPARE(cache.getStatus(t1), PDFPageCache::CURRENT);
+  QCOMPARE(cache.getStatus(t2), PDFPageCache::OUTDATED);
+
+  // Current tiles of unchanged pages stay current; tiles that were outdated
+  // before don't
+  QCOMPARE(cache.pagesWithTiles(doc1), QSet<PDFPageCache::page_size_type>({0, 1}));
+  cache.markOutdated(doc1, {0});
+  QCOMPARE(cache.getStatus(t1), PDFPageCache::CURRENT);
+  QCOMPARE(cache.getStatus(t2), PDFPageCache::OUTDATED);
+  QCOMPARE(cache.getStatus(t3), PDFPageCache::OUTDATED);
+  QCOMPARE(cache.getStatus(t4), PDFPageCache::CURRENT);
+
+  // Placeholders that are discarded become outdated
+  cache.setImage(t2, newImage(), PDFPageCache::PLACEHOLDER);
+  cache.discardPlaceholder(t2);
+  QCOMPARE(cache.getStatus(t2), PDFPageCache::OUTDATED);
+  cache.discardPlaceholder(t1);
+  QCOMPARE(cache.getStatus(t1), PDFPageCache::CURRENT);
+
+  // Stand-ins for tiles at other resolutions
+  {
+    const PDFPageTile t5{2., 2., QRect(0, 0, 32, 32), doc1, 0};
+    QList<PDFPageCache::CachedTile> overlapping = cache.overlappingTiles(t5);
+    QCOMPARE(overlapping.size(), 1);
+    QCOMPARE(overlapping[0].tile, t1);
+    QCOMPARE(overlapping[0].image, img2);
+    QCOMPARE(overlapping[0].status, PDFPageCache::CURRENT);
+
+    cache.setImage(t5, newImage(), PDFPageCache::CURRENT);
+    overlapping = cache.overlappingTiles(PDFPageTile(1., 1., QRect(8, 8, 16, 16), doc1, 0));
+    QCOMPARE(overlapping.size(), 3);
+    QCOMPARE(cache.overlappingTiles(t5).size(), 1);
+    QCOMPARE(cache.overlappingTiles(PDFPageTile(1., 1., QRect(0, 0, 16, 16), doc1, 2)).size(), 0);
+  }
+
+  // Stand-ins in different cells of the tile index, including one that spans
+  // several cells
+  {
+    const PDFPageTile a{1., 1., QRect(0, 0, 1024, 1024), doc1, 3};
+    const PDFPageTile b{1., 1., QRect(1024, 0, 1024, 1024), doc1, 3};
+    const PDFPageTile c{1., 1., QRect(2048, 2048, 1024, 1024), doc1, 3};
+    const PDFPageTile d{1., 1., QRect(1000, 1000, 100, 100), doc1, 3};
+    for (const PDFPageTile & t : {a, b, c, d})
+      cache.setImage(t, newImage(), PDFPageCache::CURRENT);
+    const auto overlappingTiles = [&cache](const PDFPageTile & tile) {
+      QSet<PDFPageTile> retVal;
+      for (const PDFPageCache::CachedTile & t : cache.overlappingTiles(tile))
+        retVal.insert(t.tile);
+      return retVal;
+    };
+    QCOMPARE(overlappingTiles(PDFPageTile(1., 1., QRect(1020, 0, 10, 10), doc1, 3)), (QSet<PDFPageTile>{a, b}));
+    QCOMPARE(cache.overlappingTiles(PDFPageTile(1., 1., QRect(900, 900, 200, 200), doc1, 3)).size(), 3);
+    QCOMPARE(overlappingTiles(PDFPageTile(1., 1., QRect(900, 900, 200, 200), doc1, 3)), (QSet<PDFPageTile>{a, b, d}));
+    QCOMPARE(overlappingTiles(PDFPageTile(2., 2., QRect(4096, 4096, 2048, 2048), doc1, 3)), QSet<PDFPageTile>{c});
+    QCOMPARE(overlappingTiles(PDFPageTile(.5, .5, QRect(0, 0, 2048, 2048), doc1, 3)), (QSet<PDFPageTile>{a, b, c, d}));
+  }
+
+  // Only composed placeholders of the given page are removed; outdated images
+  // serving as placeholders (see Page::getTileImage()) are kept
+  {
+    const PDFPageTile t6{1., 1., QRect(32, 0, 16, 16), doc1, 0};
+    const PDFPageTile t7{1., 1., QRect(32, 0, 16, 16), doc1, 1};
+    const PDFPageTile t8{1., 1., QRect(48, 0, 16, 16), doc1, 0};
+    cache.setImage(t6, newImage(), PDFPageCache::PLACEHOLDER);
+    cache.setImage(t7, newImage(), PDFPageCache::PLACEHOLDER);
+    cache.setImage(t8, newImage(), PDFPageCache::OUTDATED);
+    cache.setImage(t8, cache.getImage(t8), PDFPageCache::PLACEHOLDER, false);
+    QCOMPARE(cache.getStatus(t8), PDFPageCache::PLACEHOLDER);
+    cache.removePlaceholders(doc1, 0);
+    QCOMPARE(cache.getStatus(t6), PDFPageCache::UNKNOWN);
+    QCOMPARE(cache.getStatus(t7), PDFPageCache::PLACEHOLDER);
+    QCOMPARE(cache.getStatus(t8), PDFPageCache::PLACEHOLDER);
+    QCOMPARE(cache.getStatus(t1), PDFPageCache::CURRENT);
+    QCOMPARE(cache.getStatus(t2), PDFPageCache::OUTDATED);
+  }
+
+  // Hits and misses
+  cache.resetStatistics();
+  cache.getImage(t1);
+  cache.getImage(t2);
+  cache.getImage(PDFPageTile(2., 2., QRect(0, 0, 16, 16), doc1, 0));
+  QCOMPARE(cache.statistics().hits, qint64(1));
+  QCOMPARE(cache.statistics().misses, qint64(2));
+
+  cache.removeDocumentTiles(doc1);
+  QCOMPARE(cache.getStatus(t1), PDFPageCache::UNKNOWN);
+  QCOMPARE(cache.getStatus(t3), PDFPageCache::UNKNOWN);
+  QCOMPARE(cache.getStatus(t4), PDFPageCache::CURRENT);
+  QCOMPARE(cache.tiles(doc1, 0), QList<PDFPageTile>());
+  QCOMPARE(cache.statistics().numTiles, qint64(1));
+  QCOMPARE(cache.statistics().evictions, qint64(0));
+
+  // The largest tiles are cached even with the smallest budget
+  cache.clear();
+  cache.setMaxCost(1);
+  const PDFPageTile largeTile{1., 1., QRect(0, 0, 1024, 1024), doc2, 0};
+  cache.setImage(largeTile, QSharedPointer<QImage>(new QImage(1024, 1024, QImage::Format_ARGB32)), PDFPageCache::CURRENT);
+  QCOMPARE(cache.getStatus(largeTile), PDFPageCache::CURRENT);
+
+  // Exceeding the budget evicts the least recently used tiles (and removes
+  // them from the index)
+  // NB: 512 x 512 pixels x 4 bytes = 1 MiB per tile
+  const int numTiles = static_cast<int>(4 * PDFPageCache::minMaxCost() / (1024 * 1024));
+  cache.clear();
+  cache.setMaxCost(PDFPageCache::minMaxCost());
+  for (int i = 0; i < numTiles; ++i)
+    cache.setImage(PDFPageTile(1., 1., QRect(512 * i, 0, 512, 512), doc2, 0), QSharedPointer<QImage>(new QImage(512, 512, QImage::Format_ARGB32)), PDFPageCache::CURRENT);
+  const PDFPageCache::Statistics stats = cache.statistics();
+  QVERIFY(stats.totalCost <= cache.maxCost());
+  QVERIFY(stats.evictions > 0);
+  QCOMPARE(stats.numTiles + stats.evictions, qint64(numTiles));
+  QCOMPARE(static_cast<qint64>(cache.tiles(doc2, 0).size()), stats.numTiles);
+}
+
+void TestQtPDF::processingThreadPool()
+{
+  using QtPDF::Backend::PageProcessingRenderPageRequest;
+
+  ConcurrencyCountingDocument doc;
+  QSharedPointer<QtPDF::Backend::Page> page = doc.page(0).toStrongRef();
+  QVERIFY(page);
+  RenderedEventCounter listener;
+  QtPDF::Backend::PDFPageProcessingThreadPool pool;
+
+  QVERIFY(QtPDF::Backend::PDFPageProcessingThreadPool::defaultMaxThreadCount() >= 1);
+  QCOMPARE(pool.maxThreadCount(), QtPDF::Backend::PDFPageProcessingThreadPool::defaultMaxThreadCount());
+  pool.setMaxThreadCount(3);
+  QCOMPARE(pool.maxThreadCount(), 3);
+  QCOMPARE(pool.threadCount(), 0);
+
+  // Jobs are processed concurrently, but by no more than maxThreadCount()
+  // workers
+  ConcurrencyCountingPage::reset();
+  for (int i = 0; i < 6; ++i)
+    pool.addPageProcessingRequest(new PageProcessingRenderPageRequest(page.data(), &listener, 72, 72, QRect(i, 0, 1, 1)));
+  QTRY_COMPARE(listener.count, 6);
+  QVERIFY(pool.threadCount() <= 3);
+  QVERIFY(ConcurrencyCountingPage::maximum > 1);
+  QVERIFY(ConcurrencyCountingPage::maximum <= 3);
+
+  // The concurrency limit (e.g., imposed by the backend) is honored
+  pool.setConcurrencyLimit(1);
+  QCOMPARE(pool.concurrencyLimit(), 1);
+  ConcurrencyCountingPage::reset();
+  listener.count = 0;
+  for (int i = 0; i < 4; ++i)
+    pool.addPageProcessingRequest(new PageProcessingRenderPageRequest(page.data(), &listener, 72, 72, QRect(i, 0, 1, 1)));
+  QTRY_COMPARE(listener.count, 4);
+  QCOMPARE(ConcurrencyCountingPage::maximum.load(), 1);
+
+  // clearWorkStack() drops pending jobs and waits for running ones to finish
+  pool.setConcurrencyLimit(0);
+  for (int i = 0; i < 6; ++i)
+    pool.addPageProcessingRequest(new PageProcessingRenderPageRequest(page.data(), &listener, 72, 72, QRect(i, 0, 1, 1)));
+  pool.clearWorkStack();
+  QCOMPARE(ConcurrencyCountingPage::current.load(), 0);
+}
+
+void TestQtPDF::processingThreadPoolScheduling()
+{
+  using QtPDF::Backend::PageProcessingRequest;
+  using QtPDF::Backend::PageProcessingRenderPageRequest;
+
+  ConcurrencyCountingDocument doc;
+  QSharedPointer<QtPDF::Backend::Page> page = doc.page(0).toStrongRef();
+  QVERIFY(page);
+  RenderedEventCounter listener;
+  QtPDF::Backend::PDFPageProcessingThreadPool pool;
+  pool.setMaxThreadCount(1);
+  ConcurrencyCountingPage::reset();
+
+  auto newRequest = [&](const int i, const PageProcessingRequest::Priority priority) {
+    return new PageProcessingRenderPageRequest(page.data(), &listener, 72, 72, QRect(i, 0, 1, 1), false, priority);
+  };
+
+  // Keep the (only) worker busy so the following requests queue up
+  pool.addPageProcessingRequest(newRequest(0, PageProcessingRequest::Priority_Visible));
+  QTRY_COMPARE(ConcurrencyCountingPage::current.load(), 1);
+
+  pool.addPageProcessingRequest(newRequest(1, PageProcessingRequest::Priority_Prefetch));
+  pool.addPageProcessingRequest(newRequest(2, PageProcessingRequest::Priority_Visible));
+  pool.addPageProcessingRequest(newRequest(3, PageProcessingRequest::Priority_Prefetch));
+  pool.addPageProcessingRequest(newRequest(4, PageProcessingRequest::Priority_Prefetch));
+  pool.addPageProcessingRequest(newRequest(5, PageProcessingRequest::Priority_Preview));
+  // Identical to a pending request: coalesced, but with the higher priority
+  pool.addPageProcessingRequest(newRequest(1, PageProcessingRequest::Priority_Visible));
+  // Identical to the running request: discarded
+  pool.addPageProcessingRequest(newRequest(0, PageProcessingRequest::Priority_Visible));
+
+  QCOMPARE(pool.dropRequests([](const PageProcessingRequest & r) {
+    return dynamic_cast<const PageProcessingRenderPageRequest &>(r).render_box.left() == 3;
+  }), 1);
+
+  QTRY_COMPARE(listener.count, 5);
+  {
+    QMutexLocker l(&ConcurrencyCountingPage::renderOrderMutex);
+    QCOMPARE(ConcurrencyCountingPage::renderOrder, QVector<int>({0, 5, 1, 2, 4}));
+  }
+
+  const QtPDF::Backend::PDFPageProcessingThreadPool::Statistics stats = pool.statistics();
+  QCOMPARE(stats.executed, qint64(5));
+  QCOMPARE(stats.coalesced, qint64(2));
+  QCOMPARE(stats.dropped, qint64(1));
+
+  pool.resetStatistics();
+  QCOMPARE(pool.statistics().executed, qint64(0));
+}
+
+void TestQtPDF::processingThreadPoolAbort()
+{
+  using QtPDF::Backend::PageProcessingRequest;
+  using QtPDF::Backend::PageProcessingRenderPageRequest;
+
+  ConcurrencyCountingDocument doc;
+  QSharedPointer<QtPDF::Backend::Page> page = doc.page(0).toStrongRef();
+  QVERIFY(page);
+  RenderedEventCounter listener;
+  QtPDF::Backend::PDFPageProcessingThreadPool pool;
+  pool.setMaxThreadCount(1);
+  ConcurrencyCountingPage::reset();
+  // Long enough to make the test time out if aborting doesn't work
+  ConcurrencyCountingPage::renderDuration = 60000;
+
+  QElapsedTimer timer;
+
+  // Running requests that become stale are aborted
+  pool.addPageProcessingRequest(new PageProcessingRenderPageRequest(page.data(), &listener, 72, 72, QRect(0, 0, 1, 1)));
+  QTRY_COMPARE(ConcurrencyCountingPage::current.load(), 1);
+  timer.start();
+  QCOMPARE(pool.dropRequests([](const PageProcessingRequest &) { return true; }), 1);
+  QTRY_COMPARE(ConcurrencyCountingPage::current.load(), 0);
+  QVERIFY(timer.elapsed() < 1000);
+
+  // clearWorkStack() aborts running requests instead of waiting for them
+  pool.addPageProcessingRequest(new PageProcessingRenderPageRequest(page.data(), &listener, 72, 72, QRect(1, 0, 1, 1)));
+  QTRY_COMPARE(ConcurrencyCountingPage::current.load(), 1);
+  timer.start();
+  pool.clearWorkStack();
+  QCOMPARE(ConcurrencyCountingPage::current.load(), 0);
+  QVERIFY(timer.elapsed() < 1000);
+
+  // Aborted requests don't report back to their listener
+  QTest::qWait(50);
+  QCOMPARE(listener.count, 0);
+  QCOMPARE(pool.statistics().executed, qint64(0));
+  QCOMPARE(pool.statistics().dropped, qint64(2));
+}
+
 void TestQtPDF::physicalLength()
 {
   using namespace QtPDF::Physical;
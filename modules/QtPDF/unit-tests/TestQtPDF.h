@@ -75,6 +75,8 @@ private slots:
 
   void page_data();
   void page();
+  void releasePage();
+  void pageGeometries();
 
   void destination_data();
   void destination();
@@ -161,6 +163,9 @@ private slots:
   void page_search_data();
   void page_search();
 
+  void textLayer();
+  void boxIndex();
+
   void paperSize_data();
   void paperSize();
 
@@ -170,6 +175,13 @@ private slots:
   void ocg();
 
   void pageTile();
+  void pageCache();
+  void fingerprint();
+  void prepareReload();
+
+  void processingThreadPool();
+  void processingThreadPoolScheduling();
+  void processingThreadPoolAbort();
 
   void physicalLength();
 };
@@ -27,6 +27,7 @@
 #include "TWUtils.h"
 #include "TeXHighlighter.h"
 #include "document/SpellChecker.h"
+#include "document/SymbolIndex.h"
 #include "document/TeXDocument.h"
 #include "utils/ResourcesLibrary.h"
 
@@ -42,7 +43,9 @@
 #include <QMenu>
 #include <QModelIndex>
 #include <QPainter>
+#include <QRegularExpression>
 #include <QScrollBar>
+#include <QSet>
 #include <QSignalMapper>
 #include <QStandardItem>
 #include <QStandardItemModel>
@@ -887,6 +890,12 @@ bool CompletingEdit::handleCompletionShortcut(QKeyEvent *e)
 	}
 
 	if (!c && !atLineStart) {
+		// Labels, citations, etc. of the project take precedence where they
+		// apply (e.g., in the argument of \ref); environments are offered
+		// together with those of the completion files
+		if (startSymbolCompletion(seq, false))
+			return true;
+
 		cmpCursor = textCursor();
 		if (!selectWord(cmpCursor) && textCursor().selectionStart() > 0) {
 			cmpCursor.setPosition(textCursor().selectionStart() - 1);
@@ -943,6 +952,11 @@ bool CompletingEdit::handleCompletionShortcut(QKeyEvent *e)
 			}
 			break;
 		}
+
+		// Macros defined in the project are only offered if none of the
+		// completion files matches
+		if (startSymbolCompletion(seq, true))
+			return true;
 	}
 
 	if (c && c->completionCount() > 0) {
@@ -971,6 +985,85 @@ bool CompletingEdit::handleCompletionShortcut(QKeyEvent *e)
 	return false;
 }
 
+// Upper bound on the number of project symbols offered at once
+static const int kMaxSymbolCompletions = 200;
+
+// \returns true if completion of a project symbol was started, false otherwise
+bool CompletingEdit::startSymbolCompletion(const QKeySequence & seq, const bool includeMacros)
+{
+	if (!symbolIndex || textCursor().hasSelection())
+		return false;
+
+	QTextCursor cursor = textCursor();
+	const QString textBefore = cursor.block().text().left(cursor.positionInBlock());
+	Tw::Document::SymbolIndex::Kind kind{Tw::Document::SymbolIndex::Kind::Label};
+	QString prefix;
+	if (!Tw::Document::SymbolIndex::completionContext(textBefore, kind, prefix))
+		return false;
+	if (kind == Tw::Document::SymbolIndex::Kind::Macro && !includeMacros)
+		return false;
+
+	const QStringList names = symbolIndex->complete(kind, prefix, kMaxSymbolCompletions);
+	if (names.isEmpty())
+		return false;
+
+	if (!symbolCompleter) {
+		symbolCompleter = new QCompleter(this);
+		symbolCompleter->setCompletionMode(QCompleter::InlineCompletion);
+		symbolCompleter->setCaseSensitivity(Qt::CaseSensitive);
+		symbolCompleter->setModel(new QStandardItemModel(0, 2, symbolCompleter)); // columns are abbrev, expansion
+	}
+	QStandardItemModel * model = qobject_cast<QStandardItemModel*>(symbolCompleter->model());
+	model->removeRows(0, model->rowCount());
+
+	// NB: Environments are completed including the opening brace so the
+	// environments of the completion files (e.g., "{frame}" along with the
+	// matching \end) can be offered together with those of the project
+	QString namePrefix, nameSuffix;
+	QList<QList<QStandardItem*>> fileRows;
+	QSet<QString> fileEnvironments;
+	if (kind == Tw::Document::SymbolIndex::Kind::Macro)
+		namePrefix = QStringLiteral("\\");
+	else if (kind == Tw::Document::SymbolIndex::Kind::Environment) {
+		namePrefix = QStringLiteral("{");
+		nameSuffix = QStringLiteral("}");
+		const QStandardItemModel * files = (sharedCompleter ? qobject_cast<QStandardItemModel*>(sharedCompleter->model()) : nullptr);
+		static const QRegularExpression reEnvironment(QStringLiteral("^\\{([^{}]*)\\}"));
+		for (int i = 0; files && i < files->rowCount(); ++i) {
+			const QString abbrev = files->item(i, 0)->text();
+			if (!abbrev.startsWith(namePrefix + prefix))
+				continue;
+			fileRows.append({new QStandardItem(abbrev), new QStandardItem(files->item(i, 1)->text())});
+			const QRegularExpressionMatch match = reEnvironment.match(abbrev);
+			if (match.hasMatch())
+				fileEnvironments.insert(match.captured(1));
+		}
+	}
+	for (const QString & name : names) {
+		if (fileEnvironments.contains(name))
+			continue;
+		QList<QStandardItem*> row;
+		row.append(new QStandardItem(namePrefix + name + nameSuffix));
+		row.append(new QStandardItem(namePrefix + name + nameSuffix));
+		model->appendRow(row);
+	}
+	for (const QList<QStandardItem*> & row : fileRows)
+		model->appendRow(row);
+
+	cmpCursor = cursor;
+	cmpCursor.movePosition(QTextCursor::PreviousCharacter, QTextCursor::KeepAnchor, static_cast<pos_type>(namePrefix.length() + prefix.length()));
+	setCompleter(symbolCompleter);
+	c->setCompletionPrefix(cmpCursor.selectedText());
+	if (c->completionCount() == 0) {
+		setCompleter(nullptr);
+		return false;
+	}
+	if (seq == actionPrevious_Completion->shortcut())
+		c->setCurrentRow(c->completionCount() - 1);
+	showCurrentCompletion();
+	return true;
+}
+
 void CompletingEdit::handleTab(QKeyEvent * e)
 {
 	if (textCursor().hasSelection()) {
@@ -40,6 +40,7 @@ namespace Tw {
 namespace Document {
 
 class SpellChecker;
+class SymbolIndex;
 
 } // namespace Document
 } // namespace Tw
@@ -85,6 +86,10 @@ public:
 	void prefixLines(const QString &prefix);
 	void unPrefixLines(const QString &prefix);
 
+	// Symbols of the project (labels, citations, etc.) offered for completion
+	// in addition to the ones from the completion files
+	void setSymbolIndex(const Tw::Document::SymbolIndex * index) { symbolIndex = index; }
+
 public slots:
 	void setAutoIndentMode(int index);
 	void setSmartQuotesMode(int index);
@@ -143,6 +148,7 @@ private:
 	void loadCompletionFiles(QCompleter *theCompleter);
 
 	bool handleCompletionShortcut(QKeyEvent *e);
+	bool startSymbolCompletion(const QKeySequence & seq, const bool includeMacros);
 	void handleReturn(QKeyEvent *e);
 	void handleBackspace(QKeyEvent *e);
 	void handleTab(QKeyEvent * e);
@@ -207,6 +213,9 @@ private:
 
 	QTextCursor	currentCompletionRange;
 
+	const Tw::Document::SymbolIndex * symbolIndex{nullptr};
+	QCompleter * symbolCompleter{nullptr};
+
 	Tw::UI::LineNumberWidget * lineNumberArea;
 
 	static QTextCharFormat	*currentCompletionFormat;
@@ -1,6 +1,6 @@
 /*
 	This is part of TeXworks, an environment for working with TeX documents
-	Copyright (C) 2007-2023  Stefan Löffler
+	Copyright (C) 2007-2025  Stefan Löffler
 
 	This program is free software; you can redistribute it and/or modify
 	it under the terms of the GNU General Public License as published by
@@ -36,6 +36,10 @@ const bool kDefault_WrapLines = true;
 const int kDefault_TabWidth = 32;
 const int kDefault_LineSpacing = 100;
 const int kDefault_HideConsole = 1;
+// 0 = keep all lines of console output
+const int kDefault_ConsoleMaxLines = 0;
+// 0 = automatic, i.e., depending on the number of processor cores
+const int kDefault_MaxTypesettingJobs = 0;
 const bool kDefault_HighlightCurrentLine = true;
 const int kDefault_CursorWidth = 1;
 const bool kDefault_AutocompleteEnabled = true;
@@ -45,6 +49,7 @@ const bool kDefault_AllowScriptFileWriting = false;
 const bool kDefault_EnableScriptingPlugins = false;
 const bool kDefault_AllowSystemCommands = false;
 const bool kDefault_ScriptDebugger = false;
-const int kDefault_PDFPageCacheSizeMiB = 256;
+// 0 = automatic, i.e., depending on the amount of physical memory
+const int kDefault_PDFPageCacheSizeMiB = 0;
 
 #endif // !defined(DefaultPrefs_H)
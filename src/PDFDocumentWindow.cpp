@@ -53,6 +53,7 @@
 #include <QToolTip>
 #include <QUrl>
 #include <QVector>
+#include <QtConcurrent>
 #include <cmath>
 
 
@@ -156,6 +157,7 @@ void PDFDocumentWindow::init()
 	connect(pdfWidget, &QtPDF::PDFDocumentWidget::changedPage, this, &PDFDocumentWindow::updateStatusBar);
 	connect(pdfWidget, &QtPDF::PDFDocumentWidget::changedZoom, this, &PDFDocumentWindow::updateStatusBar);
 	connect(pdfWidget, &QtPDF::PDFDocumentWidget::changedDocument, this, &PDFDocumentWindow::changedDocument);
+	connect(&_syncDataWatcher, &QFutureWatcher< QSharedPointer<TWSyncTeXSynchronizer> >::finished, this, &PDFDocumentWindow::syncDataLoaded);
 	// NB: Using a queued connection ensures the signal has to pass through the
 	// event loop. If searching effectively blocks the GUI for a while (e.g., by
 	// spawning too many threads), this ensures that the highlighting processing
@@ -544,20 +546,42 @@ void PDFDocumentWindow::reload()
 
 void PDFDocumentWindow::loadSyncData()
 {
-	_synchronizer = std::unique_ptr<TWSyncTeXSynchronizer>(new TWSyncTeXSynchronizer(curFile, [](const QString & filename) {
-			const TeXDocumentWindow * win = TeXDocumentWindow::openDocument(filename, false, false);
-			return (win ? win->textDoc() : nullptr);
-		}, [](const QString & filename) {
-			PDFDocumentWindow * pdfWin = PDFDocumentWindow::findDocument(filename);
-			return (pdfWin && pdfWin->widget() ? pdfWin->widget()->document().toStrongRef() : QSharedPointer<QtPDF::Backend::Document>());
-		}
-	));
+	// The old data does not match the reloaded file anymore
+	_synchronizer.reset();
+	// NB: Setting a new future discards the result of one that is still
+	// running (e.g., if the file changed again in the meantime)
+	const QString pdfFile = curFile;
+	_loadingSyncData = true;
+	_syncDataWatcher.setFuture(QtConcurrent::run([pdfFile]() {
+		return QSharedPointer<TWSyncTeXSynchronizer>(new TWSyncTeXSynchronizer(pdfFile, [](const QString & filename) {
+				const TeXDocumentWindow * win = TeXDocumentWindow::openDocument(filename, false, false);
+				return (win ? win->textDoc() : nullptr);
+			}, [](const QString & filename) {
+				PDFDocumentWindow * pdfWin = PDFDocumentWindow::findDocument(filename);
+				return (pdfWin && pdfWin->widget() ? pdfWin->widget()->document().toStrongRef() : QSharedPointer<QtPDF::Backend::Document>());
+			}
+		));
+	}));
+}
+
+void PDFDocumentWindow::syncDataLoaded()
+{
+	_synchronizer = _syncDataWatcher.result();
+	_loadingSyncData = false;
 	if (!_synchronizer)
 		statusBar()->showMessage(tr("Error initializing SyncTeX"), kStatusMessageDuration);
 	else if (!_synchronizer->isValid())
 		statusBar()->showMessage(tr("No SyncTeX data available"), kStatusMessageDuration);
 	else
 		statusBar()->showMessage(tr("SyncTeX: \"%1\"").arg(_synchronizer->syncTeXFilename()), kStatusMessageDuration);
+	// getMainSourceFilename() may use the SyncTeX data
+	updateTypesettingAction();
+
+	if (_pendingSync) {
+		const std::function<void()> pendingSync = _pendingSync;
+		_pendingSync = nullptr;
+		pendingSync();
+	}
 }
 
 void PDFDocumentWindow::syncClick(size_type pageIndex, const QPointF& pos)
@@ -581,8 +605,11 @@ void PDFDocumentWindow::syncClick(size_type pageIndex, const QPointF& pos)
 
 void PDFDocumentWindow::syncRange(const size_type pageIndex, const QPointF & start, const QPointF & end, const TWSynchronizer::Resolution resolution)
 {
-	if (!_synchronizer)
+	if (!_synchronizer) {
+		if (_loadingSyncData)
+			_pendingSync = [this, pageIndex, start, end, resolution]() { syncRange(pageIndex, start, end, resolution); };
 		return;
+	}
 
 	clearSyncHighlight();
 
@@ -668,8 +695,13 @@ void PDFDocumentWindow::syncRange(const size_type pageIndex, const QPointF & sta
 
 void PDFDocumentWindow::syncFromSource(const QString& sourceFile, int lineNo, int col, bool activatePreview)
 {
-	if (!_synchronizer)
+	if (!_synchronizer) {
+		// The SyncTeX data may still be loading (e.g., right after the pdf was
+		// opened or reloaded); if so, sync once it is available
+		if (_loadingSyncData)
+			_pendingSync = [this, sourceFile, lineNo, col, activatePreview]() { syncFromSource(sourceFile, lineNo, col, activatePreview); };
 		return;
+	}
 
 	Tw::Settings settings;
 	TWSynchronizer::Resolution res{TWSynchronizer::kDefault_Resolution_ToPDF};
@@ -32,12 +32,16 @@
 
 #include <QButtonGroup>
 #include <QCursor>
+#include <QFutureWatcher>
 #include <QImage>
 #include <QList>
 #include <QMouseEvent>
 #include <QPainterPath>
+#include <QSharedPointer>
 #include <QTimer>
 
+#include <functional>
+
 
 const int kDefault_MagnifierSize = 2;
 const bool kDefault_CircularMagnifier = true;
@@ -126,6 +130,7 @@ private slots:
 	void syncClick(PDFDocumentWindow::size_type page, const QPointF& pos);
 	void syncRange(const PDFDocumentWindow::size_type pageIndex, const QPointF & start, const QPointF & end, const TWSynchronizer::Resolution resolution);
 	void invalidateSyncHighlight();
+	void syncDataLoaded();
 	void scaleLabelClick(QMouseEvent * event) { showScaleContextMenu(event->pos()); }
 	void showScaleContextMenu(const QPoint pos);
 	void setScaleFromContextMenu(const QString & strZoom);
@@ -180,7 +185,14 @@ private:
 
 	static QList<PDFDocumentWindow*> docList;
 
-	std::unique_ptr<TWSyncTeXSynchronizer> _synchronizer;
+	QSharedPointer<TWSyncTeXSynchronizer> _synchronizer;
+	// Parsing the SyncTeX data can take a while for large documents, so it is
+	// done in the background (see loadSyncData())
+	QFutureWatcher< QSharedPointer<TWSyncTeXSynchronizer> > _syncDataWatcher;
+	bool _loadingSyncData{false};
+	// The last sync requested while the SyncTeX data was still loading; it is
+	// carried out in syncDataLoaded()
+	std::function<void()> _pendingSync;
 };
 
 #endif
@@ -66,6 +66,8 @@ void PrefsDialog::init()
 	connect(toolRemove, &QToolButton::clicked, this, &PrefsDialog::removeTool);
 	connect(toolEdit, &QToolButton::clicked, this, [=]() { this->editTool(); });
 
+	connect(pdfPageCacheSizeAuto, &QCheckBox::toggled, pdfPageCacheSizeMiB, &QSpinBox::setDisabled);
+
 	connect(tabWidget, &QTabWidget::currentChanged, this, &PrefsDialog::changedTabPanel);
 
 	pathsChanged = toolsChanged = false;
@@ -372,7 +374,7 @@ void PrefsDialog::restoreDefaults()
 
 			resolution->setDpi(QApplication::screens().first()->physicalDotsPerInch());
 
-			pdfPageCacheSizeMiB->setValue(kDefault_PDFPageCacheSizeMiB);
+			setPDFPageCacheSize(kDefault_PDFPageCacheSizeMiB);
 
 			switch (TWSynchronizer::kDefault_Resolution_ToTeX) {
 				case TWSynchronizer::CharacterResolution:
@@ -417,6 +419,7 @@ void PrefsDialog::restoreDefaults()
 			TWApp::instance()->setDefaultPaths();
 			initPathAndToolLists();
 			autoHideOutput->setCurrentIndex(kDefault_HideConsole);
+			consoleMaxLines->setValue(kDefault_ConsoleMaxLines);
 			pathsChanged = true;
 			toolsChanged = true;
 			break;
@@ -452,6 +455,18 @@ void PrefsDialog::initPathAndToolLists()
 	updateToolButtons();
 }
 
+void PrefsDialog::setPDFPageCacheSize(const int sizeMiB)
+{
+	const bool automatic = (sizeMiB <= 0);
+	pdfPageCacheSizeAuto->setChecked(automatic);
+	pdfPageCacheSizeMiB->setEnabled(!automatic);
+	// Show the size that is actually used (the automatic one, or the
+	// requested one raised to the minimum; see PDFPageCache::setMaxCost())
+	const qint64 MiB = 1024 * 1024;
+	const qint64 size = (automatic ? QtPDF::Backend::PDFPageCache::defaultMaxCost() / MiB : sizeMiB);
+	pdfPageCacheSizeMiB->setValue(static_cast<int>(qBound(static_cast<qint64>(pdfPageCacheSizeMiB->minimum()), size, static_cast<qint64>(pdfPageCacheSizeMiB->maximum()))));
+}
+
 const int kSystemLocaleIndex = 0;
 const int kEnglishLocaleIndex = 1;
 
@@ -641,7 +656,7 @@ QDialog::DialogCode PrefsDialog::doPrefsDialog(QWidget *parent)
 	dlg.resolution->setDpi(oldResolution);
 
 	const int oldPDFPageCacheSize = settings.value(QStringLiteral("pdfPageCacheSizeMiB"), kDefault_PDFPageCacheSizeMiB).toInt();
-	dlg.pdfPageCacheSizeMiB->setValue(oldPDFPageCacheSize);
+	dlg.setPDFPageCacheSize(oldPDFPageCacheSize);
 
 	int oldSyncToTeX = settings.value(QString::fromLatin1("syncResolutionToTeX"), TWSynchronizer::kDefault_Resolution_ToTeX).toInt();
 	dlg.cbSyncToTeX->setCurrentIndex(oldSyncToTeX);
@@ -671,6 +686,7 @@ QDialog::DialogCode PrefsDialog::doPrefsDialog(QWidget *parent)
 	if (hideConsoleSetting.toString() == QLatin1String("true") || hideConsoleSetting.toString() == QLatin1String("false"))
 		hideConsoleSetting = (hideConsoleSetting.toBool() ? kDefault_HideConsole : 0);
 	dlg.autoHideOutput->setCurrentIndex(hideConsoleSetting.toInt());
+	dlg.consoleMaxLines->setValue(settings.value(QStringLiteral("consoleMaxLines"), kDefault_ConsoleMaxLines).toInt());
 
 	// Scripts
 	dlg.allowScriptFileReading->setChecked(settings.value(QString::fromLatin1("allowScriptFileReading"), kDefault_AllowScriptFileReading).toBool());
@@ -831,9 +847,10 @@ QDialog::DialogCode PrefsDialog::doPrefsDialog(QWidget *parent)
 			}
 		}
 
-		const int pdfPageCacheSize = dlg.pdfPageCacheSizeMiB->value();
+		// NB: 0 selects the automatic size (see PDFPageCache::setMaxCost())
+		const int pdfPageCacheSize = (dlg.pdfPageCacheSizeAuto->isChecked() ? 0 : dlg.pdfPageCacheSizeMiB->value());
 		settings.setValue(QStringLiteral("pdfPageCacheSizeMiB"), pdfPageCacheSize);
-		QtPDF::Backend::Document::pageCache().setMaxCost(pdfPageCacheSize * 1024 * 1024);
+		QtPDF::Backend::Document::pageCache().setMaxCost(static_cast<qint64>(pdfPageCacheSize) * 1024 * 1024);
 
 		int syncToTeX = dlg.cbSyncToTeX->currentIndex();
 		if (syncToTeX != oldSyncToTeX)
@@ -870,6 +887,7 @@ QDialog::DialogCode PrefsDialog::doPrefsDialog(QWidget *parent)
 			TWApp::instance()->setEngineList(dlg.engineList);
 		TWApp::instance()->setDefaultEngine(dlg.defaultTool->currentText());
 		settings.setValue(QString::fromLatin1("autoHideConsole"), dlg.autoHideOutput->currentIndex());
+		settings.setValue(QStringLiteral("consoleMaxLines"), dlg.consoleMaxLines->value());
 
 		// Scripts
 		settings.setValue(QString::fromLatin1("allowScriptFileReading"), dlg.allowScriptFileReading->isChecked());
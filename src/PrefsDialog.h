@@ -63,6 +63,9 @@ private:
 	void restoreDefaults();
 	void refreshDefaultTool();
 	void initPathAndToolLists();
+	// Shows the render cache size `sizeMiB`; values <= 0 stand for the
+	// automatic size
+	void setPDFPageCacheSize(const int sizeMiB);
 
 	QList<Engine> engineList;
 
@@ -176,7 +176,11 @@ void TWApp::init()
 	if (!defaultCodec)
 		defaultCodec = QTextCodec::codecForName("UTF-8");
 
-	QtPDF::Backend::Document::pageCache().setMaxCost(settings.value(QStringLiteral("pdfPageCacheSizeMiB"), kDefault_PDFPageCacheSizeMiB).toInt() * 1024 * 1024);
+	QtPDF::Backend::Document::pageCache().setMaxCost(static_cast<qint64>(settings.value(QStringLiteral("pdfPageCacheSizeMiB"), kDefault_PDFPageCacheSizeMiB).toInt()) * 1024 * 1024);
+
+	const int maxTypesettingJobs = settings.value(QStringLiteral("maxTypesettingJobs"), kDefault_MaxTypesettingJobs).toInt();
+	if (maxTypesettingJobs > 0)
+		m_typesetManager.setMaxConcurrentJobs(maxTypesettingJobs);
 
 	TWUtils::readConfig();
 
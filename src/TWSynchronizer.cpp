@@ -43,6 +43,18 @@ TWSyncTeXSynchronizer::TWSyncTeXSynchronizer(const QString & filename, TeXLoader
   , m_TeXLoader(texLoader)
   , m_PDFLoader(pdfLoader)
 {
+  if (!_scanner)
+    return;
+  const QDir curDir(QFileInfo(pdfFilename()).canonicalPath());
+  for (SyncTeX::synctex_node_p node = SyncTeX::synctex_scanner_input(_scanner); node; node = SyncTeX::synctex_node_sibling(node)) {
+    const char * name = SyncTeX::synctex_scanner_get_name(_scanner, SyncTeX::synctex_node_tag(node));
+    if (!name)
+      continue;
+    const QString path = QFileInfo(curDir, QString::fromLocal8Bit(name)).canonicalFilePath();
+    // Keep the first name if several refer to the same file
+    if (!path.isEmpty() && !m_inputNames.contains(path))
+      m_inputNames.insert(path, QByteArray(name));
+  }
 }
 
 TWSyncTeXSynchronizer::~TWSyncTeXSynchronizer()
@@ -77,28 +89,15 @@ TWSynchronizer::PDFSyncPoint TWSyncTeXSynchronizer::syncFromTeX(const TWSynchron
   PDFSyncPoint retVal;
   retVal.page = -1;
 
-  // Find the name SyncTeX is using for this source file...
-  const QFileInfo sourceFileInfo(src.filename);
-  QDir curDir(QFileInfo(pdfFilename()).canonicalPath());
-  SyncTeX::synctex_node_p node = SyncTeX::synctex_scanner_input(_scanner);
-  QString name;
-  bool found = false;
-  while (node) {
-    name = QString::fromLocal8Bit(SyncTeX::synctex_scanner_get_name(_scanner, SyncTeX::synctex_node_tag(node)));
-    const QFileInfo fi(curDir, name);
-    if (fi == sourceFileInfo) {
-      found = true;
-      break;
-    }
-    node = synctex_node_sibling(node);
-  }
-  if (!found)
+  const QByteArray name = _syncTeXName(src.filename);
+  if (name.isEmpty())
     return retVal;
 
   retVal.filename = pdfFilename();
 
-  if (SyncTeX::synctex_display_query(_scanner, name.toLocal8Bit().data(), src.line, static_cast<column_type>(src.col), -1) > 0) {
-	while ((node = SyncTeX::synctex_scanner_next_result(_scanner))) {
+  if (SyncTeX::synctex_display_query(_scanner, name.constData(), src.line, static_cast<column_type>(src.col), -1) > 0) {
+    SyncTeX::synctex_node_p node{nullptr};
+    while ((node = SyncTeX::synctex_scanner_next_result(_scanner))) {
       if (retVal.page < 0)
         retVal.page = SyncTeX::synctex_node_page(node);
       if (SyncTeX::synctex_node_page(node) != retVal.page)
@@ -313,6 +312,30 @@ void TWSyncTeXSynchronizer::_syncFromPDFFine(const TWSynchronizer::PDFSyncPoint
   }
 }
 
+QByteArray TWSyncTeXSynchronizer::_syncTeXName(const QString & filename) const
+{
+  if (!_scanner)
+    return QByteArray();
+
+  const QFileInfo sourceFileInfo(filename);
+  const QString path = sourceFileInfo.canonicalFilePath();
+  if (!path.isEmpty()) {
+    const auto it = m_inputNames.constFind(path);
+    if (it != m_inputNames.constEnd())
+      return it.value();
+  }
+
+  // Fall back to comparing with all input files in case the paths differ
+  // only in ways QFileInfo considers equal (e.g., case on some systems)
+  const QDir curDir(QFileInfo(pdfFilename()).canonicalPath());
+  for (SyncTeX::synctex_node_p node = SyncTeX::synctex_scanner_input(_scanner); node; node = SyncTeX::synctex_node_sibling(node)) {
+    const char * name = SyncTeX::synctex_scanner_get_name(_scanner, SyncTeX::synctex_node_tag(node));
+    if (name && QFileInfo(curDir, QString::fromLocal8Bit(name)) == sourceFileInfo)
+      return QByteArray(name);
+  }
+  return QByteArray();
+}
+
 // static
 QString::size_type TWSyncTeXSynchronizer::_findCorrespondingPosition(const QString & srcContext, const QString & destContext, const QString::size_type col, bool & unique)
 {
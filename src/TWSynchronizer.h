@@ -25,6 +25,8 @@
 #include "document/TeXDocument.h"
 #include "../modules/QtPDF/src/PDFBackend.h"
 
+#include <QByteArray>
+#include <QHash>
 #include <QList>
 #include <QRectF>
 #include <QString>
@@ -106,7 +108,14 @@ protected:
 
   static QString::size_type _findCorrespondingPosition(const QString & srcContext, const QString & destContext, const QString::size_type col, bool & unique);
 
+  // Returns the name SyncTeX uses for the source file `filename` (or an empty
+  // array if the file is not part of the SyncTeX data)
+  QByteArray _syncTeXName(const QString & filename) const;
+
   SyncTeX::synctex_scanner_p _scanner;
+  // Maps the canonical paths of all input files to the names SyncTeX uses for
+  // them; built once when loading so lookups don't have to resolve all names
+  QHash<QString, QByteArray> m_inputNames;
   TeXLoader m_TeXLoader;
   PDFLoader m_PDFLoader;
 };
@@ -62,8 +62,12 @@ void TagsDock::fillInfo()
 	disconnect(tree, &QTreeWidget::itemActivated, this, &TagsDock::followTagSelection);
 	disconnect(tree, &QTreeWidget::itemClicked, this, &TagsDock::followTagSelection);
 	tree->clear();
+	tagItems.clear();
+	tagLevels.clear();
 	const QList<Tw::Document::TextDocument::Tag> & tags = document->textDoc()->getTags();
 	if (!tags.empty()) {
+		tagItems.reserve(tags.size());
+		tagLevels.reserve(tags.size());
 		QTreeWidgetItem *item = nullptr, *bmItem = nullptr;
 		QTreeWidgetItem *bookmarks = new QTreeWidgetItem(tree);
 		bookmarks->setText(0, tr("Bookmarks"));
@@ -81,6 +85,7 @@ void TagsDock::fillInfo()
 				bmItem = new QTreeWidgetItem(bookmarks, QTreeWidgetItem::UserType);
 				bmItem->setText(0, bm.text);
 				bmItem->setText(1, QString::number(index));
+				tagItems.append(bmItem);
 			}
 			else  {
 				while (item && item->type() >= QTreeWidgetItem::UserType + static_cast<int>(bm.level))
@@ -92,7 +97,9 @@ void TagsDock::fillInfo()
 				item->setText(0, bm.text);
 				item->setText(1, QString::number(index));
 				tree->expandItem(item);
+				tagItems.append(item);
 			}
+			tagLevels.append(bm.level);
 		}
 		if (bookmarks->childCount() == 0)
 			bookmarks->setHidden(true);
@@ -115,11 +122,35 @@ void TagsDock::fillInfo()
 
 void TagsDock::listChanged()
 {
+	// Most changes (e.g., while typing) leave the tags as they were, so avoid
+	// rebuilding the tree if possible
+	if (filled && document && updateTagItems())
+		return;
 	saveScrollValue = tree->verticalScrollBar()->value();
 	tree->clear();
+	tagItems.clear();
+	tagLevels.clear();
 	filled = false;
-	if (document && isVisible())
+	if (document && isVisible()) {
 		fillInfo();
+		filled = true;
+	}
+}
+
+bool TagsDock::updateTagItems()
+{
+	const QList<Tw::Document::TextDocument::Tag> & tags = document->textDoc()->getTags();
+	if (tags.size() != tagItems.size())
+		return false;
+	for (int index = 0; index < tags.size(); ++index) {
+		if (tags[index].level != tagLevels[index])
+			return false;
+	}
+	for (int index = 0; index < tags.size(); ++index) {
+		if (tagItems[index]->text(0) != tags[index].text)
+			tagItems[index]->setText(0, tags[index].text);
+	}
+	return true;
 }
 
 void TagsDock::followTagSelection()
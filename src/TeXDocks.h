@@ -26,6 +26,7 @@
 #include <QListWidget>
 #include <QScrollArea>
 #include <QTreeWidget>
+#include <QVector>
 
 class TeXDocumentWindow;
 class QListWidget;
@@ -70,8 +71,16 @@ private slots:
 	void followTagSelection();
 
 private:
+	// Updates the existing items if the structure of the tags is unchanged
+	// (e.g., after editing the text of a heading or anything outside of tags);
+	// returns false if the tree needs to be rebuilt
+	bool updateTagItems();
+
 	QTreeWidget *tree;
 	int saveScrollValue;
+	// The items corresponding to the tags (and their levels) as shown in tree
+	QVector<QTreeWidgetItem*> tagItems;
+	QVector<unsigned int> tagLevels;
 };
 
 class TeXDockTreeWidget : public QTreeWidget
@@ -34,6 +34,7 @@
 #include "TeXHighlighter.h"
 #include "TemplateDialog.h"
 #include "scripting/ScriptAPI.h"
+#include "document/ProjectIndexer.h"
 #include "document/SpellChecker.h"
 #include "document/SpellCheckManager.h"
 #include "ui/ClickableLabel.h"
@@ -119,6 +120,8 @@ void TeXDocumentWindow::init()
 
 	setupUi(this);
 	editor()->setDocument(textDoc());
+	projectIndexer = new Tw::Document::ProjectIndexer(textDoc());
+	textEdit->setSymbolIndex(&projectIndexer->index());
 
 	setAttribute(Qt::WA_DeleteOnClose, true);
 
@@ -226,6 +229,7 @@ void TeXDocumentWindow::init()
 	clipboardChanged();
 
 	connect(actionTypeset, &QAction::triggered, this, &TeXDocumentWindow::typeset);
+	connect(actionTypeset_All, &QAction::triggered, this, &TeXDocumentWindow::typesetAll);
 
 	updateRecentFileActions();
 	connect(TWApp::instance(), &TWApp::recentFileActionsChanged, this, &TeXDocumentWindow::updateRecentFileActions);
@@ -239,6 +243,12 @@ void TeXDocumentWindow::init()
 	connect(&(TWApp::instance()->typesetManager()), &Tw::Utils::TypesetManager::typesettingStopped, this, &TeXDocumentWindow::updateTypesettingAction);
 	connect(&(TWApp::instance()->typesetManager()), &Tw::Utils::TypesetManager::typesettingStarted, this, &TeXDocumentWindow::conditionallyEnableRemoveAuxFiles);
 	connect(&(TWApp::instance()->typesetManager()), &Tw::Utils::TypesetManager::typesettingStopped, this, &TeXDocumentWindow::conditionallyEnableRemoveAuxFiles);
+	// Pick up labels, citations, etc. from the .aux files, no matter which
+	// window of the project typeset it
+	connect(&(TWApp::instance()->typesetManager()), &Tw::Utils::TypesetManager::typesettingFinished, this, [this](const QString & rootFile) {
+		if (QDir::cleanPath(rootFile) == QDir::cleanPath(textDoc()->getRootFilePath()))
+			projectIndexer->rescan();
+	});
 
 	connect(actionStack, &QAction::triggered, TWApp::instance(), &TWApp::stackWindows);
 	connect(actionTile, &QAction::triggered, TWApp::instance(), &TWApp::tileWindows);
@@ -446,6 +456,10 @@ void TeXDocumentWindow::changeEvent(QEvent *event)
 		// so that future "Goto Source" actions point here.
 		if (this == QApplication::activeWindow() && pdfDoc)
 			pdfDoc->texActivated(this);
+		// Files of the project may have been saved from other windows in the
+		// meantime
+		if (this == QApplication::activeWindow() && projectIndexer)
+			projectIndexer->update();
 	}
 	QMainWindow::changeEvent(event);
 }
@@ -1525,6 +1539,9 @@ void TeXDocumentWindow::setCurrentFile(const QFileInfo & fileInfo)
 
 	conditionallyEnableRemoveAuxFiles();
 
+	// The files of the project may have changed along with the file name
+	projectIndexer->rescan();
+
 	TWApp::instance()->updateWindowMenus();
 }
 
@@ -2758,6 +2775,45 @@ void TeXDocumentWindow::typeset()
 		return;
 	}
 
+	Tw::Utils::TypesetManager & typesetManager = TWApp::instance()->typesetManager();
+	if (typesetManager.isFileQueued(rootFilePath)) {
+		statusBar()->showMessage(tr("%1 is already waiting to be processed").arg(rootFilePath), kStatusMessageDuration);
+		return;
+	}
+	// NB: If possible, the job is started right away (from within
+	// queueTypesetting())
+	// NB: The job must typeset the root file it was queued for, even if the
+	// root of this document changes in the meantime
+	if (!typesetManager.queueTypesetting(rootFilePath, this, [this, e, rootFilePath]() { startTypesetting(e, rootFilePath); })) {
+		statusBar()->showMessage(tr("%1 is already being processed").arg(rootFilePath), kStatusMessageDuration);
+		updateTypesettingAction();
+		return;
+	}
+	if (typesetManager.isFileQueued(rootFilePath))
+		statusBar()->showMessage(tr("%1 will be processed as soon as one of the running jobs has finished").arg(rootFilePath), kStatusMessageDuration);
+}
+
+// static
+void TeXDocumentWindow::typesetAll()
+{
+	// Typeset each root file only once (from the first window showing it)
+	QStringList rootFiles;
+	foreach (TeXDocumentWindow * window, docList) {
+		const QString rootFilePath = window->textDoc()->getRootFilePath();
+		if (window->untitled() || rootFilePath.isEmpty() || rootFiles.contains(rootFilePath))
+			continue;
+		rootFiles << rootFilePath;
+		if (!window->isTypesetting())
+			window->typeset();
+	}
+}
+
+void TeXDocumentWindow::startTypesetting(Engine e, const QString & rootFilePath)
+{
+	if (process)
+		return;
+
+	QFileInfo fileInfo(rootFilePath);
 	if (!TWApp::instance()->typesetManager().startTypesetting(rootFilePath, this)) {
 		statusBar()->showMessage(tr("%1 is already being processed").arg(rootFilePath), kStatusMessageDuration);
 		updateTypesettingAction();
@@ -2780,7 +2836,17 @@ void TeXDocumentWindow::typeset()
 	process = e.run(fileInfo, this);
 
 	if (process) {
+		Tw::Settings settings;
+		textEdit_console->setMaximumLineCount(settings.value(QStringLiteral("consoleMaxLines"), kDefault_ConsoleMaxLines).toInt());
 		textEdit_console->setProcess(process);
+		// Parse the output while it arrives so the diagnostics are available as
+		// soon as the process has finished
+		logParser.reset(rootFilePath);
+		const QDir rootDir = fileInfo.absoluteDir();
+		logParser.setFileExistsFunction([rootDir](const QString & path) {
+			return (QFileInfo(rootDir, path).exists() ? Tw::Utils::TeXLogParser::FileExistence::Exists : Tw::Utils::TeXLogParser::FileExistence::DoesNotExist);
+		});
+		connect(textEdit_console, &Tw::UI::ConsoleWidget::outputAppended, this, [&](const QString & output) { logParser.addOutput(output); });
 		if (consoleTabs->isHidden()) {
 			keepConsoleOpen = false;
 			showConsole();
@@ -2911,12 +2977,14 @@ void TeXDocumentWindow::conditionallyEnableRemoveAuxFiles()
 
 void TeXDocumentWindow::processError(QProcess::ProcessError /*error*/)
 {
+	textEdit_console->flushOutput();
 	if (userInterrupt)
 		textEdit_console->append(tr("Process interrupted by user"));
 	else
 		textEdit_console->append(process->errorString());
 	process->kill();
 	textEdit_console->setProcess(nullptr, false);
+	disconnect(textEdit_console, &Tw::UI::ConsoleWidget::outputAppended, this, nullptr);
 	process->deleteLater();
 	process = nullptr;
 	inputLine->hide();
@@ -2935,6 +3003,8 @@ void TeXDocumentWindow::processFinished(int exitCode, QProcess::ExitStatus exitS
 		pdfDoc->widget()->setWatchForDocumentChangesOnDisk(true);
 
 	textEdit_console->setProcess(nullptr, false);
+	disconnect(textEdit_console, &Tw::UI::ConsoleWidget::outputAppended, this, nullptr);
+	logParser.finish();
 
 	if (exitStatus != QProcess::CrashExit) {
 		QString pdfName;
@@ -2959,6 +3029,10 @@ void TeXDocumentWindow::processFinished(int exitCode, QProcess::ExitStatus exitS
 
 	executeAfterTypesetHooks();
 
+	const qint64 duration = TWApp::instance()->typesetManager().elapsedTime(textDoc()->getRootFilePath());
+	if (duration >= 0)
+		statusBar()->showMessage(tr("Typesetting finished after %1 s").arg(static_cast<double>(duration) / 1000, 0, 'f', 1), kStatusMessageDuration);
+
 	Tw::Settings settings;
 
 	bool shouldHideConsole = false;
@@ -2990,7 +3064,12 @@ void TeXDocumentWindow::processFinished(int exitCode, QProcess::ExitStatus exitS
 		process->deleteLater();
 	process = nullptr;
 
-	TWApp::instance()->typesetManager().stopTypesetting(this);
+	// Only runs that finished normally count as finished (e.g., for picking up
+	// the new .aux files)
+	if (exitStatus == QProcess::NormalExit)
+		TWApp::instance()->typesetManager().finishTypesetting(this);
+	else
+		TWApp::instance()->typesetManager().stopTypesetting(this);
 }
 
 void TeXDocumentWindow::executeAfterTypesetHooks()
@@ -3000,6 +3079,8 @@ void TeXDocumentWindow::executeAfterTypesetHooks()
 	for (int i = consoleTabs->count() - 1; i > 0; --i)
 		consoleTabs->removeTab(i);
 
+	showDiagnostics();
+
 	foreach (Tw::Scripting::ScriptObject *so, scriptManager->getHookScripts(QString::fromLatin1("AfterTypeset"))) {
 		QVariant result;
 		Tw::Scripting::ScriptAPI api(so, qApp, this, result);
@@ -3027,6 +3108,70 @@ void TeXDocumentWindow::executeAfterTypesetHooks()
 	}
 }
 
+void TeXDocumentWindow::showDiagnostics()
+{
+	using Severity = Tw::Utils::TeXLogParser::Severity;
+
+	const QVector<Tw::Utils::TeXLogParser::Diagnostic> & diagnostics = logParser.diagnostics();
+	if (diagnostics.isEmpty())
+		return;
+
+	const auto escapeHtml = [](QString str) {
+		str.replace(QChar::fromLatin1('&'), QStringLiteral("&amp;"));
+		str.replace(QChar::fromLatin1('<'), QStringLiteral("&lt;"));
+		str.replace(QChar::fromLatin1('>'), QStringLiteral("&gt;"));
+		str.replace(QStringLiteral("\n "), QStringLiteral("\n&nbsp;"));
+		str.replace(QStringLiteral("  "), QStringLiteral("&nbsp;&nbsp;"));
+		str.replace(QStringLiteral("&nbsp; "), QStringLiteral("&nbsp;&nbsp;"));
+		return str.replace(QChar::fromLatin1('\n'), QStringLiteral("<br />\n"));
+	};
+
+	// Indexed by Severity
+	const QStringList colors{QStringLiteral("#8080FF"), QStringLiteral("#F8F800"), QStringLiteral("#F80000"), QStringLiteral("#00F800")};
+	QVector<QString> rows(colors.size());
+	QVector<int> counts(colors.size(), 0);
+	for (const Tw::Utils::TeXLogParser::Diagnostic & d : diagnostics) {
+		const int severity = static_cast<int>(d.severity);
+		QString file = QStringLiteral("&#8212;");
+		if (!d.file.isNull()) {
+			QString href = QStringLiteral("texworks:") + QString::fromLatin1(QUrl::toPercentEncoding(d.file, "/\\:"));
+			if (d.line > 0)
+				href += QStringLiteral("#%1").arg(d.line);
+			file = QStringLiteral("<a href='%1'>%2</a>").arg(href, escapeHtml(d.file.mid(qMax(d.file.lastIndexOf(QChar::fromLatin1('/')), d.file.lastIndexOf(QChar::fromLatin1('\\'))) + 1)));
+		}
+		rows[severity] += QStringLiteral("<tr><td style=\"background-color: %1\"></td><td valign=\"top\">%2</td><td valign=\"top\">%3</td><td valign=\"top\">%4</td></tr>").arg(colors[severity], file, (d.line > 0 ? QString::number(d.line) : QString()), escapeHtml(d.description));
+		++counts[severity];
+	}
+
+	// List the most severe messages first (debug output from \show & co. is
+	// listed at the very top, though, as it was explicitly requested)
+	QString html = QStringLiteral("<html><body>");
+	html += tr("Errors: %1, Warnings: %2, Bad boxes: %3").arg(counts[static_cast<int>(Severity::Error)]).arg(counts[static_cast<int>(Severity::Warning)]).arg(counts[static_cast<int>(Severity::BadBox)]);
+	html += QStringLiteral("<hr/><table border='0' cellspacing='0' cellpadding='4'>");
+	for (const Severity severity : {Severity::Debug, Severity::Error, Severity::Warning, Severity::BadBox})
+		html += rows[static_cast<int>(severity)];
+	html += QStringLiteral("</table></body></html>");
+
+	QTextBrowser *browser = new QTextBrowser(this);
+	// Use console font (which is customizable)
+	browser->setFont(textEdit_console->font());
+	browser->setOpenLinks(false);
+	connect(browser, &QTextBrowser::anchorClicked, this, &TeXDocumentWindow::anchorClicked);
+	browser->setHtml(html);
+	browser->setTextInteractionFlags(Qt::LinksAccessibleByKeyboard | Qt::LinksAccessibleByMouse | Qt::TextBrowserInteraction | Qt::TextSelectableByKeyboard | Qt::TextSelectableByMouse);
+	consoleTabs->addTab(browser, tr("Errors, warnings, badboxes"));
+
+	// An incomplete .aux file from an aborted previous run typically makes TeX
+	// choke on the next run
+	for (const Tw::Utils::TeXLogParser::Diagnostic & d : diagnostics) {
+		if (!d.description.contains(QStringLiteral("File ended while scanning use of")))
+			continue;
+		if (QMessageBox::question(this, QString(), tr("While typesetting, a corrupt .aux file from a previous run was detected. You should remove it and rerun the typesetting process. Do you want to display the \"Remove Aux Files...\" dialog now?"), QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes)
+			removeAuxFiles();
+		break;
+	}
+}
+
 void TeXDocumentWindow::anchorClicked(const QUrl& url)
 {
 	if (url.scheme() == QString::fromLatin1("texworks")) {
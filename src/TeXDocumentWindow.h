@@ -27,6 +27,7 @@
 #include "TWScriptableWindow.h"
 #include "document/TeXDocument.h"
 #include "ui_TeXDocumentWindow.h"
+#include "utils/TeXLogParser.h"
 
 #include <QDateTime>
 #include <QList>
@@ -45,9 +46,13 @@ class QActionGroup;
 class QTextCodec;
 class QFileSystemWatcher;
 
+class Engine;
 class PDFDocumentWindow;
 
 namespace Tw {
+namespace Document {
+class ProjectIndexer;
+} // namespace Document
 namespace UI {
 class ClickableLabel;
 } // namespace UI
@@ -114,6 +119,9 @@ public:
 	void setModified(const bool m = true) { textEdit->document()->setModified(m); }
 
 	bool isTypesetting() const;
+	// Typesets all root files of open documents (as far as the number of
+	// concurrent jobs permits; the others are queued)
+	static void typesetAll();
 
 	qreal lineSpacing() const { return m_lineSpacing; }
 
@@ -245,7 +253,11 @@ private:
 						 QTextDocument::FindFlags flags, int rangeStart, int rangeEnd);
 	int doReplaceAll(const QString& searchText, QRegularExpression* regex, const QString& replacement,
 						QTextDocument::FindFlags flags, int rangeStart = -1, int rangeEnd = -1);
+	// Starts typesetting `rootFilePath` (as determined when the job was
+	// queued) with `e`
+	void startTypesetting(Engine e, const QString & rootFilePath);
 	void executeAfterTypesetHooks();
+	void showDiagnostics();
 	void showConsole();
 	void hideConsole();
 	void updateTypesettingAction();
@@ -257,11 +269,13 @@ private:
 	void showEncodingSetting();
 
 	QString selectedText() { return textCursor().selectedText().replace(QChar(QChar::ParagraphSeparator), QChar::fromLatin1('\n')); }
-	QString consoleText() { return textEdit_console->toPlainText(); }
+	QString consoleText() { return textEdit_console->transcript(); }
 	QString text() { return textEdit->text(); }
 
 	Tw::Document::TeXDocument * _texDoc;
 	PDFDocumentWindow * pdfDoc{nullptr};
+	// Labels, citations, etc. of the project for completion
+	Tw::Document::ProjectIndexer * projectIndexer{nullptr};
 
 	QTextCodec * codec{nullptr};
 	// When using the UTF-8 codec, byte order marks (BOMs) are ignored during
@@ -287,6 +301,8 @@ private:
 	bool showPdfWhenFinished{true};
 	bool userInterrupt{false};
 	QDateTime oldPdfTime;
+	// Parses the console output while the typesetting process is running
+	Tw::Utils::TeXLogParser logParser;
 
 	QList<QAction*> recentFileActions;
 
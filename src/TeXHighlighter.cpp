@@ -26,10 +26,12 @@
 
 #include <QTextCursor>
 #include <QTime>
+#include <QtConcurrent>
 #include <climits> // for INT_MAX
 
 QList<TeXHighlighter::HighlightingSpec> *TeXHighlighter::syntaxRules = nullptr;
 QList<TeXHighlighter::TagPattern> *TeXHighlighter::tagPatterns = nullptr;
+Tw::Utils::PatternSet *TeXHighlighter::tagPatternSet = nullptr;
 
 TeXHighlighter::TeXHighlighter(Tw::Document::TeXDocument * parent)
 	: NonblockingSyntaxHighlighter(parent)
@@ -46,6 +48,19 @@ TeXHighlighter::TeXHighlighter(Tw::Document::TeXDocument * parent)
 	spellFormat.setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
 #endif
 	spellFormat.setUnderlineColor(Qt::red);
+
+	// Collect the words of all blocks highlighted in one go before checking
+	_spellCheckTimer.setSingleShot(true);
+	_spellCheckTimer.setInterval(0);
+	connect(&_spellCheckTimer, &QTimer::timeout, this, &TeXHighlighter::startSpellCheck);
+	connect(&_spellCheckWatcher, &QFutureWatcher<void>::finished, this, &TeXHighlighter::spellCheckFinished);
+
+	_applyTimer.setSingleShot(true);
+	_applyTimer.setInterval(0);
+	connect(&_applyTimer, &QTimer::timeout, this, &TeXHighlighter::process);
+	connect(&_tokenizeWatcher, &QFutureWatcher<QVector<TokenizedBlock>>::finished, this, &TeXHighlighter::tokenizingFinished);
+	if (parent)
+		connect(parent, &QTextDocument::contentsChange, this, &TeXHighlighter::discardTokenizedBlocks);
 }
 
 void TeXHighlighter::spellCheckRange(const QString &text, QString::size_type index, QString::size_type limit, const QTextCharFormat &spellFormat)
@@ -58,104 +73,317 @@ void TeXHighlighter::spellCheckRange(const QString &text, QString::size_type ind
 			if (end > limit)
 				end = limit;
 			if (start < end) {
-				if (!_spellChecker.isWordCorrect(text.mid(start, end - start)))
-					setFormat(start, end - start, spellFormat);
+				const QString word = text.mid(start, end - start);
+				switch (_spellChecker.cachedVerdict(word)) {
+					case Tw::Document::SpellChecker::Verdict::Incorrect:
+						setFormat(start, end - start, spellFormat);
+						break;
+					case Tw::Document::SpellChecker::Verdict::Correct:
+						break;
+					case Tw::Document::SpellChecker::Verdict::Unknown:
+						_wordsToCheck.insert(word);
+						if (_blocksAwaitingSpellCheck.isEmpty() || _blocksAwaitingSpellCheck.last() != currentBlock())
+							_blocksAwaitingSpellCheck.append(currentBlock());
+						if (!_spellCheckWatcher.isRunning() && !_spellCheckTimer.isActive())
+							_spellCheckTimer.start();
+						break;
+				}
 			}
 		}
 		index = end;
 	}
 }
 
-void TeXHighlighter::highlightBlock(const QString &text)
+// Upper bound on the number of characters tokenized in one batch; smaller
+// batches are colored sooner, larger batches cause less overhead
+static const int kMaxTokenizeChars = 1 << 17;
+
+// static
+TeXHighlighter::BlockTokens TeXHighlighter::tokenize(const QString & text, const int highlightIndex, const bool tagging)
 {
-	QString::size_type charPos = 0;
+	// NB: This is run on worker threads; the patterns are not modified once
+	// they have been loaded, and QRegularExpression can be used from several
+	// threads concurrently
+	BlockTokens tokens;
 	if (highlightIndex >= 0 && highlightIndex < syntaxRules->count()) {
-		QList<HighlightingRule>& highlightingRules = (*syntaxRules)[highlightIndex].rules;
+		const HighlightingSpec & spec = syntaxRules->at(highlightIndex);
+		QString::size_type charPos = 0;
 		// Go through the whole text...
 		while (charPos < text.length()) {
 			// ... and find the highlight pattern that matches closest to the
 			// current character index
-			QString::size_type firstIndex{std::numeric_limits<QString::size_type>::max()}, len{0};
-			const HighlightingRule* firstRule = nullptr;
-			QRegularExpressionMatch firstMatch;
-			for (int i = 0; i < highlightingRules.size(); ++i) {
-				HighlightingRule &rule = highlightingRules[i];
-				QRegularExpressionMatch m = rule.pattern.match(text, charPos);
-				if (m.capturedStart() >= 0 && m.capturedStart() < firstIndex) {
-					firstIndex = m.capturedStart();
-					firstMatch = m;
-					firstRule = &rule;
-				}
-			}
-			// If we found a rule, apply it and advance the character index to
+			const Tw::Utils::PatternSet::Match match = spec.patterns.match(text, charPos);
+			// If we found a rule, record it and advance the character index to
 			// the end of the highlighted range
-			if (firstRule && firstMatch.hasMatch() && (len = firstMatch.capturedLength()) > 0) {
-				if (_spellChecker && firstIndex > charPos)
-					spellCheckRange(text, charPos, firstIndex, spellFormat);
-				setFormat(firstIndex, len, firstRule->format);
-				charPos = firstIndex + len;
-				if (_spellChecker && firstRule->spellCheck)
-					spellCheckRange(text, firstIndex, charPos, firstRule->spellFormat);
+			if (match.index >= 0 && match.length > 0) {
+				tokens.formats.append(Token{match.start, match.length, match.index});
+				charPos = match.start + match.length;
 			}
 			// If no rule matched, we can break out of the loop
 			else
 				break;
 		}
 	}
+	if (tagging) {
+		QString::size_type index = 0;
+		while (index < text.length()) {
+			const Tw::Utils::PatternSet::Match match = tagPatternSet->match(text, index);
+			if (match.index >= 0 && match.length > 0) {
+				QString tagText = match.captured1;
+				if (tagText.isEmpty())
+					tagText = text.mid(match.start, match.length);
+				tokens.tags.append(TagToken{match.start, match.length, match.index, tagText});
+				index = match.start + match.length;
+			}
+			else
+				break;
+		}
+	}
+	return tokens;
+}
+
+void TeXHighlighter::applyTokens(const QString & text, const BlockTokens & tokens)
+{
+	QString::size_type charPos = 0;
+	if (highlightIndex >= 0 && highlightIndex < syntaxRules->count()) {
+		const HighlightingSpec & spec = (*syntaxRules)[highlightIndex];
+		for (const Token & token : tokens.formats) {
+			if (token.index < 0 || token.index >= spec.rules.size())
+				continue;
+			const HighlightingRule & rule = spec.rules[token.index];
+			if (_spellChecker && token.start > charPos)
+				spellCheckRange(text, charPos, token.start, spellFormat);
+			setFormat(token.start, token.length, rule.format);
+			charPos = token.start + token.length;
+			if (_spellChecker && rule.spellCheck)
+				spellCheckRange(text, token.start, charPos, rule.spellFormat);
+		}
+	}
 	if (_spellChecker)
 		spellCheckRange(text, charPos, text.length(), spellFormat);
 
 	if (texDoc) {
 		texDoc->removeTags(currentBlock().position(), currentBlock().length());
-		if (isTagging) {
-			QString::size_type index = 0;
-			while (index < text.length()) {
-				QString::size_type firstIndex{std::numeric_limits<QString::size_type>::max()}, len{0};
-				TagPattern* firstPatt = nullptr;
-				QRegularExpressionMatch firstMatch;
-				for (int i = 0; i < tagPatterns->count(); ++i) {
-					TagPattern& patt = (*tagPatterns)[i];
-					QRegularExpressionMatch m = patt.pattern.match(text, index);
-					if (m.capturedStart() >= 0 && m.capturedStart() < firstIndex) {
-						firstIndex = m.capturedStart();
-						firstMatch = m;
-						firstPatt = &patt;
-					}
-				}
-				if (firstPatt && firstMatch.hasMatch() && (len = firstMatch.capturedLength()) > 0) {
-					QTextCursor	cursor(document());
-					using pos_type = decltype(cursor.position());
-					cursor.setPosition(currentBlock().position() + static_cast<pos_type>(firstIndex));
-					cursor.setPosition(currentBlock().position() + static_cast<pos_type>(firstIndex + len), QTextCursor::KeepAnchor);
-					QString tagText = firstMatch.captured(1);
-					if (tagText.isEmpty())
-						tagText = firstMatch.captured(0);
-					texDoc->addTag(cursor, firstPatt->level, tagText);
-					index = firstIndex + len;
-				}
-				else
-					break;
-			}
+		for (const TagToken & tag : tokens.tags) {
+			if (tag.index < 0 || tag.index >= tagPatterns->size())
+				continue;
+			QTextCursor	cursor(document());
+			using pos_type = decltype(cursor.position());
+			cursor.setPosition(currentBlock().position() + static_cast<pos_type>(tag.start));
+			cursor.setPosition(currentBlock().position() + static_cast<pos_type>(tag.start + tag.length), QTextCursor::KeepAnchor);
+			texDoc->addTag(cursor, (*tagPatterns)[tag.index].level, tag.text);
+		}
+	}
+}
+
+void TeXHighlighter::highlightBlock(const QString &text)
+{
+	applyTokens(text, tokenize(text, highlightIndex, isTagging));
+}
+
+void TeXHighlighter::highlightBlocks()
+{
+	QTime start = QTime::currentTime();
+
+	// Keep the worker busy while the previous batch is applied
+	if (!_tokenizeWatcher.isRunning())
+		startTokenizing(start);
+
+	aboutToHighlightBlocks();
+	applyTokenizedBlocks(start);
+	blocksHighlighted();
+
+	// Apply the remaining blocks as soon as pending events have been processed
+	if (_nextTokenizedBlock < _tokenizedBlocks.size())
+		_applyTimer.start();
+}
+
+void TeXHighlighter::startTokenizing(const QTime & start)
+{
+	if (_nextTokenizedBlock >= _tokenizedBlocks.size()) {
+		_tokenizedBlocks.clear();
+		_nextTokenizedBlock = 0;
+		_tokenizedFrom = _tokenizedTo = 0;
+	}
+
+	QVector<TokenizedBlock> batch;
+	int numChars{0};
+	while (hasBlocksToHighlight() && numChars < kMaxTokenizeChars && start.msecsTo(QTime::currentTime()) < maxTimeMsecs()) {
+		const QTextBlock block = nextBlockToHighlight();
+		if (!block.isValid())
+			break;
+
+		TokenizedBlock item;
+		item.block = block;
+		item.text = block.text();
+		item.highlightIndex = highlightIndex;
+		item.tagging = isTagging;
+		// Blocks that are unchanged since they were last tokenized can be
+		// applied right away
+		const BlockData * data = dynamic_cast<const BlockData *>(block.userData());
+		if (data && data->highlightIndex == item.highlightIndex && data->tagging == item.tagging && data->text == item.text) {
+			item.tokens = data->tokens;
+			item.isCached = true;
+			_tokenizedBlocks.append(item);
+		}
+		else {
+			numChars += block.length();
+			batch.append(item);
+		}
+
+		if (_tokenizedFrom >= _tokenizedTo) {
+			_tokenizedFrom = block.position();
+			_tokenizedTo = block.position() + block.length();
+		}
+		else {
+			_tokenizedFrom = qMin(_tokenizedFrom, block.position());
+			_tokenizedTo = qMax(_tokenizedTo, block.position() + block.length());
+		}
+		popHighlightRange(block.position(), block.position() + block.length());
+	}
+
+	if (batch.isEmpty())
+		return;
+
+	const int index = highlightIndex;
+	const bool tagging = isTagging;
+	_batchGeneration = _tokenizeGeneration;
+	_tokenizeWatcher.setFuture(QtConcurrent::run([batch, index, tagging]() -> QVector<TokenizedBlock> {
+		QVector<TokenizedBlock> retVal{batch};
+		for (TokenizedBlock & item : retVal)
+			item.tokens = QSharedPointer<const BlockTokens>(new BlockTokens(tokenize(item.text, index, tagging)));
+		return retVal;
+	}));
+}
+
+void TeXHighlighter::applyTokenizedBlocks(const QTime & start)
+{
+	while (_nextTokenizedBlock < _tokenizedBlocks.size() && start.msecsTo(QTime::currentTime()) < maxTimeMsecs()) {
+		TokenizedBlock & item = _tokenizedBlocks[_nextTokenizedBlock++];
+		// NB: The document has not changed since the block was queued (see
+		// discardTokenizedBlocks()), so the block and its text are still valid
+		if (!item.isCached) {
+			BlockData * data = new BlockData;
+			data->text = item.text;
+			data->highlightIndex = item.highlightIndex;
+			data->tagging = item.tagging;
+			data->tokens = item.tokens;
+			item.block.setUserData(data);
 		}
+		beginBlock(item.block);
+		applyTokens(item.text, *item.tokens);
+		applyFormats();
+		pushDirtyRange(item.block);
+		// Release the memory as early as possible
+		item = TokenizedBlock();
 	}
+	if (!hasTokenizedBlocks()) {
+		_tokenizedBlocks.clear();
+		_nextTokenizedBlock = 0;
+		_tokenizedFrom = _tokenizedTo = 0;
+	}
+}
+
+void TeXHighlighter::invalidateTokenizedBlocks()
+{
+	++_tokenizeGeneration;
+	_tokenizedBlocks.clear();
+	_nextTokenizedBlock = 0;
+	_tokenizedFrom = _tokenizedTo = 0;
+}
+
+void TeXHighlighter::tokenizingFinished()
+{
+	if (_batchGeneration != _tokenizeGeneration)
+		return;
+	_tokenizedBlocks.remove(0, _nextTokenizedBlock);
+	_nextTokenizedBlock = 0;
+	_tokenizedBlocks += _tokenizeWatcher.result();
+	_applyTimer.start();
+}
+
+void TeXHighlighter::discardTokenizedBlocks(int position, int charsRemoved, int charsAdded)
+{
+	if (_tokenizedFrom >= _tokenizedTo)
+		return;
+
+	// Queue the blocks again that were not applied yet, adjusting their range
+	// like NonblockingSyntaxHighlighter::maybeRehighlightText() does
+	int from = _tokenizedFrom, to = _tokenizedTo;
+	if (from >= position + charsRemoved)
+		from += charsAdded - charsRemoved;
+	else if (from >= position)
+		from = position;
+	if (to >= position + charsRemoved)
+		to += charsAdded - charsRemoved;
+	else if (to >= position)
+		to = position + charsAdded;
+
+	invalidateTokenizedBlocks();
+	pushHighlightRange(from, qMax(to, from + 1));
+	processWhenIdle();
+}
+
+void TeXHighlighter::aboutToHighlightBlocks()
+{
+	// Tags are removed and added block by block; notify others only once
+	if (texDoc)
+		texDoc->beginTagsUpdate();
+}
+
+void TeXHighlighter::blocksHighlighted()
+{
+	if (texDoc)
+		texDoc->endTagsUpdate();
 }
 
 void TeXHighlighter::setActiveIndex(int index)
 {
 	int oldIndex = highlightIndex;
 	highlightIndex = (index >= 0 && index < syntaxRules->count()) ? index : -1;
-	if (oldIndex != highlightIndex)
+	if (oldIndex != highlightIndex) {
+		// NB: rehighlight() queues all blocks again
+		invalidateTokenizedBlocks();
 		rehighlight();
+	}
 }
 
 void TeXHighlighter::setSpellChecker(const Tw::Document::SpellChecker & spellChecker)
 {
 	if (_spellChecker != spellChecker) {
 		_spellChecker = spellChecker;
+		// Everything is highlighted (and thus checked) again anyway
+		_wordsToCheck.clear();
+		_blocksAwaitingSpellCheck.clear();
 		QTimer::singleShot(1, this, SLOT(rehighlight()));
 	}
 }
 
+void TeXHighlighter::startSpellCheck()
+{
+	if (_spellCheckWatcher.isRunning() || _wordsToCheck.isEmpty())
+		return;
+	_spellCheckWatcher.setFuture(_spellChecker.checkWordsInBackground(_wordsToCheck.values()));
+	_wordsToCheck.clear();
+	_blocksInSpellCheck.swap(_blocksAwaitingSpellCheck);
+	_blocksAwaitingSpellCheck.clear();
+}
+
+void TeXHighlighter::spellCheckFinished()
+{
+	const QVector<QTextBlock> blocks = _blocksInSpellCheck;
+	_blocksInSpellCheck.clear();
+	// NB: Blocks may have been removed in the meantime; if they were changed,
+	// they have been highlighted again already, though, so highlighting them
+	// once more is merely redundant
+	for (const QTextBlock & block : blocks) {
+		if (block.isValid() && block.document() == document())
+			rehighlightBlock(block);
+	}
+	// Check the words that were found while the previous check was running
+	startSpellCheck();
+}
+
 QStringList TeXHighlighter::syntaxOptions()
 {
 	loadPatterns();
@@ -249,6 +477,12 @@ void TeXHighlighter::loadPatterns()
 			if (spec.rules.count() > 0)
 				syntaxRules->append(spec);
 		}
+		for (HighlightingSpec & spec : *syntaxRules) {
+			QVector<QRegularExpression> patterns;
+			for (const HighlightingRule & rule : spec.rules)
+				patterns.append(rule.pattern);
+			spec.patterns.setPatterns(patterns);
+		}
 	}
 
 	if (!tagPatterns) {
@@ -277,6 +511,14 @@ void TeXHighlighter::loadPatterns()
 			}
 		}
 	}
+
+	if (!tagPatternSet) {
+		tagPatternSet = new Tw::Utils::PatternSet;
+		QVector<QRegularExpression> patterns;
+		for (const TagPattern & patt : *tagPatterns)
+			patterns.append(patt.pattern);
+		tagPatternSet->setPatterns(patterns);
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -382,27 +624,18 @@ void NonblockingSyntaxHighlighter::sanitizeHighlightRanges()
 }
 
 
-void NonblockingSyntaxHighlighter::process()
+void NonblockingSyntaxHighlighter::highlightBlocks()
 {
-	_processingPending = false;
-	if (!_parent)
-		return;
-
 	QTime start = QTime::currentTime();
 
+	aboutToHighlightBlocks();
 	while (start.msecsTo(QTime::currentTime()) < MAX_TIME_MSECS && hasBlocksToHighlight()) {
 		const QTextBlock & block = nextBlockToHighlight();
 		if (block.isValid()) {
 			int prevUserState = block.userState();
-			_currentBlock = block;
-			_currentFormatRanges.clear();
+			beginBlock(block);
 			highlightBlock(block.text());
-
-#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
-			block.layout()->setAdditionalFormats(_currentFormatRanges.toList());
-#else
-			block.layout()->setFormats(_currentFormatRanges);
-#endif
+			applyFormats();
 
 			// If the userState has changed, make sure the next block is rehighlighted
 			// as well
@@ -412,6 +645,26 @@ void NonblockingSyntaxHighlighter::process()
 		}
 	}
 
+	blocksHighlighted();
+}
+
+void NonblockingSyntaxHighlighter::applyFormats()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
+	_currentBlock.layout()->setAdditionalFormats(_currentFormatRanges.toList());
+#else
+	_currentBlock.layout()->setFormats(_currentFormatRanges);
+#endif
+}
+
+void NonblockingSyntaxHighlighter::process()
+{
+	_processingPending = false;
+	if (!_parent)
+		return;
+
+	highlightBlocks();
+
 	// Notify the document of our changes
 	markDirtyContent();
 
@@ -23,12 +23,17 @@
 #define TEX_HIGHLIGHTER_H
 
 #include "document/SpellChecker.h"
+#include "utils/PatternSet.h"
 
+#include <QFutureWatcher>
 #include <QRegularExpression>
+#include <QSet>
+#include <QSharedPointer>
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
 #include <QTextDocument>
 #include <QTextLayout>
+#include <QTime>
 #include <QTimer>
 
 namespace Tw {
@@ -62,6 +67,18 @@ public slots:
 
 protected:
 	virtual void highlightBlock(const QString & text) = 0;
+	// Highlights (some of) the blocks queued for highlighting; called by
+	// process(). The default implementation calls highlightBlock() for as many
+	// blocks as can be processed within MAX_TIME_MSECS.
+	virtual void highlightBlocks();
+	// Called before and after highlighting a chunk of blocks, respectively
+	virtual void aboutToHighlightBlocks() { }
+	virtual void blocksHighlighted() { }
+	int maxTimeMsecs() const { return MAX_TIME_MSECS; }
+	// Sets up setFormat() & co. for highlighting `block` and applies the
+	// formats set to the block's layout, respectively
+	void beginBlock(const QTextBlock & block) { _currentBlock = block; _currentFormatRanges.clear(); }
+	void applyFormats();
 	void setFormat(const QString::size_type start, const QString::size_type count, const QTextCharFormat & format);
 	QTextBlock currentBlock() const { return _currentBlock; }
 	int currentBlockState() const { return _currentBlock.userState(); }
@@ -78,10 +95,12 @@ protected:
 	void markDirtyContent();
 	void sanitizeHighlightRanges();
 
-private slots:
-	void maybeRehighlightText(int position, int charsRemoved, int charsAdded);
+protected slots:
 	void process();
 	void processWhenIdle();
+
+private slots:
+	void maybeRehighlightText(int position, int charsRemoved, int charsAdded);
 	void unlinkFromDocument() { setDocument(nullptr); }
 
 private:
@@ -121,12 +140,72 @@ public:
 
 protected:
 	void highlightBlock(const QString &text) override;
+	void highlightBlocks() override;
+	void aboutToHighlightBlocks() override;
+	void blocksHighlighted() override;
 
 	void spellCheckRange(const QString &text, QString::size_type index, QString::size_type limit, const QTextCharFormat &spellFormat);
 
+private slots:
+	void startSpellCheck();
+	void spellCheckFinished();
+	void tokenizingFinished();
+	void discardTokenizedBlocks(int position, int charsRemoved, int charsAdded);
+
 private:
 	static void loadPatterns();
 
+	// The ranges of a block's text matched by the highlighting rules and tag
+	// patterns, respectively (`index` refers to the rule or pattern).
+	// Tokenizing only depends on the text, so it can be done in the background;
+	// formats (including spell checking) and tags are applied on the GUI thread.
+	struct Token {
+		QString::size_type start;
+		QString::size_type length;
+		int index;
+	};
+	struct TagToken {
+		QString::size_type start;
+		QString::size_type length;
+		int index;
+		QString text;
+	};
+	struct BlockTokens {
+		QVector<Token> formats;
+		QVector<TagToken> tags;
+	};
+
+	// Attached to each highlighted block so the block is not tokenized again as
+	// long as its text and the syntax mode are unchanged (e.g., when everything
+	// is highlighted again after changing the spell checker)
+	class BlockData : public QTextBlockUserData
+	{
+	public:
+		// The text and settings the tokens were obtained for
+		// NB: QString is implicitly shared, so keeping the text is cheap
+		QString text;
+		int highlightIndex{-1};
+		bool tagging{false};
+		QSharedPointer<const BlockTokens> tokens;
+	};
+
+	struct TokenizedBlock {
+		QTextBlock block;
+		QString text;
+		int highlightIndex{-1};
+		bool tagging{false};
+		// Null until the block has been tokenized
+		QSharedPointer<const BlockTokens> tokens;
+		bool isCached{false};
+	};
+
+	static BlockTokens tokenize(const QString & text, const int highlightIndex, const bool tagging);
+	void applyTokens(const QString & text, const BlockTokens & tokens);
+	void startTokenizing(const QTime & start);
+	void applyTokenizedBlocks(const QTime & start);
+	void invalidateTokenizedBlocks();
+	bool hasTokenizedBlocks() const { return _tokenizeWatcher.isRunning() || _nextTokenizedBlock < _tokenizedBlocks.size(); }
+
 	struct HighlightingRule {
 		QRegularExpression pattern;
 		QTextCharFormat format;
@@ -137,6 +216,7 @@ private:
 	struct HighlightingSpec {
 		QString				name;
 		HighlightingRules	rules;
+		Tw::Utils::PatternSet	patterns;
 	};
 	static QList<HighlightingSpec> *syntaxRules;
 
@@ -147,12 +227,36 @@ private:
 		unsigned int level;
 	};
 	static QList<TagPattern> *tagPatterns;
+	static Tw::Utils::PatternSet *tagPatternSet;
 
 	int highlightIndex;
 	bool isTagging;
 
 	Tw::Document::SpellChecker _spellChecker;
 
+	// Words are checked in the background; blocks containing words that were
+	// not checked yet are highlighted again once the verdicts are available
+	QSet<QString> _wordsToCheck;
+	QVector<QTextBlock> _blocksAwaitingSpellCheck;
+	QVector<QTextBlock> _blocksInSpellCheck;
+	QTimer _spellCheckTimer;
+	QFutureWatcher<void> _spellCheckWatcher;
+
+	// Blocks are tokenized in batches on a worker thread, working on a copy of
+	// their text. The blocks of a batch are no longer queued for highlighting;
+	// if the document changes before they are applied, they are discarded and
+	// queued again (see discardTokenizedBlocks()).
+	QFutureWatcher<QVector<TokenizedBlock>> _tokenizeWatcher;
+	QVector<TokenizedBlock> _tokenizedBlocks;
+	QVector<TokenizedBlock>::size_type _nextTokenizedBlock{0};
+	// The character range covered by the blocks being tokenized or applied
+	int _tokenizedFrom{0};
+	int _tokenizedTo{0};
+	// Incremented whenever the blocks being tokenized or applied become invalid
+	unsigned int _tokenizeGeneration{0};
+	unsigned int _batchGeneration{0};
+	QTimer _applyTimer;
+
 	Tw::Document::TeXDocument * texDoc;
 };
 
@@ -0,0 +1,188 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+#include "document/ProjectIndexer.h"
+
+#include "document/TeXDocument.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QtConcurrent>
+
+namespace Tw {
+namespace Document {
+
+// Time (in ms) after the last edit before the document is scanned again
+static const int kUpdateDelay = 500;
+// Upper bound on the number of files scanned per project (e.g., in case of
+// unusual input paths)
+static const int kMaxProjectFiles = 1000;
+
+ProjectIndexer::ProjectIndexer(TeXDocument * document)
+	: QObject(document)
+	, _document(document)
+{
+	_updateTimer.setSingleShot(true);
+	_updateTimer.setInterval(kUpdateDelay);
+	connect(&_updateTimer, &QTimer::timeout, this, &ProjectIndexer::update);
+	connect(&_watcher, &QFutureWatcher<ScanResult>::finished, this, &ProjectIndexer::scanFinished);
+	connect(_document, &TeXDocument::contentsChanged, &_updateTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+	connect(_document, &TeXDocument::modelinesChanged, this, [this](QStringList changedKeys, QStringList removedKeys) {
+		if (changedKeys.contains(QStringLiteral("root")) || removedKeys.contains(QStringLiteral("root")))
+			rescan();
+	});
+}
+
+void ProjectIndexer::rescan()
+{
+	_rescanPending = true;
+	startScan();
+}
+
+void ProjectIndexer::update()
+{
+	_updatePending = true;
+	startScan();
+}
+
+void ProjectIndexer::startScan()
+{
+	// NB: Requests coming in while scanning are handled in scanFinished()
+	if (_watcher.isRunning() || (!_rescanPending && !_updatePending))
+		return;
+
+	const QString documentFileName = (_document->isStoredInFilesystem() ? QDir::cleanPath(_document->absoluteFilePath()) : QString());
+	const QString rootFileName = QDir::cleanPath(_document->getRootFilePath());
+	const QString rootDir = (rootFileName.isEmpty() ? QString() : QFileInfo(rootFileName).absolutePath());
+
+	QStringList fileNames;
+	QHash<QString, QDateTime> indexed;
+	const bool isComplete = _rescanPending;
+	if (isComplete) {
+		if (!rootFileName.isEmpty()) {
+			fileNames << rootFileName;
+			// The .aux file of the root file includes those of \include'd files
+			fileNames << QDir(rootDir).absoluteFilePath(QFileInfo(rootFileName).completeBaseName() + QStringLiteral(".aux"));
+		}
+		if (fileNames.isEmpty() || documentFileName != rootFileName)
+			fileNames << documentFileName;
+	}
+	else {
+		// Other files are only scanned if they were not indexed yet (e.g.,
+		// because they were just included) or changed on disk in the meantime.
+		// Files that are no longer referenced are removed by the next complete
+		// scan.
+		fileNames << documentFileName;
+		indexed = _lastModified;
+	}
+	_rescanPending = false;
+	_updatePending = false;
+
+	const QString documentText = _document->toPlainText();
+	_watcher.setFuture(QtConcurrent::run([fileNames, rootDir, documentFileName, documentText, indexed, isComplete]() -> ScanResult {
+		ScanResult retVal = scan(fileNames, rootDir, documentFileName, documentText, indexed);
+		retVal.isComplete = isComplete;
+		return retVal;
+	}));
+}
+
+void ProjectIndexer::scanFinished()
+{
+	const ScanResult result = _watcher.result();
+	// NB: Rebuilding the index from scratch also drops trie nodes that are no
+	// longer used
+	if (result.isComplete) {
+		_index.clear();
+		_lastModified.clear();
+	}
+	for (auto it = result.files.cbegin(); it != result.files.cend(); ++it)
+		_index.setFileSymbols(it.key(), it.value().symbols);
+	for (auto it = result.lastModified.cbegin(); it != result.lastModified.cend(); ++it)
+		_lastModified.insert(it.key(), it.value());
+	emit indexChanged();
+
+	startScan();
+}
+
+// static
+ProjectIndexer::ScanResult ProjectIndexer::scan(const QStringList & fileNames, const QString & rootDir, const QString & documentFileName, const QString & documentText, const QHash<QString, QDateTime> & indexed)
+{
+	ScanResult retVal;
+
+	// TeX looks for files relative to the directory it was started in (i.e.,
+	// that of the root file), appending a default suffix if necessary
+	const auto resolve = [&rootDir](QString name, const QString & suffix) {
+		if (!name.endsWith(suffix) && !QFileInfo(QDir(rootDir), name).isFile())
+			name += suffix;
+		return QDir::cleanPath(QDir(rootDir).absoluteFilePath(name));
+	};
+
+	QStringList queue{fileNames};
+	QSet<QString> visited;
+	while (!queue.isEmpty() && retVal.files.size() < kMaxProjectFiles) {
+		const QString fileName = queue.takeFirst();
+		if (visited.contains(fileName))
+			continue;
+		visited.insert(fileName);
+
+		QString text;
+		if (fileName == documentFileName)
+			text = documentText;
+		else {
+			// NB: Unchanged files that were indexed before are skipped along
+			// with the files they refer to (which were indexed at the same time)
+			const QDateTime lastModified = QFileInfo(fileName).lastModified();
+			const auto it = indexed.find(fileName);
+			if (it != indexed.end() && it.value() == lastModified)
+				continue;
+			QFile file(fileName);
+			if (!file.open(QIODevice::ReadOnly))
+				continue;
+			retVal.lastModified.insert(fileName, lastModified);
+			// NB: The names we are looking for are (almost always) ASCII, so
+			// the actual encoding of the file does not matter much
+			text = QString::fromUtf8(file.readAll());
+		}
+
+		const QString suffix = QFileInfo(fileName).suffix().toLower();
+		SymbolIndex::FileSymbols symbols;
+		if (suffix == QLatin1String("bib"))
+			symbols = SymbolIndex::scanBibTeX(text);
+		else if (suffix == QLatin1String("aux"))
+			symbols = SymbolIndex::scanAux(text);
+		else
+			symbols = SymbolIndex::scanTeX(text);
+		retVal.files.insert(fileName, symbols);
+
+		// Relative paths cannot be resolved for untitled documents
+		if (rootDir.isEmpty())
+			continue;
+		for (const QString & input : symbols.inputs)
+			queue.append(resolve(input, (suffix == QLatin1String("aux") ? QStringLiteral(".aux") : QStringLiteral(".tex"))));
+		for (const QString & bibliography : symbols.bibliographies)
+			queue.append(resolve(bibliography, QStringLiteral(".bib")));
+	}
+	return retVal;
+}
+
+} // namespace Document
+} // namespace Tw
@@ -0,0 +1,96 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+#ifndef Document_ProjectIndexer_H
+#define Document_ProjectIndexer_H
+
+#include "document/SymbolIndex.h"
+
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+
+namespace Tw {
+namespace Document {
+
+class TeXDocument;
+
+// Maintains the SymbolIndex of the project a TeXDocument belongs to, i.e., of
+// its root file and all files included from there (recursively), as well as
+// the bibliographies and .aux files. Files are scanned in the background; when
+// the document is edited, only the document itself (using the text in the
+// editor rather than the file on disk) and the files that changed on disk
+// since they were scanned last (e.g., because they were saved from another
+// window) are scanned again.
+class ProjectIndexer : public QObject
+{
+	Q_OBJECT
+public:
+	explicit ProjectIndexer(TeXDocument * document);
+
+	const SymbolIndex & index() const { return _index; }
+	bool isScanning() const { return _watcher.isRunning(); }
+
+public slots:
+	// Scans all files of the project again (e.g., after the document was saved
+	// under a different name or typesetting updated the .aux files)
+	void rescan();
+	// Scans the document and the files that changed on disk since they were
+	// scanned last
+	void update();
+
+signals:
+	void indexChanged();
+
+private slots:
+	void startScan();
+	void scanFinished();
+
+private:
+	struct ScanResult {
+		QHash<QString, SymbolIndex::FileSymbols> files;
+		// The modification times of the `files` read from disk
+		QHash<QString, QDateTime> lastModified;
+		// If true, `files` replaces the complete index
+		bool isComplete{false};
+	};
+
+	// Scans `fileNames` and all files they refer to, except for those in
+	// `indexed` that were not modified since the given time; `documentText` is
+	// used instead of the file `documentFileName`
+	static ScanResult scan(const QStringList & fileNames, const QString & rootDir, const QString & documentFileName, const QString & documentText, const QHash<QString, QDateTime> & indexed);
+
+	TeXDocument * _document;
+	SymbolIndex _index;
+	// The modification times of the indexed files at the time they were read
+	QHash<QString, QDateTime> _lastModified;
+	QFutureWatcher<ScanResult> _watcher;
+	// Edits are collected for a short while before scanning the document again
+	QTimer _updateTimer;
+	bool _updatePending{false};
+	bool _rescanPending{false};
+};
+
+} // namespace Document
+} // namespace Tw
+
+#endif // !defined(Document_ProjectIndexer_H)
@@ -32,6 +32,7 @@ namespace Document {
 
 QMultiHash<QString, QString> * SpellCheckManager::dictionaryList = nullptr;
 QHash<const QString,std::shared_ptr<Hunhandle>> * SpellCheckManager::dictionaries = nullptr;
+QHash<const QString,std::shared_ptr<SpellCheckManager::DictionaryCache>> * SpellCheckManager::dictionaryCaches = nullptr;
 SpellCheckManager * SpellCheckManager::_instance = new SpellCheckManager();
 
 // static
@@ -89,6 +90,8 @@ std::shared_ptr<Hunhandle> SpellCheckManager::getDictionary(const QString & lang
 
 	if (!dictionaries)
 		dictionaries = new QHash<const QString, std::shared_ptr<Hunhandle>>;
+	if (!dictionaryCaches)
+		dictionaryCaches = new QHash<const QString, std::shared_ptr<DictionaryCache>>;
 
 	if (dictionaries->contains(language))
 		return dictionaries->value(language);
@@ -101,15 +104,31 @@ std::shared_ptr<Hunhandle> SpellCheckManager::getDictionary(const QString & lang
 			auto h = std::shared_ptr<Hunhandle>(Hunspell_create(affFile.canonicalFilePath().toLocal8Bit().data(),
 								dicFile.canonicalFilePath().toLocal8Bit().data()), Hunspell_destroy);
 			dictionaries->insert(language, h);
+			// Verdicts obtained from a previous instance may be outdated (e.g.,
+			// due to ignored words)
+			dictionaryCaches->insert(language, std::make_shared<DictionaryCache>());
 			return h;
 		}
 	}
 	return nullptr;
 }
 
+// static
+std::shared_ptr<SpellCheckManager::DictionaryCache> SpellCheckManager::getDictionaryCache(const QString & language)
+{
+	if (!dictionaryCaches)
+		return nullptr;
+	return dictionaryCaches->value(language);
+}
+
 // static
 void SpellCheckManager::clearDictionaries()
 {
+	if (dictionaryCaches) {
+		delete dictionaryCaches;
+		dictionaryCaches = nullptr;
+	}
+
 	if (!dictionaries)
 		return;
 
@@ -22,8 +22,11 @@
 #define SpellCheckManager_H
 
 #include <memory>
+#include <QAtomicInt>
 #include <QHash>
+#include <QMutex>
 #include <QObject>
+#include <QReadWriteLock>
 #include <QTextCodec>
 
 struct Hunhandle;
@@ -45,7 +48,22 @@ class SpellCheckManager : public QObject {
 	SpellCheckManager & operator=(const SpellCheckManager &) = delete;
 	SpellCheckManager & operator=(SpellCheckManager &&) = delete;
 
+	// Verdicts of previous checks, shared by all users of a dictionary (i.e.,
+	// across windows). As Hunhandles are not thread-safe, all calls into
+	// Hunspell for the corresponding dictionary must hold hunspellMutex.
+	struct DictionaryCache {
+		QMutex hunspellMutex;
+		QReadWriteLock lock;
+		QHash<QString, bool> verdicts;
+		// Incremented (while holding hunspellMutex) whenever a word is added
+		// to the dictionary; negative verdicts obtained before are not stored
+		QAtomicInt generation;
+	};
+
 	static std::shared_ptr<Hunhandle> getDictionary(const QString & language);
+	// Returns the cache for the dictionary most recently returned by
+	// getDictionary(language)
+	static std::shared_ptr<DictionaryCache> getDictionaryCache(const QString & language);
 
 public:
 	static SpellCheckManager * instance() { return _instance; }
@@ -69,6 +87,7 @@ private:
 	static SpellCheckManager * _instance;
 	static QMultiHash<QString, QString> * dictionaryList;
 	static QHash<const QString,std::shared_ptr<Hunhandle>> * dictionaries;
+	static QHash<const QString,std::shared_ptr<DictionaryCache>> * dictionaryCaches;
 };
 
 } // namespace Document
@@ -4,15 +4,25 @@
 
 #include <hunspell.h>
 
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QtConcurrent>
+
 namespace Tw {
 namespace Document {
 
+// Upper bound on the number of verdicts cached per dictionary to keep the
+// memory footprint in check
+static const int kMaxCachedVerdicts = 100000;
+
 std::shared_ptr<Hunhandle> SpellChecker::DictRef::getHunhandle() const
 {
 	std::shared_ptr<Hunhandle> retVal = hunhandle.lock();
 	if (!retVal) {
 		retVal = SpellCheckManager::getDictionary(language);
 		hunhandle = retVal;
+		cache = SpellCheckManager::getDictionaryCache(language);
 	}
 	return retVal;
 }
@@ -72,6 +82,7 @@ bool SpellChecker::setLanguages(const QStringList & languages)
 		}
 		DictRef dictRef;
 		dictRef.hunhandle = ptrHunhandle;
+		dictRef.cache = SpellCheckManager::getDictionaryCache(language);
 		dictRef.language = language;
 		dictRef.codec = QTextCodec::codecForName(Hunspell_get_dic_encoding(ptrHunhandle.get()));
 		if (dictRef.codec == nullptr) {
@@ -89,13 +100,125 @@ bool SpellChecker::isWordCorrect(const QString & word) const
 			continue;
 		}
 		std::shared_ptr<Hunhandle> ptrHunhandle = dictRef.getHunhandle();
-		if (Hunspell_spell(ptrHunhandle.get(), dictRef.codec->fromUnicode(word).data()) != 0) {
+		if (spell(ptrHunhandle.get(), dictRef.cache.get(), dictRef.codec, word)) {
 			return true;
 		}
 	}
 	return false;
 }
 
+SpellChecker::Verdict SpellChecker::cachedVerdict(const QString & word) const
+{
+	Verdict retVal{Verdict::Incorrect};
+	for (const DictRef & dictRef : m_dicts) {
+		if (!dictRef) {
+			continue;
+		}
+		switch (lookUpVerdict(dictRef.cache.get(), word)) {
+			case Verdict::Correct:
+				return Verdict::Correct;
+			case Verdict::Unknown:
+				retVal = Verdict::Unknown;
+				break;
+			case Verdict::Incorrect:
+				break;
+		}
+	}
+	return retVal;
+}
+
+QFuture<void> SpellChecker::checkWordsInBackground(const QStringList & words) const
+{
+	// Hold on to the dictionaries in case they are released in the meantime
+	// (e.g., by SpellCheckManager::clearDictionaries())
+	struct Dictionary {
+		std::shared_ptr<Hunhandle> hunhandle;
+		CacheType cache;
+		QTextCodec * codec;
+	};
+	std::vector<Dictionary> dictionaries;
+	for (const DictRef & dictRef : m_dicts) {
+		std::shared_ptr<Hunhandle> ptrHunhandle = dictRef.getHunhandle();
+		if (dictRef) {
+			dictionaries.push_back({ptrHunhandle, dictRef.cache, dictRef.codec});
+		}
+	}
+
+	return QtConcurrent::run([dictionaries, words]() {
+		for (const QString & word : words) {
+			// Like isWordCorrect(), stop at the first dictionary that knows
+			// the word
+			for (const Dictionary & dictionary : dictionaries) {
+				if (spell(dictionary.hunhandle.get(), dictionary.cache.get(), dictionary.codec, word)) {
+					break;
+				}
+			}
+		}
+	});
+}
+
+// static
+SpellChecker::Verdict SpellChecker::lookUpVerdict(SpellCheckManager::DictionaryCache * cache, const QString & word)
+{
+	if (!cache) {
+		return Verdict::Unknown;
+	}
+	QReadLocker locker(&cache->lock);
+	const auto it = cache->verdicts.constFind(word);
+	if (it == cache->verdicts.constEnd()) {
+		return Verdict::Unknown;
+	}
+	return (it.value() ? Verdict::Correct : Verdict::Incorrect);
+}
+
+// static
+void SpellChecker::storeVerdict(SpellCheckManager::DictionaryCache * cache, const QString & word, const bool correct, const int generation)
+{
+	if (!cache) {
+		return;
+	}
+	QWriteLocker locker(&cache->lock);
+	// NB: Words only ever become correct (see ignoreWord()), so a negative
+	// verdict must neither replace a positive one nor be stored if words were
+	// added to the dictionary since it was obtained (e.g., by a background
+	// check that raced with ignoreWord())
+	if (!correct && (generation != cache->generation.loadAcquire() || cache->verdicts.value(word, false))) {
+		return;
+	}
+	if (cache->verdicts.size() >= kMaxCachedVerdicts) {
+		// Drop about half of the verdicts rather than all of them so that
+		// highlighting does not have to check every word again at once;
+		// QHash's iteration order is effectively random, so this does not
+		// favor any particular words
+		auto it = cache->verdicts.begin();
+		while (it != cache->verdicts.end() && cache->verdicts.size() > kMaxCachedVerdicts / 2) {
+			it = cache->verdicts.erase(it);
+		}
+	}
+	cache->verdicts.insert(word, correct);
+}
+
+// static
+bool SpellChecker::spell(Hunhandle * hunhandle, SpellCheckManager::DictionaryCache * cache, QTextCodec * codec, const QString & word)
+{
+	const Verdict verdict = lookUpVerdict(cache, word);
+	if (verdict != Verdict::Unknown) {
+		return (verdict == Verdict::Correct);
+	}
+
+	bool correct{false};
+	int generation{0};
+	{
+		QMutexLocker locker(cache ? &cache->hunspellMutex : nullptr);
+		if (cache) {
+			generation = cache->generation.loadAcquire();
+		}
+		correct = (Hunspell_spell(hunhandle, codec->fromUnicode(word).data()) != 0);
+	}
+	storeVerdict(cache, word, correct, generation);
+	return correct;
+}
+
 QList<QString> SpellChecker::suggestionsForWord(const QString & word) const
 {
 	QList<QString> suggestions;
@@ -105,6 +228,7 @@ QList<QString> SpellChecker::suggestionsForWord(const QString & word) const
 			continue;
 		}
 		std::shared_ptr<Hunhandle> ptrHunhandle = dictRef.getHunhandle();
+		QMutexLocker locker(dictRef.cache ? &dictRef.cache->hunspellMutex : nullptr);
 		char ** suggestionList{nullptr};
 
 		int numSuggestions = Hunspell_suggest(ptrHunhandle.get(), &suggestionList, dictRef.codec->fromUnicode(word).data());
@@ -130,7 +254,14 @@ void SpellChecker::ignoreWord(const QString & word)
 		}
 		std::shared_ptr<Hunhandle> ptrHunhandle = dictRef.getHunhandle();
 		// note that this is not persistent after quitting TW
-		Hunspell_add(ptrHunhandle.get(), dictRef.codec->fromUnicode(word).data());
+		{
+			QMutexLocker locker(dictRef.cache ? &dictRef.cache->hunspellMutex : nullptr);
+			Hunspell_add(ptrHunhandle.get(), dictRef.codec->fromUnicode(word).data());
+			if (dictRef.cache) {
+				dictRef.cache->generation.fetchAndAddOrdered(1);
+			}
+		}
+		storeVerdict(dictRef.cache.get(), word, true, 0);
 		return;
 	}
 }
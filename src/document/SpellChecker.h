@@ -1,7 +1,10 @@
 #ifndef SpellChecker_H
 #define SpellChecker_H
 
+#include "document/SpellCheckManager.h"
+
 #include <memory>
+#include <QFuture>
 #include <QString>
 #include <QStringList>
 #include <QTextCodec>
@@ -13,11 +16,18 @@ namespace Tw {
 namespace Document {
 
 class SpellChecker {
+public:
+	enum class Verdict { Unknown, Correct, Incorrect };
+
+private:
 	using DictType = std::shared_ptr<Hunhandle>;
+	using CacheType = std::shared_ptr<SpellCheckManager::DictionaryCache>;
 
 	struct DictRef {
 		QString language;
 		mutable std::weak_ptr<Hunhandle> hunhandle;
+		// Belongs to hunhandle; updated whenever that is (re)loaded
+		mutable CacheType cache;
 		QTextCodec * codec{QTextCodec::codecForLocale()};
 
 		bool operator==(const DictRef & other) const;
@@ -28,6 +38,13 @@ class SpellChecker {
 
 	std::vector<DictRef> m_dicts;
 
+	static Verdict lookUpVerdict(SpellCheckManager::DictionaryCache * cache, const QString & word);
+	// Stores the verdict for `word`; `generation` is the cache's generation at
+	// the time `word` was checked
+	static void storeVerdict(SpellCheckManager::DictionaryCache * cache, const QString & word, const bool correct, const int generation);
+	// Checks `word` using the cached verdict if possible; thread-safe
+	static bool spell(Hunhandle * hunhandle, SpellCheckManager::DictionaryCache * cache, QTextCodec * codec, const QString & word);
+
 public:
 	SpellChecker() = default;
 
@@ -42,6 +59,14 @@ public:
 	QStringList languages() const;
 	bool setLanguages(const QStringList & languages);
 	bool isWordCorrect(const QString & word) const;
+	// Only consults the verdicts of previous checks (by any SpellChecker using
+	// the same dictionaries), so it is cheap enough to call for every word
+	// while highlighting; returns Verdict::Unknown if a word still needs to be
+	// checked (e.g., using checkWordsInBackground())
+	Verdict cachedVerdict(const QString & word) const;
+	// Checks `words` in a background thread; the verdicts are available through
+	// cachedVerdict() once the returned future has finished
+	QFuture<void> checkWordsInBackground(const QStringList & words) const;
 	QList<QString> suggestionsForWord(const QString & word) const;
 	// note that this is not persistent after quitting TW
 	void ignoreWord(const QString & word);
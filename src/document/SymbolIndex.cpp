@@ -0,0 +1,268 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+#include "document/SymbolIndex.h"
+
+#include <QPair>
+#include <QRegularExpression>
+
+namespace Tw {
+namespace Document {
+
+namespace {
+
+enum class Target { Symbol, Input, Bibliography };
+
+struct DefinitionPattern {
+	Target target;
+	SymbolIndex::Kind kind;
+	QRegularExpression regexp;
+};
+
+// NB: The first non-empty capturing group holds the name (or a comma-separated
+// list of names for bibliographies)
+const QVector<DefinitionPattern> & texPatterns()
+{
+	static const QVector<DefinitionPattern> patterns{
+		{Target::Symbol, SymbolIndex::Kind::Label, QRegularExpression(QStringLiteral("\\\\label\\s*\\{([^{}]+)\\}"))},
+		{Target::Symbol, SymbolIndex::Kind::Citation, QRegularExpression(QStringLiteral("\\\\bibitem\\s*(?:\\[[^\\]]*\\])?\\s*\\{([^{}]+)\\}"))},
+		{Target::Symbol, SymbolIndex::Kind::Macro, QRegularExpression(QStringLiteral("\\\\(?:(?:re)?newcommand|providecommand|DeclareRobustCommand|(?:New|Renew|Provide|Declare)DocumentCommand|DeclareMathOperator)\\*?\\s*\\{?\\s*\\\\([a-zA-Z@]+)"))},
+		{Target::Symbol, SymbolIndex::Kind::Macro, QRegularExpression(QStringLiteral("\\\\(?:[egx]?def|let)\\s*\\\\([a-zA-Z@]+)"))},
+		{Target::Symbol, SymbolIndex::Kind::Environment, QRegularExpression(QStringLiteral("\\\\(?:(?:re)?newenvironment|(?:New|Renew|Provide|Declare)DocumentEnvironment|newtheorem|declaretheorem)\\*?\\s*\\{([^{}]+)\\}"))},
+		// NB: \input also has a TeX primitive syntax without braces
+		{Target::Input, SymbolIndex::Kind::Label, QRegularExpression(QStringLiteral("\\\\(?:input|include|subfile)(?:\\s*\\{([^{}]+)\\}|\\s+([^\\s{}\\\\]+))"))},
+		{Target::Bibliography, SymbolIndex::Kind::Label, QRegularExpression(QStringLiteral("\\\\(?:bibliography|addbibresource|addglobalbib|addsectionbib)\\s*(?:\\[[^\\]]*\\])?\\s*\\{([^{}]+)\\}"))}
+	};
+	return patterns;
+}
+
+const QVector<DefinitionPattern> & auxPatterns()
+{
+	static const QVector<DefinitionPattern> patterns{
+		{Target::Symbol, SymbolIndex::Kind::Label, QRegularExpression(QStringLiteral("\\\\newlabel\\{([^{}]+)\\}"))},
+		{Target::Symbol, SymbolIndex::Kind::Citation, QRegularExpression(QStringLiteral("\\\\bibcite\\{([^{}]+)\\}"))},
+		// biblatex (with or without the refsection number)
+		{Target::Symbol, SymbolIndex::Kind::Citation, QRegularExpression(QStringLiteral("\\\\abx@aux@cite\\{(?:\\d+\\}\\{)?([^{}]+)\\}"))},
+		{Target::Input, SymbolIndex::Kind::Label, QRegularExpression(QStringLiteral("\\\\@input\\{([^{}]+)\\}"))}
+	};
+	return patterns;
+}
+
+SymbolIndex::FileSymbols scan(const QString & text, const QVector<DefinitionPattern> & patterns)
+{
+	SymbolIndex::FileSymbols retVal;
+	for (const DefinitionPattern & pattern : patterns) {
+		QRegularExpressionMatchIterator it = pattern.regexp.globalMatch(text);
+		while (it.hasNext()) {
+			const QRegularExpressionMatch match = it.next();
+			QString name = match.captured(1);
+			if (name.isEmpty())
+				name = match.captured(2);
+			name = name.trimmed();
+			if (name.isEmpty())
+				continue;
+			switch (pattern.target) {
+				case Target::Symbol:
+					retVal.symbols.append(SymbolIndex::Symbol{pattern.kind, name});
+					break;
+				case Target::Input:
+					retVal.inputs.append(name);
+					break;
+				case Target::Bibliography:
+					for (const QString & bib : name.split(QLatin1Char(','))) {
+						if (!bib.trimmed().isEmpty())
+							retVal.bibliographies.append(bib.trimmed());
+					}
+					break;
+			}
+		}
+	}
+	return retVal;
+}
+
+} // anonymous namespace
+
+// static
+SymbolIndex::FileSymbols SymbolIndex::scanTeX(const QString & text)
+{
+	// Strip comments (keeping the character preceding the %, if any)
+	static const QRegularExpression reComment(QStringLiteral("(^|[^\\\\])%[^\\n]*"), QRegularExpression::MultilineOption);
+	QString code{text};
+	code.replace(reComment, QStringLiteral("\\1"));
+	return scan(code, texPatterns());
+}
+
+// static
+SymbolIndex::FileSymbols SymbolIndex::scanBibTeX(const QString & text)
+{
+	static const QRegularExpression reEntry(QStringLiteral("@\\s*([a-zA-Z]+)\\s*[{(]\\s*([^,\\s{}()]+)\\s*,"));
+	FileSymbols retVal;
+	QRegularExpressionMatchIterator it = reEntry.globalMatch(text);
+	while (it.hasNext()) {
+		const QRegularExpressionMatch match = it.next();
+		const QString type = match.captured(1).toLower();
+		if (type == QLatin1String("string") || type == QLatin1String("preamble") || type == QLatin1String("comment"))
+			continue;
+		retVal.symbols.append(Symbol{Kind::Citation, match.captured(2)});
+	}
+	return retVal;
+}
+
+// static
+SymbolIndex::FileSymbols SymbolIndex::scanAux(const QString & text)
+{
+	FileSymbols retVal = scan(text, auxPatterns());
+	// cleveref writes an additional label for each \label
+	QVector<Symbol> symbols;
+	symbols.reserve(retVal.symbols.size());
+	for (const Symbol & symbol : retVal.symbols) {
+		if (!symbol.name.endsWith(QLatin1String("@cref")))
+			symbols.append(symbol);
+	}
+	retVal.symbols.swap(symbols);
+	return retVal;
+}
+
+// static
+bool SymbolIndex::completionContext(const QString & textBefore, Kind & kind, QString & prefix)
+{
+	static const QVector<QPair<Kind, QRegularExpression>> contexts{
+		// NB: \href takes a URL rather than a label
+		{Kind::Label, QRegularExpression(QStringLiteral("\\\\(?!href\\b)[a-zA-Z]*ref\\*?\\s*\\{(?:[^{}]*,)?\\s*([^{},\\s]*)$"))},
+		{Kind::Citation, QRegularExpression(QStringLiteral("\\\\[a-zA-Z]*[cC]ite[a-zA-Z]*\\*?\\s*(?:\\[[^\\]]*\\]\\s*){0,2}\\{(?:[^{}]*,)?\\s*([^{},\\s]*)$"))},
+		{Kind::Environment, QRegularExpression(QStringLiteral("\\\\(?:begin|end)\\s*\\{([^{}]*)$"))},
+		// NB: Make sure the backslash is not escaped itself (as in \\ )
+		{Kind::Macro, QRegularExpression(QStringLiteral("(?:^|[^\\\\])(?:\\\\\\\\)*\\\\([a-zA-Z@]+)$"))}
+	};
+	for (const auto & context : contexts) {
+		const QRegularExpressionMatch match = context.second.match(textBefore);
+		if (match.hasMatch()) {
+			kind = context.first;
+			prefix = match.captured(1);
+			return true;
+		}
+	}
+	return false;
+}
+
+void SymbolIndex::setFileSymbols(const QString & fileName, const QVector<Symbol> & symbols)
+{
+	removeFile(fileName);
+	for (const Symbol & symbol : symbols)
+		trie(symbol.kind).insert(symbol.name);
+	_files.insert(fileName, symbols);
+}
+
+void SymbolIndex::removeFile(const QString & fileName)
+{
+	auto it = _files.find(fileName);
+	if (it == _files.end())
+		return;
+	for (const Symbol & symbol : it.value())
+		trie(symbol.kind).remove(symbol.name);
+	_files.erase(it);
+}
+
+void SymbolIndex::clear()
+{
+	for (Trie & t : _tries)
+		t.clear();
+	_files.clear();
+}
+
+void SymbolIndex::Trie::insert(const QString & name)
+{
+	int node{0};
+	++_nodes[node].subtreeCount;
+	for (const QChar c : name) {
+		int child = _nodes[node].children.value(c, -1);
+		if (child < 0) {
+			child = static_cast<int>(_nodes.size());
+			// NB: Don't hold references to nodes across this as it may
+			// reallocate the nodes
+			_nodes.append(Node());
+			_nodes[node].children.insert(c, child);
+		}
+		node = child;
+		++_nodes[node].subtreeCount;
+	}
+	++_nodes[node].count;
+}
+
+void SymbolIndex::Trie::remove(const QString & name)
+{
+	if (!contains(name))
+		return;
+	int node{0};
+	--_nodes[node].subtreeCount;
+	for (const QChar c : name) {
+		node = _nodes[node].children.value(c);
+		--_nodes[node].subtreeCount;
+	}
+	--_nodes[node].count;
+}
+
+bool SymbolIndex::Trie::contains(const QString & name) const
+{
+	const int node = findNode(name);
+	return (node >= 0 && _nodes[node].count > 0);
+}
+
+QStringList SymbolIndex::Trie::complete(const QString & prefix, const int maxCount) const
+{
+	QStringList retVal;
+	const int node = findNode(prefix);
+	if (node < 0)
+		return retVal;
+	QString name{prefix};
+	collect(node, name, retVal, maxCount);
+	return retVal;
+}
+
+int SymbolIndex::Trie::findNode(const QString & key) const
+{
+	int node{0};
+	for (const QChar c : key) {
+		node = _nodes[node].children.value(c, -1);
+		if (node < 0)
+			return -1;
+	}
+	return node;
+}
+
+void SymbolIndex::Trie::collect(const int node, QString & name, QStringList & names, const int maxCount) const
+{
+	if (_nodes[node].subtreeCount <= 0 || (maxCount >= 0 && names.size() >= maxCount))
+		return;
+	if (_nodes[node].count > 0)
+		names.append(name);
+	// NB: QMap is sorted by key, so the names are collected in lexicographical
+	// order
+	for (auto it = _nodes[node].children.cbegin(); it != _nodes[node].children.cend(); ++it) {
+		if (maxCount >= 0 && names.size() >= maxCount)
+			return;
+		name.append(it.key());
+		collect(it.value(), name, names, maxCount);
+		name.chop(1);
+	}
+}
+
+} // namespace Document
+} // namespace Tw
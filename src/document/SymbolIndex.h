@@ -0,0 +1,116 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+#ifndef Document_SymbolIndex_H
+#define Document_SymbolIndex_H
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace Tw {
+namespace Document {
+
+// Keeps track of the symbols defined in the files of a (LaTeX) project for
+// completion. The symbols are recorded per file so files can be updated
+// individually; looking up symbols by prefix uses one trie per kind of symbol.
+class SymbolIndex
+{
+public:
+	enum class Kind { Label, Citation, Macro, Environment };
+	struct Symbol {
+		Kind kind;
+		QString name;
+
+		bool operator==(const Symbol & other) const { return kind == other.kind && name == other.name; }
+	};
+	// The symbols defined in a file and the files it refers to (as given in the
+	// file, i.e., possibly relative and without suffix)
+	struct FileSymbols {
+		QVector<Symbol> symbols;
+		QStringList inputs;
+		QStringList bibliographies;
+	};
+
+	static FileSymbols scanTeX(const QString & text);
+	static FileSymbols scanBibTeX(const QString & text);
+	static FileSymbols scanAux(const QString & text);
+
+	// Checks if the text in front of the cursor (`textBefore`) ends in a place
+	// where symbols can be completed (e.g., in the argument of \ref); if so,
+	// `kind` and `prefix` (the part of the symbol typed so far) are set
+	static bool completionContext(const QString & textBefore, Kind & kind, QString & prefix);
+
+	// Replaces the symbols recorded for `fileName` before (if any)
+	void setFileSymbols(const QString & fileName, const QVector<Symbol> & symbols);
+	void removeFile(const QString & fileName);
+	void clear();
+	bool containsFile(const QString & fileName) const { return _files.contains(fileName); }
+	QStringList files() const { return _files.keys(); }
+
+	bool contains(const Kind kind, const QString & name) const { return trie(kind).contains(name); }
+	// Returns (at most `maxCount` of) the symbols of the given kind starting
+	// with `prefix` in lexicographical order; symbols defined several times
+	// are only returned once
+	QStringList complete(const Kind kind, const QString & prefix, const int maxCount = -1) const { return trie(kind).complete(prefix, maxCount); }
+
+private:
+	class Trie
+	{
+	public:
+		Trie() : _nodes(1) { }
+
+		void insert(const QString & name);
+		void remove(const QString & name);
+		bool contains(const QString & name) const;
+		QStringList complete(const QString & prefix, const int maxCount) const;
+		void clear() { _nodes.clear(); _nodes.resize(1); }
+
+	private:
+		// NB: Nodes are not removed when symbols are removed; they are skipped
+		// while their subtree does not contain any symbols, and reused if
+		// symbols are added again
+		struct Node {
+			QMap<QChar, int> children;
+			// Number of definitions of the symbol ending at this node
+			int count{0};
+			// Total number of definitions of symbols in the subtree
+			int subtreeCount{0};
+		};
+
+		int findNode(const QString & key) const;
+		void collect(const int node, QString & name, QStringList & names, const int maxCount) const;
+
+		QVector<Node> _nodes;
+	};
+
+	Trie & trie(const Kind kind) { return _tries[static_cast<int>(kind)]; }
+	const Trie & trie(const Kind kind) const { return _tries[static_cast<int>(kind)]; }
+
+	Trie _tries[4];
+	QHash<QString, QVector<Symbol>> _files;
+};
+
+} // namespace Document
+} // namespace Tw
+
+#endif // !defined(Document_SymbolIndex_H)
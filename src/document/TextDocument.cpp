@@ -21,6 +21,8 @@
 
 #include "document/TextDocument.h"
 
+#include <algorithm>
+
 namespace Tw {
 namespace Document {
 
@@ -30,37 +32,45 @@ TextDocument::TextDocument(const QString & text, QObject * parent) : QTextDocume
 
 void TextDocument::addTag(const QTextCursor & cursor, const unsigned int level, const QString & text)
 {
-	QList<Tag>::iterator it;
-
-	for (it = _tags.begin(); it != _tags.end(); ++it) {
-		if (it->cursor.selectionStart() > cursor.selectionStart())
-			break;
-	}
+	// Insert after all tags starting at or before the new one
+	const int pos = cursor.selectionStart();
+	const auto it = std::upper_bound(_tags.begin(), _tags.end(), pos, [](const int p, const Tag & tag) {
+		return p < tag.cursor.selectionStart();
+	});
 	_tags.insert(it, {cursor, level, text});
-	emit tagsChanged();
+	notifyTagsChanged();
 }
 
 unsigned int TextDocument::removeTags(int offset, int len)
 {
-	unsigned int removed = 0;
-	QList<Tag>::iterator start, end;
-
-	for (start = _tags.begin(); start != _tags.end(); ++start) {
-		if (start->cursor.selectionStart() >= offset)
-			break;
-	}
-	for (end = start; end != _tags.end(); ++end) {
-		if (end->cursor.selectionStart() < offset + len)
-			++removed;
-		else
-			break;
-	}
+	const auto startsBefore = [](const Tag & tag, const int p) { return tag.cursor.selectionStart() < p; };
+	const auto start = std::lower_bound(_tags.begin(), _tags.end(), offset, startsBefore);
+	const auto end = std::lower_bound(start, _tags.end(), offset + len, startsBefore);
+	const auto removed = static_cast<unsigned int>(std::distance(start, end));
 	if (removed > 0) {
 		_tags.erase(start, end);
-		emit tagsChanged();
+		notifyTagsChanged();
 	}
 	return removed;
 }
 
+void TextDocument::endTagsUpdate()
+{
+	if (_tagsUpdateDepth <= 0 || --_tagsUpdateDepth > 0)
+		return;
+	if (_tagsChangedPending) {
+		_tagsChangedPending = false;
+		emit tagsChanged();
+	}
+}
+
+void TextDocument::notifyTagsChanged()
+{
+	if (_tagsUpdateDepth > 0)
+		_tagsChangedPending = true;
+	else
+		emit tagsChanged();
+}
+
 } // namespace Document
 } // namespace Tw
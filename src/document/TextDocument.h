@@ -42,15 +42,27 @@ public:
 	explicit TextDocument(QObject * parent = nullptr);
 	explicit TextDocument(const QString & text, QObject * parent = nullptr);
 
+	// NB: The tags are ordered by their position in the document
 	const QList<Tag> & getTags() const { return _tags; }
 	void addTag(const QTextCursor & cursor, const unsigned int level, const QString & text);
 	unsigned int removeTags(int offset, int len);
 
+	// Changes made between these calls result in (at most) one tagsChanged()
+	// signal at the end (calls can be nested)
+	void beginTagsUpdate() { ++_tagsUpdateDepth; }
+	void endTagsUpdate();
+
 signals:
 	void tagsChanged() const;
 
 protected:
+	void notifyTagsChanged();
+
 	QList<Tag> _tags;
+
+private:
+	int _tagsUpdateDepth{0};
+	bool _tagsChangedPending{false};
 };
 
 } // namespace Document
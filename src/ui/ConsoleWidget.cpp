@@ -1,6 +1,6 @@
 /*
 	This is part of TeXworks, an environment for working with TeX documents
-	Copyright (C) 2023  Stefan Löffler
+	Copyright (C) 2023-2025  Stefan Löffler
 
 	This program is free software; you can redistribute it and/or modify
 	it under the terms of the GNU General Public License as published by
@@ -21,12 +21,27 @@
 
 #include "ui/ConsoleWidget.h"
 
+#include <QContextMenuEvent>
+#include <QDesktopServices>
+#include <QDir>
+#include <QMenu>
+#include <QUrl>
+
 namespace Tw {
 namespace UI {
 
+// Output arriving within this interval (in ms) is inserted in one go, which is
+// much faster than inserting each piece as it arrives (in particular for
+// verbose runs)
+static const int kOutputFlushInterval = 16;
+
 ConsoleWidget::ConsoleWidget(QWidget * parent /* = nullptr */)
  : QTextEdit(parent)
+ , m_transcript(QDir::temp().filePath(QStringLiteral("texworks-console-XXXXXX.log")))
 {
+	m_flushTimer.setSingleShot(true);
+	m_flushTimer.setInterval(kOutputFlushInterval);
+	connect(&m_flushTimer, &QTimer::timeout, this, &ConsoleWidget::flushOutput);
 }
 
 ConsoleWidget::~ConsoleWidget()
@@ -39,22 +54,63 @@ void ConsoleWidget::setProcess(QProcess *p, const bool clearConsole /* = true */
 	if (m_process) {
 		m_process->disconnect(this);
 	}
+	flushOutput();
 	if (clearConsole) {
 		clear();
+		restartTranscript();
 	}
 	m_unicodeCarry.clear();
 	m_process = p;
 	if (m_process) {
 		connect(m_process, &QProcess::readyReadStandardOutput, this, [&]() {appendOutput(m_process->readAllStandardOutput()); });
+		// Show the complete output right away once the process has finished
+		connect(m_process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), this, &ConsoleWidget::flushOutput);
 		connect(m_process, &QProcess::destroyed, this, [&]() {setProcess(nullptr, false);});
 	}
 }
 
+void ConsoleWidget::setMaximumLineCount(const int count)
+{
+	if (count == m_maximumLineCount)
+		return;
+	const bool hadTranscript = (m_maximumLineCount > 0);
+	m_maximumLineCount = count;
+	if (m_maximumLineCount <= 0) {
+		m_transcript.close();
+		return;
+	}
+	if (!hadTranscript) {
+		// Save what would be dropped otherwise
+		flushOutput();
+		restartTranscript();
+		if (m_transcript.isOpen())
+			m_transcript.write(toPlainText().toUtf8());
+	}
+	dropExcessLines();
+}
+
+QString ConsoleWidget::transcript()
+{
+	flushOutput();
+	if (!m_transcript.isOpen())
+		return toPlainText();
+	const qint64 pos = m_transcript.pos();
+	m_transcript.seek(0);
+	const QByteArray data = m_transcript.readAll();
+	m_transcript.seek(pos);
+	return QString::fromUtf8(data);
+}
+
 void ConsoleWidget::echo(const QString &str, const QColor foregroundColor /* = {} */)
 {
+	// Keep the order of output and input
+	flushOutput();
+	if (m_transcript.isOpen())
+		m_transcript.write(str.toUtf8());
+
 	QTextCursor curs(document());
 	using pos_type = decltype(curs.position());
-	curs.setPosition(static_cast<pos_type>(toPlainText().length()));
+	curs.movePosition(QTextCursor::End);
 	setTextCursor(curs);
 	QTextCharFormat inputFormat(currentCharFormat());
 	if (foregroundColor.isValid()) {
@@ -64,16 +120,47 @@ void ConsoleWidget::echo(const QString &str, const QColor foregroundColor /* = {
 	curs.movePosition(QTextCursor::PreviousCharacter);
 	curs.movePosition(QTextCursor::PreviousCharacter, QTextCursor::KeepAnchor, static_cast<pos_type>(str.length() - 1));
 	curs.setCharFormat(inputFormat);
+	dropExcessLines();
 }
 
-void ConsoleWidget::appendOutput(QByteArray output)
+void ConsoleWidget::flushOutput()
 {
-	processIncompleteUTF8Codes(output);
+	m_flushTimer.stop();
+	if (m_pendingOutput.isEmpty())
+		return;
 	QTextCursor cursor(document());
-	cursor.select(QTextCursor::Document);
-	cursor.setPosition(cursor.selectionEnd());
-	cursor.insertText(QString::fromUtf8(output.constData()));
+	cursor.movePosition(QTextCursor::End);
+	cursor.insertText(m_pendingOutput);
 	setTextCursor(cursor);
+	m_pendingOutput.clear();
+	dropExcessLines();
+}
+
+void ConsoleWidget::contextMenuEvent(QContextMenuEvent * event)
+{
+	QMenu * menu = createStandardContextMenu(event->pos());
+	if (m_transcript.isOpen()) {
+		menu->addSeparator();
+		QAction * action = menu->addAction(tr("Open Complete Output"));
+		connect(action, &QAction::triggered, this, [&]() {
+			m_transcript.flush();
+			QDesktopServices::openUrl(QUrl::fromLocalFile(m_transcript.fileName()));
+		});
+	}
+	menu->exec(event->globalPos());
+	delete menu;
+}
+
+void ConsoleWidget::appendOutput(QByteArray output)
+{
+	processIncompleteUTF8Codes(output);
+	if (m_transcript.isOpen())
+		m_transcript.write(output);
+	const QString str = QString::fromUtf8(output.constData());
+	m_pendingOutput += str;
+	if (!m_flushTimer.isActive())
+		m_flushTimer.start();
+	emit outputAppended(str);
 }
 
 void ConsoleWidget::processIncompleteUTF8Codes(QByteArray &data)
@@ -99,5 +186,26 @@ void ConsoleWidget::processIncompleteUTF8Codes(QByteArray &data)
 	}
 }
 
+void ConsoleWidget::restartTranscript()
+{
+	if (m_maximumLineCount <= 0)
+		return;
+	// NB: Reopening a QTemporaryFile reuses the same file
+	if (!m_transcript.isOpen() && !m_transcript.open())
+		return;
+	m_transcript.resize(0);
+	m_transcript.seek(0);
+}
+
+void ConsoleWidget::dropExcessLines()
+{
+	const int blockCount = document()->blockCount();
+	if (m_maximumLineCount <= 0 || blockCount <= m_maximumLineCount)
+		return;
+	QTextCursor cursor(document());
+	cursor.setPosition(document()->findBlockByNumber(blockCount - m_maximumLineCount).position(), QTextCursor::KeepAnchor);
+	cursor.removeSelectedText();
+}
+
 } // namespace UI
 } // namespace Tw
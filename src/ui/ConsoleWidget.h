@@ -1,6 +1,6 @@
 /*
 	This is part of TeXworks, an environment for working with TeX documents
-	Copyright (C) 2008-2023  Stefan Löffler
+	Copyright (C) 2008-2025  Stefan Löffler
 
 	This program is free software; you can redistribute it and/or modify
 	it under the terms of the GNU General Public License as published by
@@ -23,7 +23,9 @@
 #define ConsoleWidget_H
 
 #include <QProcess>
+#include <QTemporaryFile>
 #include <QTextEdit>
+#include <QTimer>
 
 namespace Tw {
 namespace UI {
@@ -40,14 +42,46 @@ public:
 
 	void echo(const QString & str, const QColor foregroundColor = {});
 
+	// If positive, only the last `count` lines are kept in the widget; the
+	// complete output is written to a temporary file instead (see transcript())
+	int maximumLineCount() const { return m_maximumLineCount; }
+	void setMaximumLineCount(const int count);
+
+	// The complete output since the console was last cleared (including lines
+	// that were dropped due to maximumLineCount())
+	QString transcript();
+	// Empty unless maximumLineCount() is positive
+	QString transcriptFileName() const { return (m_transcript.isOpen() ? m_transcript.fileName() : QString()); }
+
+public slots:
+	// Shows all output received so far; this is done periodically
+	// automatically (output arriving in between is processed in one go)
+	void flushOutput();
+
+signals:
+	// Emitted for each (decoded) piece of output read from the process
+	void outputAppended(const QString & output);
+
+protected:
+	void contextMenuEvent(QContextMenuEvent * event) override;
+
 private slots:
 	void appendOutput(QByteArray output);
 
 private:
 	void processIncompleteUTF8Codes(QByteArray & data);
+	void restartTranscript();
+	void dropExcessLines();
 
 	QProcess * m_process{nullptr};
 	QByteArray m_unicodeCarry;
+
+	// Output that has not been inserted into the document yet
+	QString m_pendingOutput;
+	QTimer m_flushTimer;
+
+	int m_maximumLineCount{0};
+	QTemporaryFile m_transcript;
 };
 
 } // namespace UI
@@ -1,6 +1,6 @@
 /*
 	This is part of TeXworks, an environment for working with TeX documents
-	Copyright (C) 2019-2020  Stefan Löffler
+	Copyright (C) 2019-2025  Stefan Löffler
 
 	This program is free software; you can redistribute it and/or modify
 	it under the terms of the GNU General Public License as published by
@@ -35,6 +35,7 @@ LineNumberWidget::LineNumberWidget(QTextEdit * parent)
 	, _bgColor(palette().color(QPalette::Mid))
 {
 	setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Ignored);
+	updateMetrics();
 }
 
 QSize LineNumberWidget::sizeHint() const
@@ -49,11 +50,7 @@ QSize LineNumberWidget::sizeHint() const
 		}
 	}
 
-#if QT_VERSION < QT_VERSION_CHECK(5, 11, 0)
-	int space = 3 + fontMetrics().width(QChar::fromLatin1('9')) * digits;
-#else
-	int space = 3 + fontMetrics().horizontalAdvance(QChar::fromLatin1('9')) * digits;
-#endif
+	int space = 3 + _digitWidth * digits;
 	return QSize(space, 0);
 }
 
@@ -65,29 +62,58 @@ void LineNumberWidget::paintEvent(QPaintEvent * event)
 	if (!_editor)
 		return;
 
-	QTextBlock block = _editor->document()->begin();
-	int blockNumber = 1;
-
 	QAbstractTextDocumentLayout *layout = _editor->document()->documentLayout();
-	int top = static_cast<int>(layout->blockBoundingRect(block).top() - _editor->verticalScrollBar()->value());
-	int bottom = static_cast<int>(top + layout->blockBoundingRect(block).height());
+	const int scrollPos = _editor->verticalScrollBar()->value();
+	QHash<int, QStaticText> numbers;
 
-	while (block.isValid() && top <= event->rect().bottom()) {
+	QTextBlock block = firstVisibleBlock(event->rect().top());
+	int blockNumber = block.blockNumber() + 1;
+	while (block.isValid()) {
+		const QRectF rect = layout->blockBoundingRect(block);
+		// NB: The top of this block may not coincide with the bottom of the
+		// previous block in case the line spacing is not 100%
+		const int top = static_cast<int>(rect.top() - scrollPos);
+		const int bottom = top + static_cast<int>(rect.height());
+		if (top > event->rect().bottom())
+			break;
 		if (bottom >= event->rect().top()) {
-			QString number = QString::number(blockNumber);
-			painter.drawText(0, top, width() - 1, fontMetrics().height(),
-							 Qt::AlignRight, number);
+			QStaticText number = _numberCache.take(blockNumber);
+			if (number.text().isEmpty()) {
+				number.setText(QString::number(blockNumber));
+				number.setTextFormat(Qt::PlainText);
+				number.prepare(QTransform(), font());
+			}
+			painter.drawStaticText(QPointF(width() - 1 - number.size().width(), top), number);
+			numbers.insert(blockNumber, number);
 		}
-
 		block = block.next();
-		if (block == _editor->document()->end())
-			break;
-		// NB: The top of this block may not coincide with the bottom of the
-		// previous block in case the line spacing is not 100%
-		top = static_cast<int>(layout->blockBoundingRect(block).top() - _editor->verticalScrollBar()->value());
-		bottom = top + static_cast<int>(layout->blockBoundingRect(block).height());
 		++blockNumber;
 	}
+	_numberCache.swap(numbers);
+}
+
+QTextBlock LineNumberWidget::firstVisibleBlock(const int y) const
+{
+	QTextDocument * doc = _editor->document();
+	// NB: For the root frame, hit testing bisects the blocks rather than
+	// iterating over all of them
+	const int pos = doc->documentLayout()->hitTest(QPointF(0, y + _editor->verticalScrollBar()->value()), Qt::FuzzyHit);
+	QTextBlock block = (pos >= 0 ? doc->findBlock(pos) : doc->begin());
+	// The hit test finds the block closest to `y`; the one before it may still
+	// overlap, e.g. if `y` falls between two blocks
+	if (block.previous().isValid())
+		block = block.previous();
+	return block;
+}
+
+void LineNumberWidget::updateMetrics()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 11, 0)
+	_digitWidth = fontMetrics().width(QChar::fromLatin1('9'));
+#else
+	_digitWidth = fontMetrics().horizontalAdvance(QChar::fromLatin1('9'));
+#endif
+	_numberCache.clear();
 }
 
 void LineNumberWidget::changeEvent(QEvent * event)
@@ -95,6 +121,9 @@ void LineNumberWidget::changeEvent(QEvent * event)
 	if (event->type() == QEvent::ParentChange) {
 		_editor = qobject_cast<QTextEdit*>(parentWidget());
 	}
+	else if (event->type() == QEvent::FontChange) {
+		updateMetrics();
+	}
 	QWidget::changeEvent(event);
 }
 
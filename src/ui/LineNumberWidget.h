@@ -1,6 +1,6 @@
 /*
 	This is part of TeXworks, an environment for working with TeX documents
-	Copyright (C) 2008-2020  Stefan Löffler
+	Copyright (C) 2008-2025  Stefan Löffler
 
 	This program is free software; you can redistribute it and/or modify
 	it under the terms of the GNU General Public License as published by
@@ -21,7 +21,10 @@
 #ifndef LineNumberWidget_H
 #define LineNumberWidget_H
 
+#include <QHash>
 #include <QPaintEvent>
+#include <QStaticText>
+#include <QTextBlock>
 #include <QTextEdit>
 
 namespace Tw {
@@ -42,9 +45,24 @@ protected:
 	void paintEvent(QPaintEvent * event) override;
 	void changeEvent(QEvent * event) override;
 
+	// Returns the first block that is (at least partially) visible at or below
+	// `y` (in viewport coordinates)
+	QTextBlock firstVisibleBlock(const int y) const;
+
+	// Returns the (unordered) line numbers painted last time
+	QList<int> paintedNumbers() const { return _numberCache.keys(); }
+
 private:
+	void updateMetrics();
+
+	// Numbers painted last time; the lines shown change only little between
+	// repaints (e.g., when scrolling), so they can mostly be reused
+	QHash<int, QStaticText> _numberCache;
+
 	QTextEdit * _editor;
 	QColor _bgColor;
+
+	int _digitWidth{0};
 };
 
 } // namespace UI
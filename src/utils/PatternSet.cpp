@@ -0,0 +1,94 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+#include "utils/PatternSet.h"
+
+namespace Tw {
+namespace Utils {
+
+void PatternSet::setPatterns(const QVector<QRegularExpression> & patterns)
+{
+	// Patterns referring to groups by number (or resetting the group numbers)
+	// would not work anymore when combined with others
+	static const QRegularExpression groupReference(QStringLiteral("\\\\(?:[1-9]|g|k)|\\(\\?(?:[|R&+\\-0-9]|P[=>])"));
+
+	m_patterns = patterns;
+	m_groups.fill(-1, patterns.size());
+	m_isCombined = !patterns.isEmpty();
+
+	QString combined;
+	int group = 1;
+	for (int i = 0; i < patterns.size() && m_isCombined; ++i) {
+		const QRegularExpression & pattern = patterns[i];
+		if (pattern.patternOptions() != QRegularExpression::NoPatternOption || pattern.pattern().contains(groupReference))
+			m_isCombined = false;
+		if (!combined.isEmpty())
+			combined += QChar::fromLatin1('|');
+		combined += QChar::fromLatin1('(') + pattern.pattern() + QChar::fromLatin1(')');
+		m_groups[i] = group;
+		group += 1 + pattern.captureCount();
+	}
+	if (m_isCombined) {
+		m_combined = QRegularExpression(combined);
+		// NB: Alternatives are tried in order at each position, so the first
+		// match of the combined expression is the one that starts first (and
+		// in case of ties, the one of the pattern listed first)
+		m_isCombined = m_combined.isValid();
+	}
+	if (m_isCombined)
+		m_combined.optimize();
+	else
+		m_combined = QRegularExpression();
+}
+
+PatternSet::Match PatternSet::match(const QString & text, const size_type offset) const
+{
+	Match retVal;
+	if (m_isCombined) {
+		const QRegularExpressionMatch m = m_combined.match(text, offset);
+		if (!m.hasMatch())
+			return retVal;
+		for (int i = 0; i < m_groups.size(); ++i) {
+			if (m.capturedStart(m_groups[i]) < 0)
+				continue;
+			retVal.index = i;
+			retVal.start = m.capturedStart();
+			retVal.length = m.capturedLength();
+			if (m_patterns[i].captureCount() > 0)
+				retVal.captured1 = m.captured(m_groups[i] + 1);
+			break;
+		}
+		return retVal;
+	}
+
+	for (int i = 0; i < m_patterns.size(); ++i) {
+		const QRegularExpressionMatch m = m_patterns[i].match(text, offset);
+		if (m.capturedStart() >= 0 && (retVal.index < 0 || m.capturedStart() < retVal.start)) {
+			retVal.index = i;
+			retVal.start = m.capturedStart();
+			retVal.length = m.capturedLength();
+			retVal.captured1 = m.captured(1);
+		}
+	}
+	return retVal;
+}
+
+} // namespace Utils
+} // namespace Tw
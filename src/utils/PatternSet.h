@@ -0,0 +1,72 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+#ifndef PatternSet_H
+#define PatternSet_H
+
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+namespace Tw {
+namespace Utils {
+
+// Finds the match of a list of patterns that starts first (preferring the
+// pattern listed first in case of ties). If possible, all patterns are
+// combined into one regular expression so the text is scanned only once
+// rather than once per pattern.
+class PatternSet
+{
+public:
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+	using size_type = int;
+#else
+	using size_type = qsizetype;
+#endif
+
+	struct Match {
+		// Index of the matching pattern (or -1 if none matched)
+		int index{-1};
+		size_type start{0};
+		size_type length{0};
+		// The first capturing group of the matching pattern (if any)
+		QString captured1;
+	};
+
+	void setPatterns(const QVector<QRegularExpression> & patterns);
+	const QVector<QRegularExpression> & patterns() const { return m_patterns; }
+	// False if the patterns are matched one by one (e.g., because some of them
+	// use back-references)
+	bool isCombined() const { return m_isCombined; }
+
+	Match match(const QString & text, const size_type offset) const;
+
+private:
+	QVector<QRegularExpression> m_patterns;
+	QRegularExpression m_combined;
+	bool m_isCombined{false};
+	// The group capturing each pattern in m_combined
+	QVector<int> m_groups;
+};
+
+} // namespace Utils
+} // namespace Tw
+
+#endif // !defined(PatternSet_H)
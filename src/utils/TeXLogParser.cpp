@@ -0,0 +1,592 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+#include "TeXLogParser.h"
+
+namespace Tw {
+namespace Utils {
+
+// Should be equal to TeX's max_print_line (which determines where lines in the
+// output are wrapped)
+static const int maxPrintLine = 79;
+
+// Parsed output is discarded once it exceeds this size (in characters)
+static const int maxParsedOutputSize = 0x10000;
+
+namespace {
+
+enum class MessageType {
+	ErrorWithContext, Error, CriticalError,
+	Warning, LaTeXWarning, PdfTeXWarning,
+	BadBoxInParagraph, BadBoxAtLines, BadBoxInOutput,
+	Show, EndLRProblem, LatexmkRule
+};
+
+struct MessagePattern {
+	MessageType type;
+	QRegularExpression regexp;
+	// Most messages start at the beginning of a line (false if omitted)
+	bool allowedWithinLine;
+};
+
+// NB: The order matters; earlier patterns take precedence
+const QVector<MessagePattern> & messagePatterns()
+{
+	static const QVector<MessagePattern> patterns{
+		// Similar to the next one, but reads another line after "l.\d" (for
+		// errors such as "Undefined control sequence")
+		{MessageType::ErrorWithContext, QRegularExpression(QStringLiteral("!\\s+((?:.*\\n)+?(l\\.(\\d+).*)\\n(\\s+).*)\\n"))},
+		// All errors generated with \errmessage, i.e., starting with "!" and
+		// containing "l.\d+" (\GenericError uses \errmessage internally, and
+		// \@latex@error and \(Class|Package)Error use \GenericError)
+		{MessageType::Error, QRegularExpression(QStringLiteral("!\\s+((?:.*\\n)+?l\\.(\\d+)\\s(?:.*\\S.*\\n)?)"))},
+		// Critical errors: "File ended while scanning use|definition of ...",
+		// "Missing \begin{document}.", "Emergency stop."
+		{MessageType::CriticalError, QRegularExpression(QStringLiteral("!\\s+(.+)\\n"))},
+		// Warnings generated with \(Class|Package)(Warning|WarningNoLine) and
+		// others like "LaTeX Font Warning: ...\n(Font) ..." (\GenericWarning
+		// doesn't produce formatted output, so we have to look for the output of
+		// higher level commands)
+		{MessageType::Warning, QRegularExpression(QStringLiteral("(?:Class|Package|LaTeX) ([^\\s]+) Warning: (?:(?:\\(\\1\\)\\s.+)+|.+\\n)*.*\\.\\n"))},
+		// Warnings generated using \@latex@warning and \@latex@warning@no@line;
+		// they should use \MessageBreak, but sometimes they don't, so we read
+		// until a dot followed by a newline
+		{MessageType::LaTeXWarning, QRegularExpression(QStringLiteral("LaTeX Warning: (?:(?!\\.\\n).|\\n)+\\.\\n"))},
+		// "pdfTeX warning"s (e.g., "destination with the same identifier (...)
+		// has been already used, duplicate ignored"); these can start in the
+		// middle of a line
+		{MessageType::PdfTeXWarning, QRegularExpression(QStringLiteral("p\\n?d\\n?f\\n?T\\n?e\\n?X\\n? \\n?w\\n?a\\n?r\\n?n\\n?i\\n?n\\n?g\\n?.+?\\n((?:.{%1}\\n)*)(.*)").arg(maxPrintLine)), true},
+		// Bad boxes in paragraphs with context given on one or more lines
+		{MessageType::BadBoxInParagraph, QRegularExpression(QStringLiteral("((?:Under|Over)full \\\\hbox\\s*\\([^)]+\\) in paragraph at lines (\\d+)--\\d+\\n)((?:.{%1}\\n)*)(.*)").arg(maxPrintLine))},
+		// Bad boxes without context, but with line numbers
+		{MessageType::BadBoxAtLines, QRegularExpression(QStringLiteral("(?:Under|Over)full \\\\[hv]box\\s*\\([^)]+\\) (?:detected at line (\\d+)|in alignment at lines (\\d+)--\\d+)\\n"))},
+		// Bad boxes without context and line numbers
+		{MessageType::BadBoxInOutput, QRegularExpression(QStringLiteral("(?:Under|Over)full \\\\[hv]box\\s*\\([^)]+\\) has occurred while \\\\output is active\\b"))},
+		// The same for tight/loose boxes
+		{MessageType::BadBoxInParagraph, QRegularExpression(QStringLiteral("((?:Tight|Loose) \\\\hbox\\s*\\([^)]+\\) in paragraph at lines (\\d+)--\\d+\\n)((?:.{%1}\\n)*)(.*)").arg(maxPrintLine))},
+		{MessageType::BadBoxAtLines, QRegularExpression(QStringLiteral("(?:Tight|Loose) \\\\[hv]box\\s*\\([^)]+\\) (?:detected at line (\\d+)|in alignment at lines (\\d+)--\\d+)\\n"))},
+		{MessageType::BadBoxInOutput, QRegularExpression(QStringLiteral("(?:Tight|Loose) \\\\[hv]box\\s*\\([^)]+\\) has occurred while \\\\output is active\\b"))},
+		// \show and \showthe
+		{MessageType::Show, QRegularExpression(QStringLiteral("> (.+(?:\\.|=(?:\\\\long\\s)?macro:)\\n(?:.*\\n)*?l\\.(\\d+)\\s.*)\\n"))},
+		// XeTeX \endL / \endR problems
+		{MessageType::EndLRProblem, QRegularExpression(QStringLiteral("(\\\\endL or \\\\endR problem \\(\\d+ missing, \\d+ extra\\) in paragraph) at lines (\\d+)--\\d+\\n"))},
+		// A rerun of LaTeX caused by some Latexmk rule
+		{MessageType::LatexmkRule, QRegularExpression(QStringLiteral("Latexmk: applying rule"))}
+	};
+	return patterns;
+}
+
+// Skips to the next parenthesis or line break (or at least the next word)
+const QRegularExpression & skipRegexp()
+{
+	static const QRegularExpression regexp(QStringLiteral("[^\\n\\r()](?:(?!\\b)[^\\n\\r()])*"));
+	return regexp;
+}
+
+// Catches file names of the following forms:
+//  * abc (encountered with MiKTeX; only file names without parentheses that are
+//    not wrapped are recognized)
+//  * /abc, "/abc"
+//  * ./abc, "./abc"
+//  * .\abc, ".\abc"
+//  * ../abc, "../abc"
+//  * ..\abc, "..\abc"
+//  * C:/abc, "C:/abc"
+//  * C:\abc, "C:\abc"
+//  * \\server\abc, "\\server\abc"
+const QRegularExpression & fileRegexp()
+{
+	static const QRegularExpression regexp(QStringLiteral("\\(\"((?:[a-zA-Z]:[\\\\/]|/|\\.{1,2}[\\\\/]|\\\\\\\\)(?:[^\"]|\\n)+)\"|\\(((?:/|\\.{1,2}[\\\\/]|[a-zA-Z]:[\\\\/]|\\\\\\\\)[^ ()\\n]+|[^ ()\\n\\r]+\\.[a-zA-Z0-9]{1,4}\\b)"));
+	return regexp;
+}
+
+bool isPathAbsolute(const QString & path)
+{
+	static const QRegularExpression regexp(QStringLiteral("^[a-zA-Z]:[\\\\/]|/|\\\\\\\\"));
+	return regexp.match(path).hasMatch();
+}
+
+bool hasFileExtension(const QString & path)
+{
+	static const QRegularExpression regexp(QStringLiteral("[^\\.]\\.[a-zA-Z0-9]{1,4}$"));
+	return regexp.match(path).hasMatch();
+}
+
+QString basePath(const QString & path)
+{
+	const auto i = qMax(path.lastIndexOf(QChar::fromLatin1('/')), path.lastIndexOf(QChar::fromLatin1('\\')));
+	return (i < 0 ? path : path.left(i + 1));
+}
+
+// TeX breaks lines after max_print_line *bytes*, not characters
+int lengthInBytes(const QString & str)
+{
+	int retVal{0};
+	for (const QChar & c : str) {
+		if (c.unicode() <= 0x7F)
+			retVal += 1;
+		else if (c.unicode() <= 0x7FF)
+			retVal += 2;
+		else
+			retVal += 3;
+	}
+	return retVal;
+}
+
+QString trimmedRight(const QString & str)
+{
+	auto n = str.size();
+	while (n > 0 && str[n - 1].isSpace())
+		--n;
+	return str.left(n);
+}
+
+// Joins the lines of a message into one
+QString joinedLines(QString str)
+{
+	return str.remove(QChar::fromLatin1('\n')).simplified();
+}
+
+int inputLine(const QString & description)
+{
+	static const QRegularExpression regexp(QStringLiteral("on input line (\\d+)\\."));
+	return regexp.match(description).captured(1).toInt();
+}
+
+} // namespace
+
+TeXLogParser::TeXLogParser(const QString & rootFileName /* = {} */)
+	: m_rootFileName(rootFileName)
+{
+}
+
+void TeXLogParser::reset(const QString & rootFileName)
+{
+	m_rootFileName = rootFileName;
+	m_output.clear();
+	m_pendingHighSurrogate = QChar();
+	m_pos = 0;
+	m_finished = false;
+	m_atFileChanges = false;
+	m_currentFile.clear();
+	m_fileStack.clear();
+	m_extraParens = 0;
+	m_midLine = false;
+	m_diagnostics.clear();
+}
+
+void TeXLogParser::addOutput(const QString & output)
+{
+	if (m_finished || output.isEmpty())
+		return;
+	if (!m_pendingHighSurrogate.isNull()) {
+		m_output += m_pendingHighSurrogate;
+		m_pendingHighSurrogate = QChar();
+	}
+	m_output += output;
+	// Keep incomplete surrogate pairs out of m_output so it is always valid
+	// UTF-16 (see match())
+	if (m_output.at(m_output.size() - 1).isHighSurrogate()) {
+		m_pendingHighSurrogate = m_output.at(m_output.size() - 1);
+		m_output.chop(1);
+	}
+	parse();
+}
+
+void TeXLogParser::finish()
+{
+	if (m_finished)
+		return;
+	if (!m_pendingHighSurrogate.isNull()) {
+		m_output += QChar(QChar::ReplacementCharacter);
+		m_pendingHighSurrogate = QChar();
+	}
+	m_finished = true;
+	parse();
+}
+
+// static
+QVector<TeXLogParser::Diagnostic> TeXLogParser::parse(const QString & output, const QString & rootFileName /* = {} */, const FileExistsFunction & fileExists /* = {} */)
+{
+	TeXLogParser parser(rootFileName);
+	parser.setFileExistsFunction(fileExists);
+	parser.addOutput(output);
+	parser.finish();
+	return parser.diagnostics();
+}
+
+void TeXLogParser::parse()
+{
+	while (m_atFileChanges ? parseFileChanges() : parseMessages()) {
+	}
+
+	if (m_finished) {
+		m_output.clear();
+		m_pos = 0;
+	}
+	else if (m_pos > maxParsedOutputSize) {
+		m_output.remove(0, m_pos);
+		m_pos = 0;
+	}
+}
+
+bool TeXLogParser::parseMessages()
+{
+	while (m_pos < m_output.size() && m_output[m_pos].isSpace())
+		++m_pos;
+	if (m_pos >= m_output.size())
+		return false;
+
+	// Text matched by some patterns (especially bad boxes) may contain
+	// unbalanced parentheses, so we always look for all patterns first to avoid
+	// conflicts with the file stack
+	const QVector<MessagePattern> & patterns = messagePatterns();
+	for (int i = 0; i < patterns.size(); ++i) {
+		if (m_midLine && !patterns[i].allowedWithinLine)
+			continue;
+		QRegularExpressionMatch m;
+		if (!match(patterns[i].regexp, m_pos, m))
+			return false;
+		if (m.hasMatch() && matchMessage(m, i) == MatchResult::Match) {
+			m_pos = m.capturedEnd();
+			return true;
+		}
+	}
+	m_atFileChanges = true;
+	return true;
+}
+
+TeXLogParser::MatchResult TeXLogParser::matchMessage(const QRegularExpressionMatch & match, const int patternIndex)
+{
+	Diagnostic d;
+	d.file = m_currentFile;
+
+	switch (messagePatterns()[patternIndex].type) {
+		case MessageType::ErrorWithContext:
+			if (match.capturedLength(4) != match.capturedLength(2))
+				return MatchResult::NoMatch;
+			d.severity = Severity::Error;
+			d.line = match.captured(3).toInt();
+			d.description = match.captured(1);
+			break;
+		case MessageType::Error:
+			d.severity = Severity::Error;
+			d.line = match.captured(2).toInt();
+			d.description = match.captured(1).trimmed();
+			break;
+		case MessageType::CriticalError:
+			d.severity = Severity::Error;
+			d.description = match.captured(1);
+			break;
+		case MessageType::Warning:
+		{
+			// Remove the "\n(<name>) " continuation markers; lines that were not
+			// wrapped by TeX end in a word boundary
+			static const QRegularExpression unwrappedLine(QStringLiteral("^(.{0,%1})$").arg(maxPrintLine - 1), QRegularExpression::MultilineOption);
+			QString description = match.captured(0);
+			description.replace(unwrappedLine, QStringLiteral("\\1 "));
+			description.replace(QRegularExpression(QStringLiteral("\\(%1\\)\\s(.+)\\n").arg(QRegularExpression::escape(match.captured(1)))), QStringLiteral(" \\1"));
+			d.severity = Severity::Warning;
+			d.description = joinedLines(description);
+			d.line = inputLine(d.description);
+			break;
+		}
+		case MessageType::LaTeXWarning:
+			d.severity = Severity::Warning;
+			d.description = joinedLines(match.captured(0));
+			d.line = inputLine(d.description);
+			break;
+		case MessageType::PdfTeXWarning:
+			d.severity = Severity::Warning;
+			d.description = joinedLines(match.captured(0));
+			break;
+		case MessageType::BadBoxInParagraph:
+			d.severity = Severity::BadBox;
+			d.line = match.captured(2).toInt();
+			d.description = trimmedRight(match.captured(1) + match.captured(3).remove(QChar::fromLatin1('\n')) + match.captured(4));
+			break;
+		case MessageType::BadBoxAtLines:
+			d.severity = Severity::BadBox;
+			d.line = (match.capturedLength(1) > 0 ? match.captured(1) : match.captured(2)).toInt();
+			d.description = trimmedRight(match.captured(0));
+			break;
+		case MessageType::BadBoxInOutput:
+			d.severity = Severity::BadBox;
+			d.description = match.captured(0);
+			break;
+		case MessageType::Show:
+			d.severity = Severity::Debug;
+			d.line = match.captured(2).toInt();
+			d.description = match.captured(1);
+			break;
+		case MessageType::EndLRProblem:
+			d.severity = Severity::Warning;
+			d.line = match.captured(2).toInt();
+			d.description = match.captured(1);
+			break;
+		case MessageType::LatexmkRule:
+			// Everything before belongs to a previous run
+			m_diagnostics.clear();
+			return MatchResult::NoMatch;
+	}
+	m_diagnostics.append(d);
+	return MatchResult::Match;
+}
+
+bool TeXLogParser::parseFileChanges()
+{
+	// Work on copies so nothing changes in case we run out of output
+	size_type pos = m_pos;
+	QString currentFile = m_currentFile;
+	QVector<QString> fileStack = m_fileStack;
+	int extraParens = m_extraParens;
+	bool midLine = false;
+	bool midLineKnown = false;
+
+	// Go to the first parenthesis or simply skip the first line
+	QRegularExpressionMatch m;
+	if (!match(skipRegexp(), pos, m))
+		return false;
+	if (m.hasMatch())
+		pos = m.capturedEnd();
+	if (needsMoreOutput(pos))
+		return false;
+
+	if (charAt(pos) == QChar::fromLatin1(')')) {
+		if (extraParens > 0)
+			--extraParens;
+		else if (!fileStack.isEmpty())
+			currentFile = fileStack.takeLast();
+		++pos;
+	}
+	else if (charAt(pos) == QChar::fromLatin1('(')) {
+		bool hasLookahead{false};
+		FileMatch lookahead;
+		do {
+			QString fileName;
+			switch (matchNewFile(pos, hasLookahead, lookahead, fileName)) {
+				case MatchResult::NeedMoreOutput:
+					return false;
+				case MatchResult::Match:
+					fileStack.append(currentFile);
+					currentFile = fileName;
+					extraParens = 0;
+					midLine = false;
+					midLineKnown = true;
+					break;
+				case MatchResult::NoMatch:
+					++extraParens;
+					++pos;
+					break;
+			}
+		} while (hasLookahead);
+	}
+
+	if (!midLineKnown) {
+		if (needsMoreOutput(pos))
+			return false;
+		midLine = (charAt(pos) != QChar::fromLatin1('\n') && charAt(pos) != QChar::fromLatin1('\r'));
+	}
+
+	m_pos = pos;
+	m_currentFile = currentFile;
+	m_fileStack = fileStack;
+	m_extraParens = extraParens;
+	m_midLine = midLine;
+	m_atFileChanges = false;
+	return true;
+}
+
+// If the path is quoted, we are on MiKTeX and the path contains spaces, so we
+// just have to read until the closing quote.
+// Otherwise, we rely on two things: whether (partial) paths exist (as far as
+// that is known) and the lengths of lines (a file name can only continue on the
+// next line if the end of the current line was reached). Where in doubt, we
+// remember the most likely candidate while looking ahead for additional parts.
+// If another file is opened right after this one, `lookahead` is set to it.
+// NB: As in the original script, `lookahead` is matched against the output
+// following the previous file even if that turns out not to be a file after
+// all
+TeXLogParser::MatchResult TeXLogParser::matchNewFile(size_type & pos, bool & hasLookahead, FileMatch & lookahead, QString & fileName) const
+{
+	const auto fromMatch = [](const QRegularExpressionMatch & m) {
+		FileMatch retVal;
+		retVal.text = m.captured(0);
+		retVal.isQuoted = (m.capturedLength(1) > 0);
+		retVal.path = m.captured(retVal.isQuoted ? 1 : 2);
+		return retVal;
+	};
+
+	size_type p = pos;
+	FileMatch initialMatch;
+	if (!hasLookahead) {
+		QRegularExpressionMatch m;
+		if (!match(fileRegexp(), p, m))
+			return MatchResult::NeedMoreOutput;
+		if (!m.hasMatch())
+			return MatchResult::NoMatch;
+		initialMatch = fromMatch(m);
+	}
+	FileMatch & file = (hasLookahead ? lookahead : initialMatch);
+	bool foundLookahead{false};
+	FileMatch nextLookahead;
+
+	p += file.text.size();
+	if (file.isQuoted)
+		file.path.remove(QChar::fromLatin1('\n'));
+	else {
+		static const QRegularExpression separatorRegexp(QStringLiteral("[/\\\\ ()\\n]"));
+		static const QRegularExpression parenRegexp(QStringLiteral("\\((?:[^()]|\\n)*\\)"));
+		static const QRegularExpression openingRegexp(QStringLiteral("\\s*[([<]"));
+
+		const QString base = (isPathAbsolute(file.path) ? QString() : basePath(m_rootFileName));
+		QString candidate;
+		size_type candidatePos{-1};
+		// NB: We ignore any preceding characters on the same line; file names
+		// starting in the middle of a line never continue on the next line
+		int len = lengthInBytes(file.text);
+
+		while (true) {
+			QRegularExpressionMatch m;
+			if (!match(separatorRegexp, p, m, false))
+				return MatchResult::NeedMoreOutput;
+			if (!m.hasMatch()) {
+				if (!m_finished)
+					return MatchResult::NeedMoreOutput;
+				break;
+			}
+			const QChar separator = m.captured(0)[0];
+			const QString chunk = m_output.mid(p, m.capturedStart() - p);
+			file.path += chunk;
+			len += lengthInBytes(chunk);
+
+			if (separator == QChar::fromLatin1(')')) {
+				p = m.capturedStart();
+				break;
+			}
+			if (separator == QChar::fromLatin1('(')) {
+				p = m.capturedStart();
+				QRegularExpressionMatch next;
+				if (!match(fileRegexp(), p, next))
+					return MatchResult::NeedMoreOutput;
+				if (next.hasMatch()) {
+					nextLookahead = fromMatch(next);
+					foundLookahead = true;
+					break;
+				}
+				QRegularExpressionMatch paren;
+				if (!match(parenRegexp, p, paren, false))
+					return MatchResult::NeedMoreOutput;
+				if (!paren.hasMatch()) {
+					if (!m_finished)
+						return MatchResult::NeedMoreOutput;
+					break;
+				}
+				// NB: The original script skips the length of the parenthesized
+				// text from the current position, even if it was found further on
+				p += paren.capturedLength(0);
+				const QString text = paren.captured(0).remove(QChar::fromLatin1('\n'));
+				file.path += text;
+				len += lengthInBytes(text);
+				continue;
+			}
+
+			p = m.capturedEnd();
+			const FileExistence existence = (m_fileExists ? m_fileExists(base + file.path) : FileExistence::MayExist);
+			if (separator == QChar::fromLatin1('/') || separator == QChar::fromLatin1('\\')) {
+				if (existence == FileExistence::DoesNotExist)
+					return MatchResult::NoMatch;
+			}
+			else {
+				if (existence == FileExistence::Exists)
+					break;
+				if (existence == FileExistence::MayExist && hasFileExtension(file.path)) {
+					// It seems that a file name can only be followed by a line
+					// break or by a space and another file or a page
+					bool isCandidate = (separator == QChar::fromLatin1('\n'));
+					if (separator == QChar::fromLatin1(' ')) {
+						if (needsMoreOutput(p))
+							return MatchResult::NeedMoreOutput;
+						QRegularExpressionMatch opening;
+						if (!match(openingRegexp, p, opening))
+							return MatchResult::NeedMoreOutput;
+						isCandidate = opening.hasMatch();
+					}
+					if (isCandidate) {
+						candidate = file.path;
+						candidatePos = p;
+					}
+				}
+			}
+
+			if (separator != QChar::fromLatin1('\n')) {
+				file.path += separator;
+				++len;
+			}
+			else if (len % maxPrintLine != 0) {
+				// The line ended before max_print_line, so the file name can't
+				// continue on the next line
+				if (existence == FileExistence::DoesNotExist) {
+					if (hasFileExtension(file.path))
+						break;
+					return MatchResult::NoMatch;
+				}
+				if (!hasFileExtension(file.path)) {
+					if (candidatePos < 0)
+						return MatchResult::NoMatch;
+					file.path = candidate;
+					p = candidatePos;
+				}
+				break;
+			}
+		}
+		// Remove possible spaces before an opening parenthesis
+		file.path = trimmedRight(file.path);
+	}
+
+	fileName = file.path;
+	hasLookahead = foundLookahead;
+	if (foundLookahead)
+		lookahead = nextLookahead;
+	pos = p;
+	return MatchResult::Match;
+}
+
+bool TeXLogParser::match(const QRegularExpression & regexp, const size_type pos, QRegularExpressionMatch & result, const bool anchored /* = true */) const
+{
+	// NB: The output is valid UTF-16 (it was decoded by QString), so there is
+	// no need to check it over and over again
+	QRegularExpression::MatchOptions options{QRegularExpression::DontCheckSubjectStringMatchOption};
+	if (anchored) {
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+		options |= QRegularExpression::AnchoredMatchOption;
+#else
+		options |= QRegularExpression::AnchorAtOffsetMatchOption;
+#endif
+	}
+	// While more output may follow, a (complete) match is only final if the
+	// matching did not run into the end of the output; otherwise (e.g., if
+	// `regexp` ends in .* or might match after more lines) we have to wait
+	result = regexp.match(m_output, pos, (m_finished ? QRegularExpression::NormalMatch : QRegularExpression::PartialPreferFirstMatch), options);
+	return !result.hasPartialMatch();
+}
+
+} // namespace Utils
+} // namespace Tw
@@ -0,0 +1,137 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2025  Stefan Löffler
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <https://tug.org/texworks/>.
+*/
+#ifndef TeXLogParser_H
+#define TeXLogParser_H
+
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+namespace Tw {
+namespace Utils {
+
+// Extracts errors, warnings, and bad boxes from the terminal output of TeX.
+// This is a port of the logParser.js hook script that was used previously; it
+// yields the same results, but the output can be fed to it piece by piece
+// while the typesetting process is still running (see addOutput()). Everything
+// that can be parsed already is parsed right away, so the diagnostics are
+// complete as soon as finish() is called after the process has terminated.
+class TeXLogParser
+{
+public:
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+	using size_type = int;
+#else
+	using size_type = qsizetype;
+#endif
+
+	enum class Severity { BadBox, Warning, Error, Debug };
+	struct Diagnostic {
+		Severity severity{Severity::Error};
+		// Null if the message could not be attributed to a file
+		QString file;
+		// 0 if the message does not refer to a specific line
+		int line{0};
+		QString description;
+
+		bool operator==(const Diagnostic & other) const {
+			return severity == other.severity && file == other.file && line == other.line && description == other.description;
+		}
+	};
+
+	enum class FileExistence { Exists, DoesNotExist, MayExist };
+	// TeX does not mark where file names in its output end, so we check which
+	// candidates exist (as far as that is known)
+	using FileExistsFunction = std::function<FileExistence(const QString &)>;
+
+	// Relative paths in the output are resolved relative to the directory of
+	// `rootFileName`
+	explicit TeXLogParser(const QString & rootFileName = {});
+
+	// Discards all output and diagnostics to start over (e.g., for a new
+	// typesetting process)
+	void reset(const QString & rootFileName);
+	// By default, all files are assumed to possibly exist
+	void setFileExistsFunction(const FileExistsFunction & fileExists) { m_fileExists = fileExists; }
+
+	void addOutput(const QString & output);
+	// Parses the remaining output; must be called after all output was added
+	void finish();
+	bool isFinished() const { return m_finished; }
+
+	// The diagnostics found so far, in the order in which they occurred
+	const QVector<Diagnostic> & diagnostics() const { return m_diagnostics; }
+
+	// Convenience function to parse complete output in one go
+	static QVector<Diagnostic> parse(const QString & output, const QString & rootFileName = {}, const FileExistsFunction & fileExists = {});
+
+private:
+	enum class MatchResult { NoMatch, Match, NeedMoreOutput };
+
+	// Candidate for a file name following an opening parenthesis
+	struct FileMatch {
+		// The text that was matched initially
+		QString text;
+		QString path;
+		bool isQuoted{false};
+	};
+
+	void parse();
+	// The output alternates between messages (which may contain parentheses)
+	// and other text in which parentheses mark files being opened and closed.
+	// Both methods return false if the end of the output was reached (or if
+	// more output is needed to tell how to continue).
+	bool parseMessages();
+	bool parseFileChanges();
+	MatchResult matchMessage(const QRegularExpressionMatch & match, const int patternIndex);
+	MatchResult matchNewFile(size_type & pos, bool & hasLookahead, FileMatch & lookahead, QString & fileName) const;
+
+	// Matches `regexp` at `pos` (or searches for it from there, respectively);
+	// returns false if the result could change with more output
+	bool match(const QRegularExpression & regexp, const size_type pos, QRegularExpressionMatch & result, const bool anchored = true) const;
+	bool needsMoreOutput(const size_type pos) const { return (pos >= m_output.size() && !m_finished); }
+	QChar charAt(const size_type pos) const { return (pos < m_output.size() ? m_output[pos] : QChar()); }
+
+	QString m_rootFileName;
+	FileExistsFunction m_fileExists;
+
+	// Output before m_pos has been parsed already
+	QString m_output;
+	// The first half of a surrogate pair at the end of the output added last
+	QChar m_pendingHighSurrogate;
+	size_type m_pos{0};
+	bool m_finished{false};
+	bool m_atFileChanges{false};
+
+	QString m_currentFile;
+	QVector<QString> m_fileStack;
+	int m_extraParens{0};
+	bool m_midLine{false};
+
+	QVector<Diagnostic> m_diagnostics;
+};
+
+} // namespace Utils
+} // namespace Tw
+
+#endif // !defined(TeXLogParser_H)
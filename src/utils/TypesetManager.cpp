@@ -1,6 +1,6 @@
 /*
 	This is part of TeXworks, an environment for working with TeX documents
-	Copyright (C) 2008-2022  Stefan Löffler
+	Copyright (C) 2008-2025  Stefan Löffler
 
 	This program is free software; you can redistribute it and/or modify
 	it under the terms of the GNU General Public License as published by
@@ -20,31 +20,110 @@
 */
 #include "TypesetManager.h"
 
+#include <QThread>
+
 namespace Tw {
 namespace Utils {
 
+TypesetManager::TypesetManager(QObject * parent /* = nullptr */)
+	: QObject(parent)
+	, m_maxConcurrentJobs(QThread::idealThreadCount())
+{
+}
+
 QObject * TypesetManager::getOwnerForRootFile(const QString & rootFile) const
 {
 	return m_running.value(rootFile, nullptr);
 }
 
+bool TypesetManager::isFileQueued(const QString & rootFile) const
+{
+	for (const QueuedJob & job : m_queue) {
+		if (job.rootFile == rootFile)
+			return true;
+	}
+	return false;
+}
+
+qint64 TypesetManager::elapsedTime(const QString & rootFile) const
+{
+	if (!m_timers.contains(rootFile))
+		return -1;
+	return m_timers[rootFile].elapsed();
+}
+
+void TypesetManager::setMaxConcurrentJobs(const int maxJobs)
+{
+	m_maxConcurrentJobs = maxJobs;
+	startQueuedJobs();
+}
+
+bool TypesetManager::queueTypesetting(const QString & rootFile, QObject * const owner, const std::function<void()> & start)
+{
+	if (rootFile.isEmpty() || owner == nullptr || !start || m_running.contains(rootFile) || isFileQueued(rootFile)) {
+		return false;
+	}
+	m_queue.append({rootFile, owner, start});
+	connect(owner, &QObject::destroyed, this, &TypesetManager::cancelQueuedTypesetting, Qt::UniqueConnection);
+	emit typesettingQueued(rootFile);
+	startQueuedJobs();
+	return true;
+}
+
+void TypesetManager::cancelQueuedTypesetting(QObject * const owner)
+{
+	for (auto i = m_queue.size() - 1; i >= 0; --i) {
+		if (m_queue[i].owner == owner)
+			m_queue.removeAt(i);
+	}
+}
+
 bool TypesetManager::startTypesetting(const QString & rootFile, QObject * const owner)
 {
 	if (rootFile.isEmpty() || owner == nullptr || m_running.contains(rootFile)) {
 		return false;
 	}
 	m_running.insert(rootFile, owner);
+	m_timers[rootFile].start();
 	connect(owner, &QObject::destroyed, this, &TypesetManager::stopTypesetting);
 	emit typesettingStarted(rootFile);
 	return true;
 }
 
 void TypesetManager::stopTypesetting(QObject * const owner)
+{
+	stopJobs(owner, false);
+}
+
+void TypesetManager::finishTypesetting(QObject * const owner)
+{
+	stopJobs(owner, true);
+}
+
+void TypesetManager::stopJobs(QObject * const owner, const bool finished)
 {
 	Q_FOREACH(const QString & rootFile, m_running.keys(owner)) {
 		m_running.remove(rootFile);
+		const qint64 duration = m_timers.take(rootFile).elapsed();
 		emit typesettingStopped(rootFile);
+		if (finished)
+			emit typesettingFinished(rootFile, duration);
+	}
+	startQueuedJobs();
+}
+
+void TypesetManager::startQueuedJobs()
+{
+	// Starting a job may run an event loop (e.g., to show an error message),
+	// during which other jobs may stop; the loop below takes care of those
+	if (m_startingQueuedJobs)
+		return;
+	m_startingQueuedJobs = true;
+	while (!m_queue.isEmpty() && (m_maxConcurrentJobs <= 0 || m_running.size() < m_maxConcurrentJobs)) {
+		const QueuedJob job = m_queue.takeFirst();
+		job.start();
 	}
+	m_startingQueuedJobs = false;
 }
 
 } // namespace Utils
@@ -1,6 +1,6 @@
 /*
 	This is part of TeXworks, an environment for working with TeX documents
-	Copyright (C) 2022  Stefan Löffler
+	Copyright (C) 2022-2025  Stefan Löffler
 
 	This program is free software; you can redistribute it and/or modify
 	it under the terms of the GNU General Public License as published by
@@ -21,10 +21,14 @@
 #ifndef TYPESETMANAGER_H
 #define TYPESETMANAGER_H
 
+#include <QElapsedTimer>
+#include <QList>
 #include <QMap>
 #include <QObject>
 #include <QString>
 
+#include <functional>
+
 namespace Tw {
 namespace Utils {
 
@@ -33,18 +37,43 @@ namespace Utils {
 // This helps avoid running multiple processes on the same input file (which
 // would wreak havoc in the auxiliary and output files) and provides information
 // in which object (window) information about a currently running typesetting
-// process for a given input (root) file can be found
+// process for a given input (root) file can be found.
+// It also schedules typesetting jobs: requests made through queueTypesetting()
+// are started in order as long as fewer than maxConcurrentJobs() processes are
+// running; the others wait until running processes have stopped.
 class TypesetManager : public QObject
 {
 	Q_OBJECT
 public:
-	explicit TypesetManager(QObject * parent = nullptr) : QObject(parent) { }
+	explicit TypesetManager(QObject * parent = nullptr);
 
 	// In practice, the returned object should be a TeXDocumentWindow; to avoid
 	// interdependencies of headers (and to enable other types as owners in the
 	// future) we use a generic QObject* here instead
 	QObject * getOwnerForRootFile(const QString & rootFile) const;
 	bool isFileBeingTypeset(const QString & rootFile) const { return getOwnerForRootFile(rootFile) != nullptr; }
+	bool isFileQueued(const QString & rootFile) const;
+
+	int runningJobCount() const { return static_cast<int>(m_running.size()); }
+	int queuedJobCount() const { return static_cast<int>(m_queue.size()); }
+	// Milliseconds since typesetting of `rootFile` was started, or -1 if it is
+	// not being typeset
+	qint64 elapsedTime(const QString & rootFile) const;
+
+	// Values <= 0 mean that the number of jobs is not limited; defaults to the
+	// number of processor cores
+	int maxConcurrentJobs() const { return m_maxConcurrentJobs; }
+	void setMaxConcurrentJobs(const int maxJobs);
+
+	// Requests that `owner` starts typesetting `rootFile` as soon as possible by
+	// calling `start` (possibly right away). `start` is expected to call
+	// startTypesetting() once the process is running (or not at all if it
+	// could not be started after all).
+	// Returns false if `rootFile` is already being typeset or queued
+	bool queueTypesetting(const QString & rootFile, QObject * const owner, const std::function<void()> & start);
+	// Removes all jobs of `owner` from the queue (jobs that were started
+	// already are not affected)
+	void cancelQueuedTypesetting(QObject * const owner);
 
 public slots:
 	// Returns true if it is safe to start typesetting, false if typesetting
@@ -52,14 +81,37 @@ public slots:
 	// the specified root file)
 	// The root file should always be a canonical file path
 	bool startTypesetting(const QString & rootFile, QObject * const owner);
+	// Ends typesetting by `owner` in any case (e.g., if the process could not
+	// be started or crashed, or if `owner` is destroyed)
 	void stopTypesetting(QObject * const owner);
+	// Ends typesetting by `owner` after the process finished normally (no
+	// matter whether TeX reported errors); unlike stopTypesetting(), this also
+	// emits typesettingFinished()
+	void finishTypesetting(QObject * const owner);
 
 signals:
+	void typesettingQueued(const QString rootFile);
 	void typesettingStarted(const QString rootFile);
 	void typesettingStopped(const QString rootFile);
+	// Emitted along with typesettingStopped() if the process finished normally
+	// (see finishTypesetting()); `duration` is in milliseconds
+	void typesettingFinished(const QString rootFile, const qint64 duration);
 
 private:
+	struct QueuedJob {
+		QString rootFile;
+		QObject * owner;
+		std::function<void()> start;
+	};
+
+	void stopJobs(QObject * const owner, const bool finished);
+	void startQueuedJobs();
+
 	QMap<QString, QObject*> m_running;
+	QMap<QString, QElapsedTimer> m_timers;
+	QList<QueuedJob> m_queue;
+	int m_maxConcurrentJobs;
+	bool m_startingQueuedJobs{false};
 };
 
 } // namespace Utils
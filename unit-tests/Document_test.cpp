@@ -27,10 +27,12 @@
 #include "document/Document.h"
 #include "document/SpellChecker.h"
 #include "document/SpellCheckManager.h"
+#include "document/SymbolIndex.h"
 #include "document/TeXDocument.h"
 #include "document/TextDocument.h"
 #include "utils/ResourcesLibrary.h"
 
+#include <QFileInfo>
 #include <QSignalSpy>
 #include <limits>
 
@@ -47,15 +49,6 @@ Q_DECLARE_METATYPE(TWSynchronizer::TeXSyncPoint)
 Q_DECLARE_METATYPE(TWSynchronizer::PDFSyncPoint)
 Q_DECLARE_METATYPE(TWSynchronizer::Resolution)
 
-void NonblockingSyntaxHighlighter::setDocument(QTextDocument * doc) { Q_UNUSED(doc) }
-void NonblockingSyntaxHighlighter::rehighlight() { }
-void NonblockingSyntaxHighlighter::rehighlightBlock(const QTextBlock & block) { Q_UNUSED(block) }
-void NonblockingSyntaxHighlighter::maybeRehighlightText(int position, int charsRemoved, int charsAdded) { Q_UNUSED(position) Q_UNUSED(charsRemoved) Q_UNUSED(charsAdded) }
-void NonblockingSyntaxHighlighter::process() { }
-void NonblockingSyntaxHighlighter::processWhenIdle() {}
-TeXHighlighter::TeXHighlighter(Tw::Document::TeXDocument * parent) : NonblockingSyntaxHighlighter(parent) { }
-void TeXHighlighter::highlightBlock(const QString &text) { Q_UNUSED(text) }
-
 char * toString(const TWSyncTeXSynchronizer::TeXSyncPoint & p) {
 	return QTest::toString(QStringLiteral("TeXSyncPoint(%0 @ %1, %2 - %3)").arg(p.filename).arg(p.line).arg(p.col).arg(p.col + p.len));
 }
@@ -126,6 +119,8 @@ namespace Tw {
 namespace Utils {
 // Referenced in Tw::Document::SpellCheckManager
 const QStringList ResourcesLibrary::getLibraryPaths(const QString & subdir, const bool updateOnDisk) { Q_UNUSED(subdir) Q_UNUSED(updateOnDisk) return QStringList(QDir::currentPath()); }
+// Referenced in TeXHighlighter (for the patterns shipped with TeXworks)
+const QString ResourcesLibrary::getLibraryPath(const QString & subdir, const bool updateOnDisk) { Q_UNUSED(updateOnDisk) return QDir(QStringLiteral("../res/resfiles")).absoluteFilePath(subdir); }
 } // namespace Utils
 } // namespace Tw
 
@@ -253,6 +248,26 @@ void TestDocument::tags()
 
 	QCOMPARE(doc.removeTags(0, 1), 1u);
 	QCOMPARE(spy.count(), 1);
+
+	// Changes within (nested) updates are reported only once at the end
+	spy.clear();
+	doc.beginTagsUpdate();
+	doc.beginTagsUpdate();
+	doc.addTag(tag1.cursor, tag1.level, tag1.text);
+	QCOMPARE(doc.removeTags(0, 1), 1u);
+	doc.addTag(tag1.cursor, tag1.level, tag1.text);
+	doc.endTagsUpdate();
+	QCOMPARE(spy.count(), 0);
+	doc.endTagsUpdate();
+	QCOMPARE(spy.count(), 1);
+	QCOMPARE(doc.getTags(), QList<Tw::Document::TextDocument::Tag>() << tag1 << tag2);
+
+	// Updates without changes are not reported
+	spy.clear();
+	doc.beginTagsUpdate();
+	QCOMPARE(doc.removeTags(3, 5), 0u);
+	doc.endTagsUpdate();
+	QCOMPARE(spy.count(), 0);
 }
 
 void TestDocument::getHighlighter()
@@ -264,6 +279,83 @@ void TestDocument::getHighlighter()
 	QCOMPARE(doc.getHighlighter(), &highlighter);
 }
 
+// Gives access to the state of the highlighting queue
+class MyTeXHighlighter : public TeXHighlighter
+{
+public:
+	explicit MyTeXHighlighter(Tw::Document::TeXDocument * parent) : TeXHighlighter(parent) { }
+	bool isIdle() const { return !hasBlocksToHighlight(); }
+};
+
+// Describes the formats set by the highlighter as "start+length:color"
+static QStringList blockFormats(const QTextBlock & block)
+{
+	QStringList retVal;
+#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
+	const QList<QTextLayout::FormatRange> formats = block.layout()->additionalFormats();
+#else
+	const QVector<QTextLayout::FormatRange> formats = block.layout()->formats();
+#endif
+	for (const QTextLayout::FormatRange & range : formats)
+		retVal << QStringLiteral("%1+%2:%3").arg(range.start).arg(range.length).arg(range.format.foreground().color().name());
+	return retVal;
+}
+
+void TestDocument::highlighting()
+{
+	Tw::Document::TeXDocument doc(QStringLiteral("\\section{Intro} $x$\n%\\chapter{Old}\n\\begin{document}"));
+	MyTeXHighlighter highlighter(&doc);
+	const int latex = TeXHighlighter::syntaxOptions().indexOf(QStringLiteral("LaTeX"));
+	const int bibtex = TeXHighlighter::syntaxOptions().indexOf(QStringLiteral("BibTeX"));
+	QVERIFY(latex >= 0);
+	QVERIFY(bibtex >= 0);
+
+	const QTextBlock block0 = doc.findBlockByNumber(0);
+	const QTextBlock block1 = doc.findBlockByNumber(1);
+	const QTextBlock block2 = doc.findBlockByNumber(2);
+	const QStringList latex0{
+		QStringLiteral("0+8:#4169e1"), QStringLiteral("8+1:#ff0000"), QStringLiteral("14+1:#ff0000"),
+		QStringLiteral("16+1:#ff0000"), QStringLiteral("18+1:#ff0000")
+	};
+	const QStringList comment1{QStringLiteral("0+14:#808080")};
+	const QStringList latex2{QStringLiteral("0+16:#808000")};
+
+	highlighter.setActiveIndex(latex);
+	QTRY_COMPARE(blockFormats(block0), latex0);
+	QTRY_COMPARE(blockFormats(block1), comment1);
+	QTRY_COMPARE(blockFormats(block2), latex2);
+	QTRY_VERIFY(doc.getTags().size() == 2);
+	QCOMPARE(doc.getTags()[0].level, 3u);
+	QCOMPARE(doc.getTags()[0].text, QStringLiteral("Intro"));
+	QCOMPARE(doc.getTags()[1].level, 2u);
+	QCOMPARE(doc.getTags()[1].text, QStringLiteral("Old"));
+
+	// Highlighting unchanged blocks again reuses their tokens
+	QTextBlockUserData * data = block0.userData();
+	QVERIFY(data != nullptr);
+	highlighter.rehighlight();
+	QTRY_VERIFY(highlighter.isIdle());
+	QCOMPARE(block0.userData(), data);
+	QCOMPARE(blockFormats(block0), latex0);
+
+	// Tokens obtained for a different syntax mode must not be reused for the
+	// same text
+	highlighter.setActiveIndex(bibtex);
+	QTRY_COMPARE(blockFormats(block0), QStringList());
+	QTRY_COMPARE(blockFormats(block2), QStringList());
+	QCOMPARE(blockFormats(block1), comment1);
+	highlighter.setActiveIndex(latex);
+	QTRY_COMPARE(blockFormats(block0), latex0);
+	QTRY_COMPARE(blockFormats(block2), latex2);
+
+	// Edited blocks are tokenized again
+	QTextCursor cursor(block2);
+	cursor.insertText(QStringLiteral("x "));
+	QTRY_COMPARE(blockFormats(doc.findBlockByNumber(2)), QStringList{QStringLiteral("2+16:#808000")});
+	QCOMPARE(blockFormats(doc.findBlockByNumber(0)), latex0);
+	QVERIFY(doc.getTags().size() == 2);
+}
+
 void TestDocument::modelines()
 {
 	Tw::Document::TeXDocument doc(QStringLiteral("Lorem ipsum\n").repeated(200));
@@ -509,6 +601,58 @@ void TestDocument::SpellChecker_ignoreWord()
 	}
 }
 
+void TestDocument::SpellChecker_checkWordsInBackground()
+{
+	using Verdict = Tw::Document::SpellChecker::Verdict;
+	const QString lang{QStringLiteral("dictionary")};
+	const QString correctWord{QStringLiteral("World")};
+	const QString wrongWord{QStringLiteral("Wrld")};
+
+	Tw::Document::SpellCheckManager::clearDictionaries();
+
+	Tw::Document::SpellChecker defaultSpellChecker;
+	Tw::Document::SpellChecker spellChecker(lang);
+
+	QCOMPARE(defaultSpellChecker.cachedVerdict(correctWord), Verdict::Incorrect);
+	QCOMPARE(spellChecker.cachedVerdict(correctWord), Verdict::Unknown);
+	QCOMPARE(spellChecker.cachedVerdict(wrongWord), Verdict::Unknown);
+
+	spellChecker.checkWordsInBackground(QStringList{correctWord, wrongWord}).waitForFinished();
+	QCOMPARE(spellChecker.cachedVerdict(correctWord), Verdict::Correct);
+	QCOMPARE(spellChecker.cachedVerdict(wrongWord), Verdict::Incorrect);
+
+	// Verdicts are shared by all spell checkers using the same dictionary
+	Tw::Document::SpellChecker otherSpellChecker(lang);
+	QCOMPARE(otherSpellChecker.cachedVerdict(wrongWord), Verdict::Incorrect);
+
+	spellChecker.ignoreWord(wrongWord);
+	QCOMPARE(otherSpellChecker.cachedVerdict(wrongWord), Verdict::Correct);
+	QCOMPARE(otherSpellChecker.isWordCorrect(wrongWord), true);
+
+	// Verdicts don't outlive the dictionaries (in particular ignored words)
+	Tw::Document::SpellCheckManager::clearDictionaries();
+	Tw::Document::SpellChecker newSpellChecker(lang);
+	QCOMPARE(newSpellChecker.cachedVerdict(wrongWord), Verdict::Unknown);
+	QCOMPARE(newSpellChecker.isWordCorrect(wrongWord), false);
+	QCOMPARE(newSpellChecker.cachedVerdict(wrongWord), Verdict::Incorrect);
+
+	// When the cache is full, only some of the verdicts are dropped
+	QStringList words;
+	for (int i = 0; i < 100000; ++i) {
+		words.append(QStringLiteral("w%1").arg(i));
+	}
+	newSpellChecker.checkWordsInBackground(words).waitForFinished();
+	QCOMPARE(newSpellChecker.cachedVerdict(words.last()), Verdict::Incorrect);
+	int numKnown{0};
+	for (const QString & word : words) {
+		if (newSpellChecker.cachedVerdict(word) != Verdict::Unknown) {
+			++numKnown;
+		}
+	}
+	QVERIFY(numKnown >= words.size() / 2 - 1);
+	QVERIFY(numKnown < words.size());
+}
+
 void TestDocument::Synchronizer_isValid()
 {
 	TWSyncTeXSynchronizer valid(QStringLiteral("sync.pdf"), nullptr, nullptr);
@@ -563,6 +707,14 @@ void TestDocument::Synchronizer_syncFromTeX_data()
 		TWSynchronizer::TeXSyncPoint({texFilename, 9, 0, 0}) <<
 		TWSynchronizer::PDFSyncPoint({pdfFilename, 1, QList<QRectF>({QRectF(133.7683563232422, 127.84612274169922, 343.7110595703125, 6.9184980392456055)})});
 
+	QTest::newRow("absolute path (line)") << synchronizer << TWSynchronizer::LineResolution <<
+		TWSynchronizer::TeXSyncPoint({QFileInfo(texFilename).absoluteFilePath(), 9, 0, 0}) <<
+		TWSynchronizer::PDFSyncPoint({pdfFilename, 1, QList<QRectF>({QRectF(133.7683563232422, 127.84612274169922, 343.7110595703125, 6.9184980392456055)})});
+
+	QTest::newRow("unknown file (line)") << synchronizer << TWSynchronizer::LineResolution <<
+		TWSynchronizer::TeXSyncPoint({QStringLiteral("does-not-exist.tex"), 9, 0, 0}) <<
+		TWSynchronizer::PDFSyncPoint({QString(), -1, QList<QRectF>()});
+
 	QTest::newRow("simple space (line)") << synchronizer << TWSynchronizer::LineResolution <<
 		TWSynchronizer::TeXSyncPoint({texFilename, 9, 5, 0}) <<
 		TWSynchronizer::PDFSyncPoint({pdfFilename, 1, QList<QRectF>({QRectF(133.7683563232422, 127.84612274169922, 343.7110595703125, 6.9184980392456055)})});
@@ -1031,6 +1183,169 @@ void TestDocument::rootFile()
 	QCOMPARE(doc->getRootFilePath(), rootPath);
 }
 
+static QStringList symbolNames(const QVector<Tw::Document::SymbolIndex::Symbol> & symbols, const Tw::Document::SymbolIndex::Kind kind)
+{
+	QStringList retVal;
+	for (const Tw::Document::SymbolIndex::Symbol & symbol : symbols) {
+		if (symbol.kind == kind)
+			retVal.append(symbol.name);
+	}
+	return retVal;
+}
+
+void TestDocument::SymbolIndex_scanTeX()
+{
+	using Kind = Tw::Document::SymbolIndex::Kind;
+	const QString text = QStringLiteral(
+		"\\documentclass{article}\n"
+		"\\newcommand{\\foo}{Foo}\n"
+		"\\newcommand*\\bar[1]{#1}\n"
+		"\\def\\baz{Baz}\n"
+		"\\NewDocumentCommand{\\qux}{m}{#1}\n"
+		"\\newenvironment{myenv}{}{}\n"
+		"\\newtheorem{theorem}{Theorem}\n"
+		"\\begin{document}\n"
+		"\\section{Intro}\\label{sec:intro}\n"
+		"% \\label{commented}\n"
+		"50\\% \\label{escaped}\n"
+		"\\input{chapter1}\n"
+		"\\include{chapters/chapter2}\n"
+		"\\input chapter3.tex\n"
+		"\\includegraphics{image}\n"
+		"\\bibliographystyle{plain}\n"
+		"\\bibliography{refs, more}\n"
+		"\\begin{thebibliography}{1}\n"
+		"\\bibitem[Knuth]{knuth84} The \\TeX book\n"
+		"\\end{thebibliography}\n"
+		"\\end{document}\n"
+	);
+
+	const Tw::Document::SymbolIndex::FileSymbols symbols = Tw::Document::SymbolIndex::scanTeX(text);
+	QCOMPARE(symbolNames(symbols.symbols, Kind::Label), QStringList({QStringLiteral("sec:intro"), QStringLiteral("escaped")}));
+	QCOMPARE(symbolNames(symbols.symbols, Kind::Citation), QStringList({QStringLiteral("knuth84")}));
+	QCOMPARE(symbolNames(symbols.symbols, Kind::Macro), QStringList({QStringLiteral("foo"), QStringLiteral("bar"), QStringLiteral("qux"), QStringLiteral("baz")}));
+	QCOMPARE(symbolNames(symbols.symbols, Kind::Environment), QStringList({QStringLiteral("myenv"), QStringLiteral("theorem")}));
+	QCOMPARE(symbols.inputs, QStringList({QStringLiteral("chapter1"), QStringLiteral("chapters/chapter2"), QStringLiteral("chapter3.tex")}));
+	QCOMPARE(symbols.bibliographies, QStringList({QStringLiteral("refs"), QStringLiteral("more")}));
+}
+
+void TestDocument::SymbolIndex_scanBibTeX()
+{
+	using Kind = Tw::Document::SymbolIndex::Kind;
+	const QString text = QStringLiteral(
+		"@string{tug = \"TeX Users Group\"}\n"
+		"@Book{knuth84,\n  author = {Donald E. Knuth},\n  title = {The \\TeX book}\n}\n"
+		"@comment{not an entry}\n"
+		"@article ( lamport94 ,\n  author = \"Leslie Lamport\"\n)\n"
+	);
+
+	const Tw::Document::SymbolIndex::FileSymbols symbols = Tw::Document::SymbolIndex::scanBibTeX(text);
+	QCOMPARE(symbolNames(symbols.symbols, Kind::Citation), QStringList({QStringLiteral("knuth84"), QStringLiteral("lamport94")}));
+	QCOMPARE(symbols.symbols.size(), 2);
+}
+
+void TestDocument::SymbolIndex_scanAux()
+{
+	using Kind = Tw::Document::SymbolIndex::Kind;
+	const QString text = QStringLiteral(
+		"\\relax\n"
+		"\\@input{chapter1.aux}\n"
+		"\\newlabel{sec:intro}{{1}{1}}\n"
+		"\\newlabel{sec:intro@cref}{{[section][1][]1}{[1][1][]1}}\n"
+		"\\bibcite{knuth84}{1}\n"
+		"\\abx@aux@cite{0}{lamport94}\n"
+	);
+
+	const Tw::Document::SymbolIndex::FileSymbols symbols = Tw::Document::SymbolIndex::scanAux(text);
+	QCOMPARE(symbolNames(symbols.symbols, Kind::Label), QStringList({QStringLiteral("sec:intro")}));
+	QCOMPARE(symbolNames(symbols.symbols, Kind::Citation), QStringList({QStringLiteral("knuth84"), QStringLiteral("lamport94")}));
+	QCOMPARE(symbols.inputs, QStringList({QStringLiteral("chapter1.aux")}));
+}
+
+void TestDocument::SymbolIndex_completionContext_data()
+{
+	using Kind = Tw::Document::SymbolIndex::Kind;
+	QTest::addColumn<QString>("textBefore");
+	QTest::addColumn<bool>("isContext");
+	QTest::addColumn<int>("kind");
+	QTest::addColumn<QString>("prefix");
+
+	QTest::newRow("empty") << QString() << false << 0 << QString();
+	QTest::newRow("text") << QStringLiteral("some text") << false << 0 << QString();
+	QTest::newRow("ref") << QStringLiteral("see \\ref{sec:") << true << static_cast<int>(Kind::Label) << QStringLiteral("sec:");
+	QTest::newRow("eqref-empty") << QStringLiteral("\\eqref{") << true << static_cast<int>(Kind::Label) << QString();
+	QTest::newRow("cref-list") << QStringLiteral("\\cref{a, b") << true << static_cast<int>(Kind::Label) << QStringLiteral("b");
+	QTest::newRow("href") << QStringLiteral("\\href{http") << false << 0 << QString();
+	QTest::newRow("ref-closed") << QStringLiteral("\\ref{sec:intro} and") << false << 0 << QString();
+	QTest::newRow("cite") << QStringLiteral("\\cite{kn") << true << static_cast<int>(Kind::Citation) << QStringLiteral("kn");
+	QTest::newRow("citep-options") << QStringLiteral("\\citep[see][p.~5]{knuth84,lam") << true << static_cast<int>(Kind::Citation) << QStringLiteral("lam");
+	QTest::newRow("Textcite") << QStringLiteral("\\Textcite{") << true << static_cast<int>(Kind::Citation) << QString();
+	QTest::newRow("begin") << QStringLiteral("\\begin{th") << true << static_cast<int>(Kind::Environment) << QStringLiteral("th");
+	QTest::newRow("end") << QStringLiteral("\\end{") << true << static_cast<int>(Kind::Environment) << QString();
+	QTest::newRow("macro") << QStringLiteral("text \\fo") << true << static_cast<int>(Kind::Macro) << QStringLiteral("fo");
+	QTest::newRow("macro-at-start") << QStringLiteral("\\fo") << true << static_cast<int>(Kind::Macro) << QStringLiteral("fo");
+	QTest::newRow("line-break") << QStringLiteral("text\\\\fo") << false << 0 << QString();
+}
+
+void TestDocument::SymbolIndex_completionContext()
+{
+	QFETCH(QString, textBefore);
+	QFETCH(bool, isContext);
+	QFETCH(int, kind);
+	QFETCH(QString, prefix);
+
+	Tw::Document::SymbolIndex::Kind actualKind{Tw::Document::SymbolIndex::Kind::Label};
+	QString actualPrefix;
+	QCOMPARE(Tw::Document::SymbolIndex::completionContext(textBefore, actualKind, actualPrefix), isContext);
+	if (isContext) {
+		QCOMPARE(static_cast<int>(actualKind), kind);
+		QCOMPARE(actualPrefix, prefix);
+	}
+}
+
+void TestDocument::SymbolIndex_complete()
+{
+	using Kind = Tw::Document::SymbolIndex::Kind;
+	using Symbol = Tw::Document::SymbolIndex::Symbol;
+	const QString main{QStringLiteral("main.tex")};
+	const QString chapter{QStringLiteral("chapter.tex")};
+
+	Tw::Document::SymbolIndex index;
+	QCOMPARE(index.complete(Kind::Label, QString()), QStringList());
+
+	index.setFileSymbols(main, {Symbol{Kind::Label, QStringLiteral("sec:intro")}, Symbol{Kind::Label, QStringLiteral("fig:plot")}, Symbol{Kind::Macro, QStringLiteral("sec")}});
+	index.setFileSymbols(chapter, {Symbol{Kind::Label, QStringLiteral("sec:method")}, Symbol{Kind::Label, QStringLiteral("sec:intro")}, Symbol{Kind::Label, QStringLiteral("sec")}});
+
+	QCOMPARE(index.files().size(), 2);
+	QVERIFY(index.containsFile(main));
+	QVERIFY(index.contains(Kind::Label, QStringLiteral("fig:plot")));
+	QVERIFY(!index.contains(Kind::Label, QStringLiteral("fig:")));
+	QVERIFY(!index.contains(Kind::Citation, QStringLiteral("fig:plot")));
+
+	// Completions are sorted, unique, and separate for each kind
+	QCOMPARE(index.complete(Kind::Label, QStringLiteral("sec")), QStringList({QStringLiteral("sec"), QStringLiteral("sec:intro"), QStringLiteral("sec:method")}));
+	QCOMPARE(index.complete(Kind::Label, QStringLiteral("sec:i")), QStringList({QStringLiteral("sec:intro")}));
+	QCOMPARE(index.complete(Kind::Label, QStringLiteral("x")), QStringList());
+	QCOMPARE(index.complete(Kind::Label, QString()), QStringList({QStringLiteral("fig:plot"), QStringLiteral("sec"), QStringLiteral("sec:intro"), QStringLiteral("sec:method")}));
+	QCOMPARE(index.complete(Kind::Label, QString(), 2), QStringList({QStringLiteral("fig:plot"), QStringLiteral("sec")}));
+	QCOMPARE(index.complete(Kind::Macro, QStringLiteral("s")), QStringList({QStringLiteral("sec")}));
+	QCOMPARE(index.complete(Kind::Citation, QString()), QStringList());
+
+	// Updating a file replaces its symbols; symbols defined in other files are
+	// kept
+	index.setFileSymbols(chapter, {Symbol{Kind::Label, QStringLiteral("sec:results")}});
+	QCOMPARE(index.complete(Kind::Label, QStringLiteral("sec")), QStringList({QStringLiteral("sec:intro"), QStringLiteral("sec:results")}));
+
+	index.removeFile(main);
+	QVERIFY(!index.containsFile(main));
+	QCOMPARE(index.complete(Kind::Label, QString()), QStringList({QStringLiteral("sec:results")}));
+	QCOMPARE(index.complete(Kind::Macro, QString()), QStringList());
+
+	index.clear();
+	QCOMPARE(index.files(), QStringList());
+	QCOMPARE(index.complete(Kind::Label, QString()), QStringList());
+}
+
 } // namespace UnitTest
 
 #if defined(STATIC_QT5) && defined(Q_OS_WIN)
@@ -45,6 +45,7 @@ private slots:
 	void tags();
 
 	void getHighlighter();
+	void highlighting();
 	void modelines();
 	void findNextWord_data();
 	void findNextWord();
@@ -52,6 +53,7 @@ private slots:
 	void SpellCheckManager_getDictionaryList();
 	void SpellChecker();
 	void SpellChecker_ignoreWord();
+	void SpellChecker_checkWordsInBackground();
 
 	void Synchronizer_isValid();
 	void Synchronizer_syncTeXFilename();
@@ -64,6 +66,13 @@ private slots:
 
 	void rootFile_data();
 	void rootFile();
+
+	void SymbolIndex_scanTeX();
+	void SymbolIndex_scanBibTeX();
+	void SymbolIndex_scanAux();
+	void SymbolIndex_completionContext_data();
+	void SymbolIndex_completionContext();
+	void SymbolIndex_complete();
 };
 
 } // namespace UnitTest
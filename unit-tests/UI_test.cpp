@@ -1,6 +1,6 @@
 /*
 	This is part of TeXworks, an environment for working with TeX documents
-	Copyright (C) 2019-2023  Stefan Löffler
+	Copyright (C) 2019-2025  Stefan Löffler
 
 	This program is free software; you can redistribute it and/or modify
 	it under the terms of the GNU General Public License as published by
@@ -29,8 +29,11 @@
 
 #include <QDoubleSpinBox>
 #include <QMouseEvent>
+#include <QScrollBar>
 #include <QTabBar>
 
+#include <algorithm>
+
 namespace UnitTest {
 
 class MyScreenCalibrationWidget : public Tw::UI::ScreenCalibrationWidget
@@ -43,6 +46,18 @@ public:
 	QMenu & contextMenu() { return _contextMenu; }
 };
 
+class MyLineNumberWidget : public Tw::UI::LineNumberWidget
+{
+public:
+	explicit MyLineNumberWidget(QTextEdit * parent) : Tw::UI::LineNumberWidget(parent) { }
+	QTextBlock firstVisibleBlock(const int y) const { return Tw::UI::LineNumberWidget::firstVisibleBlock(y); }
+	QList<int> paintedNumbers() const {
+		QList<int> retVal = Tw::UI::LineNumberWidget::paintedNumbers();
+		std::sort(retVal.begin(), retVal.end());
+		return retVal;
+	}
+};
+
 class ClosableTabWidget : public Tw::UI::ClosableTabWidget
 {
 public:
@@ -108,6 +123,40 @@ void TestUI::LineNumberWidget_paint()
 		e.insertPlainText(QStringLiteral("Hello World\n"));
 		w.grab();
 	}
+	{
+		// Painting starts at the first visible line (rather than at the start
+		// of the document)
+		QTextEdit e;
+		e.setPlainText(QStringLiteral("Hello World\n").repeated(1000));
+		e.resize(200, 100);
+		MyLineNumberWidget w(&e);
+		w.setGeometry(0, 0, 100, 100);
+		QVERIFY(e.verticalScrollBar()->maximum() > 0);
+
+		w.grab();
+		QList<int> numbers = w.paintedNumbers();
+		QVERIFY(!numbers.isEmpty());
+		QCOMPARE(numbers.first(), 1);
+		QVERIFY(numbers.size() < 100);
+
+		e.verticalScrollBar()->setValue(e.verticalScrollBar()->maximum() / 2);
+		const int firstBlockNumber = w.firstVisibleBlock(0).blockNumber();
+		QVERIFY(firstBlockNumber > 0);
+		w.grab();
+		numbers = w.paintedNumbers();
+		QVERIFY(!numbers.isEmpty());
+		// The first block returned by the hit test may end just above the
+		// widget, in which case its number is not painted
+		QVERIFY(numbers.first() == firstBlockNumber + 1 || numbers.first() == firstBlockNumber + 2);
+		QCOMPARE(numbers.last() - numbers.first() + 1, numbers.size());
+		QVERIFY(numbers.size() < 100);
+
+		e.verticalScrollBar()->setValue(e.verticalScrollBar()->maximum());
+		w.grab();
+		numbers = w.paintedNumbers();
+		QVERIFY(!numbers.isEmpty());
+		QCOMPARE(numbers.last(), e.document()->blockCount());
+	}
 }
 
 void TestUI::LineNumberWidget_setParent()
@@ -472,6 +521,36 @@ void TestUI::ConsoleWidget_output()
 	}
 }
 
+void TestUI::ConsoleWidget_maximumLineCount()
+{
+	Tw::UI::ConsoleWidget console;
+	QProcess process;
+	const QString cmd{QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("byte_echo_test"))};
+
+	QCOMPARE(console.maximumLineCount(), 0);
+	QCOMPARE(console.transcriptFileName(), QString());
+
+	console.setMaximumLineCount(3);
+	QCOMPARE(console.maximumLineCount(), 3);
+	QVERIFY(!console.transcriptFileName().isEmpty());
+
+	console.setProcess(&process);
+	process.start(cmd, {QStringLiteral("1\\x0a2\\x0a3\\x0a4\\x0a5")});
+	process.waitForStarted();
+	process.waitForFinished();
+
+	QCOMPARE(console.toPlainText(), QStringLiteral("3\n4\n5"));
+	QCOMPARE(console.transcript(), QStringLiteral("1\n2\n3\n4\n5"));
+	QVERIFY(QFileInfo(console.transcriptFileName()).isFile());
+
+	// Clearing the console also clears the transcript
+	console.setProcess(&process);
+	QCOMPARE(console.transcript(), QString());
+
+	console.setMaximumLineCount(0);
+	QCOMPARE(console.transcriptFileName(), QString());
+}
+
 void TestUI::ColorButton_color()
 {
 	const QColor white{Qt::white}, col{qRgb(210, 42, 123)};
@@ -1,6 +1,6 @@
 /*
 	This is part of TeXworks, an environment for working with TeX documents
-	Copyright (C) 2019-2023  Stefan Löffler
+	Copyright (C) 2019-2025  Stefan Löffler
 
 	This program is free software; you can redistribute it and/or modify
 	it under the terms of the GNU General Public License as published by
@@ -48,6 +48,7 @@ private slots:
 
 	void ConsoleWidget_setProcess();
 	void ConsoleWidget_output();
+	void ConsoleWidget_maximumLineCount();
 
 	void ColorButton_color();
 };
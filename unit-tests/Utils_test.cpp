@@ -1,6 +1,6 @@
 /*
 	This is part of TeXworks, an environment for working with TeX documents
-	Copyright (C) 2019-2024  Stefan Löffler
+	Copyright (C) 2019-2025  Stefan Löffler
 
 	This program is free software; you can redistribute it and/or modify
 	it under the terms of the GNU General Public License as published by
@@ -24,11 +24,16 @@
 #include "utils/CommandlineParser.h"
 #include "utils/FileVersionDatabase.h"
 #include "utils/FullscreenManager.h"
+#include "utils/PatternSet.h"
 #include "utils/ResourcesLibrary.h"
 #include "utils/SystemCommand.h"
+#include "utils/TeXLogParser.h"
 #include "utils/TextCodecs.h"
 #include "utils/TypesetManager.h"
 
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QMenuBar>
 #include <QMouseEvent>
 #include <QStatusBar>
@@ -39,6 +44,8 @@
 extern QString GetMacOSVersionString();
 #endif // defined(Q_OS_DARWIN)
 
+Q_DECLARE_METATYPE(Tw::Utils::TeXLogParser::Diagnostic)
+
 namespace Tw {
 namespace Utils {
 bool operator==(const FileVersionDatabase::Record & r1, const FileVersionDatabase::Record & r2)
@@ -802,6 +809,350 @@ void TestUtils::TypesetManager()
 	QCOMPARE(tm.isFileBeingTypeset(fileB), false);
 }
 
+void TestUtils::TypesetManager_queue()
+{
+	Tw::Utils::TypesetManager tm;
+	const QString fileA{QStringLiteral("a")};
+	const QString fileB{QStringLiteral("b")};
+	const QString fileC{QStringLiteral("c")};
+	QObject ownerA, ownerB, ownerC;
+	QStringList startedJobs;
+#if QT_VERSION < QT_VERSION_CHECK(5, 4, 0)
+	QSignalSpy queued(&tm, SIGNAL(typesettingQueued(QString)));
+	QSignalSpy finished(&tm, SIGNAL(typesettingFinished(QString, qint64)));
+#else
+	QSignalSpy queued(&tm, &Tw::Utils::TypesetManager::typesettingQueued);
+	QSignalSpy finished(&tm, &Tw::Utils::TypesetManager::typesettingFinished);
+#endif
+
+	// Jobs "start" by registering with the manager
+	const auto job = [&](const QString & rootFile, QObject * owner) {
+		return [&tm, &startedJobs, rootFile, owner]() {
+			startedJobs << rootFile;
+			tm.startTypesetting(rootFile, owner);
+		};
+	};
+
+	QVERIFY(tm.maxConcurrentJobs() > 0);
+	tm.setMaxConcurrentJobs(2);
+	QCOMPARE(tm.maxConcurrentJobs(), 2);
+	QCOMPARE(tm.elapsedTime(fileA), qint64(-1));
+
+	// 1) Jobs start right away as long as the limit is not reached
+	QCOMPARE(tm.queueTypesetting(fileA, &ownerA, job(fileA, &ownerA)), true);
+	QCOMPARE(tm.queueTypesetting(fileB, &ownerB, job(fileB, &ownerB)), true);
+	QCOMPARE(startedJobs, QStringList({fileA, fileB}));
+	QCOMPARE(tm.runningJobCount(), 2);
+	QCOMPARE(tm.queuedJobCount(), 0);
+	QVERIFY(tm.elapsedTime(fileA) >= 0);
+
+	// 2) Further jobs are queued
+	QCOMPARE(tm.queueTypesetting(fileC, &ownerC, job(fileC, &ownerC)), true);
+	QCOMPARE(startedJobs.size(), 2);
+	QCOMPARE(tm.isFileQueued(fileC), true);
+	QCOMPARE(tm.isFileBeingTypeset(fileC), false);
+	QCOMPARE(tm.queuedJobCount(), 1);
+	QCOMPARE(queued.count(), 3);
+
+	// 3) Requests for files that are running or queued are rejected
+	QCOMPARE(tm.queueTypesetting(fileA, &ownerC, job(fileA, &ownerC)), false);
+	QCOMPARE(tm.queueTypesetting(fileC, &ownerA, job(fileC, &ownerA)), false);
+	QCOMPARE(tm.queueTypesetting(QString(), &ownerA, job(fileC, &ownerA)), false);
+	QCOMPARE(tm.queueTypesetting(fileC, nullptr, job(fileC, nullptr)), false);
+	QCOMPARE(tm.queuedJobCount(), 1);
+	QCOMPARE(queued.count(), 3);
+
+	// 4) Finishing a job starts the next one
+	tm.finishTypesetting(&ownerA);
+	QCOMPARE(startedJobs, QStringList({fileA, fileB, fileC}));
+	QCOMPARE(tm.isFileQueued(fileC), false);
+	QVERIFY(tm.getOwnerForRootFile(fileC) == &ownerC);
+	QCOMPARE(tm.runningJobCount(), 2);
+	QCOMPARE(finished.count(), 1);
+	QCOMPARE(finished.first().at(0).toString(), fileA);
+	QVERIFY(finished.first().at(1).toLongLong() >= 0);
+	QCOMPARE(tm.elapsedTime(fileA), qint64(-1));
+
+	// 5) Queued jobs of destroyed owners are dropped
+	{
+		QObject owner;
+		QCOMPARE(tm.queueTypesetting(fileA, &owner, job(fileA, &owner)), true);
+		QCOMPARE(tm.isFileQueued(fileA), true);
+	}
+	QCOMPARE(tm.isFileQueued(fileA), false);
+	// Jobs that are stopped (rather than finished) are not reported as finished
+	tm.stopTypesetting(&ownerB);
+	QCOMPARE(startedJobs.size(), 3);
+	QCOMPARE(finished.count(), 1);
+
+	// 6) Jobs that fail to start don't block the queue
+	tm.setMaxConcurrentJobs(1);
+	QCOMPARE(tm.queueTypesetting(fileA, &ownerA, [&startedJobs]() { startedJobs << QStringLiteral("failed"); }), true);
+	QCOMPARE(tm.queueTypesetting(fileB, &ownerB, job(fileB, &ownerB)), true);
+	QCOMPARE(startedJobs.size(), 3);
+	tm.stopTypesetting(&ownerC);
+	QCOMPARE(startedJobs, QStringList({fileA, fileB, fileC, QStringLiteral("failed"), fileB}));
+	QCOMPARE(tm.runningJobCount(), 1);
+	QCOMPARE(tm.queuedJobCount(), 0);
+	tm.stopTypesetting(&ownerB);
+	QCOMPARE(tm.runningJobCount(), 0);
+}
+
+// The test cases were written for the logParser.js script and hold the expected
+// results as JavaScript array literals; this converts them to proper JSON
+static QJsonArray parseLogParserJSArray(QString js)
+{
+	static const QStringList severities{QStringLiteral("BadBox"), QStringLiteral("Warning"), QStringLiteral("Error"), QStringLiteral("Debug")};
+	for (int i = 0; i < severities.size(); ++i)
+		js.replace(QStringLiteral("Severity.") + severities[i], QString::number(i));
+	js.replace(QRegularExpression(QStringLiteral(":\\s*undefined\\b")), QStringLiteral(":null"));
+	js.replace(QRegularExpression(QStringLiteral(",(\\s*[\\]}])")), QStringLiteral("\\1"));
+	return QJsonDocument::fromJson(js.toUtf8()).array();
+}
+
+static QString readLogParserTestFile(const QString & path)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return {};
+	return QString::fromUtf8(file.readAll()).replace(QStringLiteral("\r\n"), QStringLiteral("\n"));
+}
+
+void TestUtils::TeXLogParser_data()
+{
+	QTest::addColumn<QString>("output");
+	QTest::addColumn<QVector<Tw::Utils::TeXLogParser::Diagnostic>>("expected");
+	QTest::addColumn<QStringList>("existingFiles");
+
+	const QString marker{QStringLiteral("-----BEGIN OUTPUT BLOCK-----\n")};
+
+	for (const QString & dirName : {QStringLiteral("tests-miktex"), QStringLiteral("tests-texlive-ubuntu")}) {
+		const QDir dir(QStringLiteral("logParser/") + dirName);
+		QStringList existingFiles;
+		for (const QJsonValue & file : parseLogParserJSArray(readLogParserTestFile(dir.filePath(QStringLiteral("files.js")))))
+			existingFiles << file.toString();
+		QVERIFY(!existingFiles.isEmpty());
+
+		const QStringList testFiles = dir.entryList({QStringLiteral("*.test")}, QDir::Files, QDir::Name);
+		QVERIFY(!testFiles.isEmpty());
+		for (const QString & testFile : testFiles) {
+			const QString contents = readLogParserTestFile(dir.filePath(testFile));
+			const auto markerPos = contents.indexOf(marker);
+			QVERIFY2(markerPos >= 0, qPrintable(testFile));
+
+			QVector<Tw::Utils::TeXLogParser::Diagnostic> expected;
+			for (const QJsonValue & value : parseLogParserJSArray(contents.left(markerPos))) {
+				const QJsonObject obj = value.toObject();
+				Tw::Utils::TeXLogParser::Diagnostic d;
+				d.severity = static_cast<Tw::Utils::TeXLogParser::Severity>(obj.value(QStringLiteral("Severity")).toInt());
+				d.file = obj.value(QStringLiteral("File")).toString();
+				d.line = obj.value(QStringLiteral("Row")).toVariant().toInt();
+				d.description = obj.value(QStringLiteral("Description")).toString();
+				expected.append(d);
+			}
+			const QString output = contents.mid(markerPos + marker.size());
+			const QString name = dirName + QChar::fromLatin1('/') + testFile;
+
+			QTest::newRow(qPrintable(name)) << output << expected << QStringList();
+			QTest::newRow(qPrintable(name + QStringLiteral(" (known files)"))) << output << expected << existingFiles;
+		}
+	}
+}
+
+void TestUtils::TeXLogParser()
+{
+	using FileExistence = Tw::Utils::TeXLogParser::FileExistence;
+
+	QFETCH(QString, output);
+	QFETCH(QVector<Tw::Utils::TeXLogParser::Diagnostic>, expected);
+	QFETCH(QStringList, existingFiles);
+
+	Tw::Utils::TeXLogParser::FileExistsFunction fileExists;
+	if (!existingFiles.isEmpty()) {
+		// A path exists if it is one of the files or one of their directories
+		fileExists = [existingFiles](const QString & path) {
+			for (const QString & file : existingFiles) {
+				if (file == path || (file.startsWith(path) && (file[path.size()] == QChar::fromLatin1('/') || file[path.size()] == QChar::fromLatin1('\\'))))
+					return FileExistence::Exists;
+			}
+			return FileExistence::DoesNotExist;
+		};
+	}
+
+	// The expected results of this test case lack the warning about the version
+	// of an included pdf file, which the logParser.js script reported as well
+	// (with and without known files)
+	QEXPECT_FAIL("tests-texlive-ubuntu/12.test", "Expected results lack a pdfTeX warning", Continue);
+	QEXPECT_FAIL("tests-texlive-ubuntu/12.test (known files)", "Expected results lack a pdfTeX warning", Continue);
+	QCOMPARE(Tw::Utils::TeXLogParser::parse(output, QString(), fileExists), expected);
+}
+
+void TestUtils::TeXLogParser_chunked_data()
+{
+	TeXLogParser_data();
+}
+
+void TestUtils::TeXLogParser_chunked()
+{
+	QFETCH(QString, output);
+
+	// Feeding the output piece by piece must not make any difference
+	const QVector<Tw::Utils::TeXLogParser::Diagnostic> diagnostics = Tw::Utils::TeXLogParser::parse(output);
+	for (const int chunkSize : {7, 100, 4096}) {
+		Tw::Utils::TeXLogParser parser;
+		for (int i = 0; i < output.size(); i += chunkSize)
+			parser.addOutput(output.mid(i, chunkSize));
+		QVERIFY(!parser.isFinished());
+		parser.finish();
+		QVERIFY(parser.isFinished());
+		QCOMPARE(parser.diagnostics(), diagnostics);
+	}
+}
+
+// Reads the patterns of the shipped configuration file `fileName`; each
+// non-comment line consists of `numFields` whitespace-separated fields, the
+// last of which is the pattern. Sections (as in syntax-patterns.txt) are
+// returned separately.
+static QMap<QString, QStringList> readPatternFile(const QString & fileName, const int numFields)
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
+	constexpr auto SkipEmptyParts = QString::SkipEmptyParts;
+#else
+	constexpr auto SkipEmptyParts = Qt::SkipEmptyParts;
+#endif
+	QMap<QString, QStringList> retVal;
+	QFile file(QDir(QStringLiteral("../res/resfiles/configuration")).filePath(fileName));
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		return retVal;
+	static const QRegularExpression reSection(QStringLiteral("^\\[([^\\]]+)\\]"));
+	static const QRegularExpression reWhitespace(QStringLiteral("\\s+"));
+	QString section{fileName};
+	while (!file.atEnd()) {
+		const QString line = QString::fromUtf8(file.readLine());
+		if (line.startsWith(QChar::fromLatin1('#')))
+			continue;
+		const QRegularExpressionMatch sectionMatch = reSection.match(line);
+		if (sectionMatch.hasMatch()) {
+			section = sectionMatch.captured(1);
+			continue;
+		}
+		const QStringList parts = line.split(reWhitespace, SkipEmptyParts);
+		if (parts.size() == numFields && QRegularExpression(parts.last()).isValid())
+			retVal[section].append(parts.last());
+	}
+	return retVal;
+}
+
+// Finds the closest match by trying each pattern in turn (as
+// TeXHighlighter::highlightBlock() used to)
+static Tw::Utils::PatternSet::Match matchOneByOne(const QVector<QRegularExpression> & patterns, const QString & text, const Tw::Utils::PatternSet::size_type offset)
+{
+	Tw::Utils::PatternSet::Match retVal;
+	for (int i = 0; i < patterns.size(); ++i) {
+		const QRegularExpressionMatch m = patterns[i].match(text, offset);
+		if (m.capturedStart() >= 0 && (retVal.index < 0 || m.capturedStart() < retVal.start)) {
+			retVal.index = i;
+			retVal.start = m.capturedStart();
+			retVal.length = m.capturedLength();
+			retVal.captured1 = m.captured(1);
+		}
+	}
+	return retVal;
+}
+
+void TestUtils::PatternSet_data()
+{
+	QTest::addColumn<QStringList>("patterns");
+	QTest::addColumn<bool>("isCombined");
+
+	const QMap<QString, QStringList> syntaxPatterns = readPatternFile(QStringLiteral("syntax-patterns.txt"), 3);
+	const QMap<QString, QStringList> tagPatterns = readPatternFile(QStringLiteral("tag-patterns.txt"), 2);
+	QVERIFY(syntaxPatterns.contains(QStringLiteral("LaTeX")));
+	QVERIFY(tagPatterns.contains(QStringLiteral("tag-patterns.txt")));
+
+	for (auto it = syntaxPatterns.cbegin(); it != syntaxPatterns.cend(); ++it) {
+		// NB: The Lua long string pattern uses a back-reference
+		QTest::newRow(qPrintable(it.key())) << it.value() << (it.key() != QLatin1String("Lua"));
+	}
+	QTest::newRow("tags") << tagPatterns.value(QStringLiteral("tag-patterns.txt")) << true;
+}
+
+void TestUtils::PatternSet()
+{
+	QFETCH(QStringList, patterns);
+	QFETCH(bool, isCombined);
+
+	const QStringList lines{
+		QStringLiteral("\\documentclass[a4paper]{article} % comment with $math$"),
+		QStringLiteral("\\usepackage [utf8] {inputenc}\\usepackage{amsmath}"),
+		QStringLiteral("\\begin{document}\\section*[short]{A \\emph{title}} text^2_{i} & 50\\% \\\\"),
+		QStringLiteral("%\\chapter{Commented} \\end {document}"),
+		QStringLiteral("   \\subsection{Sub} \\label{sec:sub}"),
+		QStringLiteral("%^^A: dtx comment ^^A more ^^^^^0041b ^^^^0041 ^^^041 ^^41"),
+		QStringLiteral("%<*driver> %</driver> %<<EOF %<@@=test> %<-guard>"),
+		QStringLiteral("%    \\begin{macrocode}\\@namedef{x}\\end{macrocode}"),
+		QStringLiteral("\\starttext \\title[x]{Title} \\subject{S} =[]#<>\"' - + / \\stoptext"),
+		QStringLiteral("<?xml version=\"1.0\"?><!-- c --><tag:sub attr='1'>&amp;</tag:sub><br/>"),
+		QStringLiteral("@article{key, author = {A. Author}, year = 2025} % bib"),
+		QStringLiteral("local s = \"a\\\"b\" .. 'c' .. [==[ long ]] string ]==] -- comment"),
+		QStringLiteral("if x then return 0x1f + 1.5e-3 - .5 end [[unterminated"),
+		QStringLiteral("äöü \\äö \\@x \\: "),
+		QString()
+	};
+
+	QVector<QRegularExpression> regexps;
+	for (const QString & pattern : patterns)
+		regexps.append(QRegularExpression(pattern));
+	QVERIFY(!regexps.isEmpty());
+
+	Tw::Utils::PatternSet patternSet;
+	patternSet.setPatterns(regexps);
+	QCOMPARE(patternSet.isCombined(), isCombined);
+
+	for (const QString & line : lines) {
+		for (Tw::Utils::PatternSet::size_type offset = 0; offset <= line.size(); ++offset) {
+			const Tw::Utils::PatternSet::Match expected = matchOneByOne(regexps, line, offset);
+			const Tw::Utils::PatternSet::Match actual = patternSet.match(line, offset);
+			const QByteArray where = (line + QStringLiteral(" @ ") + QString::number(offset)).toUtf8();
+			QVERIFY2(actual.index == expected.index, where.constData());
+			if (expected.index < 0)
+				continue;
+			QVERIFY2(actual.start == expected.start, where.constData());
+			QVERIFY2(actual.length == expected.length, where.constData());
+			QVERIFY2(actual.captured1 == expected.captured1, where.constData());
+		}
+	}
+}
+
+void TestUtils::PatternSet_backReferences()
+{
+	using size_type = Tw::Utils::PatternSet::size_type;
+
+	const QVector<QRegularExpression> patterns{
+		QRegularExpression(QStringLiteral("[a-z]+")),
+		QRegularExpression(QStringLiteral("(['\"]).*?\\1"))
+	};
+	const QString text{QStringLiteral("\"it's\" x")};
+
+	// Combining the patterns would make \1 refer to the first pattern
+	Tw::Utils::PatternSet patternSet;
+	patternSet.setPatterns(patterns);
+	QVERIFY(!patternSet.isCombined());
+
+	const Tw::Utils::PatternSet::Match match = patternSet.match(text, 0);
+	QCOMPARE(match.index, 1);
+	QCOMPARE(match.start, size_type(0));
+	QCOMPARE(match.length, size_type(6));
+	QCOMPARE(match.captured1, QStringLiteral("\""));
+
+	const Tw::Utils::PatternSet::Match next = patternSet.match(text, 6);
+	QCOMPARE(next.index, 0);
+	QCOMPARE(next.start, size_type(7));
+	QCOMPARE(next.length, size_type(1));
+
+	QCOMPARE(patternSet.match(text, text.size()).index, -1);
+}
+
 #ifdef Q_OS_DARWIN
 void TestUtils::OSVersionString()
 {
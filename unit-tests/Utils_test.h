@@ -1,6 +1,6 @@
 /*
 	This is part of TeXworks, an environment for working with TeX documents
-	Copyright (C) 2019-2022  Stefan Löffler
+	Copyright (C) 2019-2025  Stefan Löffler
 
 	This program is free software; you can redistribute it and/or modify
 	it under the terms of the GNU General Public License as published by
@@ -51,6 +51,16 @@ private slots:
 	void ResourcesLibrary_portableLibPath();
 
 	void TypesetManager();
+	void TypesetManager_queue();
+
+	void TeXLogParser_data();
+	void TeXLogParser();
+	void TeXLogParser_chunked_data();
+	void TeXLogParser_chunked();
+
+	void PatternSet_data();
+	void PatternSet();
+	void PatternSet_backReferences();
 
 #ifdef Q_OS_DARWIN
 	void OSVersionString();